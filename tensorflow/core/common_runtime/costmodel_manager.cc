@@ -32,6 +32,10 @@ CostModelManager::~CostModelManager() {
 
 CostModel* CostModelManager::FindOrCreateCostModel(const Graph* graph) {
   mutex_lock l(mu_);
+  return FindOrCreateCostModelLocked(graph);
+}
+
+CostModel* CostModelManager::FindOrCreateCostModelLocked(const Graph* graph) {
   auto it = cost_models_.find(graph);
   if (it != cost_models_.end()) {
     return it->second;
@@ -42,6 +46,19 @@ CostModel* CostModelManager::FindOrCreateCostModel(const Graph* graph) {
   return cost_model;
 }
 
+void CostModelManager::AddOnlineTimeEstimates(
+    const Graph* graph, const std::vector<Microseconds>& estimates) {
+  mutex_lock l(mu_);
+  CostModel* cost_model = FindOrCreateCostModelLocked(graph);
+  for (const Node* n : graph->nodes()) {
+    if (static_cast<size_t>(n->id()) >= estimates.size()) continue;
+    const Microseconds estimate = estimates[n->id()];
+    if (estimate > Microseconds(0)) {
+      cost_model->RecordOnlineTimeEstimate(n, estimate);
+    }
+  }
+}
+
 bool CostModelManager::RemoveCostModelForGraph(const Graph* graph) {
   mutex_lock l(mu_);
   auto itr = cost_models_.find(graph);
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_COSTMODEL_MANAGER_H_
 
 #include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/cost_graph.pb.h"
 #include "tensorflow/core/graph/costmodel.h"
@@ -41,11 +42,20 @@ class CostModelManager {
 
   CostModel* FindOrCreateCostModel(const Graph* graph);
 
+  // Records `estimates`, the execution times of the nodes of `graph` indexed
+  // by node id, as estimated online by the executor of `graph`, in the cost
+  // model of `graph`. Estimates of 0 are ignored.
+  void AddOnlineTimeEstimates(const Graph* graph,
+                              const std::vector<Microseconds>& estimates);
+
   bool RemoveCostModelForGraph(const Graph* graph);
 
   Status AddToCostGraphDef(const Graph* graph, CostGraphDef* cost_graph);
 
  private:
+  CostModel* FindOrCreateCostModelLocked(const Graph* graph)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   mutex mu_;
   CostModelMap cost_models_ TF_GUARDED_BY(mu_);
 };
@@ -39,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/optimization_registry.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
+#include "tensorflow/core/common_runtime/request_scheduler.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/function.h"
@@ -303,6 +304,26 @@ static RunHandlerPool* GetOrCreateRunHandlerPool(
   return pool;
 }
 
+// Returns the process-wide scheduler of the Run() calls of the sessions that
+// use the request scheduler. Like the global inter-op thread pool it replaces,
+// it is configured by the options of the first session that uses it.
+static RequestScheduler* GetOrCreateRequestScheduler(
+    const SessionOptions& options) {
+  static RequestScheduler* scheduler = [&]() {
+    const int num_threads = NumInterOpThreadsFromSessionOptions(options);
+    const int max_intra_op_parallelism = std::max(
+        0, options.config.experimental()
+               .request_scheduler_max_intra_op_parallelism());
+    LOG(INFO) << "Creating request scheduler with " << num_threads
+              << " inter-op threads and an intra-op parallelism of "
+              << max_intra_op_parallelism << " per request";
+    return new RequestScheduler(options.env, ThreadOptions(),
+                                "tf_request_scheduler", num_threads,
+                                max_intra_op_parallelism);
+  }();
+  return scheduler;
+}
+
 bool DirectSession::ShouldUseRunHandlerPool(
     const RunOptions& run_options) const {
   if (options_.config.use_per_session_threads()) return false;
@@ -639,6 +660,20 @@ Status DirectSession::RunInternal(
   }
   auto* handler_ptr = handler.get();
 
+  // The request ends, waiting for all of its closures, when RunInternal()
+  // returns, after all of the executors are done.
+  std::unique_ptr<RequestScheduler::Request> request;
+  RequestScheduler* request_scheduler = nullptr;
+  if (handler == nullptr && pool != nullptr && !inline_execution_requested &&
+      threadpool_options.inter_op_threadpool == nullptr &&
+      ShouldUseRunHandlerPool(run_options) &&
+      options_.config.experimental().use_request_scheduler()) {
+    VLOG(1) << "Using RequestScheduler to schedule inter-op closures.";
+    request_scheduler = GetOrCreateRequestScheduler(options_);
+    request = request_scheduler->StartRequest();
+  }
+  auto* request_ptr = request.get();
+
   Executor::Args::Runner default_runner = nullptr;
 
   if (pool == nullptr) {
@@ -647,6 +682,10 @@ Status DirectSession::RunInternal(
     default_runner = [handler_ptr](Executor::Args::Closure c) {
       handler_ptr->ScheduleInterOpClosure(std::move(c));
     };
+  } else if (request_ptr != nullptr) {
+    default_runner = [request_ptr](Executor::Args::Closure c) {
+      request_ptr->ScheduleInterOpClosure(std::move(c));
+    };
   } else {
     default_runner = [pool](Executor::Args::Closure c) {
       pool->Schedule(std::move(c));
@@ -677,6 +716,8 @@ Status DirectSession::RunInternal(
   args.sync_on_finish = sync_on_finish_;
   args.user_intra_op_threadpool = threadpool_options.intra_op_threadpool;
   args.run_all_kernels_inline = pool == nullptr;
+  args.critical_path_scheduling =
+      options_.config.experimental().enable_critical_path_scheduling();
   args.start_time_usecs = start_time_usecs;
   args.deadline = deadline;
 
@@ -717,8 +758,9 @@ Status DirectSession::RunInternal(
   Status run_status;
 
   auto set_threadpool_args_for_item =
-      [&default_runner, &handler](const PerPartitionExecutorsAndLib& item,
-                                  Executor::Args* args) {
+      [&default_runner, &handler, request_ptr, request_scheduler,
+       &threadpool_options](const PerPartitionExecutorsAndLib& item,
+                            Executor::Args* args) {
         // TODO(azaks): support partial run.
         // TODO(azaks): if the device picks its own threadpool, we need to
         // assign
@@ -737,6 +779,16 @@ Status DirectSession::RunInternal(
         if (handler != nullptr) {
           args->user_intra_op_threadpool =
               handler->AsIntraThreadPoolInterface();
+        } else if (request_ptr != nullptr &&
+                   request_scheduler->max_intra_op_parallelism() > 0 &&
+                   threadpool_options.intra_op_threadpool == nullptr) {
+          const DeviceBase::CpuWorkerThreads* worker_threads =
+              item.device->tensorflow_cpu_worker_threads();
+          args->user_intra_op_threadpool = nullptr;
+          if (worker_threads != nullptr && worker_threads->workers != nullptr) {
+            args->user_intra_op_threadpool = request_ptr->IntraOpThreadPool(
+                worker_threads->workers->AsEigenThreadPool());
+          }
         }
       };
 
@@ -813,6 +865,11 @@ Status DirectSession::RunInternal(
 
     mutex_lock l(executor_lock_);
     run_state.collector->BuildCostModel(&cost_model_manager_, device_to_graph);
+    for (const PerPartitionExecutorsAndLib& partition :
+         executors_and_keys->items) {
+      partition.executor->ExportCostEstimates(*partition.graph,
+                                              &cost_model_manager_);
+    }
 
     // annotate stats onto cost graph.
     CostGraphDef* cost_graph = run_metadata->mutable_cost_graph();
@@ -987,6 +1044,8 @@ Status DirectSession::PRunSetup(const std::vector<string>& input_names,
   // Create the run state and save it for future PRun calls.
   Executor::Args args;
   args.step_id = step_id_counter_.fetch_add(1);
+  args.critical_path_scheduling =
+      options_.config.experimental().enable_critical_path_scheduling();
   PartialRunState* run_state =
       new PartialRunState(input_names, output_names, args.step_id, &devices_);
   run_state->rendez.reset(new IntraProcessRendezvous(device_mgr_.get()));
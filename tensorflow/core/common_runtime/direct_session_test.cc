@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/direct_session.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <random>
@@ -44,6 +45,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/core/platform/test.h"
@@ -153,6 +155,29 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork) {
   EXPECT_FLOAT_EQ(5.0, mat(0, 0));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithRequestScheduler) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options = DefaultSessionOptions();
+  options.config.mutable_experimental()->set_use_request_scheduler(true);
+  options.config.mutable_experimental()
+      ->set_request_scheduler_max_intra_op_parallelism(2);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  // Concurrent calls each run on their own queue of the scheduler.
+  thread::ThreadPool clients(Env::Default(), "clients", 4);
+  for (int i = 0; i < 16; ++i) {
+    clients.Schedule([&session, this]() {
+      std::vector<Tensor> outputs;
+      TF_EXPECT_OK(session->Run({}, {y_ + ":0", z_ + ":0"}, {}, &outputs));
+      ASSERT_EQ(2, outputs.size());
+      EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+      EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+    });
+  }
+}
+
 TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_Callable) {
   Initialize({3, 2, -1, 0});
   auto session = CreateSession();
@@ -2733,6 +2758,106 @@ BENCHMARK(BM_FeedFetchCallableSingleThreadExecutor)
     ->Arg(5)
     ->Arg(10);
 
+// A load generator for mixed traffic. Concurrent clients issue small and large
+// Run() calls, and the label reports the 50th and 99th percentile latencies of
+// the small calls. The large calls run many independent MatMul chains, which
+// with the shared inter-op thread pool queue ahead of the small calls.
+// Arg(1) runs the calls on the request scheduler instead.
+void BM_MixedSizeRequests(::testing::benchmark::State& state) {
+  const bool use_request_scheduler = state.range(0);
+  // One in four clients sends large calls.
+  constexpr int kNumClients = 8;
+  constexpr int kLargeClientEvery = 4;
+  constexpr int kRequestsPerClient = 16;
+  constexpr int kNumLargeBranches = 16;
+  constexpr int kChainLength = 4;
+
+  Graph g(OpRegistry::Global());
+  auto add_input = [&g](std::vector<std::pair<string, Tensor>>* feeds,
+                        int64_t size) {
+    Node* placeholder;
+    TF_CHECK_OK(NodeBuilder(g.NewName("Placeholder"), "Placeholder")
+                    .Attr("shape", TensorShape({size, size}))
+                    .Attr("dtype", DT_FLOAT)
+                    .Device("/cpu:0")
+                    .Finalize(&g, &placeholder));
+    Tensor value(DT_FLOAT, TensorShape({size, size}));
+    // Keeps the products of the chains at 1 / size.
+    value.flat<float>().setConstant(1.0f / size);
+    feeds->push_back({placeholder->name(), value});
+    return placeholder;
+  };
+  auto add_chain = [&g](Node* x) {
+    for (int i = 0; i < kChainLength; ++i) {
+      x = test::graph::Matmul(&g, x, x, false, false);
+    }
+    return x->name();
+  };
+
+  std::vector<std::pair<string, Tensor>> small_feeds;
+  std::vector<string> small_fetches = {add_chain(add_input(&small_feeds, 32))};
+  std::vector<std::pair<string, Tensor>> large_feeds;
+  Node* large_input = add_input(&large_feeds, 256);
+  std::vector<string> large_fetches;
+  for (int i = 0; i < kNumLargeBranches; ++i) {
+    large_fetches.push_back(add_chain(large_input));
+  }
+
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+  SessionOptions opts;
+  opts.config.set_inter_op_parallelism_threads(4);
+  opts.config.mutable_experimental()->set_use_request_scheduler(
+      use_request_scheduler);
+  std::unique_ptr<Session> session(NewSession(opts));
+  TF_CHECK_OK(session->Create(gd));
+
+  auto run = [&](bool large) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run(large ? large_feeds : small_feeds,
+                             large ? large_fetches : small_fetches, {},
+                             &outputs));
+  };
+  // Ignore the first runs, which create the executors.
+  run(/*large=*/false);
+  run(/*large=*/true);
+
+  thread::ThreadPool clients(Env::Default(), "clients", kNumClients);
+  mutex mu;
+  std::vector<uint64> small_latencies_us;
+  for (auto s : state) {
+    BlockingCounter done(kNumClients);
+    for (int c = 0; c < kNumClients; ++c) {
+      clients.Schedule([&, c]() {
+        const bool large = c % kLargeClientEvery == 0;
+        for (int i = 0; i < kRequestsPerClient; ++i) {
+          const uint64 start_us = Env::Default()->NowMicros();
+          run(large);
+          if (!large) {
+            mutex_lock l(mu);
+            small_latencies_us.push_back(Env::Default()->NowMicros() -
+                                         start_us);
+          }
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+
+  std::sort(small_latencies_us.begin(), small_latencies_us.end());
+  auto percentile = [&small_latencies_us](double p) {
+    const size_t index = static_cast<size_t>(p * small_latencies_us.size());
+    return small_latencies_us[std::min(index, small_latencies_us.size() - 1)];
+  };
+  state.SetLabel(strings::StrCat("small p50 = ", percentile(0.5),
+                                 "us, small p99 = ", percentile(0.99), "us"));
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          kNumClients * kRequestsPerClient);
+}
+
+BENCHMARK(BM_MixedSizeRequests)->UseRealTime()->Arg(0)->Arg(1);
+
 }  // namespace
 
 class DirectSessionCollectiveTest : public ::testing::Test {
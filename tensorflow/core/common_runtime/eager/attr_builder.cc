@@ -258,6 +258,8 @@ const NodeDef& AttrBuilder::BuildNodeDef() {
 void AttrBuilder::CopyAttributes(const AttrBuilder& other) {
   encoded_attrs_.insert(other.encoded_attrs_.begin(),
                         other.encoded_attrs_.end());
+  node_def_finalized_ = false;
+  cached_cache_key_ = std::nullopt;
 }
 
 Status AttrTypeByName(const AttrTypeMap& m, const string& attr_name,
@@ -113,7 +113,13 @@ class AttrBuilder : public AbstractOpAttrs {
   }
 
   const string& op_name() const { return op_name_; }
-  void set_op_name(const string& name) { op_name_ = name; }
+  // Renaming the op invalidates the NodeDef and the cache key, both of which
+  // include the op name.
+  void set_op_name(const string& name) {
+    op_name_ = name;
+    node_def_finalized_ = false;
+    cached_cache_key_ = std::nullopt;
+  }
 
   // Needed to work around call to ValidateNodeDef in CreateOpKernel.
   AttrBuilder& NumInputs(int n);
@@ -1717,7 +1717,10 @@ Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
 
   // Run all the registered rewrite pass after the placement, regardless whether
   // the placement is successful or not. The passes can either create new ops
-  // (without placement) or update some fields of the input op.
+  // (without placement) or update some fields of the input op. The latter
+  // shows up as a change of the op's cache key.
+  const Fprint128 attrs_cache_key =
+      op->MutableAttrs()->CacheKey(op->DeviceName());
   std::unique_ptr<tensorflow::EagerOperation> out_op;
   TF_RETURN_IF_ERROR(EagerOpRewriteRegistry::Global()->RunRewrite(
       EagerOpRewriteRegistry::POST_PLACEMENT, op, &out_op));
@@ -1728,6 +1731,11 @@ Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
     if (op->Device() == kVariantDeviceNull) {
       status = GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel);
     }
+  } else if (!(op->MutableAttrs()->CacheKey(op->DeviceName()) ==
+               attrs_cache_key)) {
+    // The op was rewritten in place, so the kernel looked up above no longer
+    // matches it.
+    status = GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel);
   }
   if (!status.ok()) return status;
 
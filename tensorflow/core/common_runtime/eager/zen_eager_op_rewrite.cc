@@ -18,9 +18,18 @@ limitations under the License.
 #include <string>
 #include <unordered_map>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/eager/attr_builder.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
 #include "tensorflow/core/common_runtime/eager/eager_op_rewrite_registry.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/graph/zen_graph_util.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/port.h"
 #include "tensorflow/core/util/zen_util.h"
 
@@ -34,9 +43,10 @@ class ZenEagerOpRewrite : public EagerOpRewrite {
   struct ZenEagerOp {
     string op_name;
     string zen_op_name;
-    std::function<bool(EagerOperation *)> rewrite_rule;
+    // Rewrite record shared with the Zen graph rewrite pass.
+    const zen_op_registry::ZenRewriteInfo *info;
     std::function<Status(EagerOperation *, std::unique_ptr<EagerOperation> *,
-                         string)>
+                         const string &)>
         create_zen_op;
   };
 
@@ -44,42 +54,57 @@ class ZenEagerOpRewrite : public EagerOpRewrite {
   // Maintain record of Zen op to rewrite.
   std::unordered_map<std::string, ZenEagerOp> zen_eager_ops_;
 
+  // Rewrite decisions of ShouldRewriteOp() for ops in 'zen_eager_ops_',
+  // keyed by the attribute cache key of the op, which covers its name, device
+  // and attributes. A null entry records that the op is not rewritten. The
+  // cache is dropped whenever the kernel registry changes or it holds
+  // kMaxCachedDecisions entries.
+  static constexpr size_t kMaxCachedDecisions = 4096;
+  mutex decision_mu_;
+  absl::flat_hash_map<Fprint128, const ZenEagerOp *, Fprint128Hasher>
+      decision_cache_ TF_GUARDED_BY(decision_mu_);
+  uint64 decision_cache_generation_ TF_GUARDED_BY(decision_mu_) = 0;
+
   // The entry point to execute the op rewrite.
   Status Run(EagerOperation *orig_op,
              std::unique_ptr<tensorflow::EagerOperation> *out_op);
 
   // Generic rewrite for any Zen op that doesn't need special processing. It
-  // initializes new Zen op, sets up its inputs and attributes.
+  // retargets the original op in place, or clones it into a new Zen op when
+  // in-place rewrite is disabled.
   static Status CreateGenericZenOp(EagerOperation *orig_op,
                                    std::unique_ptr<EagerOperation> *zen_op,
-                                   string zen_op_name);
-
-  // Calls op-specific rewrite function to create new Zen op.
-  Status RewriteToZenOp(
-      EagerOperation *orig_op, std::unique_ptr<EagerOperation> *zen_op,
-      std::unordered_map<std::string, ZenEagerOp>::iterator *it);
-
-  // Check whether we can rewrite the original op with Zen op, or not.
-  bool ShouldRewriteOp(
-      EagerOperation *op,
-      std::unordered_map<std::string, ZenEagerOp>::iterator *it);
-
-  // Default rewrite rule that always rewrites for float data type.
-  static bool AlwaysRewriteFloat(EagerOperation *op) {
-    DataType data_type;
-    const NodeDef &kNodeDef = op->MutableAttrs()->BuildNodeDef();
-    TF_CHECK_OK(GetNodeAttr(kNodeDef, "T", &data_type));
-    return (data_type == DT_FLOAT);
-  }
+                                   const string &zen_op_name);
+
+  // Initializes new Zen op, sets up its inputs and attributes. Attributes that
+  // the Zen op does not declare are not copied, as in the graph rewrite.
+  static Status CloneToZenOp(EagerOperation *orig_op,
+                             std::unique_ptr<EagerOperation> *zen_op,
+                             const string &zen_op_name);
+
+  // Switches the original op to the Zen op and appends the Zen attributes to
+  // its AttrBuilder. Neither a new op nor a NodeDef is created, and 'zen_op'
+  // is left untouched.
+  static Status RetargetToZenOp(EagerOperation *orig_op,
+                                const string &zen_op_name);
+
+  // Attributes that every Zen op gets in eager mode, encoded once.
+  static const AttrBuilder &ZenEagerAttrs();
+
+  // Returns the rewrite record of the op, or nullptr if the op is not to be
+  // rewritten. Ops without a rewrite record or not placed on CPU are rejected
+  // without a lookup in 'decision_cache_'; the decisions for the others are
+  // served from it after the first lookup.
+  const ZenEagerOp *FindRewrite(EagerOperation *op);
+
+  // Check whether we can rewrite the original op with the Zen op of
+  // 'zen_eager_op', or not. Rewrite rules may only depend on the op's name,
+  // device and attributes, as the result is cached on those.
+  static bool ShouldRewriteOp(EagerOperation *op,
+                              const ZenEagerOp &zen_eager_op);
 
   // Helper function to insert zen_eager_ops to map.
   void InsertZenEagerOps(ZenEagerOp op);
-
-  // List of eager ops that can be rewritten with Zen ops. The list is sorted in
-  // alphabetical order.
-  const std::vector<string> kAlwaysRewriteOps = {
-      "AvgPool",          "Conv2D", "FusedBatchNorm", "FusedBatchNormV2",
-      "FusedBatchNormV3", "MatMul", "MaxPool",        "Softmax"};
 };
 
 // The priority value must be higher than MklEagerOpRewrite (10000) so that Zen
@@ -90,9 +115,17 @@ REGISTER_REWRITE(EagerOpRewriteRegistry::POST_PLACEMENT, 30000,
 // Constructor
 ZenEagerOpRewrite::ZenEagerOpRewrite(string name, string file, string line)
     : EagerOpRewrite(name, file, line) {
-  for (const auto &op_name : kAlwaysRewriteOps) {
-    InsertZenEagerOps({op_name, zen_op_registry::GetZenOpName(op_name),
-                       AlwaysRewriteFloat, CreateGenericZenOp});
+  // Ops are rewritten as by the Zen graph rewrite pass. Ops of which only some
+  // attributes are carried over to the Zen op are always cloned, since
+  // attributes cannot be removed from an op in place.
+  for (const auto &info : zen_op_registry::GetZenRewriteInfos()) {
+    if (info.attr_update == zen_op_registry::ZenAttrUpdate::kCopy) {
+      InsertZenEagerOps(
+          {info.tf_op_name, info.zen_op_name, &info, CreateGenericZenOp});
+    } else {
+      InsertZenEagerOps(
+          {info.tf_op_name, info.zen_op_name, &info, CloneToZenOp});
+    }
   }
 }
 
@@ -103,17 +136,68 @@ void ZenEagerOpRewrite::InsertZenEagerOps(ZenEagerOp op) {
 Status ZenEagerOpRewrite::Run(
     EagerOperation *orig_op,
     std::unique_ptr<tensorflow::EagerOperation> *out_op) {
-  std::unordered_map<std::string, ZenEagerOp>::iterator it;
-  // Don't rewrite the op if TF-ZenDNN use is disabled at runtime.
-  if (IsZenDnnEnabled() && ShouldRewriteOp(orig_op, &it)) {
-    TF_CHECK_OK(RewriteToZenOp(orig_op, out_op, &it));
+  // Don't rewrite the op if TF-ZenDNN use is disabled for the context.
+  const ZenDnnConfig config =
+      GetZenDnnConfig(&orig_op->EagerContext().session_options().config);
+  if (!config.enabled) {
+    return OkStatus();
+  }
+  const ZenEagerOp *zen_eager_op = FindRewrite(orig_op);
+  // Ops only supported for NHWC execution are not rewritten when the context
+  // runs with blocked format.
+  if (zen_eager_op != nullptr &&
+      !(zen_eager_op->info->nhwc_only && config.blocked_format)) {
+    TF_CHECK_OK(zen_eager_op->create_zen_op(orig_op, out_op,
+                                            zen_eager_op->zen_op_name));
+    // Forward the memory pool mode and the convolution algorithm of the
+    // context to the Zen kernel.
+    EagerOperation *zen_op = *out_op != nullptr ? out_op->get() : orig_op;
+    if (config.session_mempool) {
+      zen_op->MutableAttrs()->Set(kZenMempoolAttr, config.mempool);
+    }
+    if (config.session_conv_algo) {
+      zen_op->MutableAttrs()->Set(kZenConvAlgoAttr, config.conv_algo);
+    }
   }
   return OkStatus();
 }
 
 Status ZenEagerOpRewrite::CreateGenericZenOp(
     EagerOperation *orig_op, std::unique_ptr<EagerOperation> *zen_op,
-    string zen_op_name) {
+    const string &zen_op_name) {
+  if (IsZenEagerInplaceRewriteEnabled()) {
+    return RetargetToZenOp(orig_op, zen_op_name);
+  }
+  return CloneToZenOp(orig_op, zen_op, zen_op_name);
+}
+
+const AttrBuilder &ZenEagerOpRewrite::ZenEagerAttrs() {
+  static const AttrBuilder *zen_eager_attrs = [] {
+    AttrBuilder *attrs = new AttrBuilder();
+    attrs->Set("is_eager", true);
+    attrs->Set("reorder_before", false);
+    attrs->Set("reorder_after", false);
+    attrs->Set("in_links", 1);
+    attrs->Set("out_links", 1);
+    attrs->Set("reset", true);
+    return attrs;
+  }();
+  return *zen_eager_attrs;
+}
+
+Status ZenEagerOpRewrite::RetargetToZenOp(EagerOperation *orig_op,
+                                          const string &zen_op_name) {
+  VLOG(1) << " TF-EAGER-REWRITE Info: OriginalOp= " << orig_op->Name()
+          << " ZenOp=" << zen_op_name << " (in place)";
+  // 'zen_op_name' lives in 'zen_eager_ops_', which outlives the op.
+  orig_op->UpdateName(zen_op_name);
+  orig_op->MutableAttrs()->CopyAttributes(ZenEagerAttrs());
+  return OkStatus();
+}
+
+Status ZenEagerOpRewrite::CloneToZenOp(EagerOperation *orig_op,
+                                       std::unique_ptr<EagerOperation> *zen_op,
+                                       const string &zen_op_name) {
   VLOG(1) << " TF-EAGER-REWRITE Info: OriginalOp= " << orig_op->Name()
           << " ZenOp=" << zen_op_name;
 
@@ -126,10 +210,18 @@ Status ZenEagerOpRewrite::CreateGenericZenOp(
     TF_RETURN_IF_ERROR((*zen_op)->AddInput(input));
   }
 
-  // Copy all attributes to the Zen op.
+  // Copy the attributes declared by the Zen op, and internal attributes, to
+  // the Zen op.
+  const OpDef *zen_op_def = nullptr;
+  TF_RETURN_IF_ERROR(
+      OpRegistry::Global()->LookUpOpDef(zen_op_name, &zen_op_def));
   const NodeDef &kOrigNodeDef = orig_op->MutableAttrs()->BuildNodeDef();
   AttrSlice attr_list(kOrigNodeDef);
   for (const auto &attr : attr_list) {
+    if (!absl::StartsWith(attr.first, "_") &&
+        FindAttr(attr.first, *zen_op_def) == nullptr) {
+      continue;
+    }
     (*zen_op)->MutableAttrs()->Set(attr.first, attr.second);
   }
 
@@ -144,35 +236,51 @@ Status ZenEagerOpRewrite::CreateGenericZenOp(
   return (*zen_op)->SetDeviceName(device_name.c_str());
 }
 
-bool ZenEagerOpRewrite::ShouldRewriteOp(
-    EagerOperation *op,
-    std::unordered_map<std::string, ZenEagerOp>::iterator *it) {
+const ZenEagerOpRewrite::ZenEagerOp *ZenEagerOpRewrite::FindRewrite(
+    EagerOperation *op) {
   // Only rewrite if op is to be run on CPU device.
   if (op->GetDeviceParsedName().type != "CPU") {
-    return false;
+    return nullptr;
+  }
+  auto it = zen_eager_ops_.find(op->Name());
+  if (it == zen_eager_ops_.end()) {
+    return nullptr;
+  }
+  const ZenEagerOp *zen_eager_op = &it->second;
+  const Fprint128 key = op->MutableAttrs()->CacheKey(op->DeviceName());
+  const uint64 generation = GetKernelRegistryGeneration();
+  {
+    tf_shared_lock l(decision_mu_);
+    if (decision_cache_generation_ == generation) {
+      auto cached = decision_cache_.find(key);
+      if (cached != decision_cache_.end()) {
+        return cached->second;
+      }
+    }
   }
-  DataType data_type;
-  if (op->Attrs().Get("T", &data_type) != OkStatus()) {
-    return false;
+  if (!ShouldRewriteOp(op, *zen_eager_op)) {
+    zen_eager_op = nullptr;
   }
-  // Find the op and verify the requirements for rewriting it with Zen op.
-  *it = zen_eager_ops_.find(op->Name());
-  if (*it == zen_eager_ops_.end()) {
-    return false;
+  mutex_lock l(decision_mu_);
+  if (decision_cache_generation_ != generation ||
+      decision_cache_.size() >= kMaxCachedDecisions) {
+    decision_cache_.clear();
+    decision_cache_generation_ = generation;
   }
-  // Eager op found, verify that a kernel exists for Zen op and rewrite is
-  // possible.
-  return (zen_op_registry::IsZenOpKernelRegistered(
-              zen_op_registry::GetZenOpName(op->Name()), data_type) &&
-          (*it)->second.rewrite_rule(op));
+  decision_cache_.emplace(key, zen_eager_op);
+  return zen_eager_op;
 }
 
-Status ZenEagerOpRewrite::RewriteToZenOp(
-    EagerOperation *orig_op, std::unique_ptr<EagerOperation> *zen_op,
-    std::unordered_map<std::string, ZenEagerOp>::iterator *it) {
-  TF_RETURN_IF_ERROR(
-      (*it)->second.create_zen_op(orig_op, zen_op, (*it)->second.zen_op_name));
-  return OkStatus();
+bool ZenEagerOpRewrite::ShouldRewriteOp(EagerOperation *op,
+                                        const ZenEagerOp &zen_eager_op) {
+  // Verify that rewrite is possible and that a kernel exists for Zen op. All
+  // type attributes of the op are matched against the type constraints of the
+  // Zen kernels, as in the graph rewrite.
+  const NodeDef &node_def = op->MutableAttrs()->BuildNodeDef();
+  AttrSlice attrs(node_def);
+  return zen_op_registry::IsZenRewriteValid(*zen_eager_op.info, attrs) &&
+         zen_op_registry::IsZenOpKernelRegistered(zen_eager_op.zen_op_name,
+                                                  attrs);
 }
 
 }  // namespace tensorflow
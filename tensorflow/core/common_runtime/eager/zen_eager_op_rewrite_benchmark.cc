@@ -0,0 +1,91 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifdef AMD_ZENDNN
+
+#include <stdlib.h>
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/eager_op_rewrite_registry.h"
+#include "tensorflow/core/common_runtime/eager/eager_operation.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kCpuDevice[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+// Measures the per-op cost of dispatching an eager op through the
+// POST_PLACEMENT rewrites: resetting the op, setting its attributes and
+// running the Zen rewrite on it. Run with TF_ZEN_EAGER_INPLACE_REWRITE=0 to
+// measure the cloning rewrite and with the default setting to measure the
+// in-place one. "Relu" has no Zen rewrite and gives the baseline dispatch cost.
+static void ZenEagerOpRewrite(::testing::benchmark::State& state,
+                              const char* op_name) {
+  setenv("TF_ENABLE_ZENDNN_OPTS", "1", /*overwrite=*/0);
+
+  std::unique_ptr<DeviceMgr> device_mgr = std::make_unique<StaticDeviceMgr>(
+      DeviceFactory::NewDevice("CPU", {}, kCpuDevice));
+  auto rendezvous = tsl::core::RefCountPtr<IntraProcessRendezvous>(
+      new IntraProcessRendezvous(device_mgr.get()));
+  EagerContext* ctx = new EagerContext(
+      SessionOptions(), ContextDevicePlacementPolicy::DEVICE_PLACEMENT_SILENT,
+      /*async=*/false, device_mgr.get(), /*device_mgr_owned=*/false,
+      std::move(rendezvous), nullptr, nullptr,
+      /*run_eager_op_as_function=*/true);
+
+  {
+    EagerExecutor executor(/*async=*/false);
+    EagerOperation op(ctx);
+    for (auto s : state) {
+      TF_CHECK_OK(op.Reset(op_name, nullptr, /*remote=*/false, &executor));
+      TF_CHECK_OK(op.SetDeviceName(kCpuDevice));
+      op.MutableAttrs()->Set("T", DT_FLOAT);
+      if (op.Name() == "MatMul") {
+        op.MutableAttrs()->Set("transpose_a", false);
+        op.MutableAttrs()->Set("transpose_b", false);
+      }
+      // The kernel cache key is computed during placement, before the
+      // rewrites run.
+      op.MutableAttrs()->CacheKey(op.DeviceName());
+      std::unique_ptr<EagerOperation> out_op;
+      TF_CHECK_OK(EagerOpRewriteRegistry::Global()->RunRewrite(
+          EagerOpRewriteRegistry::POST_PLACEMENT, &op, &out_op));
+      tensorflow::testing::DoNotOptimize(out_op);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  ctx->Unref();
+}
+
+static void BM_ZenEagerOpRewrite_MatMul(::testing::benchmark::State& state) {
+  ZenEagerOpRewrite(state, "MatMul");
+}
+BENCHMARK(BM_ZenEagerOpRewrite_MatMul);
+
+static void BM_ZenEagerOpRewrite_Relu(::testing::benchmark::State& state) {
+  ZenEagerOpRewrite(state, "Relu");
+}
+BENCHMARK(BM_ZenEagerOpRewrite_Relu);
+
+}  // namespace
+}  // namespace tensorflow
+
+#endif  // AMD_ZENDNN
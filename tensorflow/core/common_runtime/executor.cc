@@ -141,10 +141,56 @@ struct KernelTimer {
   }
 };
 
+// Returns true for ~1/16 of the calls on each thread, chosen at random, so
+// that the timed invocations of a kernel do not depend on the order in which
+// the thread runs kernels. Cheaper than reading the CPU cycle counter.
+inline bool SampleKernelTiming() {
+  constexpr uint32 kKernelExecutionTrackingInvocationSkipCount = 16;
+  // An xorshift generator, which must not be seeded with 0.
+  static thread_local uint32 state = 0x9e3779b9u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state % kKernelExecutionTrackingInvocationSkipCount == 0;
+}
+
 // TODO(b/152925936): Re-evaluate these constants with current usage patterns.
 typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
 typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
+// Keeps the buffers of finished steps that used a `SimplePropagatorState`,
+// so that later steps can reuse them instead of allocating new buffers.
+class StepBuffersPool {
+ public:
+  // Returns the buffers of a finished step, or nullptr if there are none.
+  std::unique_ptr<SimplePropagatorState::StepBuffers> Get() {
+    {
+      mutex_lock l(mu_);
+      if (!free_.empty()) {
+        std::unique_ptr<SimplePropagatorState::StepBuffers> buffers =
+            std::move(free_.back());
+        free_.pop_back();
+        return buffers;
+      }
+    }
+    metrics::RecordExecutorStepStatePoolMiss("propagator_buffers");
+    return nullptr;
+  }
+
+  void Return(std::unique_ptr<SimplePropagatorState::StepBuffers> buffers) {
+    mutex_lock l(mu_);
+    if (free_.size() < kMaxFreeBuffers) free_.push_back(std::move(buffers));
+  }
+
+ private:
+  // Bounds the memory held by an executor after a burst of concurrent steps.
+  static constexpr size_t kMaxFreeBuffers = 16;
+
+  mutex mu_;
+  std::vector<std::unique_ptr<SimplePropagatorState::StepBuffers>> free_
+      TF_GUARDED_BY(mu_);
+};
+
 class ExecutorImpl : public Executor {
  public:
   explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
@@ -155,6 +201,12 @@ class ExecutorImpl : public Executor {
     return OkStatus();
   }
 
+  void ExportCostEstimates(
+      const Graph& graph, CostModelManager* cost_model_manager) const override {
+    cost_model_manager->AddOnlineTimeEstimates(&graph,
+                                               kernel_stats_.MeasuredTimes());
+  }
+
  private:
   void RunAsyncInternal(const Args& args, DoneCallback done) override;
 
@@ -174,29 +226,57 @@ class ExecutorImpl : public Executor {
         if (gview.node(i)) {
           is_expensive_[i] =
               gview.node(i)->kernel && gview.node(i)->kernel->IsExpensive();
-          cost_estimates_[i] = kInitialCostEstimateCycles;
+          cost_estimates_[i] =
+              is_expensive_[i] ? kInitialCostEstimateCycles : 0;
         }
       }
+      gview_ = &gview;
+      measured_costs_ =
+          std::make_unique<std::atomic_uint_fast64_t[]>(gview.num_nodes());
+      for (auto& priorities : priorities_) {
+        priorities =
+            std::make_unique<std::atomic_uint_fast64_t[]>(gview.num_nodes());
+      }
     }
 
     // Returns true iff the given node is considered "expensive". The
     // executor uses this flag to optimize graph execution, for example
     // by "inlining" inexpensive kernels.
+    //
+    // Kernels with the expensive marker start out expensive, and other
+    // kernels start out inexpensive, until their sampled timings show
+    // otherwise.
     bool IsExpensive(const NodeItem& node) const {
-      return is_expensive_[node.node_id] &&
-             (cost_estimates_[node.node_id].load(std::memory_order_relaxed) >
-              kOpIsExpensiveThresholdCycles);
+      return CostEstimate(node) > kOpIsExpensiveThresholdCycles;
+    }
+
+    // Returns the dynamic cost estimate (in CPU cycles) of the given node.
+    uint64 CostEstimate(const NodeItem& node) const {
+      return cost_estimates_[node.node_id].load(std::memory_order_relaxed);
     }
 
-    // Returns the value of kernel->IsExpensive().
-    bool HasExpensiveMarker(const NodeItem& node) const {
-      return is_expensive_[node.node_id];
+    // Returns the measured cost of every node in microseconds, indexed by
+    // node id. The cost is 0 for nodes that have not been timed.
+    std::vector<Microseconds> MeasuredTimes() const {
+      const double usec_per_cycle =
+          profile_utils::CpuUtils::GetMicroSecPerClock();
+      std::vector<Microseconds> times(gview_->num_nodes(), Microseconds(0));
+      for (int32_t i = 0; i < gview_->num_nodes(); ++i) {
+        const uint64 cycles =
+            measured_costs_[i].load(std::memory_order_relaxed);
+        if (cycles > 0) {
+          // Use at least 1us, so that timed nodes can be told apart.
+          times[i] = Microseconds(std::max<int64_t>(
+              1, static_cast<int64_t>(cycles * usec_per_cycle)));
+        }
+      }
+      return times;
     }
 
     // Updates the dynamic cost estimate, which is used to determine whether the
     // given node is expensive. The new cost estimate is a weighted average of
-    // the old cost estimate and the latest cost. We only update cost estimates
-    // for kernels for which IsExpensive() return true.
+    // the old cost estimate and the latest cost, so a kernel must be timed
+    // several times before its classification changes.
     void UpdateCostEstimate(const NodeItem& node, uint64 elapsed_cycles) {
       // N.B. Updates to `cost_estimate` are atomic but unlocked.  Simultaneous
       // updates may result in one or more updates being ignored.  This does not
@@ -208,27 +288,190 @@ class ExecutorImpl : public Executor {
           ((kCostDecay - 1) * prev_estimate + elapsed_cycles) / kCostDecay;
 
       cost_estimate.store(new_estimate, std::memory_order_relaxed);
+
+      // Unlike `cost_estimate`, which starts out high so that nodes are only
+      // inlined once they have proven to be cheap, the measured cost starts
+      // from the first sample.
+      std::atomic_uint_fast64_t& measured_cost = measured_costs_[node.node_id];
+      auto prev_measured = measured_cost.load(std::memory_order_relaxed);
+      measured_cost.store(
+          prev_measured == 0
+              ? std::max<uint64>(elapsed_cycles, 1)
+              : ((kCostDecay - 1) * prev_measured + elapsed_cycles) /
+                    kCostDecay,
+          std::memory_order_relaxed);
+    }
+
+    // Returns the estimated cost (in CPU cycles) of the longest path from the
+    // given node to a sink of the graph, including the node itself. Ready
+    // nodes with a higher priority are on a longer path and are scheduled
+    // first in critical path scheduling mode. All priorities are 0 until
+    // MaybeUpdatePriorities() has been called.
+    uint64 Priority(const NodeItem& node) const {
+      return priorities_[active_priorities_.load(std::memory_order_acquire)]
+                        [node.node_id]
+                            .load(std::memory_order_relaxed);
+    }
+
+    // Recomputes the priorities from the latest cost estimates. Called at the
+    // end of every step that uses critical path scheduling, so that the
+    // recomputation does not delay the start of the step. The priorities
+    // are recomputed on steps 1, 2, 4, ... and then every
+    // `kPriorityUpdateIntervalSteps` steps, so that they follow the cost
+    // estimates closely while the estimates are still converging. If another
+    // step is already recomputing them, returns immediately.
+    void MaybeUpdatePriorities() {
+      const int64_t step =
+          num_priority_steps_.fetch_add(1, std::memory_order_relaxed) + 1;
+      const bool power_of_two = (step & (step - 1)) == 0;
+      if (!power_of_two && step % kPriorityUpdateIntervalSteps != 0) return;
+      if (updating_priorities_.exchange(true, std::memory_order_acquire)) {
+        return;
+      }
+      UpdatePriorities();
+      updating_priorities_.store(false, std::memory_order_release);
     }
 
    private:
+    // Returns the cost used for the given node in the longest path lengths.
+    // Kernels that have not been timed yet are assumed to cost the expensive
+    // threshold if they have the expensive marker, and a fraction of it
+    // otherwise.
+    uint64 PathCost(const NodeItem& node) const {
+      if (node.kernel == nullptr) return 0;
+      const uint64 measured =
+          measured_costs_[node.node_id].load(std::memory_order_relaxed);
+      if (measured != 0) return measured;
+      return is_expensive_[node.node_id] ? kOpIsExpensiveThresholdCycles
+                                         : kInexpensiveCostCycles;
+    }
+
+    // Computes the longest path to a sink for every node, visiting the nodes
+    // in reverse topological order. The back edges of loops, which leave
+    // NextIteration nodes, are ignored. The paths are written to the inactive
+    // priorities, which are then swapped in, so that running steps never see
+    // a mix of old and new priorities.
+    //
+    // REQUIRES: `updating_priorities_` is held by the caller.
+    void UpdatePriorities() {
+      const int32_t num_nodes = gview_->num_nodes();
+      if (reverse_topological_order_.empty()) {
+        std::vector<int32_t> num_inputs(num_nodes, 0);
+        for (int32_t i = 0; i < num_nodes; ++i) {
+          const NodeItem* item = gview_->node(i);
+          if (item == nullptr || item->is_next_iteration) continue;
+          for (const EdgeInfo& e : item->output_edges()) {
+            ++num_inputs[e.dst_id];
+          }
+          for (const ControlEdgeInfo& e : item->output_control_edges()) {
+            ++num_inputs[e.dst_id];
+          }
+        }
+        std::vector<int32_t> order;
+        order.reserve(num_nodes);
+        for (int32_t i = 0; i < num_nodes; ++i) {
+          if (gview_->node(i) != nullptr && num_inputs[i] == 0) {
+            order.push_back(i);
+          }
+        }
+        auto visit = [&](int32_t dst_id) {
+          if (--num_inputs[dst_id] == 0) order.push_back(dst_id);
+        };
+        for (size_t next = 0; next < order.size(); ++next) {
+          const NodeItem* item = gview_->node(order[next]);
+          if (item->is_next_iteration) continue;
+          for (const EdgeInfo& e : item->output_edges()) visit(e.dst_id);
+          for (const ControlEdgeInfo& e : item->output_control_edges()) {
+            visit(e.dst_id);
+          }
+        }
+        reverse_topological_order_.assign(order.rbegin(), order.rend());
+      }
+
+      const int next = 1 - active_priorities_.load(std::memory_order_relaxed);
+      std::atomic_uint_fast64_t* path_costs = priorities_[next].get();
+      for (int32_t id : reverse_topological_order_) {
+        const NodeItem* item = gview_->node(id);
+        uint64 successor_cost = 0;
+        if (!item->is_next_iteration) {
+          for (const EdgeInfo& e : item->output_edges()) {
+            successor_cost = std::max<uint64>(
+                successor_cost,
+                path_costs[e.dst_id].load(std::memory_order_relaxed));
+          }
+          for (const ControlEdgeInfo& e : item->output_control_edges()) {
+            successor_cost = std::max<uint64>(
+                successor_cost,
+                path_costs[e.dst_id].load(std::memory_order_relaxed));
+          }
+        }
+        path_costs[id].store(PathCost(*item) + successor_cost,
+                             std::memory_order_relaxed);
+      }
+      active_priorities_.store(next, std::memory_order_release);
+    }
+
     // Initial time (in CPU cycles) we expect an operation to take.  Used to
     // determine whether an operation should be place in a threadpool.
     // Operations start out "expensive".
     static constexpr uint64 kInitialCostEstimateCycles = 100 * 1000 * 1000;
     static constexpr uint64 kOpIsExpensiveThresholdCycles = 8000;
     static constexpr uint64 kCostDecay = 10;
+    // Cost assumed for untimed kernels without the expensive marker when
+    // computing priorities.
+    static constexpr uint64 kInexpensiveCostCycles = 1000;
+    static constexpr int64_t kPriorityUpdateIntervalSteps = 128;
 
     std::vector<bool> is_expensive_;
     // std::unique_ptr<std::atomic<bool>[]> is_expensive_;
     std::unique_ptr<std::atomic_uint_fast64_t[]> cost_estimates_;
+
+    // Fields used by critical path scheduling. `measured_costs_` are 0 until
+    // the node has been timed.
+    const GraphView* gview_ = nullptr;
+    std::unique_ptr<std::atomic_uint_fast64_t[]> measured_costs_;
+    // Double buffered, `priorities_[active_priorities_]` is in use.
+    std::unique_ptr<std::atomic_uint_fast64_t[]> priorities_[2];
+    std::atomic<int> active_priorities_{0};
+    std::atomic<int64_t> num_priority_steps_{0};
+    std::atomic<bool> updating_priorities_{false};
+    std::vector<int32_t> reverse_topological_order_;
   };
 
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
+  StepBuffersPool step_buffers_pool_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
 
+// Creates the propagator of a step. `SimplePropagatorState` reuses the buffers
+// of an earlier step from `pool`, if there are any.
+template <class PropagatorStateType>
+PropagatorStateType NewPropagatorState(
+    const ImmutableExecutorState& immutable_state, int64_t step_id, bool vlog,
+    StepBuffersPool* pool) {
+  return PropagatorStateType(immutable_state, step_id, vlog);
+}
+
+template <>
+SimplePropagatorState NewPropagatorState<SimplePropagatorState>(
+    const ImmutableExecutorState& immutable_state, int64_t step_id, bool vlog,
+    StepBuffersPool* pool) {
+  return SimplePropagatorState(immutable_state, step_id, vlog, pool->Get());
+}
+
+// Returns the buffers of a finished step's propagator to `pool`.
+template <class PropagatorStateType>
+void RecyclePropagatorState(PropagatorStateType* propagator,
+                            StepBuffersPool* pool) {}
+
+template <>
+void RecyclePropagatorState<SimplePropagatorState>(
+    SimplePropagatorState* propagator, StepBuffersPool* pool) {
+  pool->Return(propagator->ReleaseStepBuffers());
+}
+
 // The state associated with one invocation of ExecutorImpl::Run.
 //
 // ExecutorState dispatches nodes when they become ready, and delegates to an
@@ -283,7 +526,8 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                StepBuffersPool* step_buffers_pool);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -297,6 +541,30 @@ class ExecutorState {
 
   struct AsyncState;
 
+  // The scratch space of `ProcessInline()`. It is kept in a per-thread free
+  // list after each call, so that later calls on the same thread, for any
+  // step of any executor, reuse it instead of allocating it again.
+  struct ProcessScratch {
+    std::unique_ptr<OpKernelContext::Params> params;
+    TensorValueVec inputs;
+    AllocatorAttributeVec input_alloc_attrs;
+    EntryVector outputs;
+    TaggedNodeSeq ready;
+  };
+
+  // Returns scratch space whose `params` may be used with `device`.
+  static std::unique_ptr<ProcessScratch> GetProcessScratch(DeviceBase* device);
+  static void ReturnProcessScratch(std::unique_ptr<ProcessScratch> scratch);
+
+  // Returns the free list of this thread. `ProcessInline()` can be reentered
+  // when kernels run inline, so a thread can use several scratch spaces.
+  static std::vector<std::unique_ptr<ProcessScratch>>&
+  ProcessScratchFreeList() {
+    static thread_local std::vector<std::unique_ptr<ProcessScratch>> free_list;
+    return free_list;
+  }
+  static constexpr size_t kMaxFreeProcessScratch = 8;
+
   // Process a ready node in current thread.
   void Process(const TaggedNode& node, int64_t scheduled_nsec);
 
@@ -332,7 +600,9 @@ class ExecutorState {
                 TaggedNodeReadyQueue* inline_ready);
 
   // Schedule all the expensive nodes in '*ready', and put all the inexpensive
-  // nodes in 'ready' into 'inline_ready'.
+  // nodes in 'ready' into 'inline_ready'. If 'inline_ready' is null, the
+  // inexpensive nodes are scheduled in groups instead. In critical path
+  // scheduling mode, both are handled in order of decreasing priority.
   //
   // This method will clear `*ready` before returning.
   //
@@ -369,6 +639,13 @@ class ExecutorState {
   // TODO(fishx): Make it configurable if necessary.
   static constexpr uint64 kInlineScheduleReadyThreshold = 500;
 
+  // Inexpensive nodes that become ready outside of `ProcessInline()` are run
+  // in groups whose total estimated cost is at most
+  // `kInexpensiveBatchCostCycles`. Every node counts as at least
+  // `kMinBatchedNodeCostCycles`, which bounds the size of a group.
+  static constexpr uint64 kInexpensiveBatchCostCycles = 8000;
+  static constexpr uint64 kMinBatchedNodeCostCycles = 250;
+
   // Not owned.
   RendezvousInterface* rendezvous_;
   CollectiveExecutor* collective_executor_ = nullptr;
@@ -388,6 +665,7 @@ class ExecutorState {
   CallFrameInterface* call_frame_;
   const ImmutableExecutorState& immutable_state_;
   ExecutorImpl::KernelStats* const kernel_stats_;
+  StepBuffersPool* const step_buffers_pool_;
   CancellationManager* cancellation_manager_;
   tsl::CoordinationServiceAgent* coordination_service_agent_;
   absl::optional<ManagedStackTrace> stack_trace_ = absl::nullopt;
@@ -396,6 +674,8 @@ class ExecutorState {
   Executor::Args::Runner runner_;
   bool sync_on_finish_;
   const bool run_all_kernels_inline_;
+  // True if ready nodes are ordered by `KernelStats::Priority()`.
+  const bool critical_path_scheduling_;
 
   PropagatorStateType propagator_;
 
@@ -417,7 +697,8 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats,
+    StepBuffersPool* step_buffers_pool)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -439,13 +720,19 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       call_frame_(args.call_frame),
       immutable_state_(immutable_state),
       kernel_stats_(kernel_stats),
+      step_buffers_pool_(step_buffers_pool),
       cancellation_manager_(args.cancellation_manager),
       coordination_service_agent_(args.coordination_service_agent),
       stack_trace_(args.stack_trace),
       runner_(args.runner),
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
-      propagator_(immutable_state, step_id_, vlog_),
+      // Reordering would break the deterministic op order.
+      critical_path_scheduling_(args.critical_path_scheduling &&
+                                !args.run_all_kernels_inline &&
+                                !OpOrderDeterminismRequired()),
+      propagator_(NewPropagatorState<PropagatorStateType>(
+          immutable_state, step_id_, vlog_, step_buffers_pool)),
       num_outstanding_ops_(0) {
   if (args.user_intra_op_threadpool != nullptr) {
     Device* device = immutable_state_.params().device;
@@ -456,6 +743,7 @@ ExecutorState<PropagatorStateType>::ExecutorState(
 
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::~ExecutorState() {
+  RecyclePropagatorState(&propagator_, step_buffers_pool_);
   if (device_context_) {
     device_context_->Unref();
   }
@@ -600,17 +888,13 @@ Status ExecutorState<PropagatorStateType>::ProcessSync(
         },
         profiler::GetTFTraceMeLevel(is_expensive));
     device->Compute(op_kernel, &ctx);
-  } else if (kernel_stats_->HasExpensiveMarker(item)) {
+  } else if (is_expensive || SampleKernelTiming()) {
+    // For expensive kernels, always update the cost estimate. For inexpensive
+    // kernels, update the cost estimate with ~1/16 probability, so that the
+    // kernels that are not as cheap as expected are still detected.
     KernelTimer timer;
     device->Compute(op_kernel, &ctx);
-    // For expensive kernels, always update the cost estimate. For inexpensive
-    // kernels, update the cost estimate with ~1/16 probability. This assumes
-    // that the last 4 bits of the CPU cycle count is uniformly distributed.
-    constexpr int kKernelExecutionTrackingInvocationSkipCount = 16;
-    if (is_expensive ||
-        timer.start_cycles % kKernelExecutionTrackingInvocationSkipCount == 0) {
-      kernel_stats_->UpdateCostEstimate(item, timer.ElapsedCycles());
-    }
+    kernel_stats_->UpdateCostEstimate(item, timer.ElapsedCycles());
   } else {
     device->Compute(op_kernel, &ctx);
   }
@@ -736,23 +1020,23 @@ template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::ProcessInline(
     TaggedNodeReadyQueue* inline_ready, int64_t scheduled_nsec) {
   WithContext wc(context_);
-  auto ready = std::make_unique<TaggedNodeSeq>();
+  // Override device's threadpool if user provides an intra_op_threadpool
+  Device* device = immutable_state_.params().device;
+  DeviceBase* const op_device =
+      user_device_ ? static_cast<DeviceBase*>(user_device_.get()) : device;
+
+  std::unique_ptr<ProcessScratch> scratch = GetProcessScratch(op_device);
+  TaggedNodeSeq* const ready = &scratch->ready;
 
   // Parameters passed to OpKernel::Compute.
-  auto inputs = std::make_unique<TensorValueVec>();
+  TensorValueVec* const inputs = &scratch->inputs;
 
-  AllocatorAttributeVec input_alloc_attrs;
+  AllocatorAttributeVec& input_alloc_attrs = scratch->input_alloc_attrs;
 
-  auto params = std::make_unique<OpKernelContext::Params>();
+  OpKernelContext::Params* const params = scratch->params.get();
 
   params->step_id = step_id_;
-  // Override device's threadpool if user provides an intra_op_threadpool
-  Device* device = immutable_state_.params().device;
-  if (user_device_) {
-    params->device = user_device_.get();
-  } else {
-    params->device = device;
-  }
+  params->device = op_device;
   params->start_time_usecs = start_time_usecs_;
   params->deadline = deadline_;
   params->log_memory = log_memory_;
@@ -798,7 +1082,8 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
   Status s;
   NodeExecStatsInterface* stats = nullptr;
 
-  EntryVector outputs(1);
+  EntryVector& outputs = scratch->outputs;
+  if (outputs.empty()) outputs.resize(1);
 
   bool completed = false;
   int64_t last_iter_num = -1;
@@ -891,7 +1176,7 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
     } else {
       // Prepares inputs.
       bool is_input_dead = false;
-      s = PrepareInputs(item, first_input, inputs.get(), &input_alloc_attrs,
+      s = PrepareInputs(item, first_input, inputs, &input_alloc_attrs,
                         &is_input_dead);
       if (!s.ok()) {
         // Clear inputs.
@@ -902,7 +1187,7 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
         propagator_.MaybeMarkCompleted(tagged_node);
         activity_watcher::ActivityEnd(activity_id);
         // Continue to process the nodes in 'inline_ready'.
-        completed = NodeDone(s, ready.get(), stats, inline_ready);
+        completed = NodeDone(s, ready, stats, inline_ready);
         continue;
       }
 
@@ -921,7 +1206,7 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
                      activity_id);
         launched_asynchronously = true;
       } else {
-        s = ProcessSync(item, params.get(), &outputs, stats);
+        s = ProcessSync(item, params, &outputs, stats);
       }
     }
 
@@ -943,7 +1228,7 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
       activity_watcher::ActivityEnd(activity_id);
       // Propagates outputs.
       if (s.ok()) {
-        propagator_.PropagateOutputs(tagged_node, &outputs, ready.get());
+        propagator_.PropagateOutputs(tagged_node, &outputs, ready);
       }
 
       // Clear outputs without deallocating the `outputs` vector.
@@ -956,14 +1241,58 @@ void ExecutorState<PropagatorStateType>::ProcessInline(
         scheduled_nsec = nodestats::NowInNsec();
       }
       // Postprocess.
-      completed = NodeDone(s, ready.get(), stats, inline_ready);
+      completed = NodeDone(s, ready, stats, inline_ready);
     }
   }  // while !inline_ready.empty()
 
+  ReturnProcessScratch(std::move(scratch));
+
   // This thread of computation is done if completed = true.
   if (completed) ScheduleFinish();
 }
 
+template <class PropagatorStateType>
+std::unique_ptr<typename ExecutorState<PropagatorStateType>::ProcessScratch>
+ExecutorState<PropagatorStateType>::GetProcessScratch(DeviceBase* device) {
+  std::vector<std::unique_ptr<ProcessScratch>>& free_list =
+      ProcessScratchFreeList();
+  std::unique_ptr<ProcessScratch> scratch;
+  if (!free_list.empty()) {
+    scratch = std::move(free_list.back());
+    free_list.pop_back();
+  } else {
+    scratch = std::make_unique<ProcessScratch>();
+  }
+  // `params->eigen_gpu_device` is specific to the device that created it, so
+  // the params can only be reused with another device if it was never set.
+  if (scratch->params == nullptr ||
+      (scratch->params->eigen_gpu_device != nullptr &&
+       scratch->params->device != device)) {
+    metrics::RecordExecutorStepStatePoolMiss("process_scratch");
+    scratch->params = std::make_unique<OpKernelContext::Params>();
+  }
+  return scratch;
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::ReturnProcessScratch(
+    std::unique_ptr<ProcessScratch> scratch) {
+  // Drop the references to the state of this step.
+  scratch->params->inputs = {};
+  scratch->params->input_alloc_attrs = {};
+  scratch->params->inc_num_deferred_ops_function = nullptr;
+  scratch->params->dec_num_deferred_ops_function = nullptr;
+  scratch->params->stack_trace = absl::nullopt;
+  for (Entry& entry : scratch->outputs) entry.ClearVal();
+  scratch->ready.clear();
+
+  std::vector<std::unique_ptr<ProcessScratch>>& free_list =
+      ProcessScratchFreeList();
+  if (free_list.size() < kMaxFreeProcessScratch) {
+    free_list.push_back(std::move(scratch));
+  }
+}
+
 template <class PropagatorStateType>
 Status ExecutorState<PropagatorStateType>::PrepareInputs(
     const NodeItem& item, Entry* first_input, TensorValueVec* inputs,
@@ -1294,20 +1623,73 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       }
     }
   } else {
+    if (critical_path_scheduling_ && ready->size() > 1) {
+      // Start the nodes on the longest paths to the sinks first. The node
+      // that stays on this thread is the most critical expensive node.
+      // Another step may update the priorities meanwhile, so the nodes are
+      // sorted by a copy of their priorities.
+      gtl::InlinedVector<std::pair<uint64, TaggedNode>, 8> prioritized;
+      prioritized.reserve(ready->size());
+      for (const TaggedNode& tagged_node : *ready) {
+        prioritized.emplace_back(
+            kernel_stats_->Priority(tagged_node.get_node_item()), tagged_node);
+      }
+      std::stable_sort(prioritized.begin(), prioritized.end(),
+                       [](const std::pair<uint64, TaggedNode>& a,
+                          const std::pair<uint64, TaggedNode>& b) {
+                         return a.first > b.first;
+                       });
+      for (size_t i = 0; i < prioritized.size(); ++i) {
+        (*ready)[i] = prioritized[i].second;
+      }
+    }
     const TaggedNode* curr_expensive_node = nullptr;
     TaggedNodeSeq expensive_nodes;
     if (inline_ready == nullptr) {
-      // Schedule to run all the ready ops in thread pool.
+      // Schedule to run all the ready ops in thread pool. Consecutive
+      // inexpensive ops are grouped into one closure, up to a total estimated
+      // cost of `kInexpensiveBatchCostCycles`, to save thread pool handoffs.
+      TaggedNodeSeq batch;
+      uint64 batch_cost = 0;
+      auto schedule_batch = [&]() {
+        if (batch.empty()) return;
+        RunTask(
+            [this, batch = std::move(batch), scheduled_nsec]() {
+              TaggedNodeReadyQueue batch_ready;
+              for (auto& tagged_node : batch) {
+                batch_ready.push_back(tagged_node);
+              }
+              ProcessInline(&batch_ready, scheduled_nsec);
+            },
+            /*sample_rate=*/ready->size());
+        batch.clear();
+        batch_cost = 0;
+      };
       for (auto& tagged_node : *ready) {
-        RunTask([=]() { Process(tagged_node, scheduled_nsec); },
-                /*sample_rate=*/ready->size());
+        const NodeItem& item = *tagged_node.node_item;
+        if (!tagged_node.get_is_dead() && kernel_stats_->IsExpensive(item)) {
+          RunTask([=]() { Process(tagged_node, scheduled_nsec); },
+                  /*sample_rate=*/ready->size());
+          continue;
+        }
+        const uint64 cost =
+            tagged_node.get_is_dead()
+                ? kMinBatchedNodeCostCycles
+                : std::max(kernel_stats_->CostEstimate(item),
+                           kMinBatchedNodeCostCycles);
+        if (batch_cost + cost > kInexpensiveBatchCostCycles) schedule_batch();
+        batch.push_back(tagged_node);
+        batch_cost += cost;
       }
+      schedule_batch();
     } else {
       for (auto& tagged_node : *ready) {
         const NodeItem& item = *tagged_node.node_item;
         if (tagged_node.get_is_dead() || !kernel_stats_->IsExpensive(item)) {
           // Inline this inexpensive node.
           inline_ready->push_back(tagged_node);
+        } else if (critical_path_scheduling_ && curr_expensive_node) {
+          expensive_nodes.push_back(tagged_node);
         } else {
           if (curr_expensive_node) {
             expensive_nodes.push_back(*curr_expensive_node);
@@ -1322,7 +1704,11 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       } else {
         // There are inline nodes to run already. We dispatch this expensive
         // node to other thread.
-        expensive_nodes.push_back(*curr_expensive_node);
+        if (critical_path_scheduling_) {
+          expensive_nodes.insert(expensive_nodes.begin(), *curr_expensive_node);
+        } else {
+          expensive_nodes.push_back(*curr_expensive_node);
+        }
       }
     }
     if (!expensive_nodes.empty()) {
@@ -1402,6 +1788,10 @@ void ExecutorState<PropagatorStateType>::Finish() {
   CHECK(done_cb != nullptr);
   Device* device = immutable_state_.params().device;
 
+  // The nodes of the step have all completed, and the executor outlives
+  // `done_cb`, so the priorities for the next steps are recomputed here.
+  if (critical_path_scheduling_) kernel_stats_->MaybeUpdatePriorities();
+
   if (vlog_ && !status.ok() && VLOG_IS_ON(1)) {
     // Logs verbose information about the current state of active and pending
     // nodes in the propagator.
@@ -1508,15 +1898,16 @@ void ExecutorState<PropagatorStateType>::Finish() {
 
 void ExecutorImpl::RunAsyncInternal(const Args& args, DoneCallback done) {
   if (OpOrderDeterminismRequired()) {
-    (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
-                                               &kernel_stats_))
+    (new ExecutorState<OrderedPropagatorState>(
+         args, immutable_state_, &kernel_stats_, &step_buffers_pool_))
         ->RunAsync(std::move(done));
   } else if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        &step_buffers_pool_))
         ->RunAsync(std::move(done));
   } else {
-    (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+    (new ExecutorState<SimplePropagatorState>(
+         args, immutable_state_, &kernel_stats_, &step_buffers_pool_))
         ->RunAsync(std::move(done));
   }
 }
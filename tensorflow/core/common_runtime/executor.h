@@ -37,6 +37,7 @@ limitations under the License.
 
 namespace tensorflow {
 
+class CostModelManager;
 class StepStatsCollector;
 
 // Executor runs a graph computation.
@@ -124,6 +125,12 @@ class Executor {
     // If true, all kernels will be treated as "inexpensive", and hence executed
     // on the scheduling thread.
     bool run_all_kernels_inline = false;
+
+    // If true, ready nodes are started in order of decreasing estimated cost
+    // of their longest path to a sink of the graph, instead of the order in
+    // which they became ready. Ignored if `run_all_kernels_inline` is true or
+    // a deterministic op order is required.
+    bool critical_path_scheduling = false;
   };
   typedef std::function<void(const Status&)> DoneCallback;
 
@@ -146,6 +153,15 @@ class Executor {
     return ret;
   }
 
+  // Records the execution time of each kernel, as estimated from the kernel
+  // timings that the executor samples while it runs, in the cost model of
+  // `graph` in `cost_model_manager`. `graph` must be the graph from which the
+  // executor was created. Executors that do not sample kernel timings record
+  // nothing.
+  virtual void ExportCostEstimates(const Graph& graph,
+                                   CostModelManager* cost_model_manager) const {
+  }
+
  private:
   virtual void RunAsyncInternal(const Args& args, DoneCallback done) = 0;
 };
@@ -0,0 +1,162 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/framework/local_rendezvous.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/test.h"
+
+// The executor allocates its per-step state with operator new, not with a
+// tensorflow::Allocator, so this test counts the calls to operator new on the
+// thread that runs a step.
+namespace {
+thread_local bool count_allocations = false;
+std::atomic<int64_t> num_allocations{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+  if (count_allocations) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) std::abort();
+  return ptr;
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace tensorflow {
+namespace {
+
+#define ALICE "/job:j/replica:0/task:0/cpu:0"
+#define BOB "/job:j/replica:0/task:0/device:GPU:0"
+
+constexpr int kNumAdds = 16;
+
+// The allocations of a step after the first one: the output buffers of the
+// Adds, plus a fixed number for the ExecutorState, the Recv and Send and the
+// rendezvous. The bound is loose, but it fails if ProcessInline() allocates
+// its scratch space for every node again.
+constexpr int64_t kMaxStepAllocations = kNumAdds + 48;
+
+Rendezvous::ParsedKey Key(const string& sender, const string& receiver,
+                          const string& name) {
+  Rendezvous::ParsedKey result;
+  CHECK(Rendezvous::ParseKey(Rendezvous::CreateKey(sender, /*incarnation=*/1,
+                                                   receiver, name,
+                                                   FrameAndIter(0, 0)),
+                             &result)
+            .ok());
+  return result;
+}
+
+TEST(ExecutorAllocationTest, StepsReuseThePooledState) {
+  std::unique_ptr<Device> device = DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0");
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  Node* out = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  for (int i = 0; i < kNumAdds; ++i) {
+    out = test::graph::Add(g.get(), out, out);
+  }
+  test::graph::Send(g.get(), out, "b", BOB, 1, ALICE);
+
+  const int version = g->versions().producer();
+  LocalExecutorParams params;
+  params.device = device.get();
+  params.create_kernel =
+      [&device, version](const std::shared_ptr<const NodeProperties>& props,
+                         OpKernel** kernel) {
+        return CreateNonCachedKernel(device.get(), nullptr, props, version,
+                                     kernel);
+      };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  Executor* exec = nullptr;
+  TF_ASSERT_OK(NewLocalExecutor(params, *g, &exec));
+  std::unique_ptr<Executor> exec_owner(exec);
+  Rendezvous* rendez = NewLocalRendezvous();
+  core::ScopedUnref rendez_unref(rendez);
+
+  // Runs one step with all kernels on this thread, and returns the number of
+  // heap allocations it made.
+  auto run_step = [&]() -> int64_t {
+    Rendezvous::Args args;
+    Tensor in(DT_FLOAT, TensorShape({}));
+    in.scalar<float>()() = 1.0;
+    TF_CHECK_OK(rendez->Send(Key(ALICE, BOB, "a"), args, in, false));
+    Executor::Args exec_args;
+    exec_args.rendezvous = rendez;
+    exec_args.runner = [](std::function<void()> fn) { fn(); };
+    const int64_t start = num_allocations;
+    count_allocations = true;
+    const Status status = exec->Run(exec_args);
+    count_allocations = false;
+    const int64_t num_step_allocations = num_allocations - start;
+    TF_CHECK_OK(status);
+    Tensor result;
+    bool is_dead = false;
+    TF_CHECK_OK(rendez->Recv(Key(BOB, ALICE, "b"), args, &result, &is_dead));
+    CHECK_EQ(65536.0, result.scalar<float>()());
+    return num_step_allocations;
+  };
+
+  monitoring::testing::CellReader<int64_t> pool_misses(
+      "/tensorflow/core/executor_step_state_pool_misses");
+  const int64_t first_step_allocations = run_step();
+  pool_misses.Delta("propagator_buffers");
+  pool_misses.Delta("process_scratch");
+  std::vector<int64_t> step_allocations;
+  for (int step = 0; step < 10; ++step) {
+    step_allocations.push_back(run_step());
+  }
+  EXPECT_EQ(pool_misses.Delta("propagator_buffers"), 0);
+  EXPECT_EQ(pool_misses.Delta("process_scratch"), 0);
+  for (const int64_t n : step_allocations) {
+    // The later steps reuse the state that the first step allocated.
+    EXPECT_LT(n, first_step_allocations);
+    // The state that is not pooled does not grow from step to step either.
+    EXPECT_LE(n, step_allocations.front());
+    EXPECT_LE(n, kMaxStepAllocations);
+  }
+  // The pool-miss counter does not count the state that is not pooled, such
+  // as the ExecutorState and the output tensors.
+  EXPECT_GT(step_allocations.front(), 0);
+}
+
+}  // namespace
+}  // namespace tensorflow
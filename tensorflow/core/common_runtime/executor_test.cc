@@ -16,6 +16,10 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
 
 #include "tensorflow/cc/framework/ops.h"
 #include "tensorflow/cc/ops/array_ops.h"
@@ -23,6 +27,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/control_flow_ops_internal.h"
 #include "tensorflow/cc/ops/function_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/costmodel_manager.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/graph_constructor.h"
@@ -31,18 +36,24 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/local_rendezvous.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/rendezvous.h"
 #include "tensorflow/core/framework/step_stats.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -102,6 +113,7 @@ class ExecutorTest : public ::testing::Test {
     args.rendezvous = rendez;
     args.stats_collector = &step_stats_collector_;
     args.runner = runner_;
+    args.critical_path_scheduling = critical_path_scheduling_;
     return exec_->Run(args);
   }
 
@@ -112,6 +124,7 @@ class ExecutorTest : public ::testing::Test {
   StepStats step_stats_;
   Executor::Args::Runner runner_;
   Rendezvous* rendez_ = nullptr;
+  bool critical_path_scheduling_ = false;
 };
 
 // A float val -> Tensor<float>
@@ -266,6 +279,338 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, ReusesStepState) {
+  monitoring::testing::CellReader<int64_t> pool_misses(
+      "/tensorflow/core/executor_step_state_pool_misses");
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(64, g.get());
+  Create(std::move(g));
+  // Run every kernel on the calling thread, so that all steps use the
+  // scratch space of the same thread.
+  runner_ = [](std::function<void()> fn) { fn(); };
+  auto run_step = [this]() {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(64.0, V(out));
+  };
+  run_step();
+  EXPECT_EQ(pool_misses.Delta("propagator_buffers"), 1);
+  pool_misses.Delta("process_scratch");
+  for (int step = 0; step < 10; ++step) {
+    run_step();
+  }
+  EXPECT_EQ(pool_misses.Delta("propagator_buffers"), 0);
+  EXPECT_EQ(pool_misses.Delta("process_scratch"), 0);
+}
+
+TEST_F(ExecutorTest, ExportCostEstimates) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(64, g.get());
+  auto graph = std::make_unique<Graph>(OpRegistry::Global());
+  CopyGraph(*g, graph.get());
+  Create(std::move(g));
+  // About 1 in 16 kernel invocations is timed.
+  for (int step = 0; step < 32; ++step) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(64.0, V(out));
+  }
+  CostModelManager cost_model_manager;
+  exec_->ExportCostEstimates(*graph, &cost_model_manager);
+  CostModel* cost_model = cost_model_manager.FindOrCreateCostModel(graph.get());
+  int num_timed = 0;
+  for (const Node* n : graph->nodes()) {
+    if (cost_model->OnlineTimeEstimate(n) > Microseconds(0)) ++num_timed;
+  }
+  EXPECT_GT(num_timed, 0);
+}
+
+// The runner closure that is running on the current thread, numbered from 1
+// by the counting runners of the tests below.
+thread_local int current_closure = 0;
+
+// The closure that last ran the ExecutorTestSleep node of each slot.
+std::atomic<int> closure_of_slot[2];
+
+REGISTER_OP("ExecutorTestSleep")
+    .Input("x: float")
+    .Output("y: float")
+    .Attr("sleep_micros: int")
+    .Attr("slot: int")
+    .SetShapeFn(shape_inference::UnchangedShape);
+
+// Forwards its input after sleeping. The kernel has no expensive marker, so
+// the executor only learns how slow it is from its timings.
+class ExecutorTestSleepOp : public OpKernel {
+ public:
+  explicit ExecutorTestSleepOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sleep_micros", &sleep_micros_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("slot", &slot_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    if (sleep_micros_ > 0) Env::Default()->SleepForMicroseconds(sleep_micros_);
+    closure_of_slot[slot_] = current_closure;
+    ctx->set_output(0, ctx->input(0));
+  }
+
+  bool IsExpensive() override { return false; }
+
+ private:
+  int64_t sleep_micros_;
+  int slot_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("ExecutorTestSleep").Device(DEVICE_CPU),
+                        ExecutorTestSleepOp);
+
+Node* ExecutorTestSleep(Graph* g, Node* in, int64_t sleep_micros, int slot) {
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ExecutorTestSleep")
+                  .Input(in)
+                  .Attr("sleep_micros", sleep_micros)
+                  .Attr("slot", slot)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+TEST_F(ExecutorTest, SlowKernelWithoutExpensiveMarkerIsDispatched) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto slow = ExecutorTestSleep(g.get(), in0, /*sleep_micros=*/1000,
+                                /*slot=*/0);
+  auto cheap = ExecutorTestSleep(g.get(), in0, /*sleep_micros=*/0,
+                                 /*slot=*/1);
+  test::graph::Send(g.get(), slow, "b", BOB, 1, ALICE);
+  test::graph::Send(g.get(), cheap, "c", BOB, 1, ALICE);
+  Create(std::move(g));
+  // Runs every closure on the calling thread, and numbers the closures.
+  int num_closures = 0;
+  runner_ = [&num_closures](std::function<void()> fn) {
+    const int prev_closure = current_closure;
+    current_closure = ++num_closures;
+    fn();
+    current_closure = prev_closure;
+  };
+  // Both nodes start out inexpensive, and are run from the same closure.
+  // The slow one is dispatched to a closure of its own once one of its
+  // invocations has been timed, which happens for ~1/16 of them.
+  bool dispatched = false;
+  for (int step = 0; step < 300 && !dispatched; ++step) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(1.0, V(out));
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(1.0, V(out));
+    if (step == 0) EXPECT_EQ(closure_of_slot[0], closure_of_slot[1]);
+    dispatched = closure_of_slot[0] != closure_of_slot[1];
+  }
+  EXPECT_TRUE(dispatched);
+}
+
+TEST_F(ExecutorTest, CheapRootsAreBatched) {
+  constexpr int kNumRoots = 16;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  for (int i = 0; i < kNumRoots; ++i) {
+    test::graph::Constant(g.get(), V(i));
+  }
+  Create(std::move(g));
+  int num_closures = 0;
+  runner_ = [&num_closures](std::function<void()> fn) {
+    ++num_closures;
+    fn();
+  };
+  TF_ASSERT_OK(Run(rendez_));
+  // Without batching, every root would get a closure of its own.
+  EXPECT_LT(num_closures, kNumRoots);
+}
+
+TEST_F(ExecutorTest, CriticalPathSchedulingRandomTree) {
+  critical_path_scheduling_ = true;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g));
+  // The priorities are recomputed from the measured costs on steps 1, 2, 4
+  // and 8.
+  for (int step = 0; step < 10; ++step) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
+TEST_F(ExecutorTest, CriticalPathSchedulingSwitch) {
+  critical_path_scheduling_ = true;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Constant(g.get(), VB(false));
+  auto tmp = test::graph::Switch(g.get(), in0, in1);
+  // A longer chain next to the Switch.
+  auto chain = in0;
+  for (int i = 0; i < 8; ++i) {
+    chain = test::graph::Add(g.get(), chain, chain);
+  }
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  test::graph::Send(g.get(), chain, "d", BOB, 1, ALICE);
+  Create(std::move(g));
+  for (int step = 0; step < 3; ++step) {
+    Rendezvous::Args args;
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = true;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(1.0, V(out));
+    EXPECT_FALSE(is_dead);
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "d"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(256.0, V(out));
+  }
+}
+
+// Runs the scheduled closures one at a time, in the order they were
+// scheduled.
+class SerialRunner {
+ public:
+  SerialRunner()
+      : thread_(Env::Default()->StartThread({}, "serial_runner",
+                                            [this]() { Loop(); })) {}
+
+  ~SerialRunner() {
+    {
+      mutex_lock l(mu_);
+      stopped_ = true;
+    }
+    cv_.notify_one();
+    thread_.reset();
+  }
+
+  void Schedule(std::function<void()> fn) {
+    {
+      mutex_lock l(mu_);
+      closures_.push_back(std::move(fn));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void Loop() {
+    while (true) {
+      std::function<void()> fn;
+      {
+        mutex_lock l(mu_);
+        while (closures_.empty() && !stopped_) cv_.wait(l);
+        if (closures_.empty()) return;
+        fn = std::move(closures_.front());
+        closures_.pop_front();
+      }
+      fn();
+    }
+  }
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<std::function<void()>> closures_ TF_GUARDED_BY(mu_);
+  bool stopped_ TF_GUARDED_BY(mu_) = false;
+  std::unique_ptr<Thread> thread_;
+};
+
+TEST_F(ExecutorTest, CriticalPathSchedulingStartsLongestChainFirst) {
+  critical_path_scheduling_ = true;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  // The cheap side branches come first in the graph, so without the
+  // priorities they would be scheduled before the chain.
+  std::vector<string> side_names;
+  for (int i = 0; i < 4; ++i) {
+    auto side = test::graph::Add(g.get(), in0, in0);
+    side_names.push_back(side->name());
+    test::graph::Send(g.get(), side, strings::StrCat("side", i), BOB, 1,
+                      ALICE);
+  }
+  auto chain = test::graph::Add(g.get(), in0, in0);
+  const string head_name = chain->name();
+  for (int i = 0; i < 8; ++i) {
+    chain = test::graph::Add(g.get(), chain, chain);
+  }
+  test::graph::Send(g.get(), chain, "d", BOB, 1, ALICE);
+  Create(std::move(g));
+
+  SerialRunner runner;
+  runner_ = [&runner](std::function<void()> fn) {
+    runner.Schedule(std::move(fn));
+  };
+  Rendezvous::Args args;
+  Tensor out = V(-1);
+  bool is_dead = true;
+  // Runs a step and checks its outputs. The priorities are computed at the
+  // end of the first step, so only the second step follows them.
+  auto run_step = [&](StepStatsCollector* collector) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    Executor::Args exec_args;
+    exec_args.rendezvous = rendez_;
+    exec_args.stats_collector = collector;
+    exec_args.runner = runner_;
+    exec_args.critical_path_scheduling = true;
+    TF_ASSERT_OK(exec_->Run(exec_args));
+    for (int i = 0; i < 4; ++i) {
+      TF_ASSERT_OK(rendez_->Recv(
+          Key(BOB, kIncarnation, ALICE, strings::StrCat("side", i)), args,
+          &out, &is_dead));
+      EXPECT_EQ(2.0, V(out));
+    }
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "d"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(512.0, V(out));
+  };
+  run_step(nullptr);
+  run_step(&step_stats_collector_);
+  step_stats_collector_.Finalize();
+
+  std::vector<string> order;
+  for (const auto& dev_stats : step_stats_.dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      order.push_back(node_stats.node_name());
+    }
+  }
+  auto position = [&order](const string& name) {
+    return static_cast<size_t>(std::find(order.begin(), order.end(), name) -
+                               order.begin());
+  };
+  ASSERT_LT(position(head_name), order.size());
+  for (const string& side_name : side_names) {
+    EXPECT_LT(position(head_name), position(side_name)) << side_name;
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -21,6 +21,29 @@ namespace tensorflow {
 
 constexpr const char* MklCPUAllocator::kMaxLimitStr;
 constexpr const size_t MklCPUAllocator::kDefaultMaxLimit;
+
+namespace {
+// Upper bound on the NUMA nodes that get their own allocator.
+constexpr int kMaxNumaNodes = 64;
+}  // namespace
+
+Allocator* GetMklNumaCPUAllocator(int numa_node) {
+  if (numa_node < 0 || numa_node >= kMaxNumaNodes) return nullptr;
+  // Allocators are looked up on every allocation, so reads take no lock.
+  static std::atomic<Allocator*> allocators[kMaxNumaNodes];
+  Allocator* allocator = allocators[numa_node].load(std::memory_order_acquire);
+  if (allocator != nullptr) return allocator;
+
+  static mutex mu(LINKER_INITIALIZED);
+  mutex_lock l(mu);
+  allocator = allocators[numa_node].load(std::memory_order_relaxed);
+  if (allocator == nullptr) {
+    allocator = new MklCPUAllocator(numa_node);
+    allocators[numa_node].store(allocator, std::memory_order_release);
+  }
+  return allocator;
+}
+
 }  // namespace tensorflow
 
 #endif  // INTEL_MKL
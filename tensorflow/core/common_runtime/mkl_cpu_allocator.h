@@ -21,12 +21,15 @@ limitations under the License.
 
 #ifdef INTEL_MKL
 
+#include <atomic>
 #include <cstdlib>
+#include <map>
 
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/util/env_var.h"
@@ -42,17 +45,120 @@ static bool mkl_small_allocator_collect_stats = false;
 class MklSubAllocator : public BasicCPUAllocator {
  public:
   MklSubAllocator() : BasicCPUAllocator(port::kNUMANoAffinity, {}, {}) {}
+  explicit MklSubAllocator(int numa_node)
+      : BasicCPUAllocator(numa_node, {}, {}) {}
+  MklSubAllocator(int numa_node, const std::vector<Visitor>& alloc_visitors,
+                  const std::vector<Visitor>& free_visitors)
+      : BasicCPUAllocator(numa_node, alloc_visitors, free_visitors) {}
   ~MklSubAllocator() override {}
 };
 
+// Set of address ranges of the memory regions that the BFC allocator got from
+// its suballocator. Regions are added and removed rarely, under a lock, while
+// Contains() reads them without any lock. A pointer handed out from a region
+// can only reach Contains() after the region was added, and regions are only
+// removed once all their pointers were freed, so lookups of live pointers
+// always see the current state of their region.
+class MklRegionSet {
+ public:
+  MklRegionSet() {}
+  ~MklRegionSet() {}
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MklRegionSet);
+
+  void Add(const void* ptr, size_t num_bytes) TF_LOCKS_EXCLUDED(mutex_) {
+    if (ptr == nullptr || num_bytes == 0) return;
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+    mutex_lock l(mutex_);
+    const int num_regions = num_regions_.load(std::memory_order_relaxed);
+    for (int i = 0; i < num_regions; ++i) {
+      if (regions_[i].end.load(std::memory_order_relaxed) == 0) {
+        regions_[i].begin.store(begin, std::memory_order_release);
+        regions_[i].end.store(begin + num_bytes, std::memory_order_release);
+        return;
+      }
+    }
+    if (num_regions < kMaxRegions) {
+      regions_[num_regions].begin.store(begin, std::memory_order_release);
+      regions_[num_regions].end.store(begin + num_bytes,
+                                      std::memory_order_release);
+      num_regions_.store(num_regions + 1, std::memory_order_release);
+      return;
+    }
+    overflow_regions_[begin] = begin + num_bytes;
+    has_overflow_regions_.store(true, std::memory_order_release);
+  }
+
+  void Remove(const void* ptr) TF_LOCKS_EXCLUDED(mutex_) {
+    if (ptr == nullptr) return;
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+    mutex_lock l(mutex_);
+    const int num_regions = num_regions_.load(std::memory_order_relaxed);
+    for (int i = 0; i < num_regions; ++i) {
+      if (regions_[i].begin.load(std::memory_order_relaxed) == begin &&
+          regions_[i].end.load(std::memory_order_relaxed) != 0) {
+        regions_[i].end.store(0, std::memory_order_release);
+        return;
+      }
+    }
+    overflow_regions_.erase(begin);
+  }
+
+  bool Contains(const void* ptr) const {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    const int num_regions = num_regions_.load(std::memory_order_acquire);
+    for (int i = 0; i < num_regions; ++i) {
+      // The end is loaded first, as it is stored last when a region is added.
+      const uintptr_t end = regions_[i].end.load(std::memory_order_acquire);
+      if (address < end &&
+          address >= regions_[i].begin.load(std::memory_order_acquire)) {
+        return true;
+      }
+    }
+    if (!has_overflow_regions_.load(std::memory_order_acquire)) return false;
+    mutex_lock l(mutex_);
+    auto it = overflow_regions_.upper_bound(address);
+    if (it == overflow_regions_.begin()) return false;
+    --it;
+    return address < it->second;
+  }
+
+ private:
+  // BFC allocator with growth doubles its region size on every extension, so
+  // it rarely needs more than a few dozens of regions.
+  static constexpr int kMaxRegions = 128;
+
+  struct Region {
+    std::atomic<uintptr_t> begin{0};
+    // 0 for an unused region. A removed region keeps its stale begin, so that
+    // a concurrent lookup never sees a range that starts at 0.
+    std::atomic<uintptr_t> end{0};
+  };
+
+  Region regions_[kMaxRegions];
+  std::atomic<int> num_regions_{0};
+
+  mutable mutex mutex_;
+  // Regions that did not fit into regions_, from their begin to their end.
+  std::map<uintptr_t, uintptr_t> overflow_regions_ TF_GUARDED_BY(mutex_);
+  std::atomic<bool> has_overflow_regions_{false};
+};
+
 // CPU allocator that handles small-size allocations by calling
 // suballocator directly. Mostly, it is just a wrapper around a suballocator
 // (that calls malloc and free directly) with support for bookkeeping.
+//
+// Statistics are kept in shards of relaxed atomic counters, each updated by a
+// subset of the threads, and only aggregated by GetStats(). When statistics
+// are collected, each allocation is preceded by a header with its size, so
+// that deallocations need no lookup of the size.
 class MklSmallSizeAllocator : public Allocator {
  public:
   MklSmallSizeAllocator(SubAllocator* sub_allocator, size_t total_memory,
                         const string& name)
-      : sub_allocator_(sub_allocator), name_(name) {
+      : sub_allocator_(sub_allocator),
+        name_(name),
+        collect_stats_(mkl_small_allocator_collect_stats) {
     stats_.bytes_limit = total_memory;
   }
   ~MklSmallSizeAllocator() override {}
@@ -62,8 +168,18 @@ class MklSmallSizeAllocator : public Allocator {
   inline string Name() override { return name_; }
 
   void* AllocateRaw(size_t alignment, size_t num_bytes) override {
-    void* ptr = port::AlignedMalloc(num_bytes, alignment);
-    if (mkl_small_allocator_collect_stats) IncrementStats(num_bytes);
+    if (!collect_stats_) return port::AlignedMalloc(num_bytes, alignment);
+
+    // The header holds the header size and the allocation size, right before
+    // the returned pointer, which keeps its alignment.
+    const size_t header_bytes = std::max(alignment, kMinHeaderBytes);
+    char* base = static_cast<char*>(
+        port::AlignedMalloc(header_bytes + num_bytes, alignment));
+    if (base == nullptr) return nullptr;
+    char* ptr = base + header_bytes;
+    reinterpret_cast<size_t*>(ptr)[-2] = header_bytes;
+    reinterpret_cast<size_t*>(ptr)[-1] = num_bytes;
+    IncrementStats(num_bytes);
     return ptr;
   }
 
@@ -73,19 +189,43 @@ class MklSmallSizeAllocator : public Allocator {
       return;
     }
 
-    if (mkl_small_allocator_collect_stats) {
-      const size_t alloc_size = port::MallocExtension_GetAllocatedSize(ptr);
-      DecrementStats(alloc_size);
+    if (!collect_stats_) {
+      port::AlignedFree(ptr);
+      return;
     }
-    port::AlignedFree(ptr);
+    const size_t header_bytes = reinterpret_cast<size_t*>(ptr)[-2];
+    DecrementStats(reinterpret_cast<size_t*>(ptr)[-1]);
+    port::AlignedFree(static_cast<char*>(ptr) - header_bytes);
   }
 
   absl::optional<AllocatorStats> GetStats() override {
+    int64_t num_allocs = 0;
+    int64_t bytes_in_use = 0;
+    int64_t largest_alloc_size = 0;
+    for (const StatsShard& shard : stats_shards_) {
+      num_allocs += shard.num_allocs.load(std::memory_order_relaxed);
+      bytes_in_use += shard.bytes_in_use.load(std::memory_order_relaxed);
+      largest_alloc_size =
+          std::max(largest_alloc_size,
+                   shard.largest_alloc_size.load(std::memory_order_relaxed));
+    }
     mutex_lock l(mutex_);
+    stats_.num_allocs = num_allocs;
+    stats_.bytes_in_use = bytes_in_use;
+    // The shards hold no consistent snapshot of the bytes in use, so the peak
+    // is the largest number of bytes in use seen by GetStats().
+    stats_.peak_bytes_in_use =
+        std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+    stats_.largest_alloc_size = largest_alloc_size;
     return stats_;
   }
 
   bool ClearStats() override {
+    for (StatsShard& shard : stats_shards_) {
+      shard.num_allocs.store(0, std::memory_order_relaxed);
+      shard.bytes_in_use.store(0, std::memory_order_relaxed);
+      shard.largest_alloc_size.store(0, std::memory_order_relaxed);
+    }
     mutex_lock l(mutex_);
     stats_.num_allocs = 0;
     stats_.peak_bytes_in_use = 0;
@@ -96,37 +236,67 @@ class MklSmallSizeAllocator : public Allocator {
   }
 
  private:
+  // Header of an allocation: the header size and the allocation size.
+  static constexpr size_t kMinHeaderBytes = 2 * sizeof(size_t);
+
+  static constexpr int kNumStatsShards = 32;
+
+  struct alignas(64) StatsShard {
+    std::atomic<int64_t> num_allocs{0};
+    std::atomic<int64_t> bytes_in_use{0};
+    std::atomic<int64_t> largest_alloc_size{0};
+  };
+
+  // Returns the statistics shard of the calling thread.
+  inline StatsShard& GetStatsShard() {
+    static std::atomic<int> next_shard{0};
+    static thread_local const int shard =
+        next_shard.fetch_add(1, std::memory_order_relaxed) % kNumStatsShards;
+    return stats_shards_[shard];
+  }
+
   // Increment statistics for the allocator handling small allocations.
-  inline void IncrementStats(size_t alloc_size) TF_LOCKS_EXCLUDED(mutex_) {
-    mutex_lock l(mutex_);
-    ++stats_.num_allocs;
-    stats_.bytes_in_use += alloc_size;
-    stats_.peak_bytes_in_use =
-        std::max(stats_.peak_bytes_in_use, stats_.bytes_in_use);
-    stats_.largest_alloc_size =
-        std::max(alloc_size, static_cast<size_t>(stats_.largest_alloc_size));
+  inline void IncrementStats(size_t alloc_size) {
+    StatsShard& shard = GetStatsShard();
+    shard.num_allocs.fetch_add(1, std::memory_order_relaxed);
+    shard.bytes_in_use.fetch_add(alloc_size, std::memory_order_relaxed);
+    int64_t largest = shard.largest_alloc_size.load(std::memory_order_relaxed);
+    while (static_cast<int64_t>(alloc_size) > largest &&
+           !shard.largest_alloc_size.compare_exchange_weak(
+               largest, alloc_size, std::memory_order_relaxed)) {
+    }
   }
 
   // Decrement statistics for the allocator handling small allocations.
-  inline void DecrementStats(size_t dealloc_size) TF_LOCKS_EXCLUDED(mutex_) {
-    mutex_lock l(mutex_);
-    stats_.bytes_in_use -= dealloc_size;
+  inline void DecrementStats(size_t dealloc_size) {
+    GetStatsShard().bytes_in_use.fetch_sub(dealloc_size,
+                                           std::memory_order_relaxed);
   }
 
   SubAllocator* sub_allocator_;  // Not owned by this class.
 
-  // Mutex for protecting updates to map of allocations.
+  // Mutex for protecting the aggregated statistics.
   mutable mutex mutex_;
 
   // Allocator name
   string name_;
 
+  // Whether statistics are collected, fixed at construction since it
+  // determines the layout of the allocations.
+  const bool collect_stats_;
+
+  StatsShard stats_shards_[kNumStatsShards];
+
   // Allocator stats for small allocs
   AllocatorStats stats_ TF_GUARDED_BY(mutex_);
 };
 
 /// CPU allocator for MKL that wraps BFC allocator and intercepts
 /// and redirects memory allocation calls from MKL.
+///
+/// An allocator for a NUMA node binds the regions of its BFC allocator to the
+/// node. Small allocations still use malloc, whose pages are placed by first
+/// touch on the node of the thread that writes them.
 class MklCPUAllocator : public Allocator {
  public:
   // Constructor and other standard functions
@@ -137,7 +307,15 @@ class MklCPUAllocator : public Allocator {
   /// Default upper limit on allocator size - 64GB
   static constexpr size_t kDefaultMaxLimit = 64LL << 30;
 
-  MklCPUAllocator() { TF_CHECK_OK(Initialize()); }
+  MklCPUAllocator() : MklCPUAllocator(port::kNUMANoAffinity) {}
+
+  explicit MklCPUAllocator(int numa_node)
+      : numa_node_(numa_node),
+        name_(numa_node == port::kNUMANoAffinity
+                  ? string(kName)
+                  : strings::StrCat(kName, "_numa_", numa_node)) {
+    TF_CHECK_OK(Initialize());
+  }
 
   ~MklCPUAllocator() override {
     delete small_size_allocator_;
@@ -177,44 +355,36 @@ class MklCPUAllocator : public Allocator {
 
     VLOG(1) << "MklCPUAllocator: Setting max_mem_bytes: " << max_mem_bytes;
 
-    sub_allocator_ = new MklSubAllocator();
+    // The regions of the BFC allocator are tracked to route deallocations
+    // to the allocator that served them.
+    sub_allocator_ = new MklSubAllocator(
+        numa_node_,
+        {[this](void* ptr, int index, size_t num_bytes) {
+          large_regions_.Add(ptr, num_bytes);
+        }},
+        {[this](void* ptr, int index, size_t num_bytes) {
+          large_regions_.Remove(ptr);
+        }});
 
     // SubAllocator is owned by BFCAllocator, so we do not need to deallocate
     // it in MklSmallSizeAllocator.
     small_size_allocator_ =
-        new MklSmallSizeAllocator(sub_allocator_, max_mem_bytes, kName);
+        new MklSmallSizeAllocator(sub_allocator_, max_mem_bytes, name_);
 
     BFCAllocator::Options large_allocator_opts;
     large_allocator_opts.allow_growth = kAllowGrowth;
     large_size_allocator_ =
-        new BFCAllocator(absl::WrapUnique(sub_allocator_), max_mem_bytes, kName,
+        new BFCAllocator(absl::WrapUnique(sub_allocator_), max_mem_bytes, name_,
                          large_allocator_opts);
     return OkStatus();
   }
 
-  inline string Name() override { return kName; }
-  inline bool IsSmallSizeAllocation(const void* ptr) const
-      TF_LOCKS_EXCLUDED(mutex_) {
-    mutex_lock l(mutex_);
-    return large_allocations_map_.find(ptr) == large_allocations_map_.end();
-  }
-  // AddLargeAllocMap and RemoveLargeAllocMap are always called with a lock held
-  inline void AddLargeAllocMap(void* ptr, size_t num_bytes)
-      TF_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    if (ptr != nullptr) {
-      std::pair<void*, size_t> map_val(ptr, num_bytes);
-      large_allocations_map_.insert(map_val);
-    }
-  }
-  inline void RemoveLargeAllocMap(void* ptr)
-      TF_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    auto map_iter = large_allocations_map_.find(ptr);
-    if (map_iter != large_allocations_map_.end()) {
-      large_allocations_map_.erase(map_iter);
-    } else {
-      LOG(ERROR) << "tried to deallocate invalid pointer";
-    }
-    return;
+  inline string Name() override { return name_; }
+  int NumaNode() const { return numa_node_; }
+
+  // Lock-free, as the regions of the large-size allocator are only read.
+  inline bool IsSmallSizeAllocation(const void* ptr) const {
+    return !large_regions_.Contains(ptr);
   }
 
   inline void* AllocateRaw(size_t alignment, size_t num_bytes) override {
@@ -225,10 +395,7 @@ class MklCPUAllocator : public Allocator {
     if (UseSystemAlloc() || num_bytes < kSmallAllocationsThreshold) {
       return small_size_allocator_->AllocateRaw(alignment, num_bytes);
     } else {
-      mutex_lock l(mutex_);
-      void* ptr = large_size_allocator_->AllocateRaw(alignment, num_bytes);
-      AddLargeAllocMap(ptr, num_bytes);
-      return ptr;
+      return large_size_allocator_->AllocateRaw(alignment, num_bytes);
     }
   }
   inline void DeallocateRaw(void* ptr) override {
@@ -237,8 +404,6 @@ class MklCPUAllocator : public Allocator {
     if (UseSystemAlloc() || IsSmallSizeAllocation(ptr)) {
       small_size_allocator_->DeallocateRaw(ptr);
     } else {
-      mutex_lock l(mutex_);
-      RemoveLargeAllocMap(ptr);
       large_size_allocator_->DeallocateRaw(ptr);
     }
   }
@@ -302,6 +467,10 @@ class MklCPUAllocator : public Allocator {
   // The alignment that we need for the allocations
   static constexpr const size_t kAlignment = 64;
 
+  // NUMA node of the large allocations, or kNUMANoAffinity.
+  const int numa_node_;
+  const string name_;
+
   Allocator* large_size_allocator_;              // owned by this class
   MklSmallSizeAllocator* small_size_allocator_;  // owned by this class.
 
@@ -309,10 +478,9 @@ class MklCPUAllocator : public Allocator {
   mutable mutex mutex_;
   AllocatorStats stats_ TF_GUARDED_BY(mutex_);
 
-  // Hash map to keep track of "BFC" allocations
-  // We do not use BFC allocator for small allocations.
-  std::unordered_map<const void*, size_t> large_allocations_map_
-      TF_GUARDED_BY(mutex_);
+  // Address ranges of the regions of the BFC allocator, which serves all
+  // allocations that are not small.
+  MklRegionSet large_regions_;
 
   // Size in bytes that defines the upper-bound for "small" allocations.
   // Any allocation below this threshold is "small" allocation.
@@ -322,6 +490,10 @@ class MklCPUAllocator : public Allocator {
   TF_DISALLOW_COPY_AND_ASSIGN(MklCPUAllocator);
 };
 
+// Returns the process-wide MklCPUAllocator for 'numa_node', created on first
+// use, or nullptr if 'numa_node' is out of range.
+Allocator* GetMklNumaCPUAllocator(int numa_node);
+
 }  // namespace tensorflow
 
 #endif  // INTEL_MKL
@@ -17,9 +17,18 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/mkl_cpu_allocator.h"
 
+#ifdef __linux__
+#include <sched.h>
+#endif  // __linux__
+
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -47,6 +56,100 @@ TEST(MKLBFCAllocatorTest, TestMaxLimit) {
   EXPECT_TRUE(errors::IsInvalidArgument(a.Initialize()));
 }
 
+TEST(MKLBFCAllocatorTest, TestRegionSet) {
+  MklRegionSet regions;
+  char buffer[1024];
+  EXPECT_FALSE(regions.Contains(buffer));
+
+  regions.Add(buffer, 512);
+  EXPECT_TRUE(regions.Contains(buffer));
+  EXPECT_TRUE(regions.Contains(buffer + 511));
+  EXPECT_FALSE(regions.Contains(buffer + 512));
+
+  // Regions beyond the lock-free slots are still found.
+  std::vector<std::unique_ptr<char[]>> more_regions;
+  for (int i = 0; i < 200; ++i) {
+    more_regions.emplace_back(new char[16]);
+    regions.Add(more_regions.back().get(), 16);
+  }
+  for (const auto& region : more_regions) {
+    EXPECT_TRUE(regions.Contains(region.get() + 15));
+  }
+
+  regions.Remove(buffer);
+  EXPECT_FALSE(regions.Contains(buffer));
+  regions.Remove(more_regions.back().get());
+  EXPECT_FALSE(regions.Contains(more_regions.back().get()));
+}
+
+TEST(MKLBFCAllocatorTest, TestSmallAndLargeAllocations) {
+  if (UseSystemAlloc()) GTEST_SKIP() << "All allocations are small";
+  MklCPUAllocator a;
+  void* small_ptr = a.AllocateRaw(64, 1024);
+  void* large_ptr = a.AllocateRaw(64, 1 << 20);
+  ASSERT_NE(small_ptr, nullptr);
+  ASSERT_NE(large_ptr, nullptr);
+  EXPECT_TRUE(a.IsSmallSizeAllocation(small_ptr));
+  EXPECT_FALSE(a.IsSmallSizeAllocation(large_ptr));
+  EXPECT_GE(a.GetStats()->bytes_in_use, 1 << 20);
+
+  a.DeallocateRaw(small_ptr);
+  a.DeallocateRaw(large_ptr);
+  EXPECT_EQ(a.GetStats()->bytes_in_use, 0);
+}
+
+TEST(MKLBFCAllocatorTest, TestNumaAllocators) {
+  Allocator* allocator = GetMklNumaCPUAllocator(0);
+  ASSERT_NE(allocator, nullptr);
+  EXPECT_EQ(allocator, GetMklNumaCPUAllocator(0));
+  EXPECT_EQ(allocator->Name(), "mklcpu_numa_0");
+  EXPECT_EQ(GetMklNumaCPUAllocator(-1), nullptr);
+
+  void* ptr = allocator->AllocateRaw(64, 1 << 20);
+  ASSERT_NE(ptr, nullptr);
+  allocator->DeallocateRaw(ptr);
+}
+
+// Reads a buffer bound to NUMA node 'range(0)' from a thread bound to node
+// 'range(1)', to compare local and remote memory bandwidth. Nodes beyond the
+// nodes of the machine wrap around. The previous CPU affinity of the thread
+// is restored afterwards, so that it does not leak into later benchmarks.
+static void BM_NumaReadBandwidth(::testing::benchmark::State& state) {
+  const int num_nodes = port::NUMANumNodes();
+  const int memory_node = state.range(0) % num_nodes;
+  const int thread_node = state.range(1) % num_nodes;
+  const size_t num_bytes = 256 << 20;
+  const size_t num_elements = num_bytes / sizeof(int64_t);
+  int64_t* buffer =
+      static_cast<int64_t*>(port::NUMAMalloc(memory_node, num_bytes, 64));
+  if (buffer == nullptr) {
+    state.SkipWithError("Failed to allocate the buffer on the NUMA node");
+    return;
+  }
+  for (size_t i = 0; i < num_elements; ++i) buffer[i] = i;
+#ifdef __linux__
+  cpu_set_t cpus;
+  const bool restore_cpus = sched_getaffinity(0, sizeof(cpus), &cpus) == 0;
+#endif  // __linux__
+  port::NUMASetThreadNodeAffinity(thread_node);
+
+  int64_t sum = 0;
+  for (auto s : state) {
+    for (size_t i = 0; i < num_elements; ++i) sum += buffer[i];
+    ::tensorflow::testing::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+#ifdef __linux__
+  if (restore_cpus) sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif  // __linux__
+  port::NUMAFree(buffer, num_bytes);
+}
+BENCHMARK(BM_NumaReadBandwidth)
+    ->ArgPair(0, 0)
+    ->ArgPair(0, 1)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1);
+
 }  // namespace tensorflow
 
 #endif  // INTEL_MKL
@@ -396,9 +396,10 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     rinfo_.push_back(
         {csinfo_.add_v2, mkl_op_registry::GetMklOpName(csinfo_.add_v2),
          CopyAttrsAll, RewriteIfAtleastOneMklInput, GetRewriteCause()});
-    rinfo_.push_back({csinfo_.avg_pool,
-                      mkl_op_registry::GetMklOpName(csinfo_.avg_pool),
-                      CopyAttrsAll, RewriteIfX86, GetRewriteCause()});
+    rinfothr_.push_back(
+        {{csinfo_.avg_pool, mkl_op_registry::GetMklOpName(csinfo_.avg_pool),
+          CopyAttrsAll, std::function<bool(const Node*)>(), GetRewriteCause()},
+         AvgPoolRewrite});
     rinfo_.push_back({csinfo_.avg_pool_grad,
                       mkl_op_registry::GetMklOpName(csinfo_.avg_pool_grad),
                       CopyAttrsAll, AlwaysRewrite, GetRewriteCause()});
@@ -408,15 +409,19 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     rinfo_.push_back({csinfo_.avg_pool3d_grad,
                       mkl_op_registry::GetMklOpName(csinfo_.avg_pool3d_grad),
                       CopyAttrsAll, AlwaysRewrite, GetRewriteCause()});
-    rinfo_.push_back({csinfo_.batch_matmul,
-                      mkl_op_registry::GetMklOpName(csinfo_.batch_matmul),
-                      CopyAttrsAll, MatMulRewrite, kRewriteForOpNameChange});
+    rinfothr_.push_back(
+        {{csinfo_.batch_matmul,
+          mkl_op_registry::GetMklOpName(csinfo_.batch_matmul), CopyAttrsAll,
+          std::function<bool(const Node*)>(), kRewriteForOpNameChange},
+         MatMulRewriteWithThreads});
     rinfo_.push_back({csinfo_.einsum,
                       mkl_op_registry::GetMklOpName(csinfo_.einsum),
                       CopyAttrsAll, MatMulRewrite, kRewriteForOpNameChange});
-    rinfo_.push_back({csinfo_.batch_matmul_v2,
-                      mkl_op_registry::GetMklOpName(csinfo_.batch_matmul_v2),
-                      CopyAttrsAll, MatMulRewrite, kRewriteForOpNameChange});
+    rinfothr_.push_back(
+        {{csinfo_.batch_matmul_v2,
+          mkl_op_registry::GetMklOpName(csinfo_.batch_matmul_v2), CopyAttrsAll,
+          std::function<bool(const Node*)>(), kRewriteForOpNameChange},
+         MatMulRewriteWithThreads});
     rinfo_.push_back({csinfo_.concat,
                       mkl_op_registry::GetMklOpName(csinfo_.concat),
                       CopyAttrsAll, AlwaysRewrite, GetRewriteCause()});
@@ -521,11 +526,13 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
                                  : csinfo_.mkl_fused_depthwise_conv2d,
                       CopyAttrsAllCheckConstFilter, FusedDepthwiseConv2DRewrite,
                       GetRewriteCause()});
-    rinfo_.push_back({csinfo_.fused_matmul,
-                      native_fmt ? csinfo_.mkl_native_fused_matmul
-                                 : csinfo_.mkl_fused_matmul,
-                      CopyAttrsAllCheckConstFilter, FusedMatMulRewrite,
-                      GetRewriteCause()});
+    rinfothr_.push_back(
+        {{csinfo_.fused_matmul,
+          native_fmt ? csinfo_.mkl_native_fused_matmul
+                     : csinfo_.mkl_fused_matmul,
+          CopyAttrsAllCheckConstFilter, std::function<bool(const Node*)>(),
+          GetRewriteCause()},
+         FusedMatMulRewriteWithThreads});
     rinfo_.push_back(
         {csinfo_.fused_pad_conv2d, csinfo_.mkl_native_pad_with_conv2d,
          CopyAttrsAllCheckConstFilter, AlwaysRewrite, kRewriteForOpNameChange});
@@ -537,18 +544,21 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     rinfo_.push_back({csinfo_.lrn_grad,
                       mkl_op_registry::GetMklOpName(csinfo_.lrn_grad),
                       CopyAttrsAll, LrnGradRewrite, GetRewriteCause()});
-    rinfo_.push_back({csinfo_.matmul,
-                      mkl_op_registry::GetMklOpName(csinfo_.matmul),
-                      CopyAttrsAll, MatMulRewrite, kRewriteForOpNameChange});
+    rinfothr_.push_back(
+        {{csinfo_.matmul, mkl_op_registry::GetMklOpName(csinfo_.matmul),
+          CopyAttrsAll, std::function<bool(const Node*)>(),
+          kRewriteForOpNameChange},
+         MatMulRewriteWithThreads});
     rinfo_.push_back({csinfo_.leakyrelu,
                       mkl_op_registry::GetMklOpName(csinfo_.leakyrelu),
                       CopyAttrsAll, LeakyReluRewrite, GetRewriteCause()});
     rinfo_.push_back({csinfo_.leakyrelu_grad,
                       mkl_op_registry::GetMklOpName(csinfo_.leakyrelu_grad),
                       CopyAttrsAll, LeakyReluRewrite, GetRewriteCause()});
-    rinfo_.push_back(
-        {csinfo_.max_pool, mkl_op_registry::GetMklOpName(csinfo_.max_pool),
-         CopyAttrsAll, NonDepthBatchWisePoolRewrite, GetRewriteCause()});
+    rinfothr_.push_back(
+        {{csinfo_.max_pool, mkl_op_registry::GetMklOpName(csinfo_.max_pool),
+          CopyAttrsAll, std::function<bool(const Node*)>(), GetRewriteCause()},
+         MaxPoolRewrite});
     rinfo_.push_back({csinfo_.max_pool_grad,
                       mkl_op_registry::GetMklOpName(csinfo_.max_pool_grad),
                       CopyAttrsAll, MaxpoolGradRewrite, GetRewriteCause()});
@@ -761,6 +771,15 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
   // Standard interface to run pass
   Status Run(const GraphOptimizationPassOptions& options);
 
+  // The rewrite is skipped when oneDNN is disabled at runtime, and its
+  // heuristics depend on the rewrite threshold profile.
+  string CacheKey() const override {
+    const LoadedRewriteThresholdProfile& profile = RewriteThresholdProfile();
+    return absl::StrCat("onednn=", IsMKLEnabled(),
+                        ";thresholds=", profile.path, "@",
+                        profile.fingerprint);
+  }
+
   // Helper function which does most of heavy lifting for rewriting
   // Mkl nodes to propagate Mkl tensor as additional output
   //
@@ -1483,6 +1502,15 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
 #endif
   }
 
+  // Returns false if the node does too little work for oneDNN to amortize
+  // its framework and thread synchronization overheads on this CPU. Nodes
+  // whose MFLOPs cannot be estimated are always considered worth rewriting.
+  static bool IsAboveRewriteThreshold(const Node* n, int threads) {
+    double mflops = CalculateNodeMFlops(n->attrs(), n->type_string());
+    double thr = FindRewriteThreshold(n->type_string(), threads);
+    return (mflops < 0 || mflops >= thr);
+  }
+
   // Rewrite rule which considers "context" of the current node to decide if we
   // should rewrite. By "context" we currently mean all the inputs of current
   // node. The idea is if none of the inputs of current node are not MKL nodes,
@@ -1528,6 +1556,11 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     }
     return false;
   }
+
+  static bool MatMulRewriteWithThreads(const Node* n, int threads) {
+    return IsAboveRewriteThreshold(n, threads) && MatMulRewrite(n);
+  }
+
   // For oneDNN, only int32 is supported for axis data type
   static bool ConcatV2Rewrite(const Node* n) {
     DataType T;
@@ -1578,6 +1611,19 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     return !trans_a;
   }
 
+  static bool FusedMatMulRewriteWithThreads(const Node* n, int threads) {
+    return IsAboveRewriteThreshold(n, threads) && FusedMatMulRewrite(n);
+  }
+
+  static bool MaxPoolRewrite(const Node* n, int threads) {
+    return IsAboveRewriteThreshold(n, threads) &&
+           NonDepthBatchWisePoolRewrite(n);
+  }
+
+  static bool AvgPoolRewrite(const Node* n, int threads) {
+    return IsAboveRewriteThreshold(n, threads) && RewriteIfX86(n);
+  }
+
   // Check if we are performing pooling on depth or batch. If it is, then we
   // do not rewrite MaxPool node to Mkl version.
   // @return - true (if it is not a depth/batch wise pooling case);
@@ -1807,10 +1853,7 @@ class MklLayoutRewritePass : public GraphOptimizationPass {
     // to use oneDNN operations as overhead to call into oneDNN
     // as data setup is higher then actual useful work we
     // might end up doing.
-    double total_mflops = CalculateNodeMFlops(n->attrs(), n->type_string());
-    double thr = FindRewriteThreshold(n->type_string(), threads);
-
-    return (total_mflops < 0 || total_mflops >= thr);
+    return IsAboveRewriteThreshold(n, threads);
   }
 
   static bool FusedConv2DRewrite(const Node* n, int threads) {
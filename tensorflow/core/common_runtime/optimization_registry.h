@@ -93,6 +93,13 @@ class GraphOptimizationPass {
   void set_name(const string& name) { name_ = name; }
   string name() const { return name_; }
 
+  // Returns what, besides the input graphs and the options, determines the
+  // output of this pass, e.g. a version of the rewrite and the environment
+  // settings it reads. Persistent caches of optimized graphs include it in
+  // their keys. An empty key, the default, marks the output of the pass as
+  // not cacheable, so passes opt in to caching by overriding this.
+  virtual string CacheKey() const { return ""; }
+
  private:
   // The name of the optimization pass, which is the same as the inherited
   // class name.
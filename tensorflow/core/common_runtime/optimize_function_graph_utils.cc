@@ -18,6 +18,7 @@ limitations under the License.
 #include <cstdlib>
 #include <iterator>
 #include <memory>
+#include <set>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -25,6 +26,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "tensorflow/core/common_runtime/composite_device.h"
@@ -33,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function_def_utils.h"
 #include "tensorflow/core/common_runtime/function_optimization_registry.h"
 #include "tensorflow/core/common_runtime/function_utils.h"
+#include "tensorflow/core/common_runtime/graph_constructor.h"
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
 #include "tensorflow/core/common_runtime/optimized_function_graph_info.h"
@@ -45,7 +48,10 @@ limitations under the License.
 #include "tensorflow/core/framework/optimized_function_graph.pb.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/graph_node_util.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/util/debug_data_dumper.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tsl/platform/env.h"
@@ -234,6 +240,158 @@ string GetFileCacheName(const string& dir_name, const string& function_name,
                       tsl::port::TaskId(), "_", plain_func_name, "_",
                       fdef->node_def_size());
 }
+
+// Identifies the CPU and the instruction set extensions that the CPU graph
+// rewrites and kernels dispatch on.
+string GetCpuFeaturesKey() {
+  static const std::pair<port::CPUFeature, const char*> kFeatures[] = {
+      {port::AVX, "avx"},
+      {port::AVX2, "avx2"},
+      {port::FMA, "fma"},
+      {port::AVX512F, "avx512f"},
+      {port::AVX512_VNNI, "avx512_vnni"},
+      {port::AVX512_BF16, "avx512_bf16"},
+      {port::AVX_VNNI, "avx_vnni"},
+      {port::AMX_TILE, "amx_tile"},
+      {port::AMX_INT8, "amx_int8"},
+      {port::AMX_BF16, "amx_bf16"}};
+  string key = absl::StrCat(port::CPUVendorIDString(), "/", port::CPUFamily(),
+                            "/", port::CPUModelNum());
+  for (const auto& feature : kFeatures) {
+    if (port::TestCPUFeature(feature.first)) {
+      absl::StrAppend(&key, ",", feature.second);
+    }
+  }
+  return key;
+}
+
+// Gets the key of the partitioned graphs cache entry for `graph`. Besides the
+// graph itself, the key covers everything the partitioning and the
+// post-partitioning passes depend on: the function library, the session
+// config, the devices, the CPU features and the CacheKey() of each
+// post-partitioning pass. Returns an empty key if the output of a
+// post-partitioning pass is not cacheable.
+string GetPartitionsCacheKey(const Graph& graph,
+                             const FunctionLibraryDefinition& lib_def,
+                             const ConfigProto& config,
+                             const DeviceSet& dev_set) {
+  GraphDef graph_def;
+  graph.ToGraphDef(&graph_def);
+  string key =
+      absl::StrCat("graph=", DeterministicProtoHash64(graph_def),
+                   ";library=", DeterministicProtoHash64(lib_def.ToProto()),
+                   ";config=", DeterministicProtoHash64(config),
+                   ";cpu=", GetCpuFeaturesKey(), ";devices=");
+  std::set<string> device_names;
+  for (const Device* device : dev_set.devices()) {
+    device_names.insert(device->name());
+  }
+  absl::StrAppend(&key, absl::StrJoin(device_names, ","));
+
+  const auto& groups = OptimizationPassRegistry::Global()->groups();
+  auto it = groups.find(OptimizationPassRegistry::POST_PARTITIONING);
+  if (it != groups.end()) {
+    for (const auto& phase : it->second) {
+      for (const auto& pass : phase.second) {
+        const string pass_key = pass->CacheKey();
+        if (pass_key.empty()) {
+          VLOG(3) << "Not caching the partitioned graphs, the output of the "
+                     "pass "
+                  << pass->name() << " is not cacheable.";
+          return "";
+        }
+        absl::StrAppend(&key, ";", pass->name(), "=", pass_key);
+      }
+    }
+  }
+  return key;
+}
+
+// Gets the full path name of the partitioned graphs file cache. The key is
+// also stored in the file, to detect fingerprint collisions.
+string GetPartitionsFileCacheName(const string& dir_name,
+                                  const string& cache_key) {
+  return absl::StrCat(dir_name, "/", tsl::port::JobName(), "_",
+                      tsl::port::TaskId(), "_partitions_",
+                      absl::Hex(Fingerprint64(cache_key), absl::kZeroPad16));
+}
+
+// Writes the post-partitioning subgraphs, and the functions the passes added
+// to `lib_def`, into a cache file. Returns error if the cache file writing
+// fails.
+Status WritePartitionsToCache(
+    const string& dir_name, const string& file_name, const string& cache_key,
+    const std::unordered_map<string, std::unique_ptr<Graph>>& subgraphs,
+    const FunctionLibraryDefinition& lib_def,
+    const std::vector<string>& function_names_before_passes, Env* env) {
+  PartitionedFunctionGraphs proto;
+  proto.set_cache_key(cache_key);
+  for (const auto& pair : subgraphs) {
+    pair.second->ToGraphDef(&(*proto.mutable_partition_graphs())[pair.first]);
+  }
+  const std::set<string> existing_functions(
+      function_names_before_passes.begin(), function_names_before_passes.end());
+  for (const string& name : lib_def.ListFunctionNames()) {
+    if (existing_functions.count(name) == 0) {
+      *proto.mutable_added_functions()->add_function() = *lib_def.Find(name);
+    }
+  }
+
+  if (!env->FileExists(dir_name).ok()) {
+    TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(dir_name));
+  }
+  // Writes a uniquely named temporary file first, so that other processes
+  // sharing the cache directory never read a partially written file.
+  string tmp_file_name = absl::StrCat(file_name, ".");
+  if (!env->CreateUniqueFileName(&tmp_file_name, ".tmp")) {
+    return errors::AlreadyExists("Failed to create a unique temporary file ",
+                                 "name for ", file_name);
+  }
+  Status s =
+      tsl::WriteStringToFile(env, tmp_file_name, proto.SerializeAsString());
+  if (s.ok()) {
+    s = env->RenameFile(tmp_file_name, file_name);
+  }
+  if (!s.ok()) {
+    env->DeleteFile(tmp_file_name).IgnoreError();
+  }
+  return s;
+}
+
+// Restores the post-partitioning subgraphs from a cache file, and adds the
+// functions the passes added to the library to `lib_def`. Returns error if
+// cache file loading fails or the file belongs to a different cache key.
+StatusOr<std::unique_ptr<std::unordered_map<string, std::unique_ptr<Graph>>>>
+ReadPartitionsFromCache(const string& file_name, const string& cache_key,
+                        const OpRegistryInterface* op_registry,
+                        FunctionLibraryDefinition* lib_def, Env* env) {
+  string proto_str;
+  TF_RETURN_IF_ERROR(tsl::ReadFileToString(env, file_name, &proto_str));
+  PartitionedFunctionGraphs proto;
+  if (!proto.ParseFromString(proto_str)) {
+    return errors::DataLoss("Failed to parse partitioned graphs cache file ",
+                            file_name);
+  }
+  if (proto.cache_key() != cache_key) {
+    return errors::FailedPrecondition("Partitioned graphs cache file ",
+                                      file_name,
+                                      " was written for a different graph");
+  }
+  TF_RETURN_IF_ERROR(lib_def->AddLibrary(proto.added_functions()));
+
+  auto subgraphs =
+      std::make_unique<std::unordered_map<string, std::unique_ptr<Graph>>>();
+  for (const auto& pair : proto.partition_graphs()) {
+    auto subgraph = std::make_unique<Graph>(op_registry);
+    GraphConstructorOptions opts;
+    opts.allow_internal_ops = true;
+    opts.expect_device_spec = true;
+    TF_RETURN_IF_ERROR(
+        ConvertGraphDefToGraph(opts, pair.second, subgraph.get()));
+    subgraphs->emplace(pair.first, std::move(subgraph));
+  }
+  return std::move(subgraphs);
+}
 }  // namespace
 
 Status GetGraphAndArgRets(
@@ -771,6 +929,62 @@ PreprocessAndPartitionGraph(
                                  "before_partition", graph.get(),
                                  &input_optimized_graph.lib_def, VLOG_IS_ON(4));
 
+  SessionOptions session_options;
+  session_options.env = env;
+  session_options.config = options.config_proto;
+
+  // As not all devices might set number of threads for intra op
+  // parallelisation we restrict this only to local device which does.
+  if (cpu_device && std::is_same<decltype(cpu_device), LocalDevice>::value &&
+      cpu_device->tensorflow_cpu_worker_threads() != nullptr) {
+    // Forward to the optimisation pass number of intra threads that are used to
+    // parallelise operations.
+    session_options.config.set_intra_op_parallelism_threads(
+        cpu_device->tensorflow_cpu_worker_threads()->num_threads);
+  }
+
+  // Normally POST_PARTITIONING passes are run by distributed workers.
+  // Distributed workers are currently not supported in this code path, so we
+  // run the passes here.
+  const bool should_run_optimization_passes = !options.is_component_function;
+
+  // The partitioned and post-optimized subgraphs are cached in the same
+  // directory as the optimized function graphs, so that a warm start skips the
+  // post-partitioning rewrites as well.
+  const string dir_name = absl::StrCat(getenv(kGraphCachingEnvVariableName));
+  // The cache is not used if the output of a pass is not cacheable.
+  string partitions_cache_key;
+  if (should_run_optimization_passes && !dir_name.empty()) {
+    partitions_cache_key =
+        GetPartitionsCacheKey(*graph, input_optimized_graph.lib_def,
+                              session_options.config, dev_set);
+  }
+  const bool use_partitions_cache = !partitions_cache_key.empty();
+  string partitions_file_name;
+  if (use_partitions_cache) {
+    partitions_file_name =
+        GetPartitionsFileCacheName(dir_name, partitions_cache_key);
+    if (env->FileExists(partitions_file_name).ok()) {
+      auto subgraphs = ReadPartitionsFromCache(
+          partitions_file_name, partitions_cache_key,
+          graph->flib_def().default_registry(), &input_optimized_graph.lib_def,
+          env);
+      if (subgraphs.ok()) {
+        LOG(INFO) << "Restored the partitioned TensorFlow graphs from cache "
+                     "for the function: "
+                  << function_name
+                  << ", full cache file path: " << partitions_file_name;
+        graph.reset();
+        return subgraphs;
+      }
+      LOG(ERROR) << "Reading from the partitioned TensorFlow graphs cache "
+                    "failed. Continue to partition and optimize the graph "
+                    "instead. Error: "
+                 << subgraphs.status();
+    }
+  }
+  const uint64_t partitioning_start_time_usecs = env->NowMicros();
+
   // Partition the graph.
   auto device_name_to_subgraphs =
       std::make_unique<std::unordered_map<string, std::unique_ptr<Graph>>>();
@@ -789,9 +1003,6 @@ PreprocessAndPartitionGraph(
 
   // Doing post-partitioning passes.
   GraphOptimizationPassOptions optimization_options;
-  SessionOptions session_options;
-  session_options.env = env;
-  session_options.config = options.config_proto;
   optimization_options.session_options = &session_options;
   optimization_options.flib_def = &(input_optimized_graph.lib_def);
   optimization_options.is_function_graph = true;
@@ -800,20 +1011,9 @@ PreprocessAndPartitionGraph(
   optimization_options.partition_graphs = device_name_to_subgraphs.get();
   optimization_options.debug_filename_prefix = function_name;
 
-  // As not all devices might set number of threads for intra op
-  // parallelisation we restrict this only to local device which does.
-  if (cpu_device && std::is_same<decltype(cpu_device), LocalDevice>::value &&
-      cpu_device->tensorflow_cpu_worker_threads() != nullptr) {
-    // Forward to the optimisation pass number of intra threads that are used to
-    // parallelise operations.
-    session_options.config.set_intra_op_parallelism_threads(
-        cpu_device->tensorflow_cpu_worker_threads()->num_threads);
-  }
-
-  // Normally POST_PARTITIONING passes are run by distributed workers.
-  // Distributed workers are currently not supported in this code path, so we
-  // run the passes here.
-  const bool should_run_optimization_passes = !options.is_component_function;
+  const std::vector<string> function_names_before_passes =
+      use_partitions_cache ? input_optimized_graph.lib_def.ListFunctionNames()
+                           : std::vector<string>();
   if (should_run_optimization_passes) {
     TF_RETURN_IF_ERROR(OptimizationPassRegistry::Global()->RunGrouping(
         OptimizationPassRegistry::POST_PARTITIONING, optimization_options));
@@ -829,6 +1029,32 @@ PreprocessAndPartitionGraph(
                                    &input_optimized_graph.lib_def, false);
   }
 
+  // Write the subgraphs into the cache if the rewriting of this function,
+  // before and after partitioning, took long enough to be worth it.
+  const uint64_t partitioning_duration_usecs =
+      env->NowMicros() - partitioning_start_time_usecs;
+  if (use_partitions_cache &&
+      absl::Microseconds(input_optimized_graph.optimization_duration_usecs +
+                         partitioning_duration_usecs) >=
+          kCachingThresholdDuration) {
+    Status s = WritePartitionsToCache(
+        dir_name, partitions_file_name, partitions_cache_key,
+        *device_name_to_subgraphs, input_optimized_graph.lib_def,
+        function_names_before_passes, env);
+    // If writing to cache failed, log the error message and move on without
+    // failing the program.
+    if (!s.ok()) {
+      LOG(ERROR) << "Caching the partitioned TensorFlow graphs failed; "
+                    "continue without caching. Error message: "
+                 << s;
+    } else {
+      VLOG(3) << "Wrote the partitioned TensorFlow graphs into cache for the "
+                 "function: "
+              << function_name << ", full cache file path: "
+              << partitions_file_name;
+    }
+  }
+
   return std::move(device_name_to_subgraphs);
 }
 
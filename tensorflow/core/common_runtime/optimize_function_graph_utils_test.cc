@@ -245,5 +245,72 @@ TEST(OptimizeFunctionGraphTest, OptimizeFunctionGraphAndWriteToCache) {
   ASSERT_TRUE(empty_file_list.empty());
 }
 
+TEST(OptimizeFunctionGraphTest, PartitionGraphAndWriteToCache) {
+  Env* env = Env::Default();
+
+  // Create a temp directory and set to env variable for the purpose of testing.
+  const string temp_dir = "/tmp/testing_partitions_cache_directory";
+  EXPECT_TRUE(env->RecursivelyCreateDir(temp_dir).ok());
+  setenv(kGraphCachingEnvVariableName, temp_dir.c_str(), 1);
+
+  // Setup InstantiateOptions, FunctionLibraryDefinition, and devices.
+  FunctionLibraryRuntime::InstantiateOptions opts;
+  opts.is_multi_device_function = true;
+  FunctionDefLibrary proto;
+  *(proto.add_function()) = test::function::FindDevice();
+  auto lib_def =
+      std::make_unique<FunctionLibraryDefinition>(OpRegistry::Global(), proto);
+  std::vector<std::unique_ptr<Device>> devices;
+  CreateCpuDeviceList(kDevicePrefix, 3, devices);
+  DeviceSet device_set;
+  for (const auto& device : devices) {
+    device_set.AddDevice(device.get());
+  }
+
+  auto optimize_and_partition = [&]() {
+    StatusOr<OptimizedFunctionGraphInfo> optimized_info =
+        OptimizeFunctionGraph("FindDevice", {}, opts, device_set, lib_def.get(),
+                              /*composite_devices=*/{}, devices[0].get(),
+                              devices[1].get(), env,
+                              OptimizedFunctionGraph::JIT);
+    TF_CHECK_OK(optimized_info.status());
+    // Make the rewriting of the function take long enough to be cached.
+    optimized_info->optimization_duration_usecs =
+        absl::ToInt64Microseconds(kCachingThresholdDuration);
+    return PreprocessAndPartitionGraph(
+        "FindDevice", *optimized_info, opts, device_set, lib_def.get(),
+        /*composite_devices=*/{}, devices[0].get(), env);
+  };
+
+  // Expect one partitions cache file after the first run.
+  auto subgraphs = optimize_and_partition();
+  TF_ASSERT_OK(subgraphs.status());
+  std::vector<string> file_list;
+  TF_ASSERT_OK(env->GetMatchingPaths(
+      absl::StrCat(temp_dir, "/*_partitions_*"), &file_list));
+  EXPECT_EQ(file_list.size(), 1);
+
+  // Expect the same subgraphs to be restored from the cache file.
+  auto restored_subgraphs = optimize_and_partition();
+  TF_ASSERT_OK(restored_subgraphs.status());
+  ASSERT_EQ((*restored_subgraphs)->size(), (*subgraphs)->size());
+  for (const auto& pair : **subgraphs) {
+    auto it = (*restored_subgraphs)->find(pair.first);
+    ASSERT_NE(it, (*restored_subgraphs)->end()) << pair.first;
+    EXPECT_EQ(it->second->num_op_nodes(), pair.second->num_op_nodes());
+  }
+  file_list.clear();
+  TF_ASSERT_OK(env->GetMatchingPaths(
+      absl::StrCat(temp_dir, "/*_partitions_*"), &file_list));
+  EXPECT_EQ(file_list.size(), 1);
+
+  int64_t undeleted_files;
+  int64_t undeleted_dirs;
+  TF_EXPECT_OK(
+      env->DeleteRecursively(temp_dir, &undeleted_files, &undeleted_dirs));
+  EXPECT_EQ(undeleted_files, 0);
+  EXPECT_EQ(undeleted_dirs, 0);
+}
+
 }  // namespace
 }  // namespace tensorflow
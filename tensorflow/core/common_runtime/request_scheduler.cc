@@ -0,0 +1,236 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/request_scheduler.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+// Runs closures on an intra-op thread pool, at most `max_parallelism` at a
+// time. The closures over the limit are queued, and run by the pool threads
+// of the closures that finish, without going back to the pool.
+class RequestScheduler::BoundedThreadPool : public thread::ThreadPoolInterface {
+ public:
+  BoundedThreadPool(thread::ThreadPoolInterface* pool, int max_parallelism)
+      : pool_(pool), max_parallelism_(max_parallelism) {}
+
+  // Waits for all of the closures to finish.
+  ~BoundedThreadPool() override {
+    mutex_lock l(mu_);
+    while (num_running_ > 0) {
+      cv_.wait(l);
+    }
+  }
+
+  void Schedule(std::function<void()> fn) override {
+    bool run_inline = false;
+    {
+      mutex_lock l(mu_);
+      if (num_running_ < max_parallelism_) {
+        ++num_running_;
+      } else if (current_ == this) {
+        // A closure of this pool may wait for the closures it schedules, as
+        // nested parallel loops do, and could deadlock if they were queued
+        // behind it. Over the limit, it runs them itself instead.
+        run_inline = true;
+      } else {
+        queue_.push_back(std::move(fn));
+        return;
+      }
+    }
+    if (run_inline) {
+      Run(fn);
+      return;
+    }
+    pool_->Schedule([this, fn = std::move(fn)]() mutable {
+      while (fn) {
+        Run(fn);
+        mutex_lock l(mu_);
+        if (queue_.empty()) {
+          fn = nullptr;
+          if (--num_running_ == 0) cv_.notify_all();
+        } else {
+          fn = std::move(queue_.front());
+          queue_.pop_front();
+        }
+      }
+    });
+  }
+
+  int NumThreads() const override { return pool_->NumThreads(); }
+
+  int CurrentThreadId() const override { return pool_->CurrentThreadId(); }
+
+  thread::ThreadPoolInterface* pool() const { return pool_; }
+
+ private:
+  void Run(const std::function<void()>& fn) {
+    BoundedThreadPool* const prev = current_;
+    current_ = this;
+    fn();
+    current_ = prev;
+  }
+
+  // The pool whose closure is running on the current thread, if any.
+  static thread_local BoundedThreadPool* current_;
+
+  thread::ThreadPoolInterface* const pool_;  // Not owned.
+  const int max_parallelism_;
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<std::function<void()>> queue_ TF_GUARDED_BY(mu_);
+  int num_running_ TF_GUARDED_BY(mu_) = 0;
+};
+
+thread_local RequestScheduler::BoundedThreadPool*
+    RequestScheduler::BoundedThreadPool::current_ = nullptr;
+
+RequestScheduler::RequestScheduler(Env* env,
+                                   const ThreadOptions& thread_options,
+                                   const string& name, int num_threads,
+                                   int max_intra_op_parallelism)
+    : max_intra_op_parallelism_(max_intra_op_parallelism) {
+  CHECK_GE(num_threads, 1);
+  CHECK_GE(max_intra_op_parallelism, 0);
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(env->StartThread(thread_options,
+                                           absl::StrCat(name, "_", i),
+                                           [this, i]() { WorkerLoop(i); }));
+  }
+}
+
+RequestScheduler::~RequestScheduler() {
+  {
+    tf_shared_lock l(requests_mu_);
+    CHECK(requests_.empty()) << requests_.size() << " requests are active";
+  }
+  {
+    mutex_lock l(wake_mu_);
+    shutdown_ = true;
+  }
+  work_cv_.notify_all();
+  // Joins the threads.
+  threads_.clear();
+}
+
+std::unique_ptr<RequestScheduler::Request> RequestScheduler::StartRequest() {
+  std::unique_ptr<Request> request(new Request(this));
+  mutex_lock l(requests_mu_);
+  requests_.push_back(request.get());
+  return request;
+}
+
+void RequestScheduler::WorkerLoop(int thread_id) {
+  Request* request = nullptr;
+  std::function<void()> fn;
+  while (true) {
+    if (!TakeClosure(thread_id, &request, &fn)) {
+      mutex_lock l(wake_mu_);
+      if (shutdown_) return;
+      // A request that queues a closure after this thread is counted as
+      // sleeping wakes it up; one that queued it before is seen by the
+      // second look at the queues.
+      num_sleeping_.fetch_add(1);
+      const bool found = TakeClosure(thread_id, &request, &fn);
+      if (!found) work_cv_.wait(l);
+      num_sleeping_.fetch_sub(1);
+      if (!found) continue;
+    }
+    fn();
+    fn = nullptr;
+    // The request may end as soon as its last closure is done, so it must
+    // not be accessed after this.
+    request->ClosureDone();
+  }
+}
+
+bool RequestScheduler::TakeClosure(int thread_id, Request** request,
+                                   std::function<void()>* fn) {
+  auto take = [request, fn](Request* victim) {
+    mutex_lock l(victim->mu_);
+    if (victim->queue_.empty()) return false;
+    *fn = std::move(victim->queue_.front());
+    victim->queue_.pop_front();
+    *request = victim;
+    return true;
+  };
+  tf_shared_lock l(requests_mu_);
+  if (requests_.empty()) return false;
+  // With more requests than threads, thread i prefers the i-th oldest request.
+  // With fewer, the threads are divided evenly over the requests.
+  Request* preferred = requests_[thread_id % requests_.size()];
+  if (take(preferred)) return true;
+  for (Request* victim : requests_) {
+    if (victim != preferred && take(victim)) return true;
+  }
+  return false;
+}
+
+void RequestScheduler::NotifyWorker() {
+  if (num_sleeping_.load() == 0) return;
+  mutex_lock l(wake_mu_);
+  work_cv_.notify_one();
+}
+
+RequestScheduler::Request::Request(RequestScheduler* scheduler)
+    : scheduler_(scheduler) {}
+
+RequestScheduler::Request::~Request() {
+  {
+    mutex_lock l(mu_);
+    while (num_pending_ > 0) {
+      done_cv_.wait(l);
+    }
+  }
+  mutex_lock l(scheduler_->requests_mu_);
+  auto& requests = scheduler_->requests_;
+  requests.erase(std::find(requests.begin(), requests.end(), this));
+  // `intra_op_pools_` wait for their closures when they are destroyed.
+}
+
+void RequestScheduler::Request::ScheduleInterOpClosure(
+    std::function<void()> fn) {
+  {
+    mutex_lock l(mu_);
+    queue_.push_back(std::move(fn));
+    ++num_pending_;
+  }
+  scheduler_->NotifyWorker();
+}
+
+void RequestScheduler::Request::ClosureDone() {
+  mutex_lock l(mu_);
+  if (--num_pending_ == 0) done_cv_.notify_all();
+}
+
+thread::ThreadPoolInterface* RequestScheduler::Request::IntraOpThreadPool(
+    thread::ThreadPoolInterface* intra_op_pool) {
+  DCHECK_GT(scheduler_->max_intra_op_parallelism_, 0);
+  mutex_lock l(intra_op_mu_);
+  for (const auto& pool : intra_op_pools_) {
+    if (pool->pool() == intra_op_pool) return pool.get();
+  }
+  intra_op_pools_.push_back(std::make_unique<BoundedThreadPool>(
+      intra_op_pool, scheduler_->max_intra_op_parallelism_));
+  return intra_op_pools_.back().get();
+}
+
+}  // namespace tensorflow
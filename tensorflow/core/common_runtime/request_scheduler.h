@@ -0,0 +1,168 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_REQUEST_SCHEDULER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_REQUEST_SCHEDULER_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool_interface.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// RequestScheduler runs the inter-op closures of concurrent requests, such as
+// the Session::Run() calls of a DirectSession, on a fixed set of threads.
+//
+// A thread::ThreadPool runs the closures of all requests from shared queues,
+// so the closures of a small request wait behind all of the closures that a
+// large request has queued before them. Here every request has its own queue
+// instead:
+//
+// * Each thread prefers one of the active requests, so that the threads are
+//   spread evenly over the oldest requests. When its preferred request has no
+//   work, the thread steals work from the other requests, oldest first. Every
+//   queue has its own lock, so concurrent requests do not contend on one.
+// * Requests are ranked by age: the requests that started earlier get the
+//   threads left over by the other requests first, and so finish first.
+// * If `max_intra_op_parallelism` is positive, at most that many intra-op
+//   closures of each request run at a time, so one request cannot occupy the
+//   whole intra-op thread pool either. This includes the closures scheduled
+//   by other intra-op closures, e.g. by nested parallel loops.
+//
+// Expected usage:
+//
+//   auto request = scheduler->StartRequest();
+//   args.runner = [&request](std::function<void()> fn) {
+//     request->ScheduleInterOpClosure(std::move(fn));
+//   };
+//   args.user_intra_op_threadpool = request->IntraOpThreadPool(intra_op_pool);
+//   executor->Run(args);
+//   request.reset();  // Waits for the closures of the request to finish.
+//
+// This class is thread safe.
+class RequestScheduler {
+ public:
+  class Request;
+
+  // Starts `num_threads` threads. If `max_intra_op_parallelism` is 0, the
+  // intra-op parallelism of the requests is not bounded.
+  RequestScheduler(Env* env, const ThreadOptions& thread_options,
+                   const string& name, int num_threads,
+                   int max_intra_op_parallelism);
+
+  // REQUIRES: All requests have ended.
+  ~RequestScheduler();
+
+  // Starts a new request, which ranks behind all of the active requests. The
+  // request ends when the returned object is destroyed.
+  std::unique_ptr<Request> StartRequest();
+
+  int NumThreads() const { return threads_.size(); }
+  int max_intra_op_parallelism() const { return max_intra_op_parallelism_; }
+
+ private:
+  class BoundedThreadPool;
+
+  // Runs closures until the scheduler is destroyed.
+  void WorkerLoop(int thread_id);
+
+  // Takes the closure that the given thread should run next, and the request
+  // it belongs to. Returns false if no request has queued closures.
+  bool TakeClosure(int thread_id, Request** request, std::function<void()>* fn)
+      TF_LOCKS_EXCLUDED(requests_mu_);
+
+  // Wakes up a sleeping thread, if any, to run a newly queued closure.
+  void NotifyWorker() TF_LOCKS_EXCLUDED(wake_mu_);
+
+  const int max_intra_op_parallelism_;
+
+  // Guards the list of requests. The threads only read it, so they share the
+  // lock; the queues have locks of their own.
+  mutex requests_mu_;
+  // The active requests, oldest first.
+  std::vector<Request*> requests_ TF_GUARDED_BY(requests_mu_);
+
+  // Only taken by the threads that have no work, and by the requests that
+  // queue a closure while a thread is sleeping.
+  mutex wake_mu_;
+  // Signalled when a closure is queued or the scheduler is destroyed.
+  condition_variable work_cv_;
+  // The number of threads that are about to sleep or sleeping on `work_cv_`.
+  std::atomic<int> num_sleeping_{0};
+  bool shutdown_ TF_GUARDED_BY(wake_mu_) = false;
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RequestScheduler);
+};
+
+// The closures of one request. This class is thread safe.
+class RequestScheduler::Request {
+ public:
+  // Waits for all of the closures of the request to finish.
+  ~Request();
+
+  // Queues `fn` to run on one of the threads of the scheduler.
+  void ScheduleInterOpClosure(std::function<void()> fn);
+
+  // Returns a thread pool that runs the closures scheduled on it on
+  // `intra_op_pool`, at most `max_intra_op_parallelism()` at a time. The
+  // closures over the limit are queued, except those scheduled by a closure
+  // of the pool itself, which run inline on the scheduling thread. The
+  // returned pool is owned by the request.
+  //
+  // REQUIRES: `max_intra_op_parallelism()` > 0.
+  thread::ThreadPoolInterface* IntraOpThreadPool(
+      thread::ThreadPoolInterface* intra_op_pool);
+
+ private:
+  friend class RequestScheduler;
+
+  explicit Request(RequestScheduler* scheduler);
+
+  // Called by the scheduler thread that ran one of the closures.
+  void ClosureDone() TF_LOCKS_EXCLUDED(mu_);
+
+  RequestScheduler* const scheduler_;  // Not owned.
+
+  // The threads that run the closures of other requests take this lock to
+  // steal from the queue, so the requests do not contend on a shared lock.
+  mutex mu_;
+  // Signalled when the last pending closure finishes.
+  condition_variable done_cv_;
+  // Queued inter-op closures, and the number of closures that are queued or
+  // running.
+  std::deque<std::function<void()>> queue_ TF_GUARDED_BY(mu_);
+  int64_t num_pending_ TF_GUARDED_BY(mu_) = 0;
+
+  mutex intra_op_mu_;
+  std::vector<std::unique_ptr<BoundedThreadPool>> intra_op_pools_
+      TF_GUARDED_BY(intra_op_mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Request);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_REQUEST_SCHEDULER_H_
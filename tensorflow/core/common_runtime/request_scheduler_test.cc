@@ -0,0 +1,229 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/common_runtime/request_scheduler.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<RequestScheduler> NewScheduler(int num_threads,
+                                               int max_intra_op_parallelism) {
+  return std::make_unique<RequestScheduler>(
+      Env::Default(), ThreadOptions(), "request_scheduler_test", num_threads,
+      max_intra_op_parallelism);
+}
+
+TEST(RequestSchedulerTest, RunsAllClosures) {
+  auto scheduler = NewScheduler(/*num_threads=*/4,
+                                /*max_intra_op_parallelism=*/0);
+  constexpr int kNumRequests = 8;
+  constexpr int kNumClosures = 1000;
+  std::vector<std::atomic<int>> counts(kNumRequests);
+  std::vector<std::unique_ptr<RequestScheduler::Request>> requests;
+  for (int i = 0; i < kNumRequests; ++i) {
+    requests.push_back(scheduler->StartRequest());
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    RequestScheduler::Request* request = requests[i].get();
+    for (int j = 0; j < kNumClosures; ++j) {
+      // Every closure schedules one more closure, as executors do.
+      request->ScheduleInterOpClosure([request, &counts, i]() {
+        request->ScheduleInterOpClosure([&counts, i]() { ++counts[i]; });
+        ++counts[i];
+      });
+    }
+  }
+  // Ending the requests waits for their closures.
+  requests.clear();
+  for (int i = 0; i < kNumRequests; ++i) {
+    EXPECT_EQ(counts[i], 2 * kNumClosures);
+  }
+}
+
+TEST(RequestSchedulerTest, SmallRequestIsNotQueuedBehindLargeRequest) {
+  auto scheduler = NewScheduler(/*num_threads=*/2,
+                                /*max_intra_op_parallelism=*/0);
+  constexpr int kNumLargeClosures = 100;
+  std::atomic<int> num_large_done{0};
+  auto large = scheduler->StartRequest();
+  for (int i = 0; i < kNumLargeClosures; ++i) {
+    large->ScheduleInterOpClosure([&num_large_done]() {
+      Env::Default()->SleepForMicroseconds(1000);
+      ++num_large_done;
+    });
+  }
+
+  int num_large_done_before_small = -1;
+  Notification small_done;
+  auto small = scheduler->StartRequest();
+  small->ScheduleInterOpClosure([&]() {
+    num_large_done_before_small = num_large_done;
+    small_done.Notify();
+  });
+  small_done.WaitForNotification();
+  small.reset();
+  // With a shared FIFO queue, the closure of the small request would only
+  // run after all of the closures of the large request.
+  EXPECT_LT(num_large_done_before_small, kNumLargeClosures / 2);
+  large.reset();
+  EXPECT_EQ(num_large_done, kNumLargeClosures);
+}
+
+TEST(RequestSchedulerTest, OlderRequestsAreRunFirst) {
+  auto scheduler = NewScheduler(/*num_threads=*/1,
+                                /*max_intra_op_parallelism=*/0);
+  // Blocks the only thread until all of the closures are queued.
+  Notification start;
+  auto blocker = scheduler->StartRequest();
+  blocker->ScheduleInterOpClosure([&start]() { start.WaitForNotification(); });
+
+  mutex mu;
+  std::vector<int> order;
+  std::vector<std::unique_ptr<RequestScheduler::Request>> requests;
+  for (int i = 0; i < 3; ++i) {
+    requests.push_back(scheduler->StartRequest());
+  }
+  for (int i = 2; i >= 0; --i) {
+    requests[i]->ScheduleInterOpClosure([&mu, &order, i]() {
+      mutex_lock l(mu);
+      order.push_back(i);
+    });
+  }
+  start.Notify();
+  blocker.reset();
+  requests.clear();
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2}));
+}
+
+TEST(RequestSchedulerTest, BoundsIntraOpParallelism) {
+  constexpr int kMaxIntraOpParallelism = 2;
+  auto scheduler = NewScheduler(/*num_threads=*/1, kMaxIntraOpParallelism);
+  thread::ThreadPool intra_op_pool(Env::Default(), "intra_op", 8);
+  auto request = scheduler->StartRequest();
+  thread::ThreadPoolInterface* pool =
+      request->IntraOpThreadPool(intra_op_pool.AsEigenThreadPool());
+  EXPECT_EQ(pool,
+            request->IntraOpThreadPool(intra_op_pool.AsEigenThreadPool()));
+  EXPECT_EQ(pool->NumThreads(), 8);
+
+  constexpr int kNumClosures = 32;
+  std::atomic<int> num_running{0};
+  std::atomic<int> max_running{0};
+  BlockingCounter counter(kNumClosures);
+  for (int i = 0; i < kNumClosures; ++i) {
+    pool->Schedule([&]() {
+      const int running = ++num_running;
+      int prev_max = max_running;
+      while (running > prev_max &&
+             !max_running.compare_exchange_weak(prev_max, running)) {
+      }
+      Env::Default()->SleepForMicroseconds(500);
+      --num_running;
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  EXPECT_LE(max_running, kMaxIntraOpParallelism);
+  request.reset();
+}
+
+TEST(RequestSchedulerTest, NestedIntraOpClosuresDoNotDeadlock) {
+  auto scheduler = NewScheduler(/*num_threads=*/1,
+                                /*max_intra_op_parallelism=*/1);
+  thread::ThreadPool intra_op_pool(Env::Default(), "intra_op", 4);
+  auto request = scheduler->StartRequest();
+  thread::ThreadPoolInterface* pool =
+      request->IntraOpThreadPool(intra_op_pool.AsEigenThreadPool());
+  Notification done;
+  pool->Schedule([pool, &done]() {
+    // Waits for a closure scheduled on the same pool, as nested parallel
+    // loops do.
+    Notification inner_done;
+    pool->Schedule([&inner_done]() { inner_done.Notify(); });
+    inner_done.WaitForNotification();
+    done.Notify();
+  });
+  done.WaitForNotification();
+  request.reset();
+}
+
+TEST(RequestSchedulerTest, BoundsNestedParallelLoops) {
+  constexpr int kMaxIntraOpParallelism = 2;
+  auto scheduler = NewScheduler(/*num_threads=*/1, kMaxIntraOpParallelism);
+  thread::ThreadPool intra_op_pool(Env::Default(), "intra_op", 8);
+  auto request = scheduler->StartRequest();
+  Eigen::ThreadPoolDevice device(
+      request->IntraOpThreadPool(intra_op_pool.AsEigenThreadPool()),
+      intra_op_pool.NumThreads());
+
+  // Counts the intra-op threads busy with the loops. The calling thread also
+  // runs a share of each loop, but it is not an intra-op thread.
+  std::atomic<int> num_running{0};
+  std::atomic<int> max_running{0};
+  auto busy = [&](const std::function<void()>& fn) {
+    static thread_local int depth = 0;
+    const bool counted = intra_op_pool.CurrentThreadId() >= 0 && depth++ == 0;
+    if (counted) {
+      const int running = ++num_running;
+      int prev_max = max_running;
+      while (running > prev_max &&
+             !max_running.compare_exchange_weak(prev_max, running)) {
+      }
+    }
+    fn();
+    if (intra_op_pool.CurrentThreadId() >= 0 && --depth == 0) --num_running;
+  };
+
+  constexpr int kNumOuter = 16;
+  constexpr int kNumInner = 64;
+  std::atomic<int> num_done{0};
+  // Large enough for Eigen to split both loops into many closures.
+  const Eigen::TensorOpCost cost(1000, 1000, 100000);
+  device.parallelFor(kNumOuter, cost, [&](Eigen::Index first,
+                                          Eigen::Index last) {
+    busy([&]() {
+      for (Eigen::Index i = first; i < last; ++i) {
+        device.parallelFor(kNumInner, cost, [&](Eigen::Index inner_first,
+                                                Eigen::Index inner_last) {
+          busy([&]() {
+            Env::Default()->SleepForMicroseconds(100);
+            num_done += inner_last - inner_first;
+          });
+        });
+      }
+    });
+  });
+  EXPECT_EQ(num_done, kNumOuter * kNumInner);
+  // Without the bound on nested closures, the inner loops would occupy all
+  // of the intra-op threads.
+  EXPECT_LE(max_running, kMaxIntraOpParallelism);
+  request.reset();
+}
+
+}  // namespace
+}  // namespace tensorflow
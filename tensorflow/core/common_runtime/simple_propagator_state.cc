@@ -15,6 +15,8 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/simple_propagator_state.h"
 
 #include <atomic>
+#include <memory>
+#include <utility>
 
 #include "tensorflow/core/common_runtime/propagator_debug_utils.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -24,27 +26,60 @@ namespace tensorflow {
 
 SimplePropagatorState::SimplePropagatorState(
     const ImmutableExecutorState& immutable_state, int64_t step_id, bool vlog)
+    : SimplePropagatorState(immutable_state, step_id, vlog,
+                            /*buffers=*/nullptr) {}
+
+SimplePropagatorState::SimplePropagatorState(
+    const ImmutableExecutorState& immutable_state, int64_t step_id, bool vlog,
+    std::unique_ptr<StepBuffers> buffers)
     : SimplePropagatorState(immutable_state, step_id,
-                            immutable_state.get_root_frame_info(), vlog) {}
+                            immutable_state.get_root_frame_info(), vlog,
+                            std::move(buffers)) {}
+
+namespace {
+
+std::unique_ptr<SimplePropagatorState::StepBuffers> NewStepBuffers(
+    const ImmutableExecutorState& immutable_state,
+    const ImmutableExecutorState::FrameInfo& finfo) {
+  auto buffers = std::make_unique<SimplePropagatorState::StepBuffers>();
+  buffers->input_tensors.resize(finfo.total_inputs);
+  buffers->pending.reset(
+      new std::atomic<int32>[immutable_state.graph_view().num_nodes()]);
+  return buffers;
+}
+
+}  // namespace
 
 SimplePropagatorState::SimplePropagatorState(
     const ImmutableExecutorState& immutable_state, int64_t step_id,
-    const ImmutableExecutorState::FrameInfo& finfo, bool vlog)
+    const ImmutableExecutorState::FrameInfo& finfo, bool vlog,
+    std::unique_ptr<StepBuffers> buffers)
     : immutable_state_(immutable_state),
       step_id_(step_id),
       vlog_(vlog || VLOG_IS_ON(1)),
-      input_tensors_(finfo.total_inputs),
-      pending_(
-          new std::atomic<int32>[immutable_state.graph_view().num_nodes()]),
+      buffers_(buffers != nullptr ? std::move(buffers)
+                                  : NewStepBuffers(immutable_state, finfo)),
+      input_tensors_(buffers_->input_tensors),
+      pending_(buffers_->pending.get()),
       active_(vlog_ ? new std::vector<bool>(
                           immutable_state.graph_view().num_nodes())
                     : nullptr),
       nodes_(finfo.nodes.get()) {
-  immutable_state_.copy_pending_counts(pending_.get());
+  DCHECK_EQ(input_tensors_.size(), finfo.total_inputs);
+  immutable_state_.copy_pending_counts(pending_);
 }
 
 SimplePropagatorState::~SimplePropagatorState() {}
 
+std::unique_ptr<SimplePropagatorState::StepBuffers>
+SimplePropagatorState::ReleaseStepBuffers() {
+  for (Entry& entry : input_tensors_) {
+    entry.ClearVal();
+    entry.alloc_attr = AllocatorAttributes();
+  }
+  return std::move(buffers_);
+}
+
 void SimplePropagatorState::ActivateRoots(
     gtl::ArraySlice<const NodeItem*> roots, TaggedNodeSeq* ready) {
   for (const NodeItem* item : roots) {
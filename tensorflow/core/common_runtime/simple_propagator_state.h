@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SIMPLE_PROPAGATOR_STATE_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_SIMPLE_PROPAGATOR_STATE_H_
 
+#include <memory>
 #include <vector>
 
 #include "tensorflow/core/common_runtime/entry.h"
@@ -46,10 +47,27 @@ namespace tensorflow {
 // dispatches `TaggedNode`s by adding them to a `TaggedNodeSeq`.
 class SimplePropagatorState {
  public:
+  // The buffers that hold the edge state of one step. They can be reused by
+  // later steps of the same executor.
+  struct StepBuffers {
+    std::vector<Entry> input_tensors;
+    std::unique_ptr<std::atomic<int32>[]> pending;
+  };
+
   SimplePropagatorState(const ImmutableExecutorState& immutable_state,
                         int64_t step_id, bool vlog);
+  // Uses `buffers`, which were released by an earlier step of the same
+  // executor, instead of allocating new buffers.
+  SimplePropagatorState(const ImmutableExecutorState& immutable_state,
+                        int64_t step_id, bool vlog,
+                        std::unique_ptr<StepBuffers> buffers);
   ~SimplePropagatorState();
 
+  // Releases the buffers of this step, after clearing the entries that were
+  // not consumed, so that a later step can reuse them. The propagator must
+  // not be used afterwards.
+  std::unique_ptr<StepBuffers> ReleaseStepBuffers();
+
   // A `TaggedNode` corresponds to a single invocation of a node's kernel,
   // and it is created when the kernel becomes runnable.
   struct TaggedNode {
@@ -159,12 +177,14 @@ class SimplePropagatorState {
   SimplePropagatorState(const ImmutableExecutorState& immutable_state_,
                         int64_t step_id,
                         const ImmutableExecutorState::FrameInfo& finfo,
-                        bool vlog);
+                        bool vlog, std::unique_ptr<StepBuffers> buffers);
 
   const ImmutableExecutorState& immutable_state_;
   const int64_t step_id_;
   const bool vlog_;
 
+  std::unique_ptr<StepBuffers> buffers_;
+
   // The i-th node's j-th input is stored at
   // `input_tensors[impl_->nodes[i].input_start + j]`.
   //
@@ -173,9 +193,9 @@ class SimplePropagatorState {
   // source node of an edge and is cleared by the destination of the same
   // edge. The destination node always runs after the source node, so there
   // is never concurrent access to the same entry.
-  std::vector<Entry> input_tensors_;
+  std::vector<Entry>& input_tensors_;  // Owned by `buffers_`.
 
-  std::unique_ptr<std::atomic<int32>[]> pending_;
+  std::atomic<int32>* const pending_;  // Owned by `buffers_`.
 
   // If `vlog_` is true, this stores a bit vector of active nodes, indexed by
   // node ID.
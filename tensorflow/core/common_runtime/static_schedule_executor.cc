@@ -0,0 +1,740 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_schedule_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/common_runtime/entry.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/renamed_device.h"
+#include "tensorflow/core/common_runtime/single_threaded_executor.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
+typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
+
+static const string& kStaticScheduleExecutor =
+    *new string("STATIC_SCHEDULE_EXECUTOR");
+
+// The number of threads of the executors created by the factory, unless
+// TF_STATIC_SCHEDULE_EXECUTOR_NUM_THREADS is set.
+constexpr int kDefaultMaxNumThreads = 4;
+
+// Estimated costs used to build the schedule, in units of the cost of an
+// inexpensive kernel. A handoff between lists costs an atomic update on the
+// critical path, and sometimes a closure passed to `Args::runner`.
+constexpr int64_t kInexpensiveKernelCost = 1;
+constexpr int64_t kExpensiveKernelCost = 4;
+constexpr int64_t kHandoffCost = 2;
+
+class StaticScheduleExecutorImpl : public Executor {
+ public:
+  explicit StaticScheduleExecutorImpl(const LocalExecutorParams& params)
+      : params_(params) {}
+
+  ~StaticScheduleExecutorImpl() override {
+    for (const KernelState& kernel_state : kernels_) {
+      params_.delete_kernel(kernel_state.kernel);
+    }
+    for (const ConstTensorKernelState& kernel_state : const_tensor_kernels_) {
+      params_.delete_kernel(kernel_state.kernel);
+    }
+  }
+
+  Status Initialize(const Graph& graph, int num_threads) {
+    if (num_threads < 1) {
+      return errors::InvalidArgument("Invalid number of threads ",
+                                     num_threads);
+    }
+
+    // Topologicially sort `graph` to get a sequence of OpKernels.
+    std::vector<Node*> ordered_nodes;
+    ordered_nodes.reserve(graph.num_nodes());
+    GetReversePostOrder(graph, &ordered_nodes);
+    if (static_cast<int>(ordered_nodes.size()) != graph.num_nodes()) {
+      return errors::InvalidArgument("Graph had ", graph.num_nodes(),
+                                     " but reverse post-order had ",
+                                     ordered_nodes.size());
+    }
+
+    std::vector<Node*> nodes_with_kernels;
+    std::vector<Node*> nodes_with_const_tensor_kernels;
+    std::map<size_t, Node*> arg_index_to_node_map;
+    absl::flat_hash_map<const Node*, int> node_to_index_map;
+    size_t num_inputs = 0;
+
+    // Create the kernel and input-related structures for each node in `graph`.
+    for (Node* n : ordered_nodes) {
+      if (n->IsSource() || n->IsSink()) {
+        continue;
+      }
+      TF_RETURN_IF_ERROR(ValidateOpIsSafeForSyncExecution(
+          *n, /*allow_control_flow_sync_execution=*/false));
+      if (n->IsArg()) {
+        int32_t arg_index;
+        TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "index", &arg_index));
+        if (arg_index < 0) {
+          return errors::InvalidArgument("Invalid argument index ", arg_index,
+                                         " in node ", n->name());
+        }
+        arg_index_to_node_map[arg_index] = n;
+        continue;
+      }
+
+      OpKernel* kernel;
+      TF_RETURN_IF_ERROR(params_.create_kernel(n->properties(), &kernel));
+
+      const Tensor* const_tensor;
+      if (n->num_outputs() == 1 && (const_tensor = kernel->const_tensor())) {
+        const_tensor_kernels_.push_back({});
+        nodes_with_const_tensor_kernels.push_back(n);
+        ConstTensorKernelState& kernel_state = const_tensor_kernels_.back();
+        kernel_state.kernel = kernel;
+        kernel_state.const_tensor = *const_tensor;
+      } else {
+        node_to_index_map[n] = kernels_.size();
+        kernels_.push_back({});
+        nodes_with_kernels.push_back(n);
+        KernelState& kernel_state = kernels_.back();
+        kernel_state.kernel = kernel;
+        kernel_state.input_start_index = num_inputs;
+        kernel_state.num_inputs = n->num_inputs();
+        kernel_state.num_outputs = n->num_outputs();
+        num_inputs += kernel_state.num_inputs;
+      }
+    }
+    total_num_inputs_ = num_inputs;
+
+    // Build the mapping from each Arg node output to the input slot for the
+    // corresponding destination node.
+    if (!arg_index_to_node_map.empty()) {
+      const size_t num_args = arg_index_to_node_map.rbegin()->first + 1;
+      arg_output_locations_.resize(num_args);
+      for (const auto& arg_index_node_pair : arg_index_to_node_map) {
+        const size_t arg_index = arg_index_node_pair.first;
+        const Node* arg_node = arg_index_node_pair.second;
+        for (const Edge* e : arg_node->out_edges()) {
+          if (e->src_output() == Graph::kControlSlot) {
+            continue;
+          } else if (e->src_output() != 0) {
+            return errors::Internal("Invalid output index ", e->src_output(),
+                                    " from argument node ", arg_index);
+          }
+          arg_output_locations_[arg_index].push_back(
+              kernels_[node_to_index_map[e->dst()]].input_start_index +
+              e->dst_input());
+        }
+      }
+    }
+
+    // Build the mapping from each const tensor kernel to the input slot for the
+    // corresponding destination node.
+    for (size_t i = 0; i < const_tensor_kernels_.size(); ++i) {
+      Node* n = nodes_with_const_tensor_kernels[i];
+      for (const Edge* e : n->out_edges()) {
+        if (e->src_output() == Graph::kControlSlot) {
+          continue;
+        } else if (e->src_output() != 0) {
+          return errors::Internal("Invalid output index ", e->src_output(),
+                                  " from node ", n->DebugString());
+        }
+        const_tensor_kernels_[i].output_locations.push_back(
+            kernels_[node_to_index_map[e->dst()]].input_start_index +
+            e->dst_input());
+      }
+    }
+
+    // Build the mapping from each node output to the input slot for the
+    // corresponding destination node, and the memory space of each output.
+    input_alloc_attrs_.resize(total_num_inputs_);
+    for (size_t i = 0; i < kernels_.size(); ++i) {
+      Node* n = nodes_with_kernels[i];
+      KernelState& kernel_state = kernels_[i];
+      kernel_state.output_locations.resize(kernel_state.num_outputs);
+      for (const Edge* e : n->out_edges()) {
+        if (!e->IsControlEdge()) {
+          kernel_state.output_locations[e->src_output()].push_back(
+              kernels_[node_to_index_map[e->dst()]].input_start_index +
+              e->dst_input());
+        }
+      }
+
+      kernel_state.output_alloc_attrs.resize(kernel_state.num_outputs);
+      const OpKernel* op_kernel = kernel_state.kernel;
+      for (int out = 0; out < n->num_outputs(); out++) {
+        DCHECK_LT(out, op_kernel->output_memory_types().size());
+        if (op_kernel->output_memory_types()[out] == HOST_MEMORY) {
+          AllocatorAttributes h;
+          h.set_on_host(true);
+          kernel_state.output_alloc_attrs[out].Merge(h);
+        }
+        for (size_t location : kernel_state.output_locations[out]) {
+          input_alloc_attrs_[location] = kernel_state.output_alloc_attrs[out];
+        }
+      }
+    }
+
+    // The kernels that must run before each kernel. Arg nodes and constants
+    // are available before any kernel runs, so they are not included.
+    std::vector<std::vector<int>> predecessors(kernels_.size());
+    for (size_t i = 0; i < kernels_.size(); ++i) {
+      for (const Edge* e : nodes_with_kernels[i]->in_edges()) {
+        auto it = node_to_index_map.find(e->src());
+        if (it != node_to_index_map.end()) {
+          predecessors[i].push_back(it->second);
+        }
+      }
+    }
+    BuildSchedule(num_threads, predecessors);
+    return OkStatus();
+  }
+
+  Status Run(const Args& args) override {
+    Notification n;
+    Status status;
+    Start(args, /*run_first_list_inline=*/true, [&](const Status& s) {
+      status = s;
+      n.Notify();
+    });
+    n.WaitForNotification();
+    return status;
+  }
+
+ private:
+  struct KernelState;
+  struct ConstTensorKernelState;
+
+  // The position of a kernel in the schedule.
+  struct Cursor {
+    int list;
+    size_t position;
+    // Whether the pending count of the kernel has already been decremented
+    // for the arrival of the list, i.e. the list is continued by a producer.
+    bool arrived = false;
+  };
+  typedef gtl::InlinedVector<Cursor, 4> CursorVec;
+
+  // The state of one step.
+  struct RunState {
+    RunState(const Args& args, size_t num_inputs,
+             const std::vector<int32>& initial_pending_counts, int num_lists)
+        : args(args),
+          inputs(num_inputs),
+          pending_counts(
+              new std::atomic<int32>[initial_pending_counts.size()]),
+          num_unfinished_lists(num_lists) {
+      for (size_t i = 0; i < initial_pending_counts.size(); ++i) {
+        pending_counts[i].store(initial_pending_counts[i],
+                                std::memory_order_relaxed);
+      }
+    }
+
+    ~RunState() {
+      if (op_device_context != nullptr) {
+        op_device_context->Unref();
+      }
+    }
+
+    // Records the first error of the step. The kernels that have not started
+    // yet are skipped.
+    void Abort(const Status& s) {
+      {
+        mutex_lock l(mu);
+        if (!status.ok()) return;
+        status = s;
+      }
+      aborted.store(true, std::memory_order_relaxed);
+      if (args.cancellation_manager != nullptr) {
+        args.cancellation_manager->StartCancelWithStatus(s);
+      }
+    }
+
+    const Args args;
+    Device* device = nullptr;
+    std::unique_ptr<Device> user_device;
+    DeviceContext* op_device_context = nullptr;
+
+    // The inputs of the kernels, in the layout that is described in
+    // `SingleThreadedExecutorImpl::Run()`.
+    std::vector<Entry> inputs;
+
+    // For each kernel with a nonnegative `pending_index`, the number of its
+    // producers on other lists that have not finished yet, plus one until
+    // its own list reaches it. The list continues on the thread that takes
+    // the count to zero.
+    std::unique_ptr<std::atomic<int32>[]> pending_counts;
+
+    std::atomic<int> num_unfinished_lists;
+    std::atomic<bool> aborted{false};
+    DoneCallback done;
+
+    mutex mu;
+    Status status TF_GUARDED_BY(mu);
+  };
+
+  void RunAsyncInternal(const Args& args, DoneCallback done) override {
+    Start(args, /*run_first_list_inline=*/false, std::move(done));
+  }
+
+  // Divides the kernels over at most `num_threads` lists by list scheduling:
+  // in topological order, each kernel is appended to the list on which it
+  // can start the earliest, given the estimated costs of the kernels and of
+  // the handoffs between lists. Then computes the handoffs that each list
+  // needs from the other lists.
+  void BuildSchedule(int num_threads,
+                     const std::vector<std::vector<int>>& predecessors) {
+    lists_.resize(num_threads);
+    std::vector<int64_t> list_end_times(num_threads, 0);
+    std::vector<int64_t> end_times(kernels_.size());
+    for (size_t i = 0; i < kernels_.size(); ++i) {
+      int best_list = 0;
+      int64_t best_start_time = std::numeric_limits<int64_t>::max();
+      for (int list = 0; list < num_threads; ++list) {
+        int64_t start_time = list_end_times[list];
+        for (int p : predecessors[i]) {
+          start_time = std::max(
+              start_time,
+              end_times[p] + (kernels_[p].list == list ? 0 : kHandoffCost));
+        }
+        if (start_time < best_start_time) {
+          best_list = list;
+          best_start_time = start_time;
+        }
+      }
+      KernelState& kernel_state = kernels_[i];
+      kernel_state.list = best_list;
+      kernel_state.position = lists_[best_list].size();
+      lists_[best_list].push_back(i);
+      end_times[i] = best_start_time + (kernel_state.kernel->IsExpensive()
+                                            ? kExpensiveKernelCost
+                                            : kInexpensiveKernelCost);
+      list_end_times[best_list] = end_times[i];
+    }
+    // Ties go to the lowest list, so only the last lists can be empty.
+    while (!lists_.empty() && lists_.back().empty()) {
+      lists_.pop_back();
+    }
+
+    // A kernel only needs a handoff from the last of its producers on each
+    // other list, since the lists run in order, and none at all if an earlier
+    // kernel on its list already waited for that producer or a later one.
+    const int num_lists = lists_.size();
+    for (int list = 0; list < num_lists; ++list) {
+      std::vector<int64_t> waited_for(lists_.size(), -1);
+      std::vector<int64_t> last_producers(lists_.size());
+      for (int i : lists_[list]) {
+        std::fill(last_producers.begin(), last_producers.end(), -1);
+        for (int p : predecessors[i]) {
+          const KernelState& producer = kernels_[p];
+          if (producer.list != list) {
+            last_producers[producer.list] = std::max<int64_t>(
+                last_producers[producer.list], producer.position);
+          }
+        }
+        int32 num_handoffs = 0;
+        for (int other = 0; other < num_lists; ++other) {
+          if (last_producers[other] > waited_for[other]) {
+            waited_for[other] = last_producers[other];
+            kernels_[lists_[other][last_producers[other]]]
+                .handoffs.push_back(i);
+            ++num_handoffs;
+          }
+        }
+        if (num_handoffs > 0) {
+          kernels_[i].pending_index = initial_pending_counts_.size();
+          initial_pending_counts_.push_back(num_handoffs + 1);
+        }
+      }
+    }
+  }
+
+  // Starts a step. Calls `done` once all of the lists have finished.
+  void Start(const Args& args, bool run_first_list_inline, DoneCallback done) {
+    auto* state = new RunState(args, total_num_inputs_,
+                               initial_pending_counts_, lists_.size());
+    // Override intra op thread pool if requested.
+    state->device = params_.device;
+    if (args.user_intra_op_threadpool != nullptr) {
+      state->user_device = RenamedDevice::NewRenamedDevice(
+          state->device->name(), state->device, /*owns_underlying=*/false,
+          /*isolate_session_state=*/false, args.user_intra_op_threadpool);
+      state->device = state->user_device.get();
+    }
+    state->device->TryGetDeviceContext(&state->op_device_context)
+        .IgnoreError();
+
+    Status s = ForwardArgsAndConstTensors(state);
+    if (!s.ok() || lists_.empty()) {
+      delete state;
+      done(s);
+      return;
+    }
+    state->done = std::move(done);
+
+    if (args.run_all_kernels_inline) {
+      // The lists that are parked are continued on this thread as well.
+      CursorVec ready;
+      for (int list = lists_.size() - 1; list >= 0; --list) {
+        ready.push_back({list, 0});
+      }
+      RunLists(state, std::move(ready));
+      return;
+    }
+    for (int list = 1; list < static_cast<int>(lists_.size()); ++list) {
+      args.runner([this, state, list]() { RunLists(state, {{list, 0}}); });
+    }
+    if (run_first_list_inline) {
+      RunLists(state, {{0, 0}});
+    } else {
+      args.runner([this, state]() { RunLists(state, {{0, 0}}); });
+    }
+  }
+
+  // Forwards the arguments and the constant tensors to the inputs of the
+  // kernels that consume them, as `SingleThreadedExecutorImpl::Run()` does.
+  Status ForwardArgsAndConstTensors(RunState* state) {
+    CallFrameInterface* call_frame = state->args.call_frame;
+    const size_t received_args = call_frame ? call_frame->num_args() : 0;
+    if (TF_PREDICT_FALSE(arg_output_locations_.size() > received_args)) {
+      return errors::InvalidArgument("Expected ", arg_output_locations_.size(),
+                                     " arguments, but only received ",
+                                     received_args, ".");
+    }
+    std::vector<Entry>& inputs = state->inputs;
+    for (size_t i = 0; i < arg_output_locations_.size(); ++i) {
+      const std::vector<size_t>& locations = arg_output_locations_[i];
+      if (locations.empty()) continue;
+      if (call_frame->CanConsumeArg(i)) {
+        Entry& first_input = inputs[locations[0]];
+        first_input.state = Entry::State::HAS_VALUE;
+        first_input.val.Init();
+        call_frame->ConsumeArg(i, first_input.val.get());
+        for (size_t j = 1; j < locations.size(); ++j) {
+          Entry& input = inputs[locations[j]];
+          input.state = Entry::State::HAS_VALUE;
+          input.val.Init(*first_input.val);
+        }
+      } else {
+        const Tensor* arg;
+        TF_RETURN_IF_ERROR(call_frame->GetArg(i, &arg));
+        for (size_t location : locations) {
+          Entry& input = inputs[location];
+          input.state = Entry::State::HAS_VALUE;
+          input.val.Init(*arg);
+        }
+      }
+    }
+    for (const ConstTensorKernelState& kernel_state : const_tensor_kernels_) {
+      for (size_t location : kernel_state.output_locations) {
+        Entry& input = inputs[location];
+        input.state = Entry::State::HAS_CONST_TENSOR;
+        input.const_tensor = &kernel_state.const_tensor;
+      }
+    }
+    return OkStatus();
+  }
+
+  // Runs the lists in `ready` from the given positions, until each of them
+  // finishes or reaches a kernel whose inputs are not all available. The
+  // lists that the finished kernels make ready again are run too, on this
+  // thread if it would be idle otherwise, and using `Args::runner` if not.
+  void RunLists(RunState* state, CursorVec ready) {
+    OpKernelContext::Params params;
+    params.step_id = state->args.step_id;
+    params.device = state->device;
+    params.log_memory = false;
+    params.rendezvous = state->args.rendezvous;
+    params.session_state = state->args.session_state;
+    params.session_metadata = params_.session_metadata;
+    params.tensor_store = state->args.tensor_store;
+    params.cancellation_manager = state->args.cancellation_manager;
+    params.call_frame = state->args.call_frame;
+    params.function_library = params_.function_library;
+    params.resource_manager = state->device->resource_manager();
+    params.step_container = state->args.step_container;
+    params.collective_executor = state->args.collective_executor;
+    params.stack_trace = state->args.stack_trace;
+    params.slice_reader_cache = nullptr;
+    params.runner = &state->args.runner;
+    params.run_all_kernels_inline = state->args.run_all_kernels_inline;
+    params.stats_collector = state->args.stats_collector;
+    params.executor_type = &kStaticScheduleExecutor;
+    params.frame_iter = FrameAndIter(0, 0);
+    params.is_input_dead = false;
+    params.op_device_context = state->op_device_context;
+    params.forward_from_array = nullptr;
+
+    TensorValueVec node_inputs;
+    AllocatorAttributeVec input_alloc_attrs;
+    const bool run_inline = state->args.run_all_kernels_inline;
+    int num_finished_lists = 0;
+    while (!ready.empty()) {
+      Cursor cursor = ready.back();
+      ready.pop_back();
+      if (!run_inline) {
+        DispatchLists(state, &ready);
+      }
+      const std::vector<int>& list = lists_[cursor.list];
+      for (; cursor.position < list.size(); ++cursor.position) {
+        const KernelState& kernel_state = kernels_[list[cursor.position]];
+        if (kernel_state.pending_index >= 0 && !cursor.arrived &&
+            state->pending_counts[kernel_state.pending_index].fetch_sub(
+                1, std::memory_order_acq_rel) != 1) {
+          // The last of the producers continues the list.
+          break;
+        }
+        cursor.arrived = false;
+        RunKernel(kernel_state, state, &params, &node_inputs,
+                  &input_alloc_attrs);
+        for (int consumer : kernel_state.handoffs) {
+          const KernelState& consumer_state = kernels_[consumer];
+          if (state->pending_counts[consumer_state.pending_index].fetch_sub(
+                  1, std::memory_order_acq_rel) == 1) {
+            ready.push_back({consumer_state.list, consumer_state.position,
+                             /*arrived=*/true});
+          }
+        }
+        if (!run_inline && cursor.position + 1 < list.size()) {
+          DispatchLists(state, &ready);
+        }
+      }
+      if (cursor.position == list.size()) {
+        ++num_finished_lists;
+      }
+    }
+    if (num_finished_lists > 0 &&
+        state->num_unfinished_lists.fetch_sub(num_finished_lists) ==
+            num_finished_lists) {
+      Finish(state);
+    }
+  }
+
+  // Runs each of the lists in `ready` in a closure passed to `Args::runner`.
+  void DispatchLists(RunState* state, CursorVec* ready) {
+    for (const Cursor& cursor : *ready) {
+      state->args.runner(
+          [this, state, cursor]() { RunLists(state, {cursor}); });
+    }
+    ready->clear();
+  }
+
+  void RunKernel(const KernelState& kernel_state, RunState* state,
+                 OpKernelContext::Params* params, TensorValueVec* node_inputs,
+                 AllocatorAttributeVec* input_alloc_attrs) {
+    std::vector<Entry>& inputs = state->inputs;
+    const size_t input_start_index = kernel_state.input_start_index;
+    const size_t num_inputs = kernel_state.num_inputs;
+    const size_t num_outputs = kernel_state.num_outputs;
+
+    if (TF_PREDICT_FALSE(state->aborted.load(std::memory_order_relaxed))) {
+      for (size_t j = 0; j < num_inputs; ++j) {
+        inputs[input_start_index + j].ClearVal();
+      }
+      return;
+    }
+
+    node_inputs->clear();
+    node_inputs->resize(num_inputs);
+    input_alloc_attrs->clear();
+    input_alloc_attrs->resize(num_inputs);
+    for (size_t j = 0; j < num_inputs; ++j) {
+      Entry& input = inputs[input_start_index + j];
+      switch (input.state) {
+        case Entry::State::HAS_CONST_TENSOR:
+          // See `SingleThreadedExecutorImpl::Run()` for why the `const_cast`
+          // is safe.
+          (*node_inputs)[j].tensor = const_cast<Tensor*>(input.const_tensor);
+          break;
+        case Entry::State::HAS_VALUE:
+          (*node_inputs)[j].tensor = input.val.get();
+          break;
+        default:
+          DCHECK(false) << "Input did not have a valid value.";
+      }
+      (*input_alloc_attrs)[j] = input_alloc_attrs_[input_start_index + j];
+    }
+    params->inputs = *node_inputs;
+    params->input_alloc_attrs = *input_alloc_attrs;
+    params->op_kernel = kernel_state.kernel;
+    params->output_attr_array = kernel_state.output_alloc_attrs.data();
+    OpKernelContext ctx(params, num_outputs);
+
+    params->device->Compute(kernel_state.kernel, &ctx);
+
+    // Free the inputs to the current kernel.
+    for (size_t j = 0; j < num_inputs; ++j) {
+      inputs[input_start_index + j].ClearVal();
+    }
+    if (!ctx.status().ok()) {
+      state->Abort(ctx.status());
+      return;
+    }
+
+    // Forward the outputs of the kernel to the inputs of subsequent kernels.
+    for (size_t j = 0; j < num_outputs; ++j) {
+      TensorValue val = ctx.release_output(j);
+      const std::vector<size_t>& locations = kernel_state.output_locations[j];
+      for (size_t k = 0; k < locations.size(); ++k) {
+        Entry& input = inputs[locations[k]];
+        input.state = Entry::State::HAS_VALUE;
+        if (val.tensor == nullptr) {
+          input.val.Init(Tensor(kernel_state.kernel->output_type(j)));
+        } else if (k + 1 < locations.size()) {
+          input.val.Init(*val.tensor);
+        } else {
+          // Move the output to the last consumer to avoid copying it.
+          input.val.Init(std::move(*val.tensor));
+        }
+      }
+      delete val.tensor;
+    }
+  }
+
+  void Finish(RunState* state) {
+    Status status;
+    {
+      mutex_lock l(state->mu);
+      status = state->status;
+    }
+    DoneCallback done = std::move(state->done);
+    delete state;
+    done(status);
+  }
+
+  const LocalExecutorParams params_;
+
+  // All following members are read-only after Initialize().
+
+  // The sum of the number of inputs for each kernel.
+  size_t total_num_inputs_ = 0;
+
+  // Represents cached graph structure state for each kernel.
+  struct KernelState {
+    // The kernel object. Not owned.
+    OpKernel* kernel;
+
+    // These fields determine the range of elements in `inputs` that corresponds
+    // to the inputs of `kernel`.
+    size_t input_start_index;
+    size_t num_inputs;
+
+    size_t num_outputs;
+
+    // For the `j`th output of `kernel`, `output_locations[j]` contains the
+    // locations in the flat `inputs` vector to which that output must be
+    // copied.
+    std::vector<std::vector<size_t>> output_locations;
+
+    // Memory space information for each output of `kernel`.
+    std::vector<AllocatorAttributes> output_alloc_attrs;
+
+    // The list that runs `kernel`, and the position of `kernel` in the list.
+    int list = -1;
+    size_t position = 0;
+
+    // The index of the pending count of `kernel` in `RunState`, or -1 if all
+    // of the producers of `kernel` run before it on the same list.
+    int pending_index = -1;
+
+    // The kernels on other lists that wait for `kernel` to finish.
+    std::vector<int> handoffs;
+  };
+  std::vector<KernelState> kernels_;
+
+  // The kernels run by each thread, in order.
+  std::vector<std::vector<int>> lists_;
+
+  // The initial values of `RunState::pending_counts`.
+  std::vector<int32> initial_pending_counts_;
+
+  // For the `i`th argument, `arg_output_locations_[i]` contains the locations
+  // in the flat `inputs` vector to which that argument must be copied.
+  std::vector<std::vector<size_t>> arg_output_locations_;
+
+  // Represents cached graph structure state for each kernel that produces
+  // a single constant-valued tensor.
+  struct ConstTensorKernelState {
+    // The kernel object. Not owned.
+    OpKernel* kernel;
+
+    // The cached value of `kernel->const_tensor()`.
+    Tensor const_tensor;
+
+    // The locations in the flat `inputs` vector to which the single output of
+    // `kernel` must be copied.
+    std::vector<size_t> output_locations;
+  };
+  std::vector<ConstTensorKernelState> const_tensor_kernels_;
+
+  // Memory space information for each input, in the same order as the flat
+  // `inputs` vector.
+  std::vector<AllocatorAttributes> input_alloc_attrs_;
+};
+
+class StaticScheduleExecutorRegistrar {
+ public:
+  StaticScheduleExecutorRegistrar() {
+    ExecutorFactory::Register(kStaticScheduleExecutor, new Factory());
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      int64_t num_threads;
+      TF_RETURN_IF_ERROR(ReadInt64FromEnvVar(
+          "TF_STATIC_SCHEDULE_EXECUTOR_NUM_THREADS",
+          std::min(port::MaxParallelism(), kDefaultMaxNumThreads),
+          &num_threads));
+      Executor* ret;
+      TF_RETURN_IF_ERROR(
+          NewStaticScheduleExecutor(params, graph, num_threads, &ret));
+      out_executor->reset(ret);
+      return OkStatus();
+    }
+  };
+};
+static StaticScheduleExecutorRegistrar registrar;
+
+}  // namespace
+
+Status NewStaticScheduleExecutor(const LocalExecutorParams& params,
+                                 const Graph& graph, int num_threads,
+                                 Executor** executor) {
+  auto impl = std::make_unique<StaticScheduleExecutorImpl>(params);
+  TF_RETURN_IF_ERROR(impl->Initialize(graph, num_threads));
+  *executor = impl.release();
+  return OkStatus();
+}
+
+}  // namespace tensorflow
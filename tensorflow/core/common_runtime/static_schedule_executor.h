@@ -0,0 +1,56 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
+
+#include "tensorflow/core/common_runtime/executor.h"
+
+namespace tensorflow {
+
+// Creates a new `Executor` that executes `graph` on up to `num_threads`
+// threads, following a schedule that is computed once, when the executor is
+// created.
+//
+// The default executor decides at run time which node to run next, which
+// costs a pending count update and a ready queue push for every node. For an
+// inference graph of many small ops, this bookkeeping can cost more than the
+// ops themselves. Instead, this executor divides the nodes of `graph` into
+// `num_threads` lists, each in topological order, so that every list runs on
+// one thread without any synchronization, except for the edges between
+// nodes on different lists. Such an edge is a lock-free handoff: the consumer
+// waits for its producers with a single atomic counter, and a list that
+// reaches a node whose inputs are not yet available is parked, and continued
+// by the thread that produces the last of those inputs, rather than blocking
+// its thread.
+//
+// The executor has the same limitations as the executor returned by
+// `NewSingleThreadedExecutor()`: graphs with reference-typed tensors, control
+// flow or "_Recv" nodes, memory logging, allocation forwarding and
+// non-default device contexts are not supported.
+//
+// `Run()` runs the first list on the calling thread, and the others using
+// `Args::runner`.
+//
+// The executor type "STATIC_SCHEDULE_EXECUTOR" creates these executors with
+// the number of threads in the TF_STATIC_SCHEDULE_EXECUTOR_NUM_THREADS
+// environment variable, or with up to 4 threads if it is not set.
+Status NewStaticScheduleExecutor(const LocalExecutorParams& params,
+                                 const Graph& graph, int num_threads,
+                                 Executor** executor);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_SCHEDULE_EXECUTOR_H_
@@ -0,0 +1,374 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_schedule_executor.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class MockOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void SetCompute(std::function<void(OpKernelContext*)> compute) {
+    compute_ = std::move(compute);
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    OP_REQUIRES(ctx, compute_ != nullptr,
+                errors::FailedPrecondition("Compute() is not set"));
+    compute_(ctx);
+  }
+
+ private:
+  std::function<void(OpKernelContext* ctx)> compute_;
+};
+REGISTER_OP("Mock").Input("x: float").Output("y: float").SetIsStateful();
+REGISTER_KERNEL_BUILDER(Name("Mock").Device(DEVICE_CPU), MockOp);
+
+class StaticScheduleExecutorTest : public ::testing::Test {
+ protected:
+  StaticScheduleExecutorTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")),
+        thread_pool_(Env::Default(), "static_schedule_executor_test", 4) {}
+
+  LocalExecutorParams Params(
+      int version, std::function<void(OpKernelContext*)> mock_fn = nullptr) {
+    LocalExecutorParams params;
+    params.device = device_.get();
+    params.create_kernel =
+        [this, mock_fn = std::move(mock_fn), version](
+            const std::shared_ptr<const NodeProperties>& props,
+            OpKernel** kernel) {
+          TF_RETURN_IF_ERROR(CreateNonCachedKernel(device_.get(), nullptr,
+                                                   props, version, kernel));
+          if ((*kernel)->type_string_view() == "Mock") {
+            down_cast<MockOp*>(*kernel)->SetCompute(mock_fn);
+          }
+          return OkStatus();
+        };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    return params;
+  }
+
+  // Resets exec_ with a new executor for `graph` that runs on `num_threads`
+  // threads.
+  Status Create(std::unique_ptr<const Graph> graph, int num_threads,
+                std::function<void(OpKernelContext*)> mock_fn = nullptr) {
+    Executor* exec;
+    TF_RETURN_IF_ERROR(NewStaticScheduleExecutor(
+        Params(graph->versions().producer(), std::move(mock_fn)), *graph,
+        num_threads, &exec));
+    exec_.reset(exec);
+    return OkStatus();
+  }
+
+  Executor::Args Args(CallFrameInterface* call_frame) {
+    Executor::Args args;
+    args.call_frame = call_frame;
+    args.runner = [this](std::function<void()> fn) {
+      thread_pool_.Schedule(std::move(fn));
+    };
+    return args;
+  }
+
+  Status Run(CallFrameInterface* call_frame) {
+    return exec_->Run(Args(call_frame));
+  }
+
+  std::unique_ptr<Device> device_;
+  thread::ThreadPool thread_pool_;
+  std::unique_ptr<Executor> exec_;
+};
+
+// A float val -> Tensor<float>
+Tensor V(const float val) {
+  Tensor tensor(DT_FLOAT, TensorShape({}));
+  tensor.scalar<float>()() = val;
+  return tensor;
+}
+
+// Tensor<float> -> a float val.
+float V(const Tensor& tensor) {
+  CHECK_EQ(tensor.dtype(), DT_FLOAT);
+  CHECK(TensorShapeUtils::IsScalar(tensor.shape()));
+  return tensor.scalar<float>()();
+}
+
+TEST_F(StaticScheduleExecutorTest, SimpleAdd) {
+  // c = a + b
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  auto in1 = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  auto tmp = test::graph::Add(g.get(), in0, in1);
+  test::graph::Retval(g.get(), 0, tmp);
+  FixupSourceAndSinkEdges(g.get());
+  TF_ASSERT_OK(Create(std::move(g), /*num_threads=*/2));
+  FunctionCallFrame call_frame({DT_FLOAT, DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0), V(2.0)}));
+  TF_ASSERT_OK(Run(&call_frame));
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(3.0, V(retvals[0]));  // out = 1.0 + 2.0 = 3.0
+}
+
+// Builds a graph which adds N copies of one variable "in", parenthesized
+// randomly.
+void BuildTree(int N, Graph* g) {
+  CHECK_GT(N, 1);
+  auto in = test::graph::Arg(g, 0, DT_FLOAT);
+  std::vector<Node*> nodes;
+  for (int i = 0; i < N; ++i) {
+    nodes.push_back(test::graph::Identity(g, in, 0));
+  }
+  random::PhiloxRandom philox(0, 17);
+  random::SimplePhilox rnd(&philox);
+  while (nodes.size() > 1) {
+    int x = rnd.Uniform(nodes.size());
+    auto in0 = nodes[x];
+    nodes[x] = nodes.back();
+    nodes.resize(nodes.size() - 1);
+    x = rnd.Uniform(nodes.size());
+    auto in1 = nodes[x];
+    nodes[x] = test::graph::Add(g, in0, in1);
+  }
+  test::graph::Retval(g, 0, nodes.back());
+  FixupSourceAndSinkEdges(g);
+}
+
+TEST_F(StaticScheduleExecutorTest, RandomTree) {
+  for (int num_threads : {1, 2, 3, 8}) {
+    auto g = std::make_unique<Graph>(OpRegistry::Global());
+    BuildTree(4096, g.get());
+    TF_ASSERT_OK(Create(std::move(g), num_threads));
+    // Runs several steps, to check that the handoffs are reset between them.
+    for (int i = 0; i < 5; ++i) {
+      FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+      TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+      TF_ASSERT_OK(Run(&call_frame));
+      std::vector<Tensor> retvals;
+      TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+      EXPECT_EQ(4096.0, V(retvals[0]));
+    }
+  }
+}
+
+TEST_F(StaticScheduleExecutorTest, RunAsync) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(1024, g.get());
+  TF_ASSERT_OK(Create(std::move(g), /*num_threads=*/4));
+  FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+  Notification done;
+  Status status;
+  exec_->RunAsync(Args(&call_frame), [&](const Status& s) {
+    status = s;
+    done.Notify();
+  });
+  done.WaitForNotification();
+  TF_ASSERT_OK(status);
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(1024.0, V(retvals[0]));
+}
+
+TEST_F(StaticScheduleExecutorTest, RunAllKernelsInline) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(1024, g.get());
+  TF_ASSERT_OK(Create(std::move(g), /*num_threads=*/4));
+  FunctionCallFrame call_frame({DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+  Executor::Args args = Args(&call_frame);
+  args.run_all_kernels_inline = true;
+  args.runner = [](std::function<void()> fn) {
+    ADD_FAILURE() << "All of the lists should run on the calling thread";
+    fn();
+  };
+  TF_ASSERT_OK(exec_->Run(args));
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(1024.0, V(retvals[0]));
+}
+
+TEST_F(StaticScheduleExecutorTest, ControlDependencies) {
+  // Independent nodes, which the schedule spreads over the lists, with random
+  // control dependencies between them.
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  Node* in = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  random::PhiloxRandom philox(0, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<Node*> nodes;
+  for (int i = 0; i < 256; ++i) {
+    Node* n;
+    TF_ASSERT_OK(NodeBuilder(strings::StrCat("n", i), "Mock")
+                     .Input(in)
+                     .Finalize(g.get(), &n));
+    if (i > 0 && rnd.OneIn(2)) {
+      g->AddControlEdge(nodes[rnd.Uniform(i)], n);
+    }
+    nodes.push_back(n);
+  }
+  std::vector<std::pair<string, string>> control_edges;
+  for (const Edge* e : g->edges()) {
+    if (e->IsControlEdge() && e->src()->IsOp() && e->dst()->IsOp()) {
+      control_edges.emplace_back(e->src()->name(), e->dst()->name());
+    }
+  }
+  FixupSourceAndSinkEdges(g.get());
+
+  mutex mu;
+  absl::flat_hash_map<string, int> order;
+  TF_ASSERT_OK(Create(std::move(g), /*num_threads=*/4,
+                      [&](OpKernelContext* ctx) {
+                        ctx->set_output(0, ctx->input(0));
+                        mutex_lock l(mu);
+                        order[ctx->op_kernel().name()] = order.size();
+                      }));
+  for (int i = 0; i < 5; ++i) {
+    order.clear();
+    FunctionCallFrame call_frame({DT_FLOAT}, {});
+    TF_ASSERT_OK(call_frame.SetArgs({V(1.0)}));
+    TF_ASSERT_OK(Run(&call_frame));
+    EXPECT_EQ(order.size(), 256);
+    for (const auto& edge : control_edges) {
+      EXPECT_LT(order[edge.first], order[edge.second])
+          << edge.first << " -> " << edge.second;
+    }
+  }
+}
+
+TEST_F(StaticScheduleExecutorTest, OpError) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto zero = test::graph::Constant(g.get(), V(0.0));
+  auto inf = test::graph::Unary(g.get(), "Reciprocal", zero);
+  auto check = test::graph::CheckNumerics(g.get(), inf, "message");
+  auto two = test::graph::Constant(g.get(), V(2.0));
+  test::graph::Binary(g.get(), "Mul", check, two);
+  FixupSourceAndSinkEdges(g.get());
+  TF_ASSERT_OK(Create(std::move(g), /*num_threads=*/2));
+  FunctionCallFrame call_frame({}, {});
+  EXPECT_TRUE(absl::IsInvalidArgument(Run(&call_frame)));
+}
+
+TEST_F(StaticScheduleExecutorTest, SwitchIsNotSupported) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  auto pred = test::graph::Constant(g.get(), test::AsScalar<bool>(true));
+  test::graph::Switch(g.get(), in, pred);
+  FixupSourceAndSinkEdges(g.get());
+  EXPECT_TRUE(absl::IsFailedPrecondition(
+      Create(std::move(g), /*num_threads=*/2)));
+}
+
+TEST_F(StaticScheduleExecutorTest, ExecutorFactory) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  auto in0 = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  auto in1 = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  test::graph::Retval(g.get(), 0, test::graph::Add(g.get(), in0, in1));
+  FixupSourceAndSinkEdges(g.get());
+  TF_ASSERT_OK(NewExecutor("STATIC_SCHEDULE_EXECUTOR",
+                           Params(g->versions().producer()), *g, &exec_));
+  FunctionCallFrame call_frame({DT_FLOAT, DT_FLOAT}, {DT_FLOAT});
+  TF_ASSERT_OK(call_frame.SetArgs({V(1.0), V(2.0)}));
+  TF_ASSERT_OK(Run(&call_frame));
+  std::vector<Tensor> retvals;
+  TF_ASSERT_OK(call_frame.ConsumeRetvals(&retvals, false));
+  EXPECT_EQ(3.0, V(retvals[0]));
+}
+
+// Compares the executors on a graph of many small ops, as in inference: wide
+// layers of Identity and Add nodes, each of which reads the previous layer.
+void BM_small_ops(::testing::benchmark::State& state,
+                  const char* executor_type) {
+  const int width = state.range(0);
+  const int depth = state.range(1);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<Node*> layer;
+  for (int i = 0; i < width; ++i) {
+    layer.push_back(test::graph::Constant(g, V(i)));
+  }
+  for (int d = 0; d < depth; ++d) {
+    std::vector<Node*> next;
+    for (int i = 0; i < width; ++i) {
+      next.push_back(
+          i % 2 == 0
+              ? test::graph::Identity(g, layer[i])
+              : test::graph::Add(g, layer[i], layer[(i + 1) % width]));
+    }
+    layer = std::move(next);
+  }
+  FixupSourceAndSinkEdges(g);
+  test::Benchmark("cpu", g, nullptr, nullptr, nullptr, executor_type,
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetLabel(strings::StrCat("Nodes = ", width * (depth + 1)));
+  state.SetItemsProcessed(width * (depth + 1) *
+                          static_cast<int64_t>(state.iterations()));
+}
+
+void BM_small_ops_default(::testing::benchmark::State& state) {
+  BM_small_ops(state, "");
+}
+void BM_small_ops_single_threaded(::testing::benchmark::State& state) {
+  BM_small_ops(state, "SINGLE_THREADED_EXECUTOR");
+}
+void BM_small_ops_static_schedule(::testing::benchmark::State& state) {
+  BM_small_ops(state, "STATIC_SCHEDULE_EXECUTOR");
+}
+
+BENCHMARK(BM_small_ops_default)->UseRealTime()->ArgPair(4, 64);
+BENCHMARK(BM_small_ops_default)->UseRealTime()->ArgPair(16, 64);
+BENCHMARK(BM_small_ops_single_threaded)->UseRealTime()->ArgPair(4, 64);
+BENCHMARK(BM_small_ops_single_threaded)->UseRealTime()->ArgPair(16, 64);
+BENCHMARK(BM_small_ops_static_schedule)->UseRealTime()->ArgPair(4, 64);
+BENCHMARK(BM_small_ops_static_schedule)->UseRealTime()->ArgPair(16, 64);
+
+}  // namespace
+}  // namespace tensorflow
@@ -41,6 +41,7 @@ info. It does not have any negative impact on performance. */
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/graph/types.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session_options.h"
@@ -53,6 +54,17 @@ info. It does not have any negative impact on performance. */
 
 namespace tensorflow {
 
+#ifdef INTEL_MKL
+namespace {
+// Returns the NUMA node the calling thread is bound to, or kNUMANoAffinity.
+// Threads are bound when they start, so the node is looked up once.
+int GetThreadNumaNode() {
+  static thread_local const int numa_node = port::NUMAGetThreadNodeAffinity();
+  return numa_node;
+}
+}  // namespace
+#endif  // INTEL_MKL
+
 ThreadPoolDevice::ThreadPoolDevice(const SessionOptions& options,
                                    const string& name, Bytes memory_limit,
                                    const DeviceLocality& locality,
@@ -61,6 +73,16 @@ ThreadPoolDevice::ThreadPoolDevice(const SessionOptions& options,
                                name, DEVICE_CPU, memory_limit, locality)),
       allocator_(allocator),
       scoped_allocator_mgr_(new ScopedAllocatorMgr(name)) {
+#ifdef INTEL_MKL
+  // In NUMA mode, the device allocates from per-node oneDNN allocators, which
+  // bind their large allocations to the node.
+  use_numa_allocators_ = IsMKLEnabled() && port::NUMAEnabled() &&
+                         options.config.experimental().use_numa_affinity();
+  if (use_numa_allocators_) {
+    Allocator* numa_allocator = GetMklNumaCPUAllocator(locality.numa_node());
+    if (numa_allocator != nullptr) allocator_ = numa_allocator;
+  }
+#endif  // INTEL_MKL
   auto s = NodeFileWriter::GetNodeFileWriterIfEnabled(name, env());
   if (!s.ok()) {
     LOG(ERROR) << s.status();
@@ -104,6 +126,18 @@ ThreadPoolDevice::ThreadPoolDevice(const SessionOptions& options,
 ThreadPoolDevice::~ThreadPoolDevice() {}
 
 Allocator* ThreadPoolDevice::GetAllocator(AllocatorAttributes attr) {
+#ifdef INTEL_MKL
+  // Allocate on the node of the executing thread when it is bound to one,
+  // e.g. a thread of a node's intra-op thread pool, so that outputs and
+  // cached constants such as reordered filters are local to their users.
+  if (use_numa_allocators_) {
+    const int numa_node = GetThreadNumaNode();
+    if (numa_node != port::kNUMANoAffinity) {
+      Allocator* numa_allocator = GetMklNumaCPUAllocator(numa_node);
+      if (numa_allocator != nullptr) return numa_allocator;
+    }
+  }
+#endif  // INTEL_MKL
   return allocator_;
 }
 
@@ -254,13 +288,12 @@ void ThreadPoolDevice::LogOutputs(OpKernel* op_kernel,
 namespace {
 class MklCPUAllocatorFactory : public AllocatorFactory {
  public:
-  bool NumaEnabled() override { return false; }
+  bool NumaEnabled() override { return true; }
 
   Allocator* CreateAllocator() override { return new MklCPUAllocator; }
 
-  // Note: Ignores numa_node, for now.
-  virtual SubAllocator* CreateSubAllocator(int numa_node) {
-    return new MklSubAllocator;
+  SubAllocator* CreateSubAllocator(int numa_node) override {
+    return new MklSubAllocator(numa_node);
   }
 };
 
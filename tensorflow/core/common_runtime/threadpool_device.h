@@ -54,6 +54,9 @@ class ThreadPoolDevice : public LocalDevice {
   void LogOutputs(OpKernel* op_kernel, OpKernelContext* context);
 
   Allocator* allocator_;  // Not owned
+  // Whether allocations are served by the allocator of the NUMA node of the
+  // executing thread.
+  bool use_numa_allocators_ = false;
   std::unique_ptr<ScopedAllocatorMgr> scoped_allocator_mgr_;
   NodeFileWriter* node_file_writer_ = nullptr;  // not owned
 };
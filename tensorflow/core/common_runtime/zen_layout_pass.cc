@@ -19,6 +19,7 @@ limitations under the License.
 #include <functional>
 #include <iterator>
 #include <memory>
+#include <numeric>
 #include <queue>
 #include <set>
 #include <stack>
@@ -33,7 +34,10 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/common_runtime/layout_pass_util.h"
 #include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/common_runtime/shape_refiner.h"
+#include "tensorflow/core/common_runtime/zen_layout_pass.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/graph.h"
@@ -43,6 +47,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/util/port.h"
 #include "tensorflow/core/util/tensor_format.h"
 #include "tensorflow/core/util/zen_util.h"
@@ -120,59 +125,82 @@ namespace tensorflow {
 //        rewrite a given node then all of its input nodes need to be fixed (in
 //        other words they cannot be deleted later.)
 //
+// Sizes in bytes of the outputs of the nodes of a graph, from the shapes
+// inferred when the object is constructed. Shape inference visits the whole
+// graph, so it is run once per pass instead of once per Zen node. The sizes are
+// kept by node name: a rewritten node keeps the name and the outputs of the
+// original node, so the sizes stay valid across the rewrites.
+class ZenTensorSizes {
+ public:
+  explicit ZenTensorSizes(const Graph &g);
+
+  // Returns the estimated size of output 'slot' of 'n'. Unknown dimensions
+  // count as 1, so the estimate is a lower bound. Returns 0 if the rank of
+  // the output is unknown.
+  int64_t EstimatedBytes(const Node *n, int slot) const;
+
+ private:
+  std::unordered_map<string, std::vector<int64_t>> sizes_;
+};
+
 class ZenLayoutRewritePass : public GraphOptimizationPass {
  public:
   ZenLayoutRewritePass() {
-    // Zen op rewrite information records
-    zen_rewrite_db_.push_back({"Conv2D", "_ZenConv2D",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrsConv2D});
-    zen_rewrite_db_.push_back({"_FusedConv2D", "_ZenFusedConv2D",
-                               CheckValidityFusedConv2D,
-                               UpdateZenOpAttrsFusedConv2D});
-    zen_rewrite_db_.push_back(
-        {"DepthwiseConv2dNative", "_ZenDepthwiseConv2dNative",
-         CheckValidityForDTypeSupported, UpdateZenOpAttrsConv2D});
-    zen_rewrite_db_.push_back(
-        {"_FusedDepthwiseConv2dNative", "_ZenFusedDepthwiseConv2dNative",
-         CheckValidityFusedConv2D, UpdateZenOpAttrsFusedConv2D});
-    zen_rewrite_db_.push_back({"MatMul", "_ZenMatMul",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    zen_rewrite_db_.push_back({"_FusedMatMul", "_ZenFusedMatMul",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    zen_rewrite_db_.push_back({"BatchMatMul", "_ZenBatchMatMul",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    zen_rewrite_db_.push_back({"BatchMatMulV2", "_ZenBatchMatMulV2",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    zen_rewrite_db_.push_back({"MaxPool", "_ZenMaxPool",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    zen_rewrite_db_.push_back({"AvgPool", "_ZenAvgPool",
-                               CheckValidityForDTypeSupported,
-                               UpdateZenOpAttrs});
-    // TF-ZenDNN supports NHWC and blocked format execution. For blocked format,
-    // following rewrites are not supported.
-    if (!IsBlockedFormatEnabled()) {
-      zen_rewrite_db_.push_back({"Softmax", "_ZenSoftmax",
-                                 CheckValidityForDTypeSupported,
-                                 UpdateZenOpAttrs});
-      zen_rewrite_db_.push_back({"ConjugateTranspose", "_ZenConjugateTranspose",
-                                 RewriteValid, UpdateZenOpAttrs});
+    const std::vector<DataType> kFloatTypes = {DT_FLOAT, DT_BFLOAT16};
+    // Zen fusion records. A BiasAdd following a Zen MatMul turns it into a
+    // fused Zen MatMul taking the bias as argument, and an activation
+    // following a fused Zen node is absorbed as a post-op of the Zen kernel.
+    // New fusions are registered by adding a record here and the resulting
+    // sequence to the fused ops of the Zen op in
+    // zen_op_registry::IsZenFusedOpsSupported().
+    AddZenFusionRecord({"_ZenMatMul", "BiasAdd", "BiasAdd", kFloatTypes, 1,
+                        "_ZenFusedMatMul"});
+    for (const string &zen_op_name :
+         {"_ZenFusedConv2D", "_ZenFusedDepthwiseConv2dNative"}) {
+      AddZenFusionRecord({zen_op_name, "Relu", "Relu", kFloatTypes, 0, ""});
+      AddZenFusionRecord({zen_op_name, "Relu6", "Relu6", kFloatTypes, 0, ""});
+    }
+    AddZenFusionRecord({"_ZenFusedMatMul", "Relu", "Relu", kFloatTypes, 0, ""});
+    AddZenFusionRecord(
+        {"_ZenFusedMatMul", "Relu6", "Relu6", kFloatTypes, 0, ""});
+    AddZenFusionRecord({"_ZenFusedMatMul", "Elu", "Elu", kFloatTypes, 0, ""});
+
+    // Zen op rewrite information records, shared with the Zen eager op
+    // rewrite.
+    for (const auto &info : zen_op_registry::GetZenRewriteInfos()) {
+      std::function<void(const Node *, NodeBuilder *)> update_zen_op_attr;
+      switch (info.attr_update) {
+        case zen_op_registry::ZenAttrUpdate::kConv2D:
+          update_zen_op_attr = UpdateZenOpAttrsConv2D;
+          break;
+        case zen_op_registry::ZenAttrUpdate::kFusedConv2D:
+          update_zen_op_attr = UpdateZenOpAttrsFusedConv2D;
+          break;
+        default:
+          update_zen_op_attr = UpdateZenOpAttrs;
+      }
       zen_rewrite_db_.push_back(
-          {"Transpose", "_ZenTranspose", RewriteValid, UpdateZenOpAttrs});
-      zen_rewrite_db_.push_back({"InvertPermutation", "_ZenInvertPermutation",
-                                 RewriteValid, UpdateZenOpAttrs});
-      zen_rewrite_db_.push_back({"FusedBatchNorm", "_ZenFusedBatchNorm",
-                                 RewriteValid, UpdateZenOpAttrs});
-      zen_rewrite_db_.push_back({"FusedBatchNormV2", "_ZenFusedBatchNormV2",
-                                 RewriteValid, UpdateZenOpAttrs});
-      zen_rewrite_db_.push_back({"FusedBatchNormV3", "_ZenFusedBatchNormV3",
-                                 RewriteValid, UpdateZenOpAttrs});
+          {info.tf_op_name, info.zen_op_name,
+           [&info](const Node *n) {
+             return zen_op_registry::IsZenRewriteValid(info, n->attrs());
+           },
+           update_zen_op_attr, info.nhwc_only});
     }
+    // Relative cost of reordering one byte of a tensor between NHWC and
+    // blocked format, per Zen op. Convolution and pooling tensors are blocked
+    // over channels and padded to the channel block, so their reorders are
+    // the most expensive. Ops not listed here use a weight of 1.0. The
+    // weights are only used to report the reorders, see GetReorderFlags().
+    zen_reorder_byte_weight_ = {{"_ZenConv2D", 1.0},
+                         {"_ZenFusedConv2D", 1.0},
+                         {"_ZenDepthwiseConv2dNative", 1.0},
+                         {"_ZenFusedDepthwiseConv2dNative", 1.0},
+                         {"_ZenMaxPool", 1.0},
+                         {"_ZenAvgPool", 1.0},
+                         {"_ZenMatMul", 0.5},
+                         {"_ZenFusedMatMul", 0.5},
+                         {"_ZenBatchMatMul", 0.5},
+                         {"_ZenBatchMatMulV2", 0.5}};
     // TF-ZenDNN currently only supports inference. The graph must not have any
     // of the training ops in tensorflow/core/kernels/training_ops.cc
     tf_training_ops_.push_back("ApplyGradientDescent");
@@ -205,14 +233,24 @@ class ZenLayoutRewritePass : public GraphOptimizationPass {
   // Standard interface to run optimization passes.
   Status Run(const GraphOptimizationPassOptions &options) override;
 
-  // Executes fusion and rewrite passes on the graph. Has an option to dump
-  // graph before and after rewrite. Returns true, if and only if the graph
-  // mutated, false otherwise.
-  bool ZenOpRewritePass(std::unique_ptr<Graph> *g);
+  // The rewrite depends on the ZenDNN settings of the environment, which the
+  // session config overrides. The version must be bumped whenever the
+  // rewritten graphs change.
+  string CacheKey() const override {
+    const ZenDnnConfig &config = GetProcessZenDnnConfig();
+    return strings::StrCat("v5;zendnn=", config.enabled,
+                           ";conv_algo=", config.conv_algo,
+                           ";mempool=", config.mempool);
+  }
+
+  // Executes fusion and rewrite passes on the graph with the ZenDNN settings
+  // 'config'. Has an option to dump graph before and after rewrite. Returns
+  // true, if and only if the graph mutated, false otherwise.
+  bool ZenOpRewritePass(std::unique_ptr<Graph> *g, const ZenDnnConfig &config);
 
   // Replaces TF-Vanilla ops with Zen ops. Returns true if one or more rewrites
   // are successful, false otherwise.
-  bool ZenOpUpdate(std::unique_ptr<Graph> *g);
+  bool ZenOpUpdate(std::unique_ptr<Graph> *g, const ZenDnnConfig &config);
 
   // Stores Zen op rewrite rules.
   typedef struct {
@@ -222,59 +260,88 @@ class ZenLayoutRewritePass : public GraphOptimizationPass {
     std::function<bool(const Node *)> check_validity;
     // Returns true if we should rewrite the node.
     std::function<void(const Node *, NodeBuilder *)> update_zen_op_attr;
+    // Whether the rewrite is only supported for NHWC execution.
+    bool nhwc_only = false;
   } ZenOpRewriteRecord;
 
+  // Stores Zen fusion rules. A Zen node of type 'zen_op_name' whose only data
+  // consumer is a node of type 'successor_op' absorbs it: the successor is
+  // removed and 'fused_op' is appended to the 'fused_ops' attribute. The
+  // Const inputs of the successor become the 'args' of the fused node.
+  typedef struct {
+    string zen_op_name;   // Zen op absorbing the successor.
+    string successor_op;  // Op type of the successor.
+    string fused_op;      // Entry appended to 'fused_ops'.
+    // Values of attribute 'T' for which the fusion applies. The successor
+    // must have the same 'T' as the Zen node.
+    std::vector<DataType> dtypes;
+    // Number of Const inputs the successor must have besides the Zen node.
+    // They are passed to the fused node as 'args', so records with Const
+    // inputs only match Zen nodes without 'args' yet.
+    int num_const_inputs;
+    // Zen op the node is rewritten to, if different from 'zen_op_name'. It
+    // must have the 'args', 'num_args' and 'fused_ops' of the fused TF ops.
+    string fused_zen_op_name;
+  } ZenFusionRecord;
+
+  // Registers a fusion record.
+  void AddZenFusionRecord(const ZenFusionRecord &record) {
+    zen_fusion_db_.push_back(record);
+  }
+
  private:
   // Maintain record about nodes to rewrite.
   std::vector<ZenOpRewriteRecord> zen_rewrite_db_;
 
+  // Maintain record about successors to fuse into Zen nodes.
+  std::vector<ZenFusionRecord> zen_fusion_db_;
+
   // TF training ops list from tensorflow/core/kernels/training_ops.cc
   std::vector<string> tf_training_ops_;
 
+  // Relative cost of reordering one byte for the tensors of a Zen op, used
+  // to report the reorders.
+  std::unordered_map<string, double> zen_reorder_byte_weight_;
+
+  // Reorder placement of a Zen node, computed by GetReorderFlags.
+  struct ZenReorderPlacement {
+    bool reorder_before = false;
+    bool reorder_after = false;
+    // Bytes converted per step by the reorders placed at this node, estimated
+    // from inferred shapes.
+    int64_t bytes = 0;
+    // 'bytes' weighted by the op's entry in zen_reorder_byte_weight_.
+    double weighted_bytes = 0;
+    // Why the reorders were placed; empty if the node has no reorder.
+    string reason;
+  };
+
   inline bool HasSubstr(const std::string primary,
                         const std::string sub) const {
     return primary.find(sub) != std::string::npos;
   }
 
-  // Check if the node 'n' has any applicable rewrite rule.
+  // Check if the node 'n' has any applicable rewrite rule for the ZenDNN
+  // settings 'config'.
   //
   // @return RewriteInfo* for the applicable rewrite rule.
-  const ZenOpRewriteRecord *CheckNodeForZenOpRewrite(const Node *n) const;
-
-  // ZenDNN currently does not support all fusions that grappler performs
-  // together with Conv2D and DepthwiseConv2D. We rewrite _FusedConv2D and
-  // _FusedDepthwiseConv2dNative only if it includes those we support.
-  static bool CheckValidityFusedConv2D(const Node *n) {
-    // Return false if the node is not with data type supported by Zen
-    // inference. Currently Zen supports inference in float only.
-    if (!CheckValidityForDTypeSupported(n)) {
-      return false;
-    }
-    std::vector<string> fused_ops;
-    TF_CHECK_OK(GetNodeAttr(n->def(), "fused_ops", &fused_ops));
-
-    return (fused_ops == std::vector<string>{"BiasAdd"} ||
-            fused_ops == std::vector<string>{"FusedBatchNorm"} ||
-            fused_ops == std::vector<string>{"Relu"} ||
-            fused_ops == std::vector<string>{"BiasAdd", "Relu"} ||
-            fused_ops == std::vector<string>{"BiasAdd", "Relu6"} ||
-            fused_ops == std::vector<string>{"BiasAdd", "Add"} ||
-            fused_ops == std::vector<string>{"BiasAdd", "Add", "Relu"} ||
-            fused_ops == std::vector<string>{"FusedBatchNorm", "Relu"});
-  }
+  const ZenOpRewriteRecord *CheckNodeForZenOpRewrite(
+      const Node *n, const ZenDnnConfig &config) const;
 
-  // Currently TF-ZenDNN supports FP32 inference only. Returns, true if node is
-  // of float dataype, false otherwise.
-  static bool CheckValidityForDTypeSupported(const Node *n) {
-    DataType data_type;
-    TF_CHECK_OK(GetNodeAttr(n->def(), "T", &data_type));
-    return (data_type == DT_FLOAT);
-  }
-
-  // Method to provide a 'valid' status for nodes that don't require any check.
-  // This method is used in ZenLayoutRewritePass() for creating the record/entry
-  // for rewriting native ops with Zen ops.
-  static bool RewriteValid(const Node *n) { return true; }
+  // Matches the fusion records of 'zen_op_name' against the successor of
+  // 'orig_node'. The successor must be the only data consumer of
+  // 'orig_node', have no other non-Const data input, share its data type and
+  // the fused sequence must stay supported by a registered Zen kernel.
+  //
+  // @input  orig_node - node being rewritten to 'zen_op_name'.
+  //         fused_ops - ops currently fused by 'orig_node'.
+  //         num_args - number of 'args' currently passed to 'orig_node'.
+  // @output successor - the matched successor, if any.
+  // @return Matching fusion record, nullptr if there is no match.
+  const ZenFusionRecord *MatchZenFusion(const Node *orig_node,
+                                        const string &zen_op_name,
+                                        const std::vector<string> &fused_ops,
+                                        int num_args, Node **successor) const;
 
   // Method to find whether the graph has inference ops only. It returns error
   // status if the graph has training ops.
@@ -287,14 +354,15 @@ class ZenLayoutRewritePass : public GraphOptimizationPass {
   //
   // @input  g - input graph, n - Node to be rewritten,
   //         ri - matching rewrite record,
-  //         reorder_flags - flags to populate reorder attributes of Zen op.
+  //         reorder_flags - flags to populate reorder attributes of Zen op,
+  //         reset - true if 'orig_node' is the last Zen node of the graph.
   // @return OkStatus(), if the input node is rewritten;
   //         Returns appropriate Status error code otherwise.
   //         Graph is updated in case the input node is rewritten.
   //         Otherwise, it is not updated.
   Status ZenOpNodeRewrite(std::unique_ptr<Graph> *g, Node *orig_node,
                           const ZenOpRewriteRecord *rewrite_record,
-                          std::pair<bool, bool> reorder_flags);
+                          std::pair<bool, bool> reorder_flags, bool reset);
 
   // Functions specific to operators to copy attributes
   // We need operator-specific function to copy attributes because the framework
@@ -313,18 +381,33 @@ class ZenLayoutRewritePass : public GraphOptimizationPass {
   // whether the tensors need to be reordered back to native nhwc format after
   // the Zen node.
   //
-  // @input  nodes - A vector of Zen nodes marked for rewrite to update reorder
-  //                 flags.
-  // @return An unordered map with nodes as key and value as a pair of reorder
-  //         flags.
-  std::unordered_map<Node *, std::pair<bool, bool>> GetReorderFlags(
+  // Every tensor exchanged between Zen nodes is either in NHWC or in blocked
+  // format, and a Zen node applies 'reorder_before' to all its inputs. So the
+  // output layout of a producer, the input layout of each of its Zen consumers
+  // and the output layouts of their other Zen producers must all be equal.
+  // The placement is a heuristic over these layout groups, which are computed
+  // with a union-find over node ids in O(|V| + |E|): a group that touches a
+  // non-Zen op is NHWC, and every other group stays blocked. It does not
+  // weigh the sizes of the reordered tensors against each other; the bytes
+  // placed at each node are only estimated to report them.
+  //
+  // @input  g - graph owning 'nodes'.
+  //         sizes - sizes of the tensors of 'g', used to report the reorders.
+  //         nodes - A vector of Zen nodes marked for rewrite to update reorder
+  //                 flags, in reverse post order.
+  // @return A vector indexed by node id with the reorder placement as value.
+  //         Entries of nodes not in 'nodes' have no reorder.
+  std::vector<ZenReorderPlacement> GetReorderFlags(
+      const Graph &g, const ZenTensorSizes &sizes,
       const std::vector<Node *> &nodes);
 
   // Update reorder information of all Zen nodes
   //
   // @input g - input graph
+  //        sizes - sizes of the tensors of 'g'.
   // @return true, if one or more updates are successful; false otherwise.
-  bool AddReorderAttrs(std::unique_ptr<Graph> *g);
+  bool AddReorderAttrs(std::unique_ptr<Graph> *g, const ZenTensorSizes &sizes);
+
 };
 
 // ZenLayoutRewritePass is executed in phase 0, to make sure it is executed
@@ -335,18 +418,21 @@ REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_PARTITIONING, 0,
 void DeleteNodeAndUpdateLinks(std::unique_ptr<Graph> *, Node *, Node *, int);
 
 const ZenLayoutRewritePass::ZenOpRewriteRecord *
-ZenLayoutRewritePass::CheckNodeForZenOpRewrite(const Node *n) const {
+ZenLayoutRewritePass::CheckNodeForZenOpRewrite(
+    const Node *n, const ZenDnnConfig &config) const {
   CHECK_NOTNULL(n);  // Crash ok.
 
-  DataType data_type;
-
   for (auto rewrite_record = zen_rewrite_db_.cbegin();
        rewrite_record != zen_rewrite_db_.cend(); ++rewrite_record) {
+    if (rewrite_record->nhwc_only && config.blocked_format) {
+      continue;
+    }
     if (n->type_string() == rewrite_record->tf_op_name &&
         rewrite_record->check_validity(n)) {
-      TF_CHECK_OK(GetNodeAttr(n->def(), "T", &data_type));
+      // Match all type attributes of the node against the type constraints
+      // of the registered Zen kernels.
       if (!zen_op_registry::IsZenOpKernelRegistered(rewrite_record->zen_op_name,
-                                                    data_type)) {
+                                                    n->attrs())) {
         // No Zen kernel is registered for op.
         return nullptr;
       }
@@ -356,18 +442,19 @@ ZenLayoutRewritePass::CheckNodeForZenOpRewrite(const Node *n) const {
   return nullptr;
 }
 
-// Returns true if 'm' is the last Zen node of the graph, false otherwise.
-bool IsLastZenNode(std::unique_ptr<Graph> *g, Node *m) {
-  std::vector<Node *> order;
-  GetPostOrder(**g, &order);
-
-  for (Node *n : order) {
+// Returns the last Zen node of the graph, i.e., the first Zen node found in
+// 'post_order'. Returns nullptr if there is no Zen node in the graph.
+//
+// The post order is computed once by the caller and shared across all nodes
+// being rewritten, instead of traversing the graph once per node.
+Node *GetLastZenNode(const std::vector<Node *> &post_order) {
+  for (Node *n : post_order) {
     if (absl::StrContains((n->type_string()),
                           zen_op_registry::kZenNodePrefix)) {
-      return (n == m);
+      return n;
     }
   }
-  return false;
+  return nullptr;
 }
 
 // Returns the count of incoming data edges to a node.
@@ -477,33 +564,64 @@ void DeleteNodeAndUpdateLinks(std::unique_ptr<Graph> *g, Node *m,
   (*g)->RemoveNode(m);
 }
 
-// Remove the successor of Zen node if it matches with 'pattern'.
-//
-// @input  g - input graph.
-// @input  orig_node - Source Zen node.
-// @input  pattern - Pattern to check in the successor nodes of 'orig_node'.
-// @return True, if the pattern is found in successor nodes of 'orig_node' and
-//         delete the successor node (otherwise false).
-bool ZenOpRemoveSuccessor(std::unique_ptr<Graph> *g, const Node *orig_node,
-                          string pattern) {
+const ZenLayoutRewritePass::ZenFusionRecord *
+ZenLayoutRewritePass::MatchZenFusion(const Node *orig_node,
+                                     const string &zen_op_name,
+                                     const std::vector<string> &fused_ops,
+                                     int num_args, Node **successor) const {
   if (OutgoingEdgeCount(orig_node) != 1) {
-    return false;
+    return nullptr;
   }
-
+  const Edge *out_edge = nullptr;
   for (const Edge *e : orig_node->out_edges()) {
-    if (!e->IsControlEdge() && e->dst()->type_string() == pattern &&
-        IncomingEdgeCount(e->dst()) == 1) {
-      DeleteNodeAndUpdateLinks(g, e->dst(), e->src(), e->src_output());
-      return true;
+    if (!e->IsControlEdge()) {
+      out_edge = e;
+      break;
+    }
+  }
+  Node *dst = out_edge->dst();
+  // The successor must only consume 'orig_node' and constants.
+  if (IncomingEdgeCount(dst) != 1) {
+    return nullptr;
+  }
+  int num_const_inputs = 0;
+  for (const Edge *e : dst->in_edges()) {
+    if (!e->IsControlEdge() && e->src()->type_string() == "Const") {
+      num_const_inputs++;
     }
   }
-  return false;
-}
 
-// Fuse Conv2D-Bias-ReLU
-bool FuseConv2DBiasRelu(std::unique_ptr<Graph> *g, const Node *orig_node,
-                        string pattern) {
-  return ZenOpRemoveSuccessor(g, orig_node, pattern);
+  DataType data_type, successor_data_type;
+  if (!TryGetNodeAttr(orig_node->attrs(), "T", &data_type) ||
+      !TryGetNodeAttr(dst->attrs(), "T", &successor_data_type) ||
+      data_type != successor_data_type) {
+    return nullptr;
+  }
+
+  for (const ZenFusionRecord &record : zen_fusion_db_) {
+    if (record.zen_op_name != zen_op_name ||
+        record.successor_op != dst->type_string() ||
+        record.num_const_inputs != num_const_inputs ||
+        (num_const_inputs > 0 && num_args > 0) ||
+        std::find(record.dtypes.begin(), record.dtypes.end(), data_type) ==
+            record.dtypes.end()) {
+      continue;
+    }
+    const string &fused_zen_op_name = record.fused_zen_op_name.empty()
+                                          ? zen_op_name
+                                          : record.fused_zen_op_name;
+    std::vector<string> new_fused_ops = fused_ops;
+    new_fused_ops.push_back(record.fused_op);
+    if (!zen_op_registry::IsZenFusedOpsSupported(fused_zen_op_name,
+                                                 new_fused_ops) ||
+        !zen_op_registry::IsZenOpKernelRegistered(fused_zen_op_name,
+                                                  data_type)) {
+      continue;
+    }
+    *successor = dst;
+    return &record;
+  }
+  return nullptr;
 }
 
 void ZenLayoutRewritePass::UpdateZenOpAttrs(const Node *orig_node,
@@ -516,7 +634,7 @@ void ZenLayoutRewritePass::UpdateZenOpAttrs(const Node *orig_node,
     // Skip the following attributes because they are handled elsewhere.
     if (name == "reorder_before" || name == "reorder_after" ||
         name == "is_eager" || name == "in_links" || name == "out_links" ||
-        name == "reset") {
+        name == "reset" || name == "_zen_reorder_reason") {
       continue;
     }
 
@@ -741,7 +859,7 @@ static void FillInputs(const Node *n,
 Status ZenLayoutRewritePass::ZenOpNodeRewrite(
     std::unique_ptr<Graph> *g, Node *orig_node,
     const ZenOpRewriteRecord *rewrite_record,
-    std::pair<bool, bool> reorder_flags) {
+    std::pair<bool, bool> reorder_flags, bool reset) {
   DCHECK_NE(rewrite_record, nullptr);
   DCHECK_NE(orig_node, nullptr);
 
@@ -758,35 +876,73 @@ Status ZenLayoutRewritePass::ZenOpNodeRewrite(
   gtl::InlinedVector<std::pair<Node *, int>, 4> inputs(num_data_inputs);
   FillInputs(orig_node, &control_edges, &inputs);
 
-  NodeBuilder nb(orig_node->name().c_str(),
-                 rewrite_record->zen_op_name.c_str());
+  // Fuse successors as per zen_fusion_db_. Their Const inputs are appended to
+  // the 'args' of the fused node.
+  string zen_op_name = rewrite_record->zen_op_name;
+  const bool has_fused_ops = HasNodeAttr(orig_node->def(), "fused_ops");
+  if (has_fused_ops) {
+    TF_CHECK_OK(GetNodeAttr(orig_node->def(), "fused_ops", &fused_ops));
+  }
+  int num_args = 0;
+  TryGetNodeAttr(orig_node->attrs(), "num_args", &num_args);
+  std::vector<NodeBuilder::NodeOut> fused_args;
+  const ZenFusionRecord *fusion = nullptr;
+  Node *successor = nullptr;
+  while ((fusion = MatchZenFusion(
+              orig_node, zen_op_name, fused_ops,
+              num_args + static_cast<int>(fused_args.size()), &successor)) !=
+         nullptr) {
+    VLOG(1) << "ZenLayoutRewritePass::ZenOpNodeRewrite: Fused "
+            << successor->name() << " " << successor->type_string()
+            << " into " << orig_node->name();
+    int source_slot = 0;
+    gtl::InlinedVector<const Edge *, 4> const_edges;
+    for (const Edge *e : successor->in_edges()) {
+      if (e->IsControlEdge()) {
+        continue;
+      }
+      if (e->src() == orig_node) {
+        source_slot = e->src_output();
+      } else {
+        const_edges.push_back(e);
+      }
+    }
+    std::sort(const_edges.begin(), const_edges.end(),
+              [](const Edge *a, const Edge *b) {
+                return a->dst_input() < b->dst_input();
+              });
+    for (const Edge *e : const_edges) {
+      fused_args.emplace_back(e->src(), e->src_output());
+    }
+    DeleteNodeAndUpdateLinks(g, successor, orig_node, source_slot);
+    fused_ops.push_back(fusion->fused_op);
+    if (!fusion->fused_zen_op_name.empty()) {
+      zen_op_name = fusion->fused_zen_op_name;
+    }
+  }
+
+  NodeBuilder nb(orig_node->name().c_str(), zen_op_name.c_str());
 
   nb.Device(orig_node->def().device());
   TF_RETURN_IF_ERROR(zendnn::CopyInputs(orig_node, inputs, &nb));
+  if (!fused_args.empty()) {
+    nb.Input(fused_args);
+    nb.Attr("num_args", static_cast<int>(fused_args.size()));
+  }
   rewrite_record->update_zen_op_attr(const_cast<const Node *>(orig_node), &nb);
 
   nb.Attr("reorder_before", reorder_flags.first);
   nb.Attr("reorder_after", reorder_flags.second);
   nb.Attr("in_links", IncomingEdgeCount(orig_node));
   nb.Attr("out_links", OutgoingEdgeCount(orig_node));
-  nb.Attr("reset", IsLastZenNode(g, orig_node));
-
-  // Add/Update Fused Op Attribute.
-  if (orig_node->type_string() == "_ZenFusedConv2D" ||
-      orig_node->type_string() == "_FusedConv2D" ||
-      orig_node->type_string() == "_FusedDepthwiseConv2dNative" ||
-      orig_node->type_string() == "_ZenFusedDepthwiseConv2dNative") {
-    TF_CHECK_OK(GetNodeAttr(orig_node->def(), "fused_ops", &fused_ops));
-    if (FuseConv2DBiasRelu(g, orig_node, "Relu")) {
-      if (fused_ops.size() == 1) {
-        fused_ops.push_back("Relu");
-      }
-    }
-    if (FuseConv2DBiasRelu(g, orig_node, "Relu6")) {
-      if (fused_ops.size() == 1) {
-        fused_ops.push_back("Relu6");
-      }
-    }
+  nb.Attr("reset", reset);
+  // Carry over the reorder placement summary recorded by AddReorderAttrs.
+  string reorder_reason;
+  if (TryGetNodeAttr(orig_node->attrs(), "_zen_reorder_reason",
+                     &reorder_reason)) {
+    nb.Attr("_zen_reorder_reason", reorder_reason);
+  }
+  if (has_fused_ops || !fused_ops.empty()) {
     nb.Attr("fused_ops", fused_ops);
   }
   TF_RETURN_IF_ERROR(nb.Finalize(&**g, &new_node));
@@ -820,40 +976,123 @@ Status ZenLayoutRewritePass::ZenOpNodeRewrite(
   return OkStatus();
 }
 
-std::unordered_map<Node *, std::pair<bool, bool>>
-ZenLayoutRewritePass::GetReorderFlags(const std::vector<Node *> &nodes) {
-  // Map from node to [reorder_before, reorder_after]
-  std::unordered_map<Node *, std::pair<bool, bool>> reorder_flags;
-  bool first_reorder_completed = false;  // assuming only one input
+// Disjoint sets of layout slots used for reorder placement. Slot 2 * id is the
+// input layout of the node with that id, and slot 2 * id + 1 its output
+// layout. Each set records whether it is bound to NHWC format, and why.
+class ZenLayoutSlots {
+ public:
+  explicit ZenLayoutSlots(int num_node_ids)
+      : parent_(2 * num_node_ids),
+        size_(2 * num_node_ids, 1),
+        reason_(2 * num_node_ids) {
+    std::iota(parent_.begin(), parent_.end(), 0);
+  }
 
-  for (Node *n : nodes) {
-    // When setting reorder_before, we check if the input ops are read ops
-    // typically to avoid considering read ops from filter weights as they are
-    // reordered anyway in the Zen op. However, for the first op, there will be
-    // two read ops, one from weights, and one from input data. To handle this
-    // special case, this bool variable is used.
-    bool reorder_before, reorder_after;
-    reorder_before = reorder_after = false;
+  static int In(const Node *n) { return 2 * n->id(); }
+  static int Out(const Node *n) { return 2 * n->id() + 1; }
 
-    for (const Edge *e : n->out_edges()) {
-      Node *dst = e->dst();
-      if (!dst->IsOp() || e->IsControlEdge()) {
+  int Find(int slot) {
+    while (parent_[slot] != slot) {
+      parent_[slot] = parent_[parent_[slot]];
+      slot = parent_[slot];
+    }
+    return slot;
+  }
+
+  void Union(int a, int b) {
+    a = Find(a);
+    b = Find(b);
+    if (a == b) return;
+    if (size_[a] < size_[b]) std::swap(a, b);
+    parent_[b] = a;
+    size_[a] += size_[b];
+    if (reason_[a].empty()) reason_[a] = std::move(reason_[b]);
+  }
+
+  // Binds the set of 'slot' to NHWC format. The first reason is kept.
+  void BindToNhwc(int slot, const string &reason) {
+    string &root_reason = reason_[Find(slot)];
+    if (root_reason.empty()) root_reason = reason;
+  }
+
+  bool IsNhwc(int slot) { return !reason_[Find(slot)].empty(); }
+  const string &Reason(int slot) { return reason_[Find(slot)]; }
+
+ private:
+  std::vector<int> parent_;
+  std::vector<int> size_;
+  // Non-empty if and only if the set is bound to NHWC format.
+  std::vector<string> reason_;
+};
+
+ZenTensorSizes::ZenTensorSizes(const Graph &g) {
+  std::vector<Node *> order;
+  GetReversePostOrder(g, &order);
+  ShapeRefiner refiner(g.versions(), g.op_registry());
+  for (Node *n : order) {
+    Status s = refiner.AddNode(n);
+    if (!s.ok()) {
+      VLOG(2) << "ZenLayoutRewritePass: No shape for " << n->name() << ": "
+              << s.message();
+      continue;
+    }
+    shape_inference::InferenceContext *ctx = refiner.GetContext(n);
+    std::vector<int64_t> &output_sizes = sizes_[n->name()];
+    output_sizes.resize(ctx->num_outputs(), 0);
+    for (int slot = 0; slot < ctx->num_outputs(); ++slot) {
+      shape_inference::ShapeHandle shape = ctx->output(slot);
+      if (!ctx->RankKnown(shape)) {
         continue;
       }
-
-      auto it = std::find(nodes.begin(), nodes.end(), dst);
-      if (it == nodes.end()) {
-        VLOG(1) << "ZenLayoutRewritePass::GetReorderFlags: At " << n->name()
-                << " " << n->type_string() << ", non-Zen output - "
-                << dst->name() << " " << dst->type_string();
-        // Did not find the next node. This means that the next node is not a
-        // Zen node, thus, we must reorder.
-        reorder_after = true;
-        // Exit the loop as remaining edges will not change this flag.
-        break;
+      const int64_t type_size = DataTypeSize(n->output_type(slot));
+      int64_t num_known_elements = 1;
+      for (int i = 0; i < ctx->Rank(shape); ++i) {
+        int64_t dim = ctx->Value(ctx->Dim(shape, i));
+        if (dim > 0) {
+          num_known_elements *= dim;
+        }
       }
+      output_sizes[slot] = num_known_elements * type_size;
     }
+  }
+}
+
+int64_t ZenTensorSizes::EstimatedBytes(const Node *n, int slot) const {
+  auto it = sizes_.find(n->name());
+  if (it == sizes_.end() || slot < 0 ||
+      slot >= static_cast<int>(it->second.size())) {
+    return 0;
+  }
+  return it->second[slot];
+}
+
+std::vector<ZenLayoutRewritePass::ZenReorderPlacement>
+ZenLayoutRewritePass::GetReorderFlags(const Graph &g,
+                                      const ZenTensorSizes &sizes,
+                                      const std::vector<Node *> &nodes) {
+  // Bitmap of Zen nodes indexed by node id. Node ids are dense in
+  // [0, num_node_ids()), so a membership test is a single lookup instead of a
+  // linear search over 'nodes'.
+  std::vector<bool> is_zen_node(g.num_node_ids(), false);
+  for (const Node *n : nodes) {
+    is_zen_node[n->id()] = true;
+  }
+  auto IsZenNode = [&is_zen_node](const Node *n) {
+    return is_zen_node[n->id()];
+  };
+
+  ZenLayoutSlots slots(g.num_node_ids());
+  // Input edges of each Zen node whose tensors take part in its layout, used
+  // to estimate the bytes converted by 'reorder_before'.
+  std::unordered_map<const Node *, std::vector<const Edge *>> layout_inputs;
+  // When binding inputs, we check if the input ops are read ops typically to
+  // avoid considering read ops from filter weights as they are reordered
+  // anyway in the Zen op. However, for the first op, there will be two read
+  // ops, one from weights, and one from input data. To handle this special
+  // case, this bool variable is used.
+  bool first_reorder_completed = false;  // assuming only one input
 
+  for (Node *n : nodes) {
     for (const Edge *e : n->in_edges()) {
       Node *src = e->src();
       if (!src->IsOp() || e->IsControlEdge() ||
@@ -861,127 +1100,110 @@ ZenLayoutRewritePass::GetReorderFlags(const std::vector<Node *> &nodes) {
         continue;
       }
 
+      if (IsZenNode(src)) {
+        // Zen producer: its output layout is the input layout of 'n'.
+        slots.Union(ZenLayoutSlots::In(n), ZenLayoutSlots::Out(src));
+        layout_inputs[n].push_back(e);
+        continue;
+      }
+
       if (HasSubstr(src->type_string(), "_Arg")) {
-        // Found a placeholder op.
-        VLOG(1) << "ZenLayoutRewritePass::GetReorderFlags: At " << n->name()
-                << " " << n->type_string() << ", a placeholder op "
-                << src->name() << " " << src->type_string();
-        // In this case, we don't need to worry about a read op from data.
+        // Found a placeholder op. In this case, we don't need to worry about
+        // a read op from data.
         first_reorder_completed = true;
-        reorder_before = true;
-        break;
+        slots.BindToNhwc(ZenLayoutSlots::In(n),
+                         strings::StrCat("placeholder input ", src->name()));
+        layout_inputs[n].push_back(e);
+        continue;
       }
 
       // Ignore read ops coming from weights.
       if (HasSubstr(src->name(), "read")) {
         // Found read op, check if it is the first.
         if (!first_reorder_completed) {
-          VLOG(1) << "ZenLayoutRewritePass::GetReorderFlags: At " << n->name()
-                  << " " << n->type_string() << ", encountered first read op "
-                  << src->name() << " " << src->type_string();
           first_reorder_completed = true;
-          reorder_before = true;
-          break;
+          slots.BindToNhwc(ZenLayoutSlots::In(n),
+                           strings::StrCat("first read input ", src->name()));
+          layout_inputs[n].push_back(e);
         }
         continue;
       }
 
-      auto it = std::find(nodes.begin(), nodes.end(), src);
-      if (it == nodes.end()) {
-        VLOG(1) << "ZenLayoutRewritePass::GetReorderFlags: At " << n->name()
-                << " " << n->type_string() << ", non-Zen input - "
-                << src->name() << " " << src->type_string();
-        // Did not find the previous node. This means that the previous node is
-        // not a Zen node, thus, we must reorder.
-        reorder_before = true;
-        // Exit the loop since remaining edges will not change this flag.
-        break;
-      }
+      // The previous node is not a Zen node, thus, we must reorder.
+      slots.BindToNhwc(ZenLayoutSlots::In(n),
+                       strings::StrCat("non-Zen input ", src->name(), " ",
+                                       src->type_string()));
+      layout_inputs[n].push_back(e);
     }
 
-    std::pair<bool, bool> n_flags(reorder_before, reorder_after);
-    reorder_flags[n] = n_flags;
-  }
-
-  // Handle the case of branches separately.
-  // Case 1
-  for (Node *n : nodes) {
-    // Let A and B be Zen nodes, and X be a non-Zen node.
-    // rb - reorder_before, ra - reorder_after
-    // Handle first case of branching:
-    //       A (rb=True, ra)
-    //     /   \
-    //    X     B(rb, ra=False)
-    if (reorder_flags[n].second == false) {
-      for (const Edge *e : n->out_edges()) {
-        Node *dst = e->dst();
-        auto it = std::find(nodes.begin(), nodes.end(), dst);
-        if (it != nodes.end() && reorder_flags[dst].first) {
-          // Found Zen node.
-          reorder_flags[n].second = true;
-          break;
-        }
+    for (const Edge *e : n->out_edges()) {
+      Node *dst = e->dst();
+      if (!dst->IsOp() || e->IsControlEdge() || IsZenNode(dst)) {
+        continue;
       }
+      // The next node is not a Zen node, thus, we must reorder.
+      slots.BindToNhwc(ZenLayoutSlots::Out(n),
+                       strings::StrCat("non-Zen output ", dst->name(), " ",
+                                       dst->type_string()));
+      break;
     }
-    // Reorder flags set to true cannot be altered.
   }
 
-  // Case 2
+  std::vector<ZenReorderPlacement> placements(g.num_node_ids());
   for (Node *n : nodes) {
-    // Let A and B be Zen nodes, and X be a non-Zen node.
-    // rb - reorder_before, ra - reorder_after
-    // Handle second case of branching:
-    //    B(rb=False, ra)   X
-    //                  \  /
-    //                   A(rb,ra=True)
-    if (reorder_flags[n].first == false) {
-      for (const Edge *e : n->in_edges()) {
-        Node *src = e->src();
-        auto it = std::find(nodes.begin(), nodes.end(), src);
-        if (it != nodes.end() && reorder_flags[src].second) {
-          // Found Zen node.
-          reorder_flags[n].first = true;
-          break;
-        }
+    ZenReorderPlacement &placement = placements[n->id()];
+    double byte_weight = 1.0;
+    auto weight_it = zen_reorder_byte_weight_.find(n->type_string());
+    if (weight_it != zen_reorder_byte_weight_.end()) {
+      byte_weight = weight_it->second;
+    }
+
+    if (slots.IsNhwc(ZenLayoutSlots::In(n))) {
+      placement.reorder_before = true;
+      for (const Edge *e : layout_inputs[n]) {
+        placement.bytes += sizes.EstimatedBytes(e->src(), e->src_output());
       }
+      strings::StrAppend(&placement.reason, "reorder_before: ",
+                         slots.Reason(ZenLayoutSlots::In(n)));
     }
-    // Reorder flags set to true cannot be altered.
-  }
 
-  // Case 3
-  for (Node *n : nodes) {
-    // Let A be a Zen nodes, and B and X be a Zen/Non Zen node.
-    // rb - reorder_before, ra - reorder_after
-    // Handle third case of branching:
-    //    B(rb, ra=True)    X (set ra=True) if one of the siblings has ra=True
-    //                  \  /
-    //                   A
-    if (reorder_flags[n].second == false) {
+    if (slots.IsNhwc(ZenLayoutSlots::Out(n))) {
+      placement.reorder_after = true;
+      std::set<int> output_slots;
       for (const Edge *e : n->out_edges()) {
-        Node *dst = e->dst();
-        for (const Edge *f : dst->in_edges()) {
-          Node *src = f->src();
-          auto it = std::find(nodes.begin(), nodes.end(), src);
-          if (it != nodes.end() && src != n && reorder_flags[src].second) {
-            // Found a sibling with reorder_after set to True.
-            reorder_flags[n].second = true;
-            break;
-          }
+        if (!e->IsControlEdge() &&
+            output_slots.insert(e->src_output()).second) {
+          placement.bytes += sizes.EstimatedBytes(n, e->src_output());
         }
       }
+      strings::StrAppend(&placement.reason,
+                         placement.reason.empty() ? "" : "; ",
+                         "reorder_after: ",
+                         slots.Reason(ZenLayoutSlots::Out(n)));
+    }
+
+    placement.weighted_bytes = byte_weight * placement.bytes;
+    if (!placement.reason.empty()) {
+      VLOG(1) << "ZenLayoutRewritePass::GetReorderFlags: At " << n->name()
+              << " " << n->type_string() << ", " << placement.reason << " ("
+              << placement.bytes << " bytes)";
     }
-    // Reorder flags set to true cannot be altered.
   }
 
-  return reorder_flags;
+  return placements;
 }
 
-bool ZenLayoutRewritePass::AddReorderAttrs(std::unique_ptr<Graph> *g) {
+bool ZenLayoutRewritePass::AddReorderAttrs(std::unique_ptr<Graph> *g,
+                                           const ZenTensorSizes &sizes) {
   bool result = false;
   CHECK_NOTNULL(g);  // Crash ok.
 
+  // A single traversal provides both the last Zen node (first Zen node in
+  // post order) and the reverse post order used to visit Zen nodes.
   std::vector<Node *> order;
-  GetReversePostOrder(**g, &order);
+  GetPostOrder(**g, &order);
+  const Node *last_zen_node = GetLastZenNode(order);
+  std::reverse(order.begin(), order.end());
   std::vector<Node *> zen_nodes;
 
   for (Node *n : order) {
@@ -999,13 +1221,24 @@ bool ZenLayoutRewritePass::AddReorderAttrs(std::unique_ptr<Graph> *g) {
     }
   }
 
-  std::unordered_map<Node *, std::pair<bool, bool>> reorder_flags =
-      GetReorderFlags(zen_nodes);
+  std::vector<ZenReorderPlacement> placements =
+      GetReorderFlags(**g, sizes, zen_nodes);
 
+  int num_reorders = 0;
+  int64_t total_bytes = 0;
+  double total_weighted_bytes = 0;
   for (Node *n : zen_nodes) {
     std::string node_name = n->name();
     std::string op_name = n->type_string();
-    std::pair<bool, bool> n_reorder = reorder_flags[n];
+    const ZenReorderPlacement &placement = placements[n->id()];
+    std::pair<bool, bool> n_reorder(placement.reorder_before,
+                                    placement.reorder_after);
+    num_reorders += placement.reorder_before + placement.reorder_after;
+    total_bytes += placement.bytes;
+    total_weighted_bytes += placement.weighted_bytes;
+    // Recorded on the node so that the placement can be inspected in dumped
+    // graphs.
+    n->AddAttr("_zen_reorder_reason", placement.reason);
 
     ZenOpRewriteRecord rewrite_record;
     for (auto it = zen_rewrite_db_.begin(); it < zen_rewrite_db_.end(); it++) {
@@ -1016,7 +1249,8 @@ bool ZenLayoutRewritePass::AddReorderAttrs(std::unique_ptr<Graph> *g) {
     }
 
     // Rewrite op with a copy containing the new reorder flags.
-    if (ZenOpNodeRewrite(g, n, &rewrite_record, n_reorder) == OkStatus()) {
+    if (ZenOpNodeRewrite(g, n, &rewrite_record, n_reorder,
+                         n == last_zen_node) == OkStatus()) {
       VLOG(1) << "ZenLayoutRewritePass::AddReorderAttrs: Node " << node_name
               << " " << op_name << " updated reorders to " << n_reorder.first
               << " " << n_reorder.second;
@@ -1024,24 +1258,39 @@ bool ZenLayoutRewritePass::AddReorderAttrs(std::unique_ptr<Graph> *g) {
     }
   }
 
+  VLOG(1) << "ZenLayoutRewritePass::AddReorderAttrs: Placed " << num_reorders
+          << " reorders on " << zen_nodes.size() << " Zen nodes, "
+          << total_bytes << " bytes reordered per step (weighted "
+          << total_weighted_bytes << ")";
   return result;
 }
 
-bool ZenLayoutRewritePass::ZenOpUpdate(std::unique_ptr<Graph> *g) {
+bool ZenLayoutRewritePass::ZenOpUpdate(std::unique_ptr<Graph> *g,
+                                       const ZenDnnConfig &config) {
   bool result = false;
   std::vector<Node *> order;
   GetReversePostOrder(**g, &order);
-  for (Node *n : order) {
-    if (!n->IsOp() || !zendnn::CanOpRunOnCPUDevice(n)) {
+  // Node ids are never reused, so visiting by id skips nodes that were
+  // removed from the graph when fused into a preceding Zen node.
+  std::vector<int> order_ids;
+  order_ids.reserve(order.size());
+  for (const Node *n : order) {
+    order_ids.push_back(n->id());
+  }
+  for (int id : order_ids) {
+    Node *n = (*g)->FindNodeId(id);
+    if (n == nullptr || !n->IsOp() || !zendnn::CanOpRunOnCPUDevice(n)) {
       continue;
     }
 
     const ZenOpRewriteRecord *rewrite_record = nullptr;
-    if ((rewrite_record = CheckNodeForZenOpRewrite(n)) != nullptr) {
+    if ((rewrite_record = CheckNodeForZenOpRewrite(n, config)) != nullptr) {
       string node_name = n->name();
       string op_name = n->type_string();
       std::pair<bool, bool> n_reorder(true, true);
-      if (ZenOpNodeRewrite(g, n, rewrite_record, n_reorder) == OkStatus()) {
+      // 'reset' is finalized in AddReorderAttrs once all Zen nodes exist.
+      if (ZenOpNodeRewrite(g, n, rewrite_record, n_reorder,
+                           /*reset=*/false) == OkStatus()) {
         VLOG(1) << "ZenLayoutRewritePass::ZenOpUpdate: Node " << op_name
                 << " rewritten with ZenOp " << rewrite_record->zen_op_name;
         result = true;
@@ -1078,7 +1327,8 @@ Status ZenLayoutRewritePass::AreAllInferenceOps(std::unique_ptr<Graph> *g) {
   return OkStatus();
 }
 
-bool ZenLayoutRewritePass::ZenOpRewritePass(std::unique_ptr<Graph> *g) {
+bool ZenLayoutRewritePass::ZenOpRewritePass(std::unique_ptr<Graph> *g,
+                                            const ZenDnnConfig &config) {
   bool result = false;
   CHECK_NOTNULL(g);  // Crash ok.
 
@@ -1094,7 +1344,7 @@ bool ZenLayoutRewritePass::ZenOpRewritePass(std::unique_ptr<Graph> *g) {
   // Two passes of Graph optimization:
 
   // First pass implements Basic Fusion Eg. Conv2D-Bias-Relu.
-  result = ZenOpUpdate(g);
+  result = ZenOpUpdate(g, config);
   if (!result) {
     VLOG(1) << "ZenLayoutRewritePass::ZenOpRewritePass: No opportunity for Zen "
             << "op conversion found in first graph optimization pass.";
@@ -1121,23 +1371,45 @@ bool ZenLayoutRewritePass::ZenOpRewritePass(std::unique_ptr<Graph> *g) {
     }
   }
   // Third Pass to implement optimizations over Zen ops.
-  result = ZenOpUpdate(g);
+  result = ZenOpUpdate(g, config);
   if (!result) {
     VLOG(1) << "ZenLayoutRewritePass::ZenOpRewritePass: No opportunity for Zen "
             << "op conversion found in third graph optimization pass.";
   }
 
-  result = AddReorderAttrs(g);
+  const ZenTensorSizes sizes(**g);
+  result = AddReorderAttrs(g, sizes);
   if (!result) {
     VLOG(1) << "ZenLayoutRewritePass::ZenOpRewritePass: No reorder attributes "
             << "were updated.";
   }
+
+  // Forward the memory pool mode and the convolution algorithm of the session
+  // to the Zen kernels.
+  if (config.session_mempool || config.session_conv_algo) {
+    for (Node *n : (*g)->op_nodes()) {
+      if (!absl::StartsWith(n->type_string(), "_Zen")) continue;
+      if (config.session_mempool) {
+        n->AddAttr(kZenMempoolAttr, config.mempool);
+      }
+      if (config.session_conv_algo) {
+        n->AddAttr(kZenConvAlgoAttr, config.conv_algo);
+      }
+    }
+  }
   DumpGraph("\nAfter ZenRewritePass:\n", &**g);
   return result;
 }
 
+bool RunZenLayoutRewritePass(std::unique_ptr<Graph> *g) {
+  return ZenLayoutRewritePass().ZenOpRewritePass(g, GetProcessZenDnnConfig());
+}
+
 Status ZenLayoutRewritePass::Run(const GraphOptimizationPassOptions &options) {
-  if (!IsZenDnnEnabled()) {
+  const ZenDnnConfig config = GetZenDnnConfig(
+      options.session_options != nullptr ? &options.session_options->config
+                                         : nullptr);
+  if (!config.enabled) {
     VLOG(2) << "TF-ZENDNN: ZenDNN Inference is disabled! ";
     return OkStatus();
   }
@@ -1148,12 +1420,12 @@ Status ZenLayoutRewritePass::Run(const GraphOptimizationPassOptions &options) {
 
   if (options.graph != nullptr) {
     std::unique_ptr<Graph> *graph = std::move(options.graph);
-    ZenOpRewritePass(graph);
+    ZenOpRewritePass(graph, config);
     options.graph->reset(graph->release());
   } else {
     for (auto &g : *options.partition_graphs) {
       std::unique_ptr<Graph> *graph = std::move(&g.second);
-      ZenOpRewritePass(graph);
+      ZenOpRewritePass(graph, config);
       (&g.second)->reset(graph->release());
     }
   }
@@ -0,0 +1,136 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifdef AMD_ZENDNN
+
+#include <cstdlib>
+#include <memory>
+
+#include "tensorflow/core/common_runtime/zen_layout_pass.h"
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/util/zen_util.h"
+
+namespace tensorflow {
+
+// The Zen ops and kernels are provided by the TF-ZenDNN plugin, which this
+// benchmark does not link. The pass only rewrites MatMul if a _ZenMatMul
+// kernel is registered, so a stub op and kernel are registered here. The
+// kernel is never run.
+REGISTER_OP("_ZenMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("T: {float, bfloat16}")
+    .Attr("is_eager: bool = false")
+    .Attr("reorder_before: bool")
+    .Attr("reorder_after: bool")
+    .Attr("in_links: int")
+    .Attr("out_links: int")
+    .Attr("reset: bool")
+    .SetShapeFn(shape_inference::MatMulShape);
+
+namespace {
+
+class ZenMatMulStubOp : public OpKernel {
+ public:
+  explicit ZenMatMulStubOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    context->SetStatus(
+        errors::Unimplemented("_ZenMatMul stub of the benchmark."));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("_ZenMatMul").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ZenMatMulStubOp);
+
+// Returns the number of nodes of type 'op' in 'g'.
+int CountNodes(const Graph& g, const string& op) {
+  int count = 0;
+  for (const Node* n : g.op_nodes()) {
+    if (n->type_string() == op) ++count;
+  }
+  return count;
+}
+
+// Builds a graph of 'num_layers' MatMul+Relu blocks fed by an _Arg. Every
+// other block also feeds a non-Zen Identity and joins it back with an Add, so
+// that the reorder analysis sees Zen/non-Zen boundaries, fan-out and siblings.
+static Graph* ZenLayoutPassGraph(int num_layers) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor weights(DT_FLOAT, TensorShape({2, 2}));
+  weights.flat<float>().setRandom();
+
+  Node* x = test::graph::Arg(g, 0, DT_FLOAT);
+  for (int i = 0; i < num_layers; ++i) {
+    Node* w = test::graph::Constant(g, weights);
+    Node* mm = test::graph::Matmul(g, x, w, false, false);
+    x = test::graph::Relu(g, mm);
+    if (i % 2 == 1) {
+      Node* side = test::graph::Identity(g, mm);
+      x = test::graph::Add(g, x, side);
+    }
+  }
+  test::graph::Retval(g, 0, x);
+  return g;
+}
+
+// Measures the rewrite pass time against the graph size. The pass cost is
+// expected to grow linearly with the number of nodes and edges.
+static void BM_ZenLayoutRewritePass(::testing::benchmark::State& state) {
+  // Must be set before the ZenDNN settings of the process are first read.
+  setenv("TF_ENABLE_ZENDNN_OPTS", "1", /*overwrite=*/1);
+  CHECK(GetProcessZenDnnConfig().enabled);
+  const int num_layers = state.range(0);
+  bool first_iteration = true;
+  for (auto s : state) {
+    state.PauseTiming();
+    std::unique_ptr<Graph> g(ZenLayoutPassGraph(num_layers));
+    state.ResumeTiming();
+    const bool rewritten = RunZenLayoutRewritePass(&g);
+    if (first_iteration) {
+      // Otherwise the pass exits early and its scaling is not measured.
+      state.PauseTiming();
+      CHECK(rewritten);
+      CHECK_EQ(CountNodes(*g, "_ZenMatMul"), num_layers);
+      CHECK_EQ(CountNodes(*g, "MatMul"), 0);
+      first_iteration = false;
+      state.ResumeTiming();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_layers);
+}
+BENCHMARK(BM_ZenLayoutRewritePass)
+    ->Arg(1000)
+    ->Arg(4000)
+    ->Arg(16000)
+    ->Arg(40000);
+
+}  // namespace
+}  // namespace tensorflow
+
+#endif  // AMD_ZENDNN
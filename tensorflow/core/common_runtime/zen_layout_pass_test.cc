@@ -0,0 +1,170 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifdef AMD_ZENDNN
+
+#include "tensorflow/core/common_runtime/zen_layout_pass.h"
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/zen_util.h"
+
+namespace tensorflow {
+
+// The Zen ops and kernels are provided by the TF-ZenDNN plugin, which this
+// test does not link. The pass only rewrites to Zen ops with a registered
+// kernel, so stub ops and kernels are registered here. The kernels are never
+// run.
+REGISTER_OP("_ZenMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("T: {float, bfloat16}")
+    .Attr("is_eager: bool = false")
+    .Attr("reorder_before: bool")
+    .Attr("reorder_after: bool")
+    .Attr("in_links: int")
+    .Attr("out_links: int")
+    .Attr("reset: bool")
+    .SetShapeFn(shape_inference::MatMulShape);
+
+REGISTER_OP("_ZenFusedMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Input("args: num_args * T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("T: {float, bfloat16}")
+    .Attr("num_args: int >= 0")
+    .Attr("fused_ops: list(string) = []")
+    .Attr("epsilon: float = 0.0001")
+    .Attr("leakyrelu_alpha: float = 0.2")
+    .Attr("is_eager: bool = false")
+    .Attr("reorder_before: bool")
+    .Attr("reorder_after: bool")
+    .Attr("in_links: int")
+    .Attr("out_links: int")
+    .Attr("reset: bool")
+    .SetShapeFn(shape_inference::MatMulShape);
+
+namespace {
+
+class ZenStubOp : public OpKernel {
+ public:
+  explicit ZenStubOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    context->SetStatus(errors::Unimplemented("Zen stub op of the test."));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("_ZenMatMul").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ZenStubOp);
+REGISTER_KERNEL_BUILDER(
+    Name("_ZenFusedMatMul").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    ZenStubOp);
+
+class ZenLayoutPassTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Must be set before the ZenDNN settings of the process are first read.
+    setenv("TF_ENABLE_ZENDNN_OPTS", "1", /*overwrite=*/1);
+    ASSERT_TRUE(GetProcessZenDnnConfig().enabled);
+  }
+
+  // Returns the nodes of type 'op' in 'g'.
+  static std::vector<const Node*> FindNodes(const Graph& g,
+                                            const string& op) {
+    std::vector<const Node*> nodes;
+    for (const Node* n : g.op_nodes()) {
+      if (n->type_string() == op) nodes.push_back(n);
+    }
+    return nodes;
+  }
+
+  static Tensor RandomTensor(const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return t;
+  }
+};
+
+TEST_F(ZenLayoutPassTest, FusesMatMulBiasAddRelu) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  Node* x = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  Node* w = test::graph::Constant(g.get(), RandomTensor(TensorShape({4, 8})));
+  Node* b = test::graph::Constant(g.get(), RandomTensor(TensorShape({8})));
+  Node* mm = test::graph::Matmul(g.get(), x, w, false, false);
+  Node* bias_add = test::graph::BiasAdd(g.get(), mm, b);
+  Node* relu = test::graph::Relu(g.get(), bias_add);
+  test::graph::Retval(g.get(), 0, relu);
+
+  ASSERT_TRUE(RunZenLayoutRewritePass(&g));
+
+  EXPECT_TRUE(FindNodes(*g, "MatMul").empty());
+  EXPECT_TRUE(FindNodes(*g, "BiasAdd").empty());
+  EXPECT_TRUE(FindNodes(*g, "Relu").empty());
+  std::vector<const Node*> fused = FindNodes(*g, "_ZenFusedMatMul");
+  ASSERT_EQ(fused.size(), 1);
+  std::vector<string> fused_ops;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "fused_ops", &fused_ops));
+  EXPECT_EQ(fused_ops, std::vector<string>({"BiasAdd", "Relu"}));
+  int num_args = 0;
+  TF_ASSERT_OK(GetNodeAttr(fused[0]->attrs(), "num_args", &num_args));
+  EXPECT_EQ(num_args, 1);
+  // The bias of the deleted BiasAdd is the argument of the fused node.
+  const Node* arg = nullptr;
+  TF_ASSERT_OK(fused[0]->input_node(2, &arg));
+  EXPECT_EQ(arg->type_string(), "Const");
+  EXPECT_EQ(arg->name(), b->name());
+}
+
+TEST_F(ZenLayoutPassTest, DoesNotFuseBiasAddWithNonConstBias) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  Node* x = test::graph::Arg(g.get(), 0, DT_FLOAT);
+  Node* b = test::graph::Arg(g.get(), 1, DT_FLOAT);
+  Node* w = test::graph::Constant(g.get(), RandomTensor(TensorShape({4, 8})));
+  Node* mm = test::graph::Matmul(g.get(), x, w, false, false);
+  Node* bias_add = test::graph::BiasAdd(g.get(), mm, b);
+  test::graph::Retval(g.get(), 0, bias_add);
+
+  ASSERT_TRUE(RunZenLayoutRewritePass(&g));
+
+  EXPECT_EQ(FindNodes(*g, "_ZenMatMul").size(), 1);
+  EXPECT_EQ(FindNodes(*g, "BiasAdd").size(), 1);
+  EXPECT_TRUE(FindNodes(*g, "_ZenFusedMatMul").empty());
+}
+
+}  // namespace
+}  // namespace tensorflow
+
+#endif  // AMD_ZENDNN
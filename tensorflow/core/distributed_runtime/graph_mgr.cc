@@ -578,6 +578,11 @@ void GraphMgr::BuildCostModel(Item* item, StepStatsCollector* collector,
       }
     }
     collector->BuildCostModel(&cost_model_manager_, device_to_graph);
+    for (const auto& unit : item->units) {
+      if (unit.build_cost_model > 0) {
+        unit.root->ExportCostEstimates(*unit.graph, &cost_model_manager_);
+      }
+    }
 
     if (cost_graph != nullptr) {
       for (const auto& unit : item->units) {
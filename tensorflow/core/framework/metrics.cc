@@ -52,6 +52,12 @@ auto* graph_pending_queue_length_histogram = tsl::monitoring::Sampler<0>::New(
     // Power of 1.5 with bucket count 30 (> 191k)
     {tsl::monitoring::Buckets::Exponential(1, 1.5, 30)});
 
+auto* executor_step_state_pool_misses = tsl::monitoring::Counter<1>::New(
+    "/tensorflow/core/executor_step_state_pool_misses",
+    "The number of times the executor found no pooled per-step state of a "
+    "kind to reuse, and allocated it.",
+    "kind");
+
 auto* graph_run_input_tensor_bytes = tsl::monitoring::Sampler<0>::New(
     {"/tensorflow/core/graph_run_input_tensor_bytes",
      "The size of input tensors in bytes."},
@@ -671,6 +677,10 @@ void UpdateGraphPendingQueueLength(uint64 len) {
   graph_pending_queue_length_cell->Add(len);
 }
 
+void RecordExecutorStepStatePoolMiss(const string& kind) {
+  executor_step_state_pool_misses->GetCell(kind)->IncrementBy(1);
+}
+
 void UpdateGraphBuildTime(const uint64 running_time_usecs) {
   if (running_time_usecs > 0) {
     static auto* build_graph_calls_cell = build_graph_calls->GetCell();
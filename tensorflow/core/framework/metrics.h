@@ -226,6 +226,13 @@ void RecordTPUXlaSpmdCoresPerReplica(int64_t cores_per_replica);
 void UpdateGraphExecTime(const uint64 running_time_usecs);
 void UpdateGraphPendingQueueLength(uint64 len);
 
+// Records that the executor found no pooled per-step state of the given
+// `kind` ("propagator_buffers" or "process_scratch") to reuse. In steady state
+// this counter does not increase. It does not count the per-step state that
+// is not pooled, such as the ExecutorState itself, the runner closures and
+// the node stats, so it is not a count of all per-step allocations.
+void RecordExecutorStepStatePoolMiss(const string& kind);
+
 // Records that one output of an op of type `op_name` was unused.
 void RecordUnusedOutput(const string& op_name);
 
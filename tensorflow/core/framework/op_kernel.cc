@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <mutex>  // NOLINT
@@ -1154,6 +1155,8 @@ struct KernelRegistry {
   mutex mu;
   std::unordered_multimap<string, KernelRegistration> registry
       TF_GUARDED_BY(mu);
+  // Incremented on every change to 'registry'.
+  std::atomic<uint64> generation{0};
 };
 
 #if defined(_WIN32)
@@ -1295,6 +1298,7 @@ void SetupOrDisableJit(KernelRegistry* registry) {
   for (auto& jit_kernel : jit_kernels) {
     all_kernels.insert(std::move(jit_kernel));
   }
+  registry->generation.fetch_add(1, std::memory_order_release);
 }
 
 namespace register_kernel {
@@ -1347,6 +1351,7 @@ void OpKernelRegistrar::InitInternal(const KernelDef* kernel_def,
   global_registry->registry.emplace(
       key,
       KernelRegistration(*kernel_def, kernel_class_name, std::move(factory)));
+  global_registry->generation.fetch_add(1, std::memory_order_release);
   delete kernel_def;
 }
 
@@ -1624,6 +1629,13 @@ KernelList GetFilteredRegisteredKernels(
   return kernel_list;
 }
 
+uint64 GetKernelRegistryGeneration() {
+  // Does not trigger the loading of dynamic kernels, which will increment the
+  // generation when it happens.
+  auto* registry = reinterpret_cast<KernelRegistry*>(GlobalKernelRegistry());
+  return registry->generation.load(std::memory_order_acquire);
+}
+
 KernelList GetRegisteredKernelsForOp(StringPiece op_name) {
   auto op_pred = [op_name](const KernelDef& k) { return k.op() == op_name; };
   return GetFilteredRegisteredKernels(op_pred);
@@ -1520,6 +1520,12 @@ KernelList GetFilteredRegisteredKernels(
 // Gets a list of all registered kernels for a given op
 KernelList GetRegisteredKernelsForOp(StringPiece op_name);
 
+// Returns a counter that is incremented whenever the kernel registry changes,
+// e.g. when a kernel library is loaded. Caches derived from the registered
+// kernels can compare it against the value they were built with to detect
+// that they are stale.
+uint64 GetKernelRegistryGeneration();
+
 namespace kernel_factory {
 
 // OpKernelFactory is responsible for creating OpKernels when TensorFlow needs
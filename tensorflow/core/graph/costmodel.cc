@@ -150,6 +150,7 @@ void CostModel::Ensure(int id, int num_outputs) {
     time_.resize(id + 1);
     max_mem_usage_.resize(id + 1);
     max_exec_time_.resize(id + 1);
+    online_time_estimate_.resize(id + 1);
     output_port_alloc_ids_.resize(id + 1);
   }
   if (num_outputs > 0) {
@@ -368,6 +369,21 @@ Microseconds CostModel::MaxExecutionTime(const Node* node) const {
   return max_exec_time_[id];
 }
 
+void CostModel::RecordOnlineTimeEstimate(const Node* node, Microseconds time) {
+  const int id = Id(node);
+  if (id < 0) return;
+  Ensure(id, node->num_outputs());
+  online_time_estimate_[id] = time;
+}
+
+Microseconds CostModel::OnlineTimeEstimate(const Node* node) const {
+  const int id = Id(node);
+  if (id < 0 || static_cast<size_t>(id) >= online_time_estimate_.size()) {
+    return Microseconds(0);
+  }
+  return online_time_estimate_[id];
+}
+
 void CostModel::RecordAllocationId(const Node* node, int output_slot,
                                    int64_t alloc_id) {
   const int id = Id(node);
@@ -484,6 +500,7 @@ void CostModel::InitFromGraph(const Graph& g) {
   time_.reserve(num_node_ids);
   max_mem_usage_.reserve(num_node_ids);
   max_exec_time_.reserve(num_node_ids);
+  online_time_estimate_.reserve(num_node_ids);
   output_port_alloc_ids_.reserve(num_node_ids);
 
   AddNodesToCostModel(g, this);
@@ -552,7 +569,12 @@ void CostModel::AddToCostGraphDef(const Graph* graph,
     cnode->set_temporary_memory_size(TempMemorySize(n).value());
     cnode->set_persistent_memory_size(PersistentMemorySize(n).value());
 
-    cnode->set_compute_cost(MaxExecutionTime(n).value());
+    // Prefer the traced execution time, and fall back to the online estimate
+    // of the executor for nodes that were never traced.
+    const Microseconds max_exec_time = MaxExecutionTime(n);
+    cnode->set_compute_cost(max_exec_time > Microseconds(0)
+                                ? max_exec_time.value()
+                                : OnlineTimeEstimate(n).value());
 
     // For now we treat all send nodes as final.
     // TODO(yuanbyu): Send nodes for fetches shouldn't be treated as final.
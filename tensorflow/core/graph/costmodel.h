@@ -154,6 +154,14 @@ class CostModel {
   // Returns the maximum execution time (in microseconds) of "node".
   Microseconds MaxExecutionTime(const Node* node) const;
 
+  // Records the execution time (in microseconds) of "node", as estimated
+  // online by the executor that runs it. Replaces the previous estimate.
+  void RecordOnlineTimeEstimate(const Node* node, Microseconds time);
+
+  // Returns the online execution time estimate (in microseconds) of "node",
+  // or 0 if none was recorded.
+  Microseconds OnlineTimeEstimate(const Node* node) const;
+
   // Record the unique id of the tensor generated by "output_slot" of "node".
   // Any other tensor sharing the same id will be an alias, i.e. it will share
   // the same underlying memory storage area.
@@ -212,6 +220,9 @@ class CostModel {
   // Maximum execution time
   std::vector<Microseconds> max_exec_time_;
 
+  // Execution time estimated online by the executor.
+  std::vector<Microseconds> online_time_estimate_;
+
   // Maximum memory usage
   struct MemUsage {
     MemUsage() : temp_memory_size(0), persistent_memory_size(0) {}
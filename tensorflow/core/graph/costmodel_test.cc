@@ -18,6 +18,7 @@ limitations under the License.
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "tensorflow/cc/framework/scope.h"
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
@@ -378,6 +379,54 @@ TEST(CostModelTest, RecordMaxExecutionTime) {
   EXPECT_EQ(cm.MaxExecutionTime(E), Microseconds(0));
 }
 
+TEST(CostModelTest, RecordOnlineTimeEstimate) {
+  auto graph = CreateBasicTestGraph();
+  CostModel cm(/*is_global=*/false);
+  InitModelFromGraph(*graph, cm);
+  Node* C = FindNode(*graph, "C");
+
+  EXPECT_EQ(cm.OnlineTimeEstimate(C), Microseconds(0));
+
+  cm.RecordOnlineTimeEstimate(C, Microseconds(13));
+  EXPECT_EQ(cm.OnlineTimeEstimate(C), Microseconds(13));
+  cm.RecordOnlineTimeEstimate(C, Microseconds(9));
+  EXPECT_EQ(cm.OnlineTimeEstimate(C), Microseconds(9));
+
+  // Online time estimate for unrecorded node is 0.
+  Node* E = AddNode(*graph, "E", "Mul", 2);
+  EXPECT_EQ(cm.OnlineTimeEstimate(E), Microseconds(0));
+}
+
+TEST(CostModelTest, AddOnlineTimeEstimatesToCostGraphDef) {
+  auto graph = CreateBasicTestGraph();
+  Node* C = FindNode(*graph, "C");
+  Node* D = FindNode(*graph, "D");
+  std::vector<Microseconds> estimates(graph->num_node_ids(), Microseconds(0));
+  estimates[C->id()] = Microseconds(13);
+  estimates[D->id()] = Microseconds(27);
+  CostModelManager cost_model_manager;
+  CostModel* cm = cost_model_manager.FindOrCreateCostModel(graph.get());
+  // The traced execution time takes precedence over the online estimate.
+  cm->RecordMaxExecutionTime(D, Microseconds(5));
+  cost_model_manager.AddOnlineTimeEstimates(graph.get(), estimates);
+  EXPECT_EQ(cm->OnlineTimeEstimate(C), Microseconds(13));
+
+  CostGraphDef cost_graph_def;
+  TF_ASSERT_OK(
+      cost_model_manager.AddToCostGraphDef(graph.get(), &cost_graph_def));
+  int num_checked = 0;
+  for (const CostGraphDef::Node& node : cost_graph_def.node()) {
+    if (node.name() == "C") {
+      EXPECT_EQ(node.compute_cost(), 13);
+      ++num_checked;
+    } else if (node.name() == "D") {
+      EXPECT_EQ(node.compute_cost(), 5);
+      ++num_checked;
+    }
+  }
+  EXPECT_EQ(num_checked, 2);
+}
+
 TEST(CostModelTest, RecordMemoryStats) {
   auto graph = CreateBasicTestGraph();
   CostModel cm(/*is_global=*/false);
@@ -17,14 +17,25 @@ limitations under the License.
 #define TENSORFLOW_CORE_GRAPH_ZEN_GRAPH_UTIL_H_
 #ifdef AMD_ZENDNN
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/kernel_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
@@ -40,6 +51,153 @@ inline string GetZenOpName(const string& name) {
   return string(kZenNodePrefix) + name;
 }
 
+// Data types of floating point ops supported by Zen kernels. BF16 kernels
+// use AVX512-BF16 on Zen 4 and later hosts. Whether a Zen kernel exists for a
+// given type is checked against the kernel registry.
+inline bool IsZenFloatDataType(DataType T) {
+  return T == DT_FLOAT || T == DT_BFLOAT16;
+}
+
+// Data types of quantized ops supported by Zen kernels.
+inline bool IsZenQuantizedDataType(DataType T) {
+  return T == DT_QINT8 || T == DT_QUINT8;
+}
+
+// Returns true if 'T' is allowed by the type constraint 'constraint'.
+inline bool ZenConstraintAllowsType(const KernelDef::AttrConstraint& constraint,
+                                    DataType T) {
+  const auto& allowed = constraint.allowed_values().list().type();
+  return std::find(allowed.begin(), allowed.end(), T) != allowed.end();
+}
+
+// Returns true if all type constraints of 'kernel' are satisfied by 'attrs'.
+inline bool ZenKernelConstraintsMatch(const KernelDef& kernel,
+                                      AttrSlice attrs) {
+  for (const auto& constraint : kernel.constraint()) {
+    const AttrValue* value = attrs.Find(constraint.name());
+    if (value == nullptr) {
+      return false;
+    }
+    if (value->value_case() == AttrValue::kType) {
+      if (!ZenConstraintAllowsType(constraint, value->type())) {
+        return false;
+      }
+    } else if (value->value_case() == AttrValue::kList) {
+      for (int T : value->list().type()) {
+        if (!ZenConstraintAllowsType(constraint, static_cast<DataType>(T))) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Process-wide index of the kernels registered for Zen ops, keyed by op name,
+// device type and data type. The index is an immutable snapshot built once
+// from the kernel registry, so lookups take no lock and build no key string.
+// The snapshot is rebuilt when the generation of the kernel registry changes,
+// i.e., when kernels are registered by a library loaded at runtime.
+class ZenKernelIndex {
+ public:
+  // Returns the current snapshot of the index, rebuilding it if stale.
+  static const ZenKernelIndex& Get() {
+    const uint64 generation = GetKernelRegistryGeneration();
+    const ZenKernelIndex* index = Current().load(std::memory_order_acquire);
+    if (index != nullptr && index->generation_ == generation) {
+      return *index;
+    }
+    static mutex* rebuild_mu = new mutex;
+    mutex_lock l(*rebuild_mu);
+    index = Current().load(std::memory_order_acquire);
+    if (index == nullptr || index->generation_ != generation) {
+      // Previous snapshots are never deleted, since lock-free readers may
+      // still use them. Rebuilds only happen when kernels are registered.
+      index = new ZenKernelIndex(generation);
+      Current().store(index, std::memory_order_release);
+    }
+    return *index;
+  }
+
+  // Returns true if a kernel of 'op_name' on 'device_type' accepts 'T' as
+  // attribute "T". Kernels without a constraint on "T" accept any type.
+  bool IsRegistered(absl::string_view op_name, DataType T,
+                    absl::string_view device_type) const {
+    const DeviceKernels* kernels = Find(op_name, device_type);
+    const int type = static_cast<int>(T);
+    return kernels != nullptr && type >= 0 && type < 64 &&
+           ((kernels->type_mask >> type) & 1);
+  }
+
+  // Returns true if a kernel of 'op_name' on 'device_type' has all its type
+  // constraints satisfied by 'attrs'.
+  bool IsRegistered(absl::string_view op_name, AttrSlice attrs,
+                    absl::string_view device_type) const {
+    const DeviceKernels* kernels = Find(op_name, device_type);
+    if (kernels == nullptr) {
+      return false;
+    }
+    for (const KernelDef& kernel : kernels->kernels) {
+      if (ZenKernelConstraintsMatch(kernel, attrs)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  // Kernels registered for one (op, device type) pair.
+  struct DeviceKernels {
+    // Bit i is set if a kernel accepts the DataType with value i as "T".
+    uint64_t type_mask = 0;
+    std::vector<KernelDef> kernels;
+  };
+
+  explicit ZenKernelIndex(uint64 generation) : generation_(generation) {
+    KernelList kernel_list =
+        GetFilteredRegisteredKernels([](const KernelDef& kernel) {
+          return absl::StartsWith(kernel.op(), kZenNodePrefix);
+        });
+    for (const KernelDef& kernel : kernel_list.kernel()) {
+      DeviceKernels& entry = index_[kernel.op()][kernel.device_type()];
+      uint64_t type_mask = ~uint64_t{0};
+      for (const auto& constraint : kernel.constraint()) {
+        if (constraint.name() != "T") {
+          continue;
+        }
+        type_mask = 0;
+        for (int T : constraint.allowed_values().list().type()) {
+          if (T >= 0 && T < 64) {
+            type_mask |= uint64_t{1} << T;
+          }
+        }
+      }
+      entry.type_mask |= type_mask;
+      entry.kernels.push_back(kernel);
+    }
+  }
+
+  static std::atomic<const ZenKernelIndex*>& Current() {
+    static std::atomic<const ZenKernelIndex*> current{nullptr};
+    return current;
+  }
+
+  const DeviceKernels* Find(absl::string_view op_name,
+                            absl::string_view device_type) const {
+    auto op_it = index_.find(op_name);
+    if (op_it == index_.end()) {
+      return nullptr;
+    }
+    auto device_it = op_it->second.find(device_type);
+    return device_it == op_it->second.end() ? nullptr : &device_it->second;
+  }
+
+  // Generation of the kernel registry the snapshot was built from.
+  const uint64 generation_;
+  absl::flat_hash_map<string, absl::flat_hash_map<string, DeviceKernels>>
+      index_;
+};
+
 // Check whether op name with type T is registered as Zen operator
 // that will go through name change or layout change pass.
 //
@@ -48,32 +206,174 @@ inline string GetZenOpName(const string& name) {
 // @return true if op name is registered as Zen op that will go through name
 // change or layout change pass; false otherwise.
 static inline bool IsZenOpKernelRegistered(const string& op_name, DataType T) {
-  string registered_kernels_key = op_name + string(DataType_Name(T));
-  thread_local static auto* registered_kernels_map =
-      new absl::flat_hash_map<string, bool>();
-  auto kernel_element = registered_kernels_map->find(registered_kernels_key);
-  bool kernel_registered = false;
-
-  if (kernel_element == registered_kernels_map->end()) {
-    string registered_kernels = KernelsRegisteredForOp(op_name);
-    // String returned by KernelsRegisteredForOp looks like below:
-    //
-    // Op = ZenMatMul, kernels =
-    // device='CPU'; T in [DT_FLOAT]
-    // device='CPU'; T in [DT_DOUBLE]
-
-    // If we have multiple kernels registered for the op. We need to verify
-    // our datatype
-    if (registered_kernels.find(string(DataType_Name(T))) != string::npos) {
-      kernel_registered = true;
+  return ZenKernelIndex::Get().IsRegistered(op_name, T, DEVICE_CPU);
+}
+
+// Check whether a Zen kernel is registered on CPU for op name with the type
+// attributes in 'attrs'. Unlike the DataType variant, all type constraints of
+// the kernel are matched, so ops with several type attributes (for example
+// quantized ops with Tinput, Tfilter and out_type) are handled.
+//
+// @input  op_name - name of the op.
+// @input  attrs - attributes of the node to be rewritten.
+// @return true if a CPU kernel of op name accepts 'attrs'; false otherwise.
+inline bool IsZenOpKernelRegistered(const string& op_name, AttrSlice attrs) {
+  return ZenKernelIndex::Get().IsRegistered(op_name, attrs, DEVICE_CPU);
+}
+
+// Check that a rewrite record applies to the attributes of the original op,
+// before the Zen kernel registry is consulted.
+enum class ZenRewriteCheck {
+  kAny,        // No check.
+  kFloat,      // 'T' is a float type supported by Zen kernels.
+  kQuantized,  // 'T' is a quantized type supported by Zen kernels.
+  kFusedOps,   // As kFloat, and 'fused_ops' is supported by the Zen op.
+};
+
+// How the attributes of the original op are carried over to the Zen op.
+enum class ZenAttrUpdate {
+  kCopy,         // All attributes are copied.
+  kConv2D,       // Only the attributes of the Zen Conv2D ops are copied.
+  kFusedConv2D,  // Only the attributes of the Zen _FusedConv2D ops are copied.
+};
+
+// Rewrite of a TensorFlow op to a Zen op, shared by the Zen graph rewrite
+// pass and the Zen eager op rewrite.
+struct ZenRewriteInfo {
+  string tf_op_name;
+  string zen_op_name;
+  ZenRewriteCheck check;
+  ZenAttrUpdate attr_update;
+  // Whether the rewrite is only supported for NHWC execution.
+  bool nhwc_only;
+};
+
+// Returns the Zen rewrite records, in the order they are matched.
+inline const std::vector<ZenRewriteInfo>& GetZenRewriteInfos() {
+  static const std::vector<ZenRewriteInfo>* infos = [] {
+    auto* infos = new std::vector<ZenRewriteInfo>{
+        {"Conv2D", "_ZenConv2D", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kConv2D, false},
+        {"_FusedConv2D", "_ZenFusedConv2D", ZenRewriteCheck::kFusedOps,
+         ZenAttrUpdate::kFusedConv2D, false},
+        {"DepthwiseConv2dNative", "_ZenDepthwiseConv2dNative",
+         ZenRewriteCheck::kFloat, ZenAttrUpdate::kConv2D, false},
+        {"_FusedDepthwiseConv2dNative", "_ZenFusedDepthwiseConv2dNative",
+         ZenRewriteCheck::kFusedOps, ZenAttrUpdate::kFusedConv2D, false},
+        {"MatMul", "_ZenMatMul", ZenRewriteCheck::kFloat, ZenAttrUpdate::kCopy,
+         false},
+        {"_FusedMatMul", "_ZenFusedMatMul", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, false},
+        {"BatchMatMul", "_ZenBatchMatMul", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, false},
+        {"BatchMatMulV2", "_ZenBatchMatMulV2", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, false},
+        {"MaxPool", "_ZenMaxPool", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, false},
+        {"AvgPool", "_ZenAvgPool", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, false},
+        // TF-ZenDNN supports NHWC and blocked format execution. For blocked
+        // format, the following rewrites are not supported.
+        {"Softmax", "_ZenSoftmax", ZenRewriteCheck::kFloat,
+         ZenAttrUpdate::kCopy, true},
+        {"ConjugateTranspose", "_ZenConjugateTranspose", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true},
+        {"Transpose", "_ZenTranspose", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true},
+        {"InvertPermutation", "_ZenInvertPermutation", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true},
+        {"FusedBatchNorm", "_ZenFusedBatchNorm", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true},
+        {"FusedBatchNormV2", "_ZenFusedBatchNormV2", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true},
+        {"FusedBatchNormV3", "_ZenFusedBatchNormV3", ZenRewriteCheck::kAny,
+         ZenAttrUpdate::kCopy, true}};
+    // Quantized ops. The supported combinations of Tinput, Tfilter and
+    // out_type are those of the registered Zen kernels.
+    for (const string& op_name :
+         {"QuantizedConv2D", "QuantizedConv2DAndRequantize",
+          "QuantizedConv2DWithBias", "QuantizedConv2DWithBiasAndRequantize",
+          "QuantizedConv2DAndRelu", "QuantizedConv2DAndReluAndRequantize",
+          "QuantizedConv2DWithBiasAndRelu",
+          "QuantizedConv2DWithBiasAndReluAndRequantize",
+          "QuantizedConv2DWithBiasSumAndRelu",
+          "QuantizedConv2DWithBiasSumAndReluAndRequantize",
+          "QuantizedConv2DWithBiasSignedSumAndReluAndRequantize",
+          "QuantizedMatMulWithBias", "QuantizedMatMulWithBiasAndRelu",
+          "QuantizedMatMulWithBiasAndReluAndRequantize",
+          "QuantizedMatMulWithBiasAndDequantize",
+          "QuantizedMatMulWithBiasAndRequantize"}) {
+      infos->push_back({op_name, GetZenOpName(op_name), ZenRewriteCheck::kAny,
+                        ZenAttrUpdate::kCopy, true});
+    }
+    infos->push_back({"QuantizeV2", "_ZenQuantizeV2",
+                      ZenRewriteCheck::kQuantized, ZenAttrUpdate::kCopy, true});
+    infos->push_back({"Dequantize", "_ZenDequantize",
+                      ZenRewriteCheck::kQuantized, ZenAttrUpdate::kCopy, true});
+    return infos;
+  }();
+  return *infos;
+}
+
+// Returns true if 'fused_ops' is a sequence of fused ops supported by the
+// fused Zen op 'zen_op_name'.
+inline bool IsZenFusedOpsSupported(const string& zen_op_name,
+                                   const std::vector<string>& fused_ops) {
+  using FusedOpsDb =
+      absl::flat_hash_map<string, std::vector<std::vector<string>>>;
+  static const FusedOpsDb* fused_ops_db = [] {
+    const std::vector<std::vector<string>> kFusedConv2DOps = {
+        {"BiasAdd"},
+        {"FusedBatchNorm"},
+        {"Relu"},
+        {"BiasAdd", "Relu"},
+        {"BiasAdd", "Relu6"},
+        {"BiasAdd", "Add"},
+        {"BiasAdd", "Add", "Relu"},
+        {"FusedBatchNorm", "Relu"},
+        {"FusedBatchNorm", "Relu6"}};
+    auto* db = new FusedOpsDb;
+    (*db)["_ZenFusedConv2D"] = kFusedConv2DOps;
+    (*db)["_ZenFusedDepthwiseConv2dNative"] = kFusedConv2DOps;
+    (*db)["_ZenFusedMatMul"] = {{"BiasAdd"},
+                                {"BiasAdd", "Relu"},
+                                {"BiasAdd", "Relu6"},
+                                {"BiasAdd", "Elu"},
+                                {"BiasAdd", "GeluApproximate"},
+                                {"BiasAdd", "GeluExact"}};
+    return db;
+  }();
+  auto it = fused_ops_db->find(zen_op_name);
+  if (it == fused_ops_db->end()) {
+    return false;
+  }
+  return std::find(it->second.begin(), it->second.end(), fused_ops) !=
+         it->second.end();
+}
+
+// Returns true if the op with attributes 'attrs' passes the check of the
+// rewrite record 'info'. Whether a Zen kernel is registered for the
+// attributes is checked separately with IsZenOpKernelRegistered().
+inline bool IsZenRewriteValid(const ZenRewriteInfo& info, AttrSlice attrs) {
+  if (info.check == ZenRewriteCheck::kAny) {
+    return true;
+  }
+  DataType data_type;
+  if (!TryGetNodeAttr(attrs, "T", &data_type)) {
+    return false;
+  }
+  switch (info.check) {
+    case ZenRewriteCheck::kQuantized:
+      return IsZenQuantizedDataType(data_type);
+    case ZenRewriteCheck::kFusedOps: {
+      std::vector<string> fused_ops;
+      return IsZenFloatDataType(data_type) &&
+             TryGetNodeAttr(attrs, "fused_ops", &fused_ops) &&
+             IsZenFusedOpsSupported(info.zen_op_name, fused_ops);
     }
-    registered_kernels_map->insert(
-        std::make_pair(registered_kernels_key, kernel_registered));
-  } else {
-    // Kernel is visited at least once. Return stored registration result.
-    kernel_registered = kernel_element->second;
+    default:
+      return IsZenFloatDataType(data_type);
   }
-  return kernel_registered;
 }
 
 }  // namespace zen_op_registry
@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/util/mkl_util.h"
+#include "tensorflow/core/util/weight_only_quantization.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -968,6 +969,344 @@ TEST_F(MklFusedBatchMatMul, MulAndAdd2) {
     }
 }
 
+class MklFusedAttentionTest : public MklRemapperTest {
+ public:
+  // Verifies that Softmax(query * key^T * scale + mask) * value is fused,
+  // with more queries and keys than fit into one block of the kernel.
+  template <typename T>
+  void VerifyFused(bool scale_query, bool with_mask, bool adj_y) {
+    using ::tensorflow::ops::Placeholder;
+    using normal_generator = Eigen::internal::NormalRandomGenerator<T>;
+
+    const int b0 = 2, b1 = 3, query_len = 70, key_len = 600, depth = 16,
+              value_depth = 8;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto query_shape = TensorShape({b0, b1, query_len, depth});
+    auto key_shape = adj_y ? TensorShape({b0, b1, key_len, depth})
+                           : TensorShape({b0, b1, depth, key_len});
+    auto value_shape = TensorShape({b0, b1, key_len, value_depth});
+    auto mask_shape = TensorShape({b0, 1, 1, key_len});
+
+    const DataType dtype = DataTypeToEnum<T>::v();
+    auto query = Placeholder(s.WithOpName("query"), dtype,
+                             ops::Placeholder::Shape(query_shape));
+    auto key = Placeholder(s.WithOpName("key"), dtype,
+                           ops::Placeholder::Shape(key_shape));
+    auto value = Placeholder(s.WithOpName("value"), dtype,
+                             ops::Placeholder::Shape(value_shape));
+    auto mask = Placeholder(s.WithOpName("mask"), dtype,
+                            ops::Placeholder::Shape(mask_shape));
+
+    auto scale_const = ops::Const(s.WithOpName("scale_const"), {0.25f});
+    auto scale = ops::Cast(s.WithOpName("scale"), scale_const, dtype);
+    Output scores;
+    if (scale_query) {
+      auto scaled_query = ops::Multiply(s.WithOpName("mul"), query, scale);
+      scores = ops::BatchMatMulV2(s.WithOpName("scores"), scaled_query, key,
+                                  ops::BatchMatMulV2::Attrs().AdjY(adj_y));
+    } else {
+      auto qk = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::Attrs().AdjY(adj_y));
+      scores = ops::Multiply(s.WithOpName("mul"), qk, scale);
+    }
+    if (with_mask) scores = ops::AddV2(s.WithOpName("add"), scores, mask);
+    auto probs = ops::Softmax(s.WithOpName("softmax"), scores);
+    auto attention =
+        ops::BatchMatMulV2(s.WithOpName("attention"), probs, value);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+    Tensor query_t(dtype, query_shape);
+    Tensor key_t(dtype, key_shape);
+    Tensor value_t(dtype, value_shape);
+    Tensor mask_t(dtype, mask_shape);
+    query_t.flat<T>() =
+        query_t.flat<T>().template setRandom<normal_generator>();
+    key_t.flat<T>() = key_t.flat<T>().template setRandom<normal_generator>();
+    value_t.flat<T>() =
+        value_t.flat<T>().template setRandom<normal_generator>();
+    // Masks out the last keys, like the padding of a shorter sequence.
+    auto mask_values = mask_t.tensor<T, 4>();
+    for (int b = 0; b < b0; ++b) {
+      for (int j = 0; j < key_len; ++j) {
+        mask_values(b, 0, 0, j) = T(j < key_len - 50 * (b + 1) ? 0.0f : -1e9f);
+      }
+    }
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"query", query_t},
+                 {"key", key_t},
+                 {"value", value_t},
+                 {"mask", mask_t}};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+    // Place all nodes on CPU.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE("Softmax", node.op());
+      if (node.name() == "attention") {
+        EXPECT_EQ("_MklFusedAttention", node.op());
+        ASSERT_EQ(with_mask ? 5 : 4, node.input_size());
+        EXPECT_EQ("query", node.input(0));
+        EXPECT_EQ("key", node.input(1));
+        EXPECT_EQ("value", node.input(2));
+        EXPECT_EQ("scale", node.input(3));
+        EXPECT_EQ(adj_y, node.attr().at("adj_y").b());
+        const auto fused_ops = node.attr().at("fused_ops").list().s();
+        ASSERT_EQ(with_mask ? 2 : 1, fused_ops.size());
+        EXPECT_EQ("Mul", fused_ops[0]);
+        if (with_mask) {
+          EXPECT_EQ("mask", node.input(4));
+          EXPECT_EQ("Add", fused_ops[1]);
+        }
+        found++;
+      }
+    }
+    EXPECT_EQ(1, found);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    float atol = 1e-5, rtol = 1e-5;
+    if (std::is_same<T, bfloat16>::value) {
+      atol = 5e-2;
+      rtol = 5e-2;
+    }
+    test::ExpectClose(tensors_expected[0], tensors[0], atol, rtol);
+  }
+
+  // Verifies that attention is not fused when the query broadcasts against
+  // the batch dimensions of key and value, which the kernel does not do.
+  void VerifyNotFusedWithBroadcastQuery(bool scale_query) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                             ops::Placeholder::Shape({1, 3, 8, 16}));
+    auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 3, 16, 32}));
+    auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                             ops::Placeholder::Shape({2, 3, 32, 8}));
+    auto scale = ops::Const(s.WithOpName("scale"), {0.25f});
+    Output scores;
+    if (scale_query) {
+      auto scaled_query = ops::Multiply(s.WithOpName("mul"), query, scale);
+      scores = ops::BatchMatMulV2(s.WithOpName("scores"), scaled_query, key);
+    } else {
+      auto qk = ops::BatchMatMulV2(s.WithOpName("scores"), query, key);
+      scores = ops::Multiply(s.WithOpName("mul"), qk, scale);
+    }
+    auto probs = ops::Softmax(s.WithOpName("softmax"), scores);
+    auto attention =
+        ops::BatchMatMulV2(s.WithOpName("attention"), probs, value);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE("_MklFusedAttention", node.op());
+      if (node.op() == "Softmax") found++;
+    }
+    EXPECT_EQ(1, found);
+  }
+};
+
+TEST_F(MklFusedAttentionTest, ScaleAndMask) {
+  for (const auto adj_y : {true, false}) {
+    this->VerifyFused<float>(/*scale_query=*/false, /*with_mask=*/true, adj_y);
+    this->VerifyFused<bfloat16>(/*scale_query=*/false, /*with_mask=*/true,
+                                adj_y);
+  }
+}
+
+TEST_F(MklFusedAttentionTest, ScaledQueryAndMask) {
+  this->VerifyFused<float>(/*scale_query=*/true, /*with_mask=*/true,
+                           /*adj_y=*/true);
+  this->VerifyFused<bfloat16>(/*scale_query=*/true, /*with_mask=*/true,
+                              /*adj_y=*/true);
+}
+
+TEST_F(MklFusedAttentionTest, ScaleOnly) {
+  this->VerifyFused<float>(/*scale_query=*/false, /*with_mask=*/false,
+                           /*adj_y=*/true);
+}
+
+TEST_F(MklFusedAttentionTest, BroadcastQueryIsNotFused) {
+  this->VerifyNotFusedWithBroadcastQuery(/*scale_query=*/false);
+  this->VerifyNotFusedWithBroadcastQuery(/*scale_query=*/true);
+}
+
+class MklWeightOnlyQuantizedMatMulTest : public MklRemapperTest {
+ protected:
+  void TearDown() override {
+    unsetenv("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION");
+    unsetenv("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION_GROUP_SIZE");
+  }
+
+  // Builds input * weights + bias, followed by 'activation' if not empty.
+  template <typename T>
+  GraphDef BuildGraph(const Tensor& weights, bool transpose_b,
+                      const Tensor& bias, const string& activation) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    const DataType dtype = DataTypeToEnum<T>::v();
+    auto input = Placeholder(s.WithOpName("input"), dtype);
+    auto weights_const = ops::Const(s.WithOpName("weights"), weights);
+    auto bias_const = ops::Const(s.WithOpName("bias"), bias);
+    auto matmul = ops::MatMul(s.WithOpName("matmul"), input, weights_const,
+                              ops::MatMul::Attrs().TransposeB(transpose_b));
+    Output output =
+        ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias_const);
+    if (activation == "Relu") {
+      output = ops::Relu(s.WithOpName("activation"), output);
+    } else if (activation == "Tanh") {
+      output = ops::Tanh(s.WithOpName("activation"), output);
+    }
+    ops::Identity(s.WithOpName("fetch"), output);
+
+    GraphDef graph;
+    TF_CHECK_OK(s.ToGraphDef(&graph));
+    // Place all nodes on CPU.
+    for (int i = 0; i < graph.node_size(); ++i) {
+      graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+    return graph;
+  }
+
+  // Verifies that the MatMul is rewritten and matches a MatMul with the
+  // dequantized weights. The shapes span several blocks of the kernel, and
+  // the odd number of output channels leaves half a byte of packed 4 bit
+  // weights.
+  template <typename T>
+  void VerifyQuantized(const string& type, int64_t group_size,
+                       bool transpose_b, const string& activation) {
+    using normal_generator = Eigen::internal::NormalRandomGenerator<T>;
+    setenv("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION", type.c_str(), 1);
+    setenv("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION_GROUP_SIZE",
+           std::to_string(group_size).c_str(), 1);
+    const int bits = type == "int8" ? 8 : 4;
+    const int64_t m = 3, k = 300, n = 301;
+
+    const DataType dtype = DataTypeToEnum<T>::v();
+    Tensor input(dtype, {m, k});
+    Tensor weights(dtype, transpose_b ? TensorShape({n, k})
+                                      : TensorShape({k, n}));
+    Tensor bias(dtype, {n});
+    input.flat<T>() = input.flat<T>().template setRandom<normal_generator>();
+    weights.flat<T>() =
+        weights.flat<T>().template setRandom<normal_generator>();
+    bias.flat<T>() = bias.flat<T>().template setRandom<normal_generator>();
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"input", input}};
+    item.graph = BuildGraph<T>(weights, transpose_b, bias, activation);
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+    const string fused_name = activation.empty() ? "bias_add" : "activation";
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE("weights", node.name());
+      if (node.name() == fused_name) {
+        EXPECT_EQ("_MklWeightOnlyQuantizedMatMul", node.op());
+        ASSERT_EQ(4, node.input_size());
+        EXPECT_EQ("input", node.input(0));
+        EXPECT_EQ("matmul/quantized_weights", node.input(1));
+        EXPECT_EQ("matmul/weight_scales", node.input(2));
+        EXPECT_EQ("bias", node.input(3));
+        EXPECT_EQ(bits, node.attr().at("weight_bits").i());
+        EXPECT_EQ(group_size, node.attr().at("group_size").i());
+        const auto fused_ops = node.attr().at("fused_ops").list().s();
+        ASSERT_EQ(activation.empty() ? 1 : 2, fused_ops.size());
+        EXPECT_EQ("BiasAdd", fused_ops[0]);
+        if (!activation.empty()) EXPECT_EQ(activation, fused_ops[1]);
+        found++;
+      }
+    }
+    EXPECT_EQ(1, found);
+
+    // The reference multiplies with the dequantized weights.
+    Tensor quantized, scales;
+    TF_ASSERT_OK(QuantizeWeightsForMatMul(weights, transpose_b, bits,
+                                          group_size, &quantized, &scales));
+    Tensor dequantized(DT_FLOAT, {k, n});
+    DequantizeWeightBlock(quantized.flat<int8>().data(),
+                          scales.flat<float>().data(), bits, n, group_size, 0,
+                          k, 0, n, dequantized.flat<float>().data());
+    Tensor reference_weights(dtype, {k, n});
+    reference_weights.flat<T>() = dequantized.flat<float>().cast<T>();
+    GraphDef reference = BuildGraph<T>(reference_weights,
+                                       /*transpose_b=*/false, bias, activation);
+
+    auto tensors_expected = EvaluateNodes(reference, item.fetch, item.feed);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    float atol = 1e-4, rtol = 1e-4;
+    if (std::is_same<T, bfloat16>::value) {
+      atol = 5e-2;
+      rtol = 5e-2;
+    }
+    test::ExpectClose(tensors_expected[0], tensors[0], atol, rtol);
+  }
+};
+
+TEST_F(MklWeightOnlyQuantizedMatMulTest, Int8PerChannel) {
+  for (const bool transpose_b : {false, true}) {
+    this->VerifyQuantized<float>("int8", /*group_size=*/0, transpose_b,
+                                 "Relu");
+    this->VerifyQuantized<bfloat16>("int8", /*group_size=*/0, transpose_b,
+                                    "Relu");
+  }
+}
+
+TEST_F(MklWeightOnlyQuantizedMatMulTest, Int4Grouped) {
+  for (const bool transpose_b : {false, true}) {
+    this->VerifyQuantized<float>("int4", /*group_size=*/64, transpose_b, "");
+    this->VerifyQuantized<bfloat16>("int4", /*group_size=*/64, transpose_b,
+                                    "Tanh");
+  }
+}
+
+TEST_F(MklWeightOnlyQuantizedMatMulTest, DisabledByDefault) {
+  Tensor weights(DT_FLOAT, {300, 301});
+  Tensor bias(DT_FLOAT, {301});
+  weights.flat<float>().setRandom();
+  bias.flat<float>().setRandom();
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.graph = BuildGraph<float>(weights, /*transpose_b=*/false, bias, "");
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_MklWeightOnlyQuantizedMatMul", node.op());
+  }
+}
+
 class MklRemapperSwishTest : public GrapplerTest {
  protected:
   template <DataType DTYPE>
@@ -42,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 #include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/use_cudnn.h"
+#include "tensorflow/core/util/weight_only_quantization.h"
 #include "tsl/platform/errors.h"
 #ifdef INTEL_MKL
 #include "tensorflow/core/util/mkl_heuristics.h"
@@ -74,6 +75,9 @@ namespace grappler {
 //
 // Sigmoid + Mul -> _MklSwish  // This fusion only works on Intel CPU.
 //
+// MatMul + <BiasAdd> + <Activation> with constant weights
+//   -> _MklWeightOnlyQuantizedMatMul  // Opt-in, only works on Intel CPU.
+//
 //
 // In all cases, the supported activation functions are Relu, Relu6, and Elu.
 //
@@ -106,6 +110,47 @@ constexpr char kFill[] = "fill";
 
 constexpr int kMissingIndex = -1;
 
+// MatMul weights with fewer elements are not worth quantizing.
+constexpr int64_t kMinWeightOnlyQuantizedElements = 64 * 1024;
+
+// Weight-only quantization of constant MatMul weights into
+// _MklWeightOnlyQuantizedMatMul. It changes the numerics of the model, so it
+// only happens if TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION is "int8" or "int4".
+// TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION_GROUP_SIZE is the number of rows of the
+// weights that share a scale, 0 (the default) for one scale per output
+// channel. Both are read on every run of the remapper.
+struct WeightOnlyQuantizationConfig {
+  int bits = 0;  // 0 if disabled.
+  int64_t group_size = 0;
+};
+
+WeightOnlyQuantizationConfig GetWeightOnlyQuantizationConfig() {
+  WeightOnlyQuantizationConfig config;
+  if (!IsMKLEnabled()) return config;
+  string type;
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION",
+                                   /*default_val=*/"", &type));
+  if (type == "int8") {
+    config.bits = 8;
+  } else if (type == "int4") {
+    config.bits = 4;
+  } else if (!type.empty()) {
+    LOG(WARNING) << "Ignoring TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION=" << type
+                 << ", expected int8 or int4";
+  }
+  Status status =
+      ReadInt64FromEnvVar("TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION_GROUP_SIZE",
+                          /*default_val=*/0, &config.group_size);
+  if (config.bits != 0 && (!status.ok() || config.group_size < 0)) {
+    LOG(WARNING) << "Disabling weight-only quantization, invalid "
+                 << "TF_ONEDNN_WEIGHT_ONLY_QUANTIZATION_GROUP_SIZE: "
+                 << (status.ok() ? std::to_string(config.group_size)
+                                 : status.ToString());
+    config.bits = 0;
+  }
+  return config;
+}
+
 struct RemapperContext {
   explicit RemapperContext(GrapplerItem* item, Status* status,
                            RewriterConfig::CpuLayout cpu_layout_conversion,
@@ -115,7 +160,8 @@ struct RemapperContext {
         graph_properties(*item),
         inferred_graph_properties(false),
         cpu_layout_conversion(cpu_layout_conversion),
-        xla_auto_clustering_on(xla_auto_clustering_on) {}
+        xla_auto_clustering_on(xla_auto_clustering_on),
+        weight_only_quantization(GetWeightOnlyQuantizationConfig()) {}
 
   std::unordered_set<string> nodes_to_preserve;
   utils::MutableGraphView graph_view;
@@ -123,6 +169,7 @@ struct RemapperContext {
   bool inferred_graph_properties;
   RewriterConfig::CpuLayout cpu_layout_conversion;
   bool xla_auto_clustering_on;
+  WeightOnlyQuantizationConfig weight_only_quantization;
 };
 
 // FusedBatchNorm that can be replaced with a cheaper set of primitives.
@@ -2786,6 +2833,280 @@ bool FindFusedBatchMatMul(RemapperContext* ctx, int node_index,
   return found_op_type_match;
 }
 
+// Returns true if the dimensions are known to be equal, either statically or
+// symbolically.
+bool DimsSymbolicallyEqual(const TensorShapeProto::Dim& left,
+                           const TensorShapeProto::Dim& right) {
+  return (IsKnown(left) || IsKnownSymbolically(left)) &&
+         left.size() == right.size();
+}
+
+// Matches scaled dot-product attention,
+//   BatchMatMul(Softmax(BatchMatMul(query, key) * scale + mask), value),
+// where the scale is optional and may also be applied to the query, and the
+// mask is optional. On success, 'input_node_names' holds the query, key and
+// value followed by the scale and the mask, if any, and 'fused_ops' the
+// matching fused ops of _MklFusedAttention.
+bool FindFusedAttention(RemapperContext* ctx, int node_index,
+                        std::map<string, int>* matched_nodes_map,
+                        std::set<int>* remove_node_indices,
+                        std::vector<string>* input_node_names,
+                        std::vector<string>* fused_ops) {
+  if (!IsMKLEnabled()) return false;
+
+  using utils::MatchingDirection;
+  using utils::NodeStatus;
+  using utils::OpTypePattern;
+  const NodeDef* node_def = ctx->graph_view.GetNode(node_index)->node();
+  if (!IsAnyBatchMatMul(*node_def) || node_def->op() == "BatchMatMulV3") {
+    return false;
+  }
+
+  // Softmax, optionally after the mask and the scale, over the scores.
+  enum class ScaleKind { kNone, kScores, kQuery };
+  auto make_pattern = [](ScaleKind scale_kind, bool with_mask) {
+    const string kBatchMatMul = "BatchMatMul|BatchMatMulV2";
+    OpTypePattern scores = {kBatchMatMul, "scores", NodeStatus::kRemove,
+                            {{"*", "query", NodeStatus::kRemain},
+                             {"*", "key", NodeStatus::kRemain}}};
+    if (scale_kind == ScaleKind::kQuery) {
+      scores.children[0] = {"Mul", "scale_mul", NodeStatus::kRemove,
+                            {{"*", "query", NodeStatus::kRemain},
+                             {"*", "scale", NodeStatus::kRemain}}};
+    } else if (scale_kind == ScaleKind::kScores) {
+      scores = {"Mul", "scale_mul", NodeStatus::kRemove,
+                {scores, {"*", "scale", NodeStatus::kRemain}}};
+    }
+    if (with_mask) {
+      scores = {"Add|AddV2", "mask_add", NodeStatus::kRemove,
+                {scores, {"*", "mask", NodeStatus::kRemain}}};
+    }
+    return OpTypePattern{
+        kBatchMatMul, "output", NodeStatus::kReplace,
+        {{"Softmax", "softmax", NodeStatus::kRemove, {scores}},
+         {"*", "value", NodeStatus::kRemain}}};
+  };
+
+  utils::SubGraphMatcher<MatchingDirection::kFollowInputs> graph_matcher(
+      &(ctx->graph_view));
+  bool found_op_type_match = false;
+  bool with_mask = false;
+  ScaleKind scale_kind = ScaleKind::kNone;
+  for (bool mask : {true, false}) {
+    for (ScaleKind kind :
+         {ScaleKind::kScores, ScaleKind::kQuery, ScaleKind::kNone}) {
+      matched_nodes_map->clear();
+      remove_node_indices->clear();
+      found_op_type_match = graph_matcher.GetMatchedNodes(
+          make_pattern(kind, mask), ctx->nodes_to_preserve,
+          ctx->graph_view.GetNode(node_index), matched_nodes_map,
+          remove_node_indices);
+      if (found_op_type_match) {
+        with_mask = mask;
+        scale_kind = kind;
+        break;
+      }
+    }
+    if (found_op_type_match) break;
+  }
+  if (!found_op_type_match) return false;
+
+  auto get_node = [&](const string& label) {
+    return ctx->graph_view.GetNode(matched_nodes_map->at(label))->node();
+  };
+  const NodeDef* output = get_node("output");
+  const NodeDef* scores = get_node("scores");
+  if (!NodeIsOnCpu(output) || !IsCpuCompatibleDataType(output) ||
+      !NodeIsOnCpu(scores) || !IsCpuCompatibleDataType(scores) ||
+      GetDataTypeFromAttr(*output, "T") != GetDataTypeFromAttr(*scores, "T") ||
+      output->attr().at("adj_x").b() || output->attr().at("adj_y").b() ||
+      scores->attr().at("adj_x").b()) {
+    return false;
+  }
+
+  if (!ctx->inferred_graph_properties) {
+    Status s = ctx->graph_properties.InferStatically(
+        /*assume_valid_feeds=*/true,
+        /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/false,
+        /*include_output_tensor_values=*/true);
+    if (!s.ok()) return false;
+    ctx->inferred_graph_properties = true;
+  }
+
+  // The kernel does not broadcast query, key and value, so their ranks and
+  // batch dimensions must be known to be equal.
+  const auto& scores_props =
+      ctx->graph_properties.GetInputProperties(scores->name());
+  const auto& output_props =
+      ctx->graph_properties.GetInputProperties(output->name());
+  if (scores_props.size() != 2 || output_props.size() != 2) return false;
+  const TensorShapeProto& key_shape = scores_props[1].shape();
+  const TensorShapeProto& value_shape = output_props[1].shape();
+  const TensorShapeProto& probs_shape = output_props[0].shape();
+  const int rank = Rank(probs_shape);
+  if (rank < 3 || Rank(key_shape) != rank || Rank(value_shape) != rank) {
+    return false;
+  }
+  for (int i = 0; i < rank - 2; ++i) {
+    if (!DimsSymbolicallyEqual(probs_shape.dim(i), key_shape.dim(i)) ||
+        !DimsSymbolicallyEqual(probs_shape.dim(i), value_shape.dim(i))) {
+      return false;
+    }
+  }
+
+  input_node_names->clear();
+  fused_ops->clear();
+  string query = scores->input(0);
+  const TensorShapeProto* query_shape = &scores_props[0].shape();
+  string scale;
+  if (scale_kind != ScaleKind::kNone) {
+    // Mul is commutative, so find the scalar operand by its shape.
+    const NodeDef* scale_mul = get_node("scale_mul");
+    const auto& mul_props =
+        ctx->graph_properties.GetInputProperties(scale_mul->name());
+    if (mul_props.size() != 2) return false;
+    int scale_port = -1;
+    for (int port : {1, 0}) {
+      if (NumCoefficients(mul_props[port].shape()) == 1) scale_port = port;
+    }
+    if (scale_port == -1) return false;
+    const int operand_port = 1 - scale_port;
+    if (Rank(mul_props[operand_port].shape()) != rank) return false;
+    scale = scale_mul->input(scale_port);
+    if (scale_kind == ScaleKind::kQuery) {
+      query = scale_mul->input(operand_port);
+      query_shape = &mul_props[operand_port].shape();
+    }
+  }
+  if (Rank(*query_shape) != rank) return false;
+  for (int i = 0; i < rank - 2; ++i) {
+    if (!DimsSymbolicallyEqual(probs_shape.dim(i), query_shape->dim(i))) {
+      return false;
+    }
+  }
+  string mask;
+  if (with_mask) {
+    // The mask must broadcast to the scores and not the other way around.
+    const NodeDef* mask_add = get_node("mask_add");
+    const auto& add_props =
+        ctx->graph_properties.GetInputProperties(mask_add->name());
+    if (add_props.size() != 2) return false;
+    const string inner_name =
+        get_node(scale_kind == ScaleKind::kScores ? "scale_mul" : "scores")
+            ->name();
+    const int mask_port = NodeName(mask_add->input(0)) == inner_name ? 1 : 0;
+    const TensorShapeProto& mask_shape = add_props[mask_port].shape();
+    const TensorShapeProto& logits_shape = add_props[1 - mask_port].shape();
+    if (Rank(mask_shape) != rank || Rank(logits_shape) != rank) return false;
+    for (int i = 0; i < rank; ++i) {
+      if (mask_shape.dim(i).size() != 1 &&
+          !DimsSymbolicallyEqual(mask_shape.dim(i), logits_shape.dim(i))) {
+        return false;
+      }
+    }
+    mask = mask_add->input(mask_port);
+  }
+
+  input_node_names->push_back(query);
+  input_node_names->push_back(scores->input(1));
+  input_node_names->push_back(output->input(1));
+  if (!scale.empty()) {
+    input_node_names->push_back(scale);
+    fused_ops->push_back("Mul");
+  }
+  if (!mask.empty()) {
+    input_node_names->push_back(mask);
+    fused_ops->push_back("Add");
+  }
+  return true;
+}
+
+// Matches a MatMul with constant weights, optionally followed by BiasAdd and
+// an activation, to run it on weight-only quantized weights. On success,
+// 'fused_ops' holds the matching fused ops of _MklWeightOnlyQuantizedMatMul.
+bool FindWeightOnlyQuantizedMatMul(RemapperContext* ctx, int node_index,
+                                   std::map<string, int>* matched_nodes_map,
+                                   std::set<int>* remove_node_indices,
+                                   std::vector<string>* fused_ops) {
+  if (ctx->weight_only_quantization.bits == 0) return false;
+
+  using utils::MatchingDirection;
+  using utils::NodeStatus;
+  using utils::OpTypePattern;
+  const NodeDef* node_def = ctx->graph_view.GetNode(node_index)->node();
+  const bool is_activation = IsRelu(*node_def) || IsRelu6(*node_def) ||
+                             IsElu(*node_def) || IsTanh(*node_def) ||
+                             IsSigmoid(*node_def);
+  if (!IsMatMul(*node_def) && !IsBiasAdd(*node_def) && !is_activation) {
+    return false;
+  }
+
+  OpTypePattern matmul = {"MatMul", "matmul", NodeStatus::kRemove,
+                          {{"*", "input", NodeStatus::kRemain},
+                           {"Const", "weights", NodeStatus::kRemain}}};
+  OpTypePattern bias_add = {"BiasAdd", "bias_add", NodeStatus::kRemove,
+                            {matmul, {"*", "bias", NodeStatus::kRemain}}};
+  OpTypePattern pattern;
+  if (is_activation) {
+    pattern = {node_def->op(), "activation", NodeStatus::kRemove, {bias_add}};
+  } else if (IsBiasAdd(*node_def)) {
+    pattern = bias_add;
+  } else {
+    pattern = matmul;
+  }
+  pattern.node_status = NodeStatus::kReplace;
+
+  utils::SubGraphMatcher<MatchingDirection::kFollowInputs> graph_matcher(
+      &(ctx->graph_view));
+  matched_nodes_map->clear();
+  remove_node_indices->clear();
+  if (!graph_matcher.GetMatchedNodes(pattern, ctx->nodes_to_preserve,
+                                     ctx->graph_view.GetNode(node_index),
+                                     matched_nodes_map, remove_node_indices)) {
+    return false;
+  }
+  (*matched_nodes_map)["output"] = node_index;
+
+  const NodeDef* matmul_node =
+      ctx->graph_view.GetNode(matched_nodes_map->at("matmul"))->node();
+  const DataType dtype = GetDataTypeFromAttr(*matmul_node, "T");
+  bool transpose_a = false;
+  TryGetNodeAttr(*matmul_node, "transpose_a", &transpose_a);
+  if (!NodeIsOnCpu(matmul_node) ||
+      (dtype != DT_FLOAT && dtype != DT_BFLOAT16) || transpose_a) {
+    return false;
+  }
+
+  // Only large weights are worth it, and their shape and type are checked
+  // without parsing their values.
+  const NodeDef* weights_node =
+      ctx->graph_view.GetNode(matched_nodes_map->at("weights"))->node();
+  const TensorProto& weights = weights_node->attr().at("value").tensor();
+  if (weights.dtype() != dtype ||
+      !TensorShape::IsValid(weights.tensor_shape())) {
+    return false;
+  }
+  const TensorShape weights_shape(weights.tensor_shape());
+  if (weights_shape.dims() != 2 ||
+      weights_shape.num_elements() < kMinWeightOnlyQuantizedElements) {
+    return false;
+  }
+
+  // The quantized weights are added next to the MatMul.
+  for (const char* suffix : {"quantized_weights", "weight_scales"}) {
+    if (ctx->graph_view.GetNode(
+            AddPrefixToNodeName(suffix, matmul_node->name())) != nullptr) {
+      return false;
+    }
+  }
+
+  fused_ops->clear();
+  if (matched_nodes_map->count("bias_add")) fused_ops->push_back("BiasAdd");
+  if (is_activation) fused_ops->push_back(node_def->op());
+  return true;
+}
+
 // Helper function to check if the reduction axes for a given input
 // shape align with instance normalization's mean computation.
 // Mean reduction axes for instance norm are expected to be:
@@ -4141,6 +4462,135 @@ Status AddFusedBatchMatMul(RemapperContext* ctx,
   return OkStatus();
 }
 
+Status AddFusedAttention(RemapperContext* ctx,
+                         const std::map<string, int>& matched_nodes_map,
+                         const std::set<int>& remove_node_indices,
+                         const std::vector<string>& input_node_names,
+                         const std::vector<string>& fused_ops,
+                         std::vector<bool>* invalidated_nodes,
+                         std::vector<bool>* nodes_to_delete) {
+  auto* output_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("output"))->node();
+  auto* scores_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("scores"))->node();
+
+  NodeDef fused_node;
+  fused_node.set_name(output_node->name());
+  fused_node.set_op("_MklFusedAttention");
+  fused_node.set_device(output_node->device());
+  for (const auto& name : input_node_names) fused_node.add_input(name);
+
+  auto* attr = fused_node.mutable_attr();
+  (*attr)["T"] = output_node->attr().at("T");
+  (*attr)["adj_y"] = scores_node->attr().at("adj_y");
+  SetAttrValue(fused_ops, &(*attr)["fused_ops"]);
+  SetAttrValue(static_cast<int>(fused_ops.size()), &(*attr)["num_args"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  (*invalidated_nodes)[matched_nodes_map.at("output")] = true;
+
+  for (const auto& node_idx : remove_node_indices) {
+    (*nodes_to_delete)[node_idx] = true;
+  }
+  return OkStatus();
+}
+
+Status AddWeightOnlyQuantizedMatMul(
+    RemapperContext* ctx, const std::map<string, int>& matched_nodes_map,
+    const std::set<int>& remove_node_indices,
+    const std::vector<string>& fused_ops, std::vector<bool>* invalidated_nodes,
+    std::vector<bool>* nodes_to_delete) {
+  const int output_index = matched_nodes_map.at("output");
+  const int weights_index = matched_nodes_map.at("weights");
+  const auto* output_node = ctx->graph_view.GetNode(output_index)->node();
+  const auto* matmul_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("matmul"))->node();
+  const auto* weights_view = ctx->graph_view.GetNode(weights_index);
+  const auto* weights_node = weights_view->node();
+
+  Tensor weights;
+  if (!weights.FromProto(weights_node->attr().at("value").tensor())) {
+    VLOG(2) << "Unable to read the weights of " << matmul_node->name()
+            << ", abort fusion";
+    return OkStatus();
+  }
+  const WeightOnlyQuantizationConfig& config = ctx->weight_only_quantization;
+  bool transpose_b = false;
+  TryGetNodeAttr(*matmul_node, "transpose_b", &transpose_b);
+  Tensor quantized, scales;
+  Status status =
+      QuantizeWeightsForMatMul(weights, transpose_b, config.bits,
+                               config.group_size, &quantized, &scales);
+  if (!status.ok()) {
+    VLOG(2) << "Unable to quantize the weights of " << matmul_node->name()
+            << ": " << status << ", abort fusion";
+    return OkStatus();
+  }
+
+  // The quantized weights keep the control dependencies of the original ones.
+  auto make_const = [&](const char* suffix, const Tensor& value) {
+    NodeDef node;
+    node.set_name(AddPrefixToNodeName(suffix, matmul_node->name()));
+    node.set_op("Const");
+    node.set_device(matmul_node->device());
+    for (const string& input : weights_node->input()) node.add_input(input);
+    (*node.mutable_attr())["dtype"].set_type(value.dtype());
+    value.AsProtoTensorContent(
+        (*node.mutable_attr())["value"].mutable_tensor());
+    return node;
+  };
+  NodeDef quantized_node = make_const("quantized_weights", quantized);
+  NodeDef scales_node = make_const("weight_scales", scales);
+
+  NodeDef fused_node;
+  fused_node.set_name(output_node->name());
+  fused_node.set_op("_MklWeightOnlyQuantizedMatMul");
+  fused_node.set_device(matmul_node->device());
+  fused_node.add_input(matmul_node->input(0));
+  fused_node.add_input(quantized_node.name());
+  fused_node.add_input(scales_node.name());
+  const bool has_bias = matched_nodes_map.count("bias_add") > 0;
+  if (has_bias) {
+    fused_node.add_input(
+        ctx->graph_view.GetNode(matched_nodes_map.at("bias_add"))
+            ->node()
+            ->input(1));
+  }
+
+  auto* attr = fused_node.mutable_attr();
+  (*attr)["T"] = matmul_node->attr().at("T");
+  SetAttrValue(config.bits, &(*attr)["weight_bits"]);
+  SetAttrValue(config.group_size, &(*attr)["group_size"]);
+  SetAttrValue(fused_ops, &(*attr)["fused_ops"]);
+  SetAttrValue(static_cast<int>(has_bias), &(*attr)["num_args"]);
+
+  // The float weights go away unless something else reads them.
+  const bool delete_weights =
+      weights_view->NumRegularFanouts() == 1 &&
+      weights_view->NumControlledFanouts() == 0 &&
+      !ctx->nodes_to_preserve.count(weights_node->name());
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  mutation->AddNode(std::move(quantized_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  mutation->AddNode(std::move(scales_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  mutation->AddNode(std::move(fused_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  (*invalidated_nodes)[output_index] = true;
+
+  for (const auto& node_idx : remove_node_indices) {
+    (*nodes_to_delete)[node_idx] = true;
+  }
+  if (delete_weights) (*nodes_to_delete)[weights_index] = true;
+  return OkStatus();
+}
+
 // Helper function to get data of type T from a given tensor and
 // return them in a vector and casted to type U.
 // Note - use this function only when type cast is safe from T to U.
@@ -4650,6 +5100,21 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
 
     if (IsMKLEnabled()) {
+      // Remap MatMul+BiasAdd+Activation with constant weights into the
+      // _MklWeightOnlyQuantizedMatMul, if enabled. This goes first so that the
+      // MatMul is not fused into a _FusedMatMul.
+      std::map<string, int> woq_matched_nodes_map;
+      std::set<int> woq_remove_node_indices;
+      std::vector<string> woq_fused_ops;
+      if (FindWeightOnlyQuantizedMatMul(&ctx, i, &woq_matched_nodes_map,
+                                        &woq_remove_node_indices,
+                                        &woq_fused_ops)) {
+        TF_RETURN_IF_ERROR(AddWeightOnlyQuantizedMatMul(
+            &ctx, woq_matched_nodes_map, woq_remove_node_indices,
+            woq_fused_ops, &invalidated_nodes, &nodes_to_delete));
+        continue;
+      }
+
       // Remap Conv2D+BiasAdd+Add+relu into the _FusedConv2D.
       // or Remap Conv3D+BiasAdd+Add+relu into _FusedConv3D
       if (FindContractionWithBiasAndAddActivation(
@@ -4703,6 +5168,17 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
         continue;
       }
 
+      // Remap BatchMatMul+Mul+Add+Softmax+BatchMatMul into the
+      // _MklFusedAttention.
+      std::vector<string> fused_ops;
+      if (FindFusedAttention(&ctx, i, &matched_nodes_map, &remove_node_indices,
+                             &input_node_names, &fused_ops)) {
+        TF_RETURN_IF_ERROR(AddFusedAttention(
+            &ctx, matched_nodes_map, remove_node_indices, input_node_names,
+            fused_ops, &invalidated_nodes, &nodes_to_delete));
+        continue;
+      }
+
       // Remap BatchMatMul+Mul+AddV2 into the _FusedBatchMatMul.
       matched_nodes_map.clear();
       remove_node_indices.clear();
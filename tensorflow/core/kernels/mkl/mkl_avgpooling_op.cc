@@ -47,6 +47,7 @@ class MklAvgPoolingOp : public MklPoolingForwardOpBase<T> {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& input_tensor =
           MklGetInput(context, this->kInputTensorIndexInput);
       MklDnnShape dnn_shape_input;
@@ -201,6 +202,7 @@ class MklAvgPoolingGradOp : public MklPoolingBackwardOpBase<T> {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& orig_input_tensor =
           MklGetInput(context, kInputTensorIndexInputShape);
       const Tensor& grad_tensor =
@@ -73,6 +73,7 @@ class BatchMatMulMkl : public OpKernel {
   virtual ~BatchMatMulMkl() {}
 
   void Compute(OpKernelContext* ctx) override {
+    MklPrimitivePinScope pin_scope;
     const Tensor& lhs = ctx->input(0);
     const Tensor& rhs = ctx->input(1);
 
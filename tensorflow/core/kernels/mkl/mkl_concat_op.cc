@@ -32,9 +32,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/mkl_util.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::concat;
 using dnnl::stream;
@@ -297,41 +295,15 @@ class MklConcatFwdPrimitive : public MklPrimitive {
                const dnnl::memory& dst_data,
                const MklConcatFwdParams& concat_fwd_dims,
                std::shared_ptr<stream> fwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
     DCHECK_EQ(in_data.size(), context_.data_mem.size());
+    MklMemoryBindings bindings;
     for (size_t i = 0; i < concat_fwd_dims.num_inputs; i++) {
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-      context_.data_mem_shdptr[i]->set_data_handle(
-          static_cast<void*>(in_data[i].get_data_handle()), *fwd_stream);
+      bindings.Bind(context_.data_mem_shdptr[i], in_data[i].get_data_handle());
     }
-    context_.dst_mem->set_data_handle(
-        static_cast<void*>(dst_data.get_data_handle()), *fwd_stream);
-#else
-      context_.data_mem_shdptr[i]->set_data_handle(
-          static_cast<void*>(in_data[i].get_data_handle()));
-    }
-    context_.dst_mem->set_data_handle(
-        static_cast<void*>(dst_data.get_data_handle()));
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-
-    for (size_t i = 0; i < concat_fwd_dims.num_inputs; i++) {
-      context_.data_mem[i] = *context_.data_mem_shdptr[i];
-    }
-
+    bindings.Bind(context_.dst_mem, dst_data.get_data_handle());
     execute_primitives(context_.fwd_primitives, fwd_stream,
-                       context_.fwd_primitives_args);
-
-    // After exec, set data handle back
-    context_.dst_mem->set_data_handle(DummyData);
-    for (int k = 0; k < concat_fwd_dims.num_inputs; k++) {
-      context_.data_mem_shdptr[k]->set_data_handle(DummyData);
-    }
-
-    for (size_t i = 0; i < concat_fwd_dims.num_inputs; i++) {
-      context_.data_mem[i] = *context_.data_mem_shdptr[i];
-    }
+                       context_.fwd_primitives_args, bindings);
   }
 
  private:
@@ -397,9 +369,8 @@ class MklConcatFwdPrimitive : public MklPrimitive {
 
   struct ConcatFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 // Class to create/cache the mkl concat primitives based on the
@@ -439,7 +410,7 @@ class MklConcatFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const MklConcatFwdParams& concat_fwd_dims) {
+  static MklPrimitiveKey CreateKey(const MklConcatFwdParams& concat_fwd_dims) {
     string prefix = "concat_fwd_";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -451,13 +422,13 @@ class MklConcatFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetConcatFwd(const MklConcatFwdParams& concat_fwd_dims) {
-    string key = CreateKey(concat_fwd_dims);
+    MklPrimitiveKey key = CreateKey(concat_fwd_dims);
     return this->GetOp(key);
   }
 
   void SetConcatFwd(const MklConcatFwdParams& concat_fwd_dims,
                     MklPrimitive* op) {
-    string key = CreateKey(concat_fwd_dims);
+    MklPrimitiveKey key = CreateKey(concat_fwd_dims);
     this->SetOp(key, op);
   }
 };
@@ -480,6 +451,7 @@ class MklConcatOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       auto cpu_engine = engine(engine::kind::cpu, 0);
       OpInputList input_tensors(context, 0, 0);
       GetMklInputList(context, "values", &input_tensors);
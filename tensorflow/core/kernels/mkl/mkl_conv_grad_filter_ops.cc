@@ -23,9 +23,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/mkl/mkl_conv_ops.h"
 #include "tensorflow/core/util/use_cudnn.h"
 #include "tensorflow/core/util/work_sharder.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::convolution_backward_weights;
 using dnnl::memory;
@@ -93,44 +91,16 @@ class MklConvBwdFilterPrimitive : public MklPrimitive {
   void Execute(const T* src_data, const T* diff_filter_data,
                const T* diff_bias_data, const T* diff_dst_data,
                std::shared_ptr<stream> bwd_filter_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    // TODO(intel-tf): Create a common function and avoid the duplicate code
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *bwd_filter_stream);
-    context_.diff_filter_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_filter_data)),
-        *bwd_filter_stream);
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.diff_filter_mem, diff_filter_data);
     if (diff_bias_data != nullptr) {
-      context_.diff_bias_mem->set_data_handle(
-          static_cast<void*>(const_cast<T*>(diff_bias_data)),
-          *bwd_filter_stream);
+      bindings.Bind(context_.diff_bias_mem, diff_bias_data);
     }
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)), *bwd_filter_stream);
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.diff_filter_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_filter_data)));
-    if (diff_bias_data != nullptr) {
-      context_.diff_bias_mem->set_data_handle(
-          static_cast<void*>(const_cast<T*>(diff_bias_data)));
-    }
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)));
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
+    bindings.Bind(context_.diff_dst_mem, diff_dst_data);
     execute_primitives(context_.bwd_filter_primitives, bwd_filter_stream,
-                       context_.bwd_filter_primitives_args);
-
-    context_.src_mem->set_data_handle(DummyData);
-    context_.diff_filter_mem->set_data_handle(DummyData);
-    if (diff_bias_data != nullptr) {
-      context_.diff_bias_mem->set_data_handle(DummyData);
-    }
-    context_.diff_dst_mem->set_data_handle(DummyData);
+                       context_.bwd_filter_primitives_args, bindings);
   }
 
   // Convolution backward weights without bias.
@@ -315,9 +285,8 @@ class MklConvBwdFilterPrimitive : public MklPrimitive {
 
   struct ConvBwdFilterContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -354,7 +323,8 @@ class MklConvBwdFilterPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const MklConvBwdFilterParams& convBwdFilterDims) {
+  static MklPrimitiveKey CreateKey(
+      const MklConvBwdFilterParams& convBwdFilterDims) {
     string prefix = "conv_bwd_filter";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -374,13 +344,13 @@ class MklConvBwdFilterPrimitiveFactory : public MklPrimitiveFactory<T> {
 
   MklPrimitive* GetConvBwdFilter(
       const MklConvBwdFilterParams& convBwdFilterDims) {
-    string key = CreateKey(convBwdFilterDims);
+    MklPrimitiveKey key = CreateKey(convBwdFilterDims);
     return this->GetOp(key);
   }
 
   void SetConvBwdFilter(const MklConvBwdFilterParams& convBwdFilterDims,
                         MklPrimitive* op) {
-    string key = CreateKey(convBwdFilterDims);
+    MklPrimitiveKey key = CreateKey(convBwdFilterDims);
     this->SetOp(key, op);
   }
 };
@@ -397,6 +367,7 @@ class MklConvCustomBackpropFilterOp
 
   void Compute(OpKernelContext* context) {
     try {
+      MklPrimitivePinScope pin_scope;
       // Input tensors.
       const Tensor& src_tensor = MklGetInput(context, kInputIdx);
       const Tensor& filter_tensor = MklGetInput(context, kFilterIdx);
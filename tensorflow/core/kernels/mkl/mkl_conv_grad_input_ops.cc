@@ -30,9 +30,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/mkl/mkl_conv_ops.h"
 #include "tensorflow/core/util/use_cudnn.h"
 #include "tensorflow/core/util/work_sharder.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::convolution_backward_data;
 using dnnl::prop_kind;
@@ -100,33 +98,13 @@ class MklConvBwdInputPrimitive : public MklPrimitive {
   void Execute(const T* diff_src_data, const T* filter_data,
                const T* diff_dst_data,
                std::shared_ptr<stream> bwd_input_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    // TODO(intel-tf): Create a common function and avoid the duplicate code
-    context_.diff_src_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(diff_src_data)), *bwd_input_stream);
-    context_.filter_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(filter_data)), *bwd_input_stream);
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(diff_dst_data)), *bwd_input_stream);
-#else
-    context_.diff_src_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(diff_src_data)));
-    context_.filter_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(filter_data)));
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<T*>(const_cast<T*>(diff_dst_data)));
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.diff_src_mem, diff_src_data);
+    bindings.Bind(context_.filter_mem, filter_data);
+    bindings.Bind(context_.diff_dst_mem, diff_dst_data);
     execute_primitives(context_.bwd_input_primitives, bwd_input_stream,
-                       context_.bwd_input_primitives_args);
-
-    // Set data handle back to DummyData.
-    context_.diff_src_mem->set_data_handle(DummyData);
-    context_.filter_mem->set_data_handle(DummyData);
-    context_.diff_dst_mem->set_data_handle(DummyData);
-    return;
+                       context_.bwd_input_primitives_args, bindings);
   }
 
   std::shared_ptr<ConvBwdDataPd> GetPrimitiveDesc() const {
@@ -255,9 +233,8 @@ class MklConvBwdInputPrimitive : public MklPrimitive {
   }
 
   struct ConvBwdInputContext context_;
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -294,7 +271,8 @@ class MklConvBwdInputPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const MklConvBwdInputParams& convBwdInputDims) {
+  static MklPrimitiveKey CreateKey(
+      const MklConvBwdInputParams& convBwdInputDims) {
     string prefix = "conv_bwd_input";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -317,13 +295,13 @@ class MklConvBwdInputPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetConvBwdInput(const MklConvBwdInputParams& convBwdInputDims) {
-    string key = CreateKey(convBwdInputDims);
+    MklPrimitiveKey key = CreateKey(convBwdInputDims);
     return this->GetOp(key);
   }
 
   void SetConvBwdInput(const MklConvBwdInputParams& convBwdInputDims,
                        MklPrimitive* op) {
-    string key = CreateKey(convBwdInputDims);
+    MklPrimitiveKey key = CreateKey(convBwdInputDims);
     this->SetOp(key, op);
   }
 };
@@ -339,6 +317,7 @@ class MklConvCustomBackpropInputOp
 
   void Compute(OpKernelContext* context) {
     try {
+      MklPrimitivePinScope pin_scope;
       // Input tensors.
       const Tensor& src_tensor = MklGetInput(context, kInputIdx);
       const Tensor& filter_tensor = MklGetInput(context, kFilterIdx);
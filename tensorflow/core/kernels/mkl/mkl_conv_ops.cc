@@ -21,15 +21,17 @@ limitations under the License.
 #include <algorithm>
 #include <map>
 #include <string>
+#include <typeinfo>
 #include <unordered_map>
 
+#include "absl/base/call_once.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/core/kernels/mkl/mkl_kernel_util.h"
 #include "tensorflow/core/kernels/mkl/mkl_quantized_conv_ops.h"
 #include "tensorflow/core/kernels/no_op.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
+#include "tensorflow/core/util/reordered_weight_cache.h"
 
 using dnnl::convolution_forward;
 using dnnl::prop_kind;
@@ -76,12 +78,6 @@ namespace tensorflow {
 #define SUMMAND_SCALE_S8(summand_range, output_range) summand_range / 127.0f
 #endif  // !ENABLE_ONEDNN_V3
 
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-#define FWD_STREAM , *fwd_stream
-#else
-#define FWD_STREAM
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-
 // TODO(intel-tf) Remove this once old API of quantized ops is abandoned
 namespace quantized_fusions {
 string none[] = {""};
@@ -115,7 +111,7 @@ struct MklConvFwdParams {
     string name;
     dnnl::algorithm alg;
     std::vector<float> param;
-    std::string partial_key;
+    MklPrimitiveKey partial_key;
     DataType dtype = DT_INVALID;
   };
   std::vector<PostOpParam> post_op_params;
@@ -177,74 +173,40 @@ class MklConvFwdPrimitive : public MklPrimitive {
                const Tinput* bn_offset_data, const Tinput* bn_rsqrt_data,
                const MklConvFwdParams& convFwdDims,
                std::shared_ptr<stream> fwd_stream, void* sp_data) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    // When we are using single global cache then in this case we can have
-    // multiple threads running the same primitive that we created so this
-    // should happen under the lock.
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tinput*>(src_data)) FWD_STREAM);
-    context_.filter_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tfilter*>(filter_data)) FWD_STREAM);
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.filter_mem, filter_data);
     if (bias_data != nullptr) {
-      context_.bias_mem->set_data_handle(const_cast<void*>(bias_data)
-                                             FWD_STREAM);
+      bindings.Bind(context_.bias_mem, bias_data);
     }
     auto const& post_op_params = convFwdDims.post_op_params;
     if (!post_op_params.empty()) {
       for (auto const& post_op_param : post_op_params) {
         if (post_op_param.name == "src_scale") {
-          context_.src_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.src_scale_mem, post_op_param.param.data());
         } else if (post_op_param.name == "wei_scale") {
-          context_.wei_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.wei_scale_mem, post_op_param.param.data());
         } else if (post_op_param.name == "dst_scale") {
-          context_.dst_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.dst_scale_mem, post_op_param.param.data());
         }
       }
     }
     if (bn_scale_data != nullptr) {
-      context_.bn_scale_mem->set_data_handle(
-          static_cast<void*>(const_cast<Tinput*>(bn_scale_data)) FWD_STREAM);
-      context_.bn_mean_mem->set_data_handle(
-          static_cast<void*>(const_cast<Tinput*>(bn_mean_data)) FWD_STREAM);
-      context_.bn_rsqrt_mem->set_data_handle(
-          static_cast<void*>(const_cast<Tinput*>(bn_rsqrt_data)) FWD_STREAM);
-      context_.bn_offset_mem->set_data_handle(
-          static_cast<void*>(const_cast<Tinput*>(bn_offset_data)) FWD_STREAM);
-    }
-    context_.dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<Toutput*>(dst_data)) FWD_STREAM);
+      bindings.Bind(context_.bn_scale_mem, bn_scale_data);
+      bindings.Bind(context_.bn_mean_mem, bn_mean_data);
+      bindings.Bind(context_.bn_rsqrt_mem, bn_rsqrt_data);
+      bindings.Bind(context_.bn_offset_mem, bn_offset_data);
+    }
+    bindings.Bind(context_.dst_mem, dst_data);
     if (sp_data) {
-      context_.sp_mem->set_data_handle(static_cast<void*>(sp_data) FWD_STREAM);
+      bindings.Bind(context_.sp_mem, sp_data);
     }
 
     DCHECK_EQ(context_.fwd_primitives.size(),
               context_.fwd_primitives_args.size());
-    for (size_t i = 0; i < context_.fwd_primitives.size(); ++i) {
-      context_.fwd_primitives.at(i).execute(*fwd_stream,
-                                            context_.fwd_primitives_args.at(i));
-    }
-
-    // After execution, set data handle back
-    context_.src_mem->set_data_handle(DummyData);
-    context_.filter_mem->set_data_handle(DummyData);
-    if (bias_data != nullptr) {
-      context_.bias_mem->set_data_handle(DummyData);
-    }
-    if (bn_scale_data != nullptr) {
-      context_.bn_scale_mem->set_data_handle(DummyData);
-      context_.bn_mean_mem->set_data_handle(DummyData);
-      context_.bn_rsqrt_mem->set_data_handle(DummyData);
-      context_.bn_offset_mem->set_data_handle(DummyData);
-    }
-    context_.dst_mem->set_data_handle(DummyData);
-    if (sp_data) {
-      context_.sp_mem->set_data_handle(DummyData);
-    }
+    execute_primitives(context_.fwd_primitives, fwd_stream,
+                       context_.fwd_primitives_args, bindings);
   }
 
   // Convolution forward execute without bias
@@ -582,10 +544,8 @@ class MklConvFwdPrimitive : public MklPrimitive {
 
   struct ConvFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  // Guards Execution()
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 // TODO(intel-tf): We should not require passing a type to MklPrimitiveFactory.
@@ -616,11 +576,30 @@ class MklConvFwdPrimitiveFactory : public MklPrimitiveFactory<float> {
                                    Toutput>::GetInstance()
             .SetConvFwd(convFwdDims, conv_fwd);
       }
+      if (snapshot_enabled_) {
+        RecordMklPrimitiveUse(conv_fwd, SnapshotName(),
+                              [&] { return SerializeParams(convFwdDims); });
+      }
     }
 
     return conv_fwd;
   }
 
+  // Creates and caches the primitives for `convFwdDims` with each of the
+  // given batch sizes in the background, so that runs with those batches
+  // skip creation.
+  static void WarmUp(const string& kernel_name,
+                     const MklConvFwdParams& convFwdDims,
+                     std::vector<int64_t> batches) {
+    MklPrimitiveFactory<float>::WarmUpInBackground(
+        kernel_name, std::move(batches), [convFwdDims](int64_t batch) {
+          MklConvFwdParams params = convFwdDims;
+          params.src_dims[MklDnnDims::Dim_N] = batch;
+          params.dst_dims[MklDnnDims::Dim_N] = batch;
+          Get(params, /*do_not_cache=*/false);
+        });
+  }
+
  private:
   MklConvFwdPrimitiveFactory() {}
   ~MklConvFwdPrimitiveFactory() {}
@@ -632,7 +611,85 @@ class MklConvFwdPrimitiveFactory : public MklPrimitiveFactory<float> {
     return instance_;
   }
 
-  static string CreateKey(const MklConvFwdParams& convFwdDims) {
+  // Whether the parameters of created primitives are recorded in
+  // MklPrimitiveSnapshot, which then replays them through ReplayParams().
+  static const bool snapshot_enabled_;
+
+  static string SnapshotName() {
+    return absl::StrCat("conv_fwd_", typeid(Tinput).name(), "_",
+                        typeid(Tfilter).name(), "_", typeid(Tbias).name(), "_",
+                        typeid(Toutput).name());
+  }
+
+  static string SerializeParams(const MklConvFwdParams& params) {
+    MklPrimitiveParamsWriter writer;
+    writer.AddInts(params.src_dims);
+    writer.AddInts(params.filter_dims);
+    writer.AddInts(params.bias_dims);
+    writer.AddInts(params.dst_dims);
+    writer.AddInts(params.strides);
+    writer.AddInts(params.dilations);
+    writer.AddInts(params.padding_left);
+    writer.AddInts(params.padding_right);
+    writer.AddInts(params.fuse_bn_dims);
+    writer.AddInt(static_cast<int64_t>(params.tf_fmt));
+    writer.AddInt(params.native_format);
+    writer.AddInt(params.is_depthwise);
+    writer.AddString(params.dtypes);
+    writer.AddInt(params.post_op_params.size());
+    for (const auto& post_op_param : params.post_op_params) {
+      writer.AddString(post_op_param.name);
+      writer.AddInt(static_cast<int64_t>(post_op_param.alg));
+      writer.AddFloats(post_op_param.param);
+      writer.AddString(post_op_param.partial_key.bytes());
+      writer.AddInt(post_op_param.dtype);
+    }
+    return writer.data();
+  }
+
+  static bool ReplayParams(StringPiece data) {
+    MklPrimitiveParamsReader reader(data);
+    MklConvFwdParams params({}, {}, {}, {}, {}, {}, {}, {}, {},
+                            MklTensorFormat::FORMAT_INVALID,
+                            /*native_format=*/false, /*is_depthwise=*/false);
+    int64_t tf_fmt, native_format, is_depthwise, num_post_ops;
+    if (!reader.ReadInts(&params.src_dims) ||
+        !reader.ReadInts(&params.filter_dims) ||
+        !reader.ReadInts(&params.bias_dims) ||
+        !reader.ReadInts(&params.dst_dims) ||
+        !reader.ReadInts(&params.strides) ||
+        !reader.ReadInts(&params.dilations) ||
+        !reader.ReadInts(&params.padding_left) ||
+        !reader.ReadInts(&params.padding_right) ||
+        !reader.ReadInts(&params.fuse_bn_dims) || !reader.ReadInt(&tf_fmt) ||
+        !reader.ReadInt(&native_format) || !reader.ReadInt(&is_depthwise) ||
+        !reader.ReadString(&params.dtypes) || !reader.ReadInt(&num_post_ops) ||
+        num_post_ops < 0) {
+      return false;
+    }
+    params.tf_fmt = static_cast<MklTensorFormat>(tf_fmt);
+    params.native_format = native_format != 0;
+    params.is_depthwise = is_depthwise != 0;
+    for (int64_t i = 0; i < num_post_ops; ++i) {
+      MklConvFwdParams::PostOpParam post_op_param;
+      int64_t alg, dtype;
+      string partial_key;
+      if (!reader.ReadString(&post_op_param.name) || !reader.ReadInt(&alg) ||
+          !reader.ReadFloats(&post_op_param.param) ||
+          !reader.ReadString(&partial_key) || !reader.ReadInt(&dtype)) {
+        return false;
+      }
+      post_op_param.alg = static_cast<dnnl::algorithm>(alg);
+      post_op_param.partial_key = MklPrimitiveKey(partial_key);
+      post_op_param.dtype = static_cast<DataType>(dtype);
+      params.post_op_params.push_back(std::move(post_op_param));
+    }
+    if (!reader.done()) return false;
+    Get(params, /*do_not_cache=*/false);
+    return true;
+  }
+
+  static MklPrimitiveKey CreateKey(const MklConvFwdParams& convFwdDims) {
     string prefix = "conv_fwd_";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -675,7 +732,7 @@ class MklConvFwdPrimitiveFactory : public MklPrimitiveFactory<float> {
         key_creator.AddAsKey(post_op_param.name);
         key_creator.AddAsKey(convFwdDims.fuse_bn_dims);
       } else {
-        return string("not_a_key");
+        return MklPrimitiveKey("not_a_key");
       }
     }
 
@@ -683,16 +740,21 @@ class MklConvFwdPrimitiveFactory : public MklPrimitiveFactory<float> {
   }
 
   MklPrimitive* GetConvFwd(const MklConvFwdParams& convFwdDims) {
-    string key = CreateKey(convFwdDims);
+    MklPrimitiveKey key = CreateKey(convFwdDims);
     return this->GetOp(key);
   }
 
   void SetConvFwd(const MklConvFwdParams& convFwdDims, MklPrimitive* op) {
-    string key = CreateKey(convFwdDims);
+    MklPrimitiveKey key = CreateKey(convFwdDims);
     this->SetOp(key, op);
   }
 };
 
+template <typename Tinput, typename Tfilter, typename Tbias, typename Toutput>
+const bool MklConvFwdPrimitiveFactory<Tinput, Tfilter, Tbias,
+                                      Toutput>::snapshot_enabled_ =
+    RegisterMklPrimitiveReplayer(SnapshotName(), &ReplayParams);
+
 // Base class for convolution forward operations
 template <typename Device, typename Tinput, typename Tfilter, typename Tbias,
           typename Toutput, typename Ttemp_output, typename Tpadding,
@@ -782,6 +844,7 @@ class MklConvOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       // Input tensors
       const Tensor& src_tensor = MklGetInput(context, kInputIndex_Src);
       const Tensor& filter_tensor = MklGetInput(context, kInputIndex_Filter);
@@ -976,6 +1039,16 @@ class MklConvOp : public OpKernel {
           EigenThreadPoolFromTfContext(context);
       tsl::OneDnnThreadPool eigen_tp(eigen_interface,
                                      ThreadPoolUseCallerThread());
+      // Convolutions do not pad the batch, so warm-up creates a primitive for
+      // every batch of the declared range.
+      absl::call_once(warm_up_once_, [&] {
+        int64_t lo, hi;
+        if (!do_not_cache && MklBatchBuckets::WarmUpRange(&lo, &hi)) {
+          MklConvFwdPrimitiveFactory<Tinput, Tfilter, Tbias, Ttemp_output>::
+              WarmUp(name(), convFwdDims,
+                     MklBatchBuckets::Cover(lo, hi, /*padded=*/false));
+        }
+      });
       conv_fwd =
           MklConvFwdPrimitiveFactory<Tinput, Tfilter, Tbias, Ttemp_output>::Get(
               convFwdDims, do_not_cache);
@@ -1228,18 +1301,18 @@ class MklConvOp : public OpKernel {
       // checking `fuse_biasadd_` flag.
       if (fuse_add_) {
         params.post_op_params.push_back(
-            {"sum", dnnl::algorithm::undef, {1.0}, ""});
+            {"sum", dnnl::algorithm::undef, {1.0}, MklPrimitiveKey()});
       }
       // NOTE - fuse_bn post_op entry must be before fuse_activation
       if (fuse_bn_) {
         params.post_op_params.push_back(
-            {"fuse_bn", dnnl::algorithm::undef, {1.0}, ""});
+            {"fuse_bn", dnnl::algorithm::undef, {1.0}, MklPrimitiveKey()});
       }
       if (fuse_activation_) {
         params.post_op_params.push_back({"activation",
                                          activation_alg_,
                                          {1.0, alpha_or_upbound_, beta_},
-                                         ""});
+                                         MklPrimitiveKey()});
       }
     }
   }
@@ -1368,6 +1441,7 @@ class MklConvOp : public OpKernel {
   std::vector<Tpadding> padding_list_;
   bool is_filter_const_;
   mutex mu_;
+  absl::once_flag warm_up_once_;
   Padding padding_;
   string data_format_str_;
   TensorFormat data_format_;
@@ -1424,7 +1498,12 @@ class MklConvOp : public OpKernel {
                                         filter_tf_shape, &cached_filter_data_));
 
     *filter_tensor = &cached_filter_data_;
+    CacheFilterMd(context, conv_prim_desc);
+  }
 
+  // Cache the memory descriptor (data format) of the cached filter data.
+  void CacheFilterMd(OpKernelContext* context, const ConvFwdPd& conv_prim_desc)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     memory::desc weights_desc = conv_prim_desc.weights_desc();
 #ifndef ENABLE_ONEDNN_V3
     // There is no tensor format in DNNL 1.x. So we cache the complete filter
@@ -1513,6 +1592,21 @@ class MklConvOp : public OpKernel {
     }
 #endif  // ENABLE_ONEDNN_V3
 
+    // Share the reordered filter with other kernels that reorder the same
+    // filter to the same format, e.g. in other replicas of the model.
+    ReorderedWeightCache* weight_cache = ReorderedWeightCache::Global();
+    ReorderedWeightCache::Key weight_key;
+    if (weight_cache->enabled()) {
+      weight_key.weights =
+          ReorderedWeightCache::FingerprintWeights(filter_tensor);
+      weight_key.layout =
+          GetReorderLayoutKey(filter_md, conv_fwd_pd->weights_desc());
+      if (weight_cache->Lookup(weight_key, &cached_filter_data_)) {
+        CacheFilterMd(context, *conv_fwd_pd);
+        return;
+      }
+    }
+
     // Otherwise, cache reordered filter
     filter.SetUsrMem(filter_md, &filter_tensor);
     filter.CheckReorderToOpMem(conv_fwd_pd.get()->weights_desc(),
@@ -1525,6 +1619,9 @@ class MklConvOp : public OpKernel {
     void* cached_filter_data = filter.GetTensorBuffer(filter_tensor_ptr);
     size_t cached_filter_data_size = filter.GetOpMem().get_desc().get_size();
     memcpy(cached_filter_data, filter_data, cached_filter_data_size);
+    if (weight_cache->enabled() && context->status().ok()) {
+      weight_cache->Insert(weight_key, &cached_filter_data_);
+    }
   }
 
 #ifndef ENABLE_ONEDNN_V3
@@ -2313,19 +2410,19 @@ class MklQuantizedConvOp
               "sum",
               dnnl::algorithm::undef,
               {SUMMAND_SCALE_U8(summand_range, output_range)},
-              ""};
+              MklPrimitiveKey()};
         } else {
           params.post_op_params[post_op_to_idx_["sum"]] = {
               "sum",
               dnnl::algorithm::undef,
               {SUMMAND_SCALE_S8(summand_range, output_range)},
-              ""};
+              MklPrimitiveKey()};
         }
       } else {
         params.post_op_params[post_op_to_idx_["sum"]] = {"sum",
                                                          dnnl::algorithm::undef,
                                                          {1.0},
-                                                         "",
+                                                         MklPrimitiveKey(),
 #ifdef ENABLE_ONEDNN_V3
                                                          summand_dt
 #endif  // ENABLE_ONEDNN_V3
@@ -2335,7 +2432,10 @@ class MklQuantizedConvOp
 
     if (IsFused(oneDNNFusedOps::kRelu)) {
       params.post_op_params[post_op_to_idx_["activation"]] = {
-          "activation", dnnl::algorithm::eltwise_relu, {1.0, 0.0, 0.0}, ""};
+          "activation",
+          dnnl::algorithm::eltwise_relu,
+          {1.0, 0.0, 0.0},
+          MklPrimitiveKey()};
     }
   }
 
@@ -51,6 +51,7 @@ class MklDequantizeOp : public OpKernel {
 
   void Compute(OpKernelContext* ctx) override {
     try {
+      MklPrimitivePinScope pin_scope;
       // Using CPU device
       auto cpu_engine = engine(engine::kind::cpu, 0);
 
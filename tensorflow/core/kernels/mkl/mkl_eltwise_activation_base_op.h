@@ -30,9 +30,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/util/mkl_util.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::algorithm;
 using dnnl::eltwise_forward;
@@ -100,26 +98,20 @@ class MklEltwiseFwdActivationPrimitive : public MklPrimitive {
   //   src_data:  input data buffer of src
   //   dst_data:  output data buffer of dst
   void Execute(const T* src_data, T* dst_data, OpKernelContext* op_context) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data));
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.dst_mem, dst_data);
     DCHECK_EQ(context_.fwd_primitives.size(),
               context_.fwd_primitives_args.size());
 
     std::vector<primitive> net;
     net.push_back(eltwise_forward(*context_.fwd_pd));
     std::vector<MemoryArgsMap> net_args;
-    net_args.push_back(
-        {{DNNL_ARG_SRC, *context_.src_mem}, {DNNL_ARG_DST, *context_.dst_mem}});
+    net_args.push_back(bindings.Apply({{DNNL_ARG_SRC, *context_.src_mem},
+                                       {DNNL_ARG_DST, *context_.dst_mem}}));
     // execute eltwise_fwd primitve
     ExecutePrimitive(net, &net_args, GetEngine(), op_context);
-
-    // After execution, set data handle back.
-    context_.src_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
   }
 
   std::shared_ptr<EltwiseFwdActivationPd> GetEltwiseFwdActivationPd() {
@@ -202,9 +194,8 @@ class MklEltwiseFwdActivationPrimitive : public MklPrimitive {
 
   struct EltwiseFwdActivationContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -236,7 +227,8 @@ class MklEltwiseFwdActivationPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklEltwiseFwdActivationPrimitiveFactory() {}
   ~MklEltwiseFwdActivationPrimitiveFactory() {}
 
-  static string CreateKey(const MklEltwiseFwdActivationParams<T>& fwdParams) {
+  static MklPrimitiveKey CreateKey(
+      const MklEltwiseFwdActivationParams<T>& fwdParams) {
     string prefix = "eltwise_fwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -249,13 +241,13 @@ class MklEltwiseFwdActivationPrimitiveFactory : public MklPrimitiveFactory<T> {
 
   MklPrimitive* GetEltwiseFwdActivation(
       const MklEltwiseFwdActivationParams<T>& fwdParams) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     return this->GetOp(key);
   }
 
   void SetEltwiseFwdActivation(
       const MklEltwiseFwdActivationParams<T>& fwdParams, MklPrimitive* op) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     this->SetOp(key, op);
   }
 };
@@ -272,6 +264,7 @@ class MklEltwiseFwdActivationOpBase : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& src_tensor = context->input(0);
       TensorShape src_shape = src_tensor.shape();
       if (src_tensor.dims() == 0) {
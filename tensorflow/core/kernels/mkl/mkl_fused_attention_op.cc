@@ -0,0 +1,373 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Fused scaled dot-product attention,
+//   output = Softmax(query * key^T * scale + mask) * value,
+// computed without materializing the [Lq, Lk] score matrix. The queries are
+// split into blocks of rows, and for each block the keys and values are
+// streamed through the cache in blocks, keeping a running maximum and sum of
+// the softmax per query row (online softmax, as in FlashAttention). Memory
+// traffic is thus linear in the sequence length instead of quadratic.
+
+#ifdef INTEL_MKL
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "absl/strings/str_join.h"
+#include "dnnl.hpp"
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/util/mkl_util.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using CPUDevice = Eigen::ThreadPoolDevice;
+
+namespace tensorflow {
+
+namespace {
+
+// Query rows processed together. The key block is sized so that the keys,
+// values and scores of a step stay in the L2 cache of a core.
+constexpr int64_t kQueryBlock = 64;
+constexpr int64_t kL2CacheBytes = 256 * 1024;
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+int64_t KeyBlockSize(int64_t depth, int64_t value_depth) {
+  const int64_t block =
+      kL2CacheBytes / (sizeof(float) * (depth + value_depth + kQueryBlock));
+  return std::max<int64_t>(16, std::min<int64_t>(512, block / 16 * 16));
+}
+
+// Row-major sgemm on the calling thread. The attention blocks are already
+// sharded across the intra-op threads.
+void BlockSgemm(char transa, char transb, int64_t m, int64_t n, int64_t k,
+                const float* a, int64_t lda, const float* b, int64_t ldb,
+                float beta, float* c, int64_t ldc) {
+#ifndef ENABLE_ONEDNN_OPENMP
+  dnnl::threadpool_interop::sgemm(transa, transb, m, n, k, 1.0f, a, lda, b,
+                                  ldb, beta, c, ldc, nullptr);
+#else
+  dnnl_sgemm(transa, transb, m, n, k, 1.0f, a, lda, b, ldb, beta, c, ldc);
+#endif  // !ENABLE_ONEDNN_OPENMP
+}
+
+void ToFloat(const float* src, float* dst, int64_t size) {
+  std::copy_n(src, size, dst);
+}
+
+void ToFloat(const bfloat16* src, float* dst, int64_t size) {
+  BFloat16ToFloat(src, dst, size);
+}
+
+void FromFloat(const float* src, float* dst, int64_t size) {
+  std::copy_n(src, size, dst);
+}
+
+void FromFloat(const float* src, bfloat16* dst, int64_t size) {
+  RoundFloatToBFloat16(src, dst, size);
+}
+
+// Returns a float view of the row-major [rows, cols] block at 'src' with
+// leading dimension 'ld'. Float blocks are used in place, others are
+// converted into 'buffer' and returned with leading dimension 'cols'.
+const float* LoadBlock(const float* src, int64_t rows, int64_t cols,
+                       int64_t ld, float* buffer, int64_t* block_ld) {
+  *block_ld = ld;
+  return src;
+}
+
+const float* LoadBlock(const bfloat16* src, int64_t rows, int64_t cols,
+                       int64_t ld, float* buffer, int64_t* block_ld) {
+  for (int64_t i = 0; i < rows; ++i) {
+    BFloat16ToFloat(src + i * ld, buffer + i * cols, cols);
+  }
+  *block_ld = cols;
+  return buffer;
+}
+
+}  // namespace
+
+template <typename Device, typename T>
+class MklFusedAttentionOp : public OpKernel {
+ public:
+  explicit MklFusedAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("adj_y", &adj_y_));
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+
+    for (const string& fused_op : fused_ops) {
+      if (fused_op == "Mul" && !has_scale_ && !has_mask_) {
+        has_scale_ = true;
+      } else if (fused_op == "Add" && !has_mask_) {
+        has_mask_ = true;
+      } else {
+        OP_REQUIRES(context, false,
+                    errors::Unimplemented("Unsupported fusion: [",
+                                          absl::StrJoin(fused_ops, ","), "]"));
+      }
+    }
+    OP_REQUIRES(context, num_args == has_scale_ + has_mask_,
+                errors::InvalidArgument("Expected ", has_scale_ + has_mask_,
+                                        " arguments, got ", num_args));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& query = ctx->input(kQueryIndex);
+    const Tensor& key = ctx->input(kKeyIndex);
+    const Tensor& value = ctx->input(kValueIndex);
+
+    const int rank = query.dims();
+    OP_REQUIRES(ctx, rank >= 3,
+                errors::InvalidArgument("query must be at least 3D: ",
+                                        query.shape().DebugString()));
+    OP_REQUIRES(ctx, key.dims() == rank && value.dims() == rank,
+                errors::InvalidArgument(
+                    "query, key and value must have the same rank: ",
+                    query.shape().DebugString(), " ",
+                    key.shape().DebugString(), " ",
+                    value.shape().DebugString()));
+    int64_t num_batches = 1;
+    for (int i = 0; i < rank - 2; ++i) {
+      OP_REQUIRES(
+          ctx,
+          key.dim_size(i) == query.dim_size(i) &&
+              value.dim_size(i) == query.dim_size(i),
+          errors::InvalidArgument(
+              "query, key and value must have the same batch dimensions: ",
+              query.shape().DebugString(), " ", key.shape().DebugString(),
+              " ", value.shape().DebugString()));
+      num_batches *= query.dim_size(i);
+    }
+
+    const int64_t query_len = query.dim_size(rank - 2);
+    const int64_t depth = query.dim_size(rank - 1);
+    const int64_t key_len = key.dim_size(adj_y_ ? rank - 2 : rank - 1);
+    const int64_t value_depth = value.dim_size(rank - 1);
+    OP_REQUIRES(ctx, key.dim_size(adj_y_ ? rank - 1 : rank - 2) == depth,
+                errors::InvalidArgument("key depth must match query: ",
+                                        query.shape().DebugString(), " ",
+                                        key.shape().DebugString()));
+    OP_REQUIRES(ctx, value.dim_size(rank - 2) == key_len,
+                errors::InvalidArgument("value length must match key: ",
+                                        key.shape().DebugString(), " ",
+                                        value.shape().DebugString()));
+
+    float scale = 1.0f;
+    int arg_index = kArgsIndex;
+    if (has_scale_) {
+      const Tensor& scale_tensor = ctx->input(arg_index++);
+      OP_REQUIRES(ctx, scale_tensor.NumElements() == 1,
+                  errors::InvalidArgument("scale must be a scalar: ",
+                                          scale_tensor.shape().DebugString()));
+      scale = static_cast<float>(scale_tensor.flat<T>()(0));
+    }
+
+    // The mask is broadcast to [batch..., Lq, Lk], so each of its dimensions
+    // is either 1 or the one of the scores.
+    const T* mask_data = nullptr;
+    std::vector<int64_t> mask_batch_offsets;
+    int64_t mask_row_stride = 0, mask_col_stride = 0;
+    if (has_mask_) {
+      const Tensor& mask = ctx->input(arg_index++);
+      TensorShape scores_shape = query.shape();
+      scores_shape.set_dim(rank - 1, key_len);
+      OP_REQUIRES(ctx, mask.dims() == rank,
+                  errors::InvalidArgument("mask must have the rank of query: ",
+                                          mask.shape().DebugString()));
+      std::vector<int64_t> strides(rank);
+      int64_t stride = 1;
+      for (int i = rank - 1; i >= 0; --i) {
+        OP_REQUIRES(ctx,
+                    mask.dim_size(i) == 1 ||
+                        mask.dim_size(i) == scores_shape.dim_size(i),
+                    errors::InvalidArgument(
+                        "mask ", mask.shape().DebugString(),
+                        " cannot be broadcast to the attention scores ",
+                        scores_shape.DebugString()));
+        strides[i] = mask.dim_size(i) == 1 ? 0 : stride;
+        stride *= mask.dim_size(i);
+      }
+      mask_row_stride = strides[rank - 2];
+      mask_col_stride = strides[rank - 1];
+      mask_batch_offsets.resize(num_batches);
+      for (int64_t b = 0; b < num_batches; ++b) {
+        int64_t offset = 0;
+        for (int64_t i = rank - 3, rest = b; i >= 0; --i) {
+          offset += (rest % query.dim_size(i)) * strides[i];
+          rest /= query.dim_size(i);
+        }
+        mask_batch_offsets[b] = offset;
+      }
+      mask_data = mask.flat<T>().data();
+    }
+
+    TensorShape output_shape = query.shape();
+    output_shape.set_dim(rank - 1, value_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    T* output_data = output->flat<T>().data();
+    if (key_len == 0) {
+      // Attention over no keys, like the unfused ops, yields zeros.
+      std::fill_n(output_data, output->NumElements(), T(0));
+      return;
+    }
+
+    const T* query_data = query.flat<T>().data();
+    const T* key_data = key.flat<T>().data();
+    const T* value_data = value.flat<T>().data();
+    const int64_t key_block = KeyBlockSize(depth, value_depth);
+    const int64_t num_query_blocks =
+        (query_len + kQueryBlock - 1) / kQueryBlock;
+
+    auto compute_blocks = [&](int64_t begin, int64_t end) {
+      std::vector<float> q(kQueryBlock * depth);
+      std::vector<float> k(key_block * depth);
+      std::vector<float> v(key_block * value_depth);
+      std::vector<float> scores(kQueryBlock * key_block);
+      std::vector<float> out(kQueryBlock * value_depth);
+      std::vector<float> row_max(kQueryBlock);
+      std::vector<float> row_sum(kQueryBlock);
+
+      for (int64_t unit = begin; unit < end; ++unit) {
+        const int64_t b = unit / num_query_blocks;
+        const int64_t q0 = (unit % num_query_blocks) * kQueryBlock;
+        const int64_t bq = std::min(kQueryBlock, query_len - q0);
+
+        // Folds the scale into the queries: (s * Q) K^T == s * (Q K^T).
+        ToFloat(query_data + (b * query_len + q0) * depth, q.data(),
+                bq * depth);
+        for (int64_t i = 0; i < bq * depth; ++i) q[i] *= scale;
+        std::fill_n(row_max.begin(), bq, -kInfinity);
+        std::fill_n(row_sum.begin(), bq, 0.0f);
+        std::fill_n(out.begin(), bq * value_depth, 0.0f);
+
+        const T* key_batch = key_data + b * key_len * depth;
+        const T* value_batch = value_data + b * key_len * value_depth;
+        for (int64_t k0 = 0; k0 < key_len; k0 += key_block) {
+          const int64_t bk = std::min(key_block, key_len - k0);
+
+          // scores = Q_block * K_block^T.
+          int64_t k_ld;
+          if (adj_y_) {
+            const float* k_block = LoadBlock(key_batch + k0 * depth, bk, depth,
+                                             depth, k.data(), &k_ld);
+            BlockSgemm('N', 'T', bq, bk, depth, q.data(), depth, k_block,
+                       k_ld, 0.0f, scores.data(), bk);
+          } else {
+            const float* k_block = LoadBlock(key_batch + k0, depth, bk,
+                                             key_len, k.data(), &k_ld);
+            BlockSgemm('N', 'N', bq, bk, depth, q.data(), depth, k_block,
+                       k_ld, 0.0f, scores.data(), bk);
+          }
+
+          if (mask_data != nullptr) {
+            const T* mask_block = mask_data + mask_batch_offsets[b] +
+                                  q0 * mask_row_stride + k0 * mask_col_stride;
+            for (int64_t i = 0; i < bq; ++i) {
+              float* row = scores.data() + i * bk;
+              const T* mask_row = mask_block + i * mask_row_stride;
+              for (int64_t j = 0; j < bk; ++j) {
+                row[j] += static_cast<float>(mask_row[j * mask_col_stride]);
+              }
+            }
+          }
+
+          // Online softmax: rescales what was accumulated so far to the new
+          // row maximum and turns the scores into unnormalized probabilities.
+          for (int64_t i = 0; i < bq; ++i) {
+            Eigen::Map<Eigen::ArrayXf> row(scores.data() + i * bk, bk);
+            const float new_max = std::max(row_max[i], row.maxCoeff());
+            if (new_max == -kInfinity) {
+              // All keys so far are masked out.
+              row.setZero();
+              continue;
+            }
+            const float correction = std::exp(row_max[i] - new_max);
+            row = (row - new_max).exp();
+            row_sum[i] = row_sum[i] * correction + row.sum();
+            row_max[i] = new_max;
+            Eigen::Map<Eigen::ArrayXf>(out.data() + i * value_depth,
+                                       value_depth) *= correction;
+          }
+
+          // out += P_block * V_block.
+          int64_t v_ld;
+          const float* v_block =
+              LoadBlock(value_batch + k0 * value_depth, bk, value_depth,
+                        value_depth, v.data(), &v_ld);
+          BlockSgemm('N', 'N', bq, value_depth, bk, scores.data(), bk, v_block,
+                     v_ld, 1.0f, out.data(), value_depth);
+        }
+
+        for (int64_t i = 0; i < bq; ++i) {
+          Eigen::Map<Eigen::ArrayXf>(out.data() + i * value_depth,
+                                     value_depth) /= row_sum[i];
+        }
+        FromFloat(out.data(),
+                  output_data + (b * query_len + q0) * value_depth,
+                  bq * value_depth);
+      }
+    };
+
+    const int64_t cost_per_unit =
+        2 * kQueryBlock * key_len * (depth + value_depth);
+#ifndef ENABLE_ONEDNN_OPENMP
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(ctx->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_batches * num_query_blocks, cost_per_unit, compute_blocks);
+#else
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t unit = 0; unit < num_batches * num_query_blocks; ++unit) {
+      compute_blocks(unit, unit + 1);
+    }
+#endif  // !ENABLE_ONEDNN_OPENMP
+  }
+
+ private:
+  bool adj_y_;
+  bool has_scale_ = false;
+  bool has_mask_ = false;
+  const int kQueryIndex = 0;
+  const int kKeyIndex = 1;
+  const int kValueIndex = 2;
+  const int kArgsIndex = 3;
+};
+
+#define REGISTER_FUSED_ATTENTION_CPU(T)                \
+  REGISTER_KERNEL_BUILDER(Name("_MklFusedAttention")   \
+                              .Device(DEVICE_CPU)      \
+                              .TypeConstraint<T>("T"), \
+                          MklFusedAttentionOp<CPUDevice, T>);
+
+TF_CALL_float(REGISTER_FUSED_ATTENTION_CPU);
+TF_CALL_bfloat16(REGISTER_FUSED_ATTENTION_CPU);
+
+#undef REGISTER_FUSED_ATTENTION_CPU
+
+}  // namespace tensorflow
+
+#endif  // INTEL_MKL
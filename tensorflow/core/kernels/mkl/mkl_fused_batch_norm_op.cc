@@ -24,9 +24,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/no_op.h"
 #include "tensorflow/core/util/mkl_util.h"
 #include "tensorflow/core/util/tensor_format.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 #define GET_FLAG(bn_flag) static_cast<int>(dnnl::normalization_flags::bn_flag)
 #define IS_SET(cflag) (context_.flags & GET_FLAG(cflag))
@@ -131,81 +129,32 @@ class MklFusedBatchNormFwdPrimitive : public MklPrimitive {
 #endif  // !ENABLE_ONEDNN_V3
                U* mean_data, U* variance_data,
                std::shared_ptr<stream> fwd_stream, U* workspace_data) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    // TODO(intel-tf): Create a common function and avoid the duplicate code
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *fwd_stream);
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data),
-                                      *fwd_stream);
-
-    if (IS_SET(use_scale_shift))
-      context_.scale_shift_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_shift_data)), *fwd_stream);
-
-    if ((context_.pkind == prop_kind::forward_training) ||
-        (IS_SET(use_global_stats))) {
-      context_.mean_mem->set_data_handle(static_cast<void*>(mean_data),
-                                         *fwd_stream);
-      context_.variance_mem->set_data_handle(static_cast<void*>(variance_data),
-                                             *fwd_stream);
-    }
-    if (workspace_data != nullptr) {
-      context_.ws_mem->set_data_handle(workspace_data, *fwd_stream);
-    }
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data));
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.dst_mem, dst_data);
 
     if (IS_SCALE_AND_SHIFT_FLAG_SET) {
 #ifndef ENABLE_ONEDNN_V3
-      context_.scale_shift_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_shift_data)));
+      bindings.Bind(context_.scale_shift_mem, scale_shift_data);
 #else
-      context_.scale_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_data)));
-      context_.shift_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(shift_data)));
+      bindings.Bind(context_.scale_mem, scale_data);
+      bindings.Bind(context_.shift_mem, shift_data);
 #endif  // !ENABLE_ONEDNN_V3
     }
 
     if ((context_.pkind == prop_kind::forward_training) ||
         (IS_SET(use_global_stats))) {
-      context_.mean_mem->set_data_handle(static_cast<void*>(mean_data));
-      context_.variance_mem->set_data_handle(static_cast<void*>(variance_data));
+      bindings.Bind(context_.mean_mem, mean_data);
+      bindings.Bind(context_.variance_mem, variance_data);
     }
     if (workspace_data != nullptr) {
-      context_.ws_mem->set_data_handle(workspace_data);
+      bindings.Bind(context_.ws_mem, workspace_data);
     }
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
 
     // Execute batch-normalization forward primitives.
-    execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args);
-
-    context_.src_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
-
-    if (IS_SCALE_AND_SHIFT_FLAG_SET) {
-#ifndef ENABLE_ONEDNN_V3
-      context_.scale_shift_mem->set_data_handle(DummyData);
-#else
-      context_.scale_mem->set_data_handle(DummyData);
-      context_.shift_mem->set_data_handle(DummyData);
-#endif  // !ENABLE_ONEDNN_V3
-    }
-
-    if ((context_.pkind == prop_kind::forward_training) ||
-        (IS_SET(use_global_stats))) {
-      context_.mean_mem->set_data_handle(DummyData);
-      context_.variance_mem->set_data_handle(DummyData);
-    }
-
-    if (workspace_data != nullptr) {
-      context_.ws_mem->set_data_handle(DummyData);
-    }
+    execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args,
+                       bindings);
   }
 
   memory::desc GetDstPd() const { return context_.dst_mem->get_desc(); }
@@ -416,9 +365,8 @@ class MklFusedBatchNormFwdPrimitive : public MklPrimitive {
 
   struct BatchNormFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T, typename U>
@@ -447,7 +395,7 @@ class MklFusedBatchNormFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklFusedBatchNormFwdPrimitiveFactory() {}
   ~MklFusedBatchNormFwdPrimitiveFactory() {}
 
-  static string CreateKey(const MklBatchNormFwdParams& fwdParams) {
+  static MklPrimitiveKey CreateKey(const MklBatchNormFwdParams& fwdParams) {
     string prefix = "bn_fwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -463,13 +411,13 @@ class MklFusedBatchNormFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetBatchNormFwd(const MklBatchNormFwdParams& fwdParams) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     return this->GetOp(key);
   }
 
   void SetBatchNormFwd(const MklBatchNormFwdParams& fwdParams,
                        MklPrimitive* op) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     this->SetOp(key, op);
   }
 };
@@ -542,77 +490,29 @@ class MklFusedBatchNormBwdPrimitive : public MklPrimitive {
                U* diff_scale_data, U* diff_shift_data, U* res_space_data,
 #endif  // !ENABLE_ONEDNN_V3
                std::shared_ptr<stream> bwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    // TODO(intel-tf): Create a common function and avoid the duplicate code
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *bwd_stream);
-    context_.mean_mem->set_data_handle(
-        static_cast<void*>(const_cast<U*>(mean_data)), *bwd_stream);
-    context_.variance_mem->set_data_handle(
-        static_cast<void*>(const_cast<U*>(variance_data)), *bwd_stream);
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)), *bwd_stream);
-
-    if (IS_SET(use_scale_shift)) {
-      context_.scale_shift_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_shift_data)), *bwd_stream);
-      context_.diff_scale_shift_mem->set_data_handle(
-          static_cast<void*>(diff_scale_shift_data), *bwd_stream);
-    }
-
-    context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data),
-                                           *bwd_stream);
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.mean_mem->set_data_handle(
-        static_cast<void*>(const_cast<U*>(mean_data)));
-    context_.variance_mem->set_data_handle(
-        static_cast<void*>(const_cast<U*>(variance_data)));
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)));
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.mean_mem, mean_data);
+    bindings.Bind(context_.variance_mem, variance_data);
+    bindings.Bind(context_.diff_dst_mem, diff_dst_data);
 
     if (IS_SCALE_AND_SHIFT_FLAG_SET) {
 #ifndef ENABLE_ONEDNN_V3
-      context_.scale_shift_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_shift_data)));
-      context_.diff_scale_shift_mem->set_data_handle(
-          static_cast<void*>(diff_scale_shift_data));
+      bindings.Bind(context_.scale_shift_mem, scale_shift_data);
+      bindings.Bind(context_.diff_scale_shift_mem, diff_scale_shift_data);
 #else
-      context_.scale_mem->set_data_handle(
-          static_cast<void*>(const_cast<U*>(scale_data)));
-      context_.diff_scale_mem->set_data_handle(
-          static_cast<void*>(diff_scale_data));
-      context_.diff_shift_mem->set_data_handle(
-          static_cast<void*>(diff_shift_data));
+      bindings.Bind(context_.scale_mem, scale_data);
+      bindings.Bind(context_.diff_scale_mem, diff_scale_data);
+      bindings.Bind(context_.diff_shift_mem, diff_shift_data);
 #endif  // !ENABLE_ONEDNN_V3
     }
 
-    context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data));
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
+    bindings.Bind(context_.diff_src_mem, diff_src_data);
     // Execute backward batch-normalization primitives.
     DCHECK_EQ(context_.bwd_primitives.size(), context_.net_args.size());
-    execute_primitives(context_.bwd_primitives, bwd_stream, context_.net_args);
-
-    // After execution, set data handle back to DummyData.
-    context_.src_mem->set_data_handle(DummyData);
-    context_.mean_mem->set_data_handle(DummyData);
-    context_.variance_mem->set_data_handle(DummyData);
-    context_.diff_dst_mem->set_data_handle(DummyData);
-    if (IS_SCALE_AND_SHIFT_FLAG_SET) {
-#ifndef ENABLE_ONEDNN_V3
-      context_.scale_shift_mem->set_data_handle(DummyData);
-      context_.diff_scale_shift_mem->set_data_handle(DummyData);
-#else
-      context_.scale_mem->set_data_handle(DummyData);
-      context_.diff_scale_mem->set_data_handle(DummyData);
-      context_.diff_shift_mem->set_data_handle(DummyData);
-#endif  // !ENABLE_ONEDNN_V3
-    }
-    context_.diff_src_mem->set_data_handle(DummyData);
+    execute_primitives(context_.bwd_primitives, bwd_stream, context_.net_args,
+                       bindings);
   }
 
   std::shared_ptr<BatchNormBwdPd> GetBatchNormBwdPd() const {
@@ -766,9 +666,8 @@ class MklFusedBatchNormBwdPrimitive : public MklPrimitive {
 
   struct BatchNormBwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T, typename U>
@@ -796,7 +695,7 @@ class MklFusedBatchNormBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklFusedBatchNormBwdPrimitiveFactory() {}
   ~MklFusedBatchNormBwdPrimitiveFactory() {}
 
-  static string CreateKey(const MklBatchNormBwdParams& bwdParams) {
+  static MklPrimitiveKey CreateKey(const MklBatchNormBwdParams& bwdParams) {
     string prefix = "bn_bwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -812,13 +711,13 @@ class MklFusedBatchNormBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetBatchNormBwd(const MklBatchNormBwdParams& bwdParams) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     return this->GetOp(key);
   }
 
   void SetBatchNormBwd(const MklBatchNormBwdParams& bwdParams,
                        MklPrimitive* op) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     this->SetOp(key, op);
   }
 };
@@ -868,6 +767,7 @@ class MklFusedBatchNormOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const size_t kSrcIndex = 0;       // index of src input tensor
       const size_t kScaleIndex = 1;     // index of scale tensor
       const size_t kShiftIndex = 2;     // index of shift tensor
@@ -1337,6 +1237,7 @@ class MklFusedBatchNormGradOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const size_t kDiffDstIndex = 0;        // index of diff_dst tensor
       const size_t kSrcIndex = 1;            // index of src input tensor
       const size_t kScaleIndex = 2;          // index of scale tensor
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/mkl_layout_pass.h"
 #include "tensorflow/core/graph/mkl_graph_util.h"
 #include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/util/mkl_util.h"
 #include "tensorflow/core/util/util.h"
 
 namespace tensorflow {
@@ -157,6 +158,54 @@ BM_Matmul(2000, 1, 2000, true, true);
 
 // LINT.ThenChange(//tensorflow/core/kernels/matmul_op_test.cc)
 
+// Small shapes, where the primitive cache lookup is a sizable part of the op.
+BM_Matmul(1, 16, 16, false, false);
+BM_Matmul(1, 64, 64, false, false);
+BM_Matmul(8, 64, 64, false, false);
+
+// Builds the key of a small matmul primitive and looks it up in the cache, as
+// done by each MatMul op, to report the lookup cost apart from the op cost.
+// The lookups go to a cache of the benchmark's own, of the kind the factories
+// use, so that the stub primitive never reaches the caches of the process.
+static void BM_oneDNNPrimitiveCacheLookup(
+    ::testing::benchmark::State& state) {
+  auto create_key = []() {
+    FactoryKeyCreator key_creator;
+    key_creator.AddAsKey(string("matmul_fwd_"));
+    key_creator.AddAsKey(memory::dims({1, 64}));
+    key_creator.AddAsKey(memory::dims({64, 64}));
+    key_creator.AddAsKey(memory::dims({64}));
+    key_creator.AddAsKey(memory::dims({1, 64}));
+    key_creator.AddAsKey(string("f32f32f32f32"));
+    key_creator.AddAsKey(static_cast<int>(memory::format_tag::any));
+    return key_creator.GetKey();
+  };
+  constexpr int kCapacity = 1024;
+  if (IsMklPrimitiveCacheShared()) {
+    MklSharedPrimitiveCache<MklPrimitive> cache(kCapacity,
+                                                /*capacity_bytes=*/0);
+    MklPrimitive* primitive = nullptr;
+    TF_CHECK_OK(cache.GetOp(create_key(), &primitive));
+    primitive = new MklPrimitive();
+    cache.SetOp(create_key(), primitive);
+    primitive->Unref();
+    for (auto s : state) {
+      TF_CHECK_OK(cache.GetOp(create_key(), &primitive));
+      ::tensorflow::testing::DoNotOptimize(primitive);
+      primitive->Unref();
+    }
+  } else {
+    LRUCache<MklPrimitive> cache(kCapacity);
+    cache.SetOp(create_key(), new MklPrimitive());
+    for (auto s : state) {
+      MklPrimitive* primitive = cache.GetOp(create_key());
+      ::tensorflow::testing::DoNotOptimize(primitive);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_oneDNNPrimitiveCacheLookup);
+
 }  // namespace
 }  // namespace tensorflow
 
@@ -19,6 +19,9 @@ limitations under the License.
 // Multiplication (MatMul) with bias (BiasAdd) operations.
 #if defined(INTEL_MKL)
 
+#include <algorithm>
+
+#include "absl/base/call_once.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/kernels/mkl/mkl_matmul_ops_common.h"
@@ -59,6 +62,7 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
   }
 
   void Compute(OpKernelContext* ctx) override {
+    MklPrimitivePinScope pin_scope;
     // FusedMatMul has 3 inputs: src, weights, bias
     const Tensor& src_tensor = ctx->input(this->kInputIndexSrc);
     const Tensor& weight_tensor = ctx->input(this->kInputIndexWeight);
@@ -118,11 +122,17 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
     // dims should be described like this:
     //   s[batch, k] * w^T[channel, k] + b[channel] = dst[batch, channel]
     //    [n,    ic] *    [oc,     ic] +  [oc]      =    [n,          oc]
-    memory::dims src_dims = memory::dims({batch, k});
+    //
+    // With batch bucketing the primitive is created for the bucket and run
+    // on zero-padded rows. Fused Add reads dst, so it is not padded.
+    const bool can_pad = !fuse_add_ && !src_mkl_shape.IsMklTensor();
+    const int64_t padded_batch =
+        (can_pad && batch > 0) ? MklBatchBuckets::RoundUp(batch) : batch;
+    memory::dims src_dims = memory::dims({padded_batch, k});
     // Reverse the weights dims from [k, channel] to [channel, k].
     memory::dims weight_dims = memory::dims({channel, k});
     memory::dims bias_dims = memory::dims({channel});
-    memory::dims dst_dims = memory::dims({batch, channel});
+    memory::dims dst_dims = memory::dims({padded_batch, channel});
     memory::format_tag src_format = memory::format_tag::nc;
     memory::format_tag weight_format =
         transpose_b_ ? memory::format_tag::oi : memory::format_tag::io;
@@ -141,6 +151,14 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
         EigenThreadPoolFromTfContext(ctx);
     tsl::OneDnnThreadPool eigen_tp(eigen_interface, ThreadPoolUseCallerThread(),
                                    st ? 1 : -1);
+    absl::call_once(warm_up_once_, [&] {
+      int64_t lo, hi;
+      if (MklBatchBuckets::WarmUpRange(&lo, &hi)) {
+        MklDnnMatMulFwdPrimitiveFactory<T, T, T, T, T>::WarmUp(
+            this->name(), matmul_params,
+            MklBatchBuckets::Cover(lo, hi, can_pad));
+      }
+    });
     MklDnnMatMulFwdPrimitive<T, T, T, T, T>* matmul_prim =
         MklDnnMatMulFwdPrimitiveFactory<T, T, T, T, T>::Get(matmul_params, 0);
 
@@ -223,6 +241,23 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
       T* bias_data = const_cast<T*>(bias_tensor.flat<T>().data());
       T* dst_data = const_cast<T*>(dst_tensor->flat<T>().data());
 
+      Tensor padded_src_tensor, padded_dst_tensor;
+      if (padded_batch != batch) {
+        OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::v(),
+                                               TensorShape({padded_batch, k}),
+                                               &padded_src_tensor));
+        OP_REQUIRES_OK(
+            ctx, ctx->allocate_temp(DataTypeToEnum<T>::v(),
+                                    TensorShape({padded_batch, channel}),
+                                    &padded_dst_tensor));
+        T* padded_src_data = padded_src_tensor.flat<T>().data();
+        std::copy_n(src_data, batch * k, padded_src_data);
+        std::fill(padded_src_data + batch * k,
+                  padded_src_data + padded_batch * k, T(0));
+        src_data = padded_src_data;
+        dst_data = padded_dst_tensor.flat<T>().data();
+      }
+
       // Reorder input if necessary.
       MklDnnData<T> src_mkl(&(this->cpu_engine_));
       MklDnnData<T> weight_mkl(&(this->cpu_engine_));
@@ -281,6 +316,11 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
       // Execute fused matmul op.
       matmul_prim->Execute(src_data, weight_data, bias_data, dst_data,
                            matmul_params, scratch_pad.Get(), cpu_stream);
+
+      // Keep only the rows of the real batch.
+      if (padded_batch != batch) {
+        std::copy_n(dst_data, batch * channel, dst_tensor->flat<T>().data());
+      }
     } catch (dnnl::error& e) {
       string error_msg = "Status: " + std::to_string(e.status) +
                          ", message: " + string(e.message) + ", in file " +
@@ -328,6 +368,7 @@ class MklFusedMatMulOp : public MklDnnMatMulOpBase<T, void, T> {
   bool transpose_b_;
   float leakyrelu_alpha = 0.2;
   std::vector<string> fused_ops_;
+  absl::once_flag warm_up_once_;
   const int kInputIndex_Add = 3;
   const int kOutputIndex_Dst = 0;
 };  // namespace tensorflow
@@ -19,9 +19,11 @@ limitations under the License.
 #if defined(INTEL_MKL)
 #include <memory>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "absl/strings/str_cat.h"
 #include "dnnl.hpp"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -29,9 +31,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/mkl/mkl_kernel_util.h"
 #include "tensorflow/core/util/mkl_util.h"
 #include "tensorflow/core/util/onednn_env_vars.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+#include "tensorflow/core/util/reordered_weight_cache.h"
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::inner_product_forward;
 using dnnl::primitive_attr;
@@ -60,12 +61,6 @@ namespace tensorflow {
 #define TSCALED_BIAS float
 #endif  // !ENABLE_ONEDNN_V3
 
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-#define FWD_STREAM , *fwd_stream
-#else
-#define FWD_STREAM
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-
 static Eigen::internal::CacheSizes cache_sizes = Eigen::internal::CacheSizes();
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -153,39 +148,28 @@ class MklDnnMatMulFwdPrimitive : public MklPrimitive {
                const void* bias_data, Toutput* dst_data,
                const MklDnnMatMulFwdParams& matmul_fwd_params, void* sp_data,
                std::shared_ptr<stream> fwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tinput*>(src_data)) FWD_STREAM);
-    context_.weight_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tweight*>(weight_data)) FWD_STREAM);
-    context_.bias_mem->set_data_handle(const_cast<void*>(bias_data) FWD_STREAM);
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data) FWD_STREAM);
-    context_.sp_mem->set_data_handle(sp_data FWD_STREAM);
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.weight_mem, weight_data);
+    bindings.Bind(context_.bias_mem, bias_data);
+    bindings.Bind(context_.dst_mem, dst_data);
+    bindings.Bind(context_.sp_mem, sp_data);
     auto const& post_op_params = matmul_fwd_params.post_op_params;
     if (!post_op_params.empty()) {
       for (auto const& post_op_param : post_op_params) {
         if (post_op_param.name == "src_scale") {
-          context_.src_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.src_scale_mem, post_op_param.param.data());
         } else if (post_op_param.name == "wei_scale") {
-          context_.wei_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.wei_scale_mem, post_op_param.param.data());
         } else if (post_op_param.name == "dst_scale") {
-          context_.dst_scale_mem->set_data_handle(static_cast<void*>(
-              const_cast<float*>(post_op_param.param.data())) FWD_STREAM);
+          bindings.Bind(context_.dst_scale_mem, post_op_param.param.data());
         }
       }
     }
 
-    execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args);
-
-    // After execution, set data handle back
-    context_.src_mem->set_data_handle(DummyData);
-    context_.weight_mem->set_data_handle(DummyData);
-    context_.bias_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
+    execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args,
+                       bindings);
   }
 
   std::shared_ptr<dnnl::inner_product_forward::primitive_desc>
@@ -445,10 +429,8 @@ class MklDnnMatMulFwdPrimitive : public MklPrimitive {
 
   struct MklDnnMatMulFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  // Guards Execution()
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T, typename Tinput, typename Tweight, typename Tbias,
@@ -480,10 +462,31 @@ class MklDnnMatMulFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
                                         Toutput>::GetInstance()
             .SetMklDnnMatMulFwd(mkldnn_matmul_fwd_dims, matmul_fwd);
       }
+      if (snapshot_enabled_) {
+        RecordMklPrimitiveUse(matmul_fwd, SnapshotName(), [&] {
+          return SerializeParams(mkldnn_matmul_fwd_dims);
+        });
+      }
     }
     return matmul_fwd;
   }
 
+  // Creates and caches the primitives for `mkldnn_matmul_fwd_dims` with each
+  // of the given batch sizes in the background, so that runs with those
+  // batches skip creation.
+  static void WarmUp(const string& kernel_name,
+                     const MklDnnMatMulFwdParams& mkldnn_matmul_fwd_dims,
+                     std::vector<int64_t> batches) {
+    MklPrimitiveFactory<T>::WarmUpInBackground(
+        kernel_name, std::move(batches),
+        [mkldnn_matmul_fwd_dims](int64_t batch) {
+          MklDnnMatMulFwdParams params = mkldnn_matmul_fwd_dims;
+          params.src_dims[0] = batch;
+          params.dst_dims[0] = batch;
+          Get(params, /*do_not_cache=*/false);
+        });
+  }
+
  private:
   MklDnnMatMulFwdPrimitiveFactory() {}
   ~MklDnnMatMulFwdPrimitiveFactory() {}
@@ -493,7 +496,67 @@ class MklDnnMatMulFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const MklDnnMatMulFwdParams& mkldnn_matmul_fwd_dims) {
+  // Whether the parameters of created primitives are recorded in
+  // MklPrimitiveSnapshot, which then replays them through ReplayParams().
+  static const bool snapshot_enabled_;
+
+  static string SnapshotName() {
+    return absl::StrCat("matmul_fwd_", typeid(T).name(), "_",
+                        typeid(Tinput).name(), "_", typeid(Tweight).name(),
+                        "_", typeid(Tbias).name(), "_", typeid(Toutput).name());
+  }
+
+  static string SerializeParams(const MklDnnMatMulFwdParams& params) {
+    MklPrimitiveParamsWriter writer;
+    writer.AddInts(params.src_dims);
+    writer.AddInts(params.weight_dims);
+    writer.AddInts(params.bias_dims);
+    writer.AddInts(params.dst_dims);
+    writer.AddInt(static_cast<int64_t>(params.src_format));
+    writer.AddInt(static_cast<int64_t>(params.weight_format));
+    writer.AddInt(static_cast<int64_t>(params.dst_format));
+    writer.AddString(params.dtypes);
+    writer.AddInt(params.const_weight);
+    writer.AddInt(params.post_op_params.size());
+    for (const auto& post_op_param : params.post_op_params) {
+      writer.AddString(post_op_param.name);
+      writer.AddFloats(post_op_param.param);
+    }
+    return writer.data();
+  }
+
+  static bool ReplayParams(StringPiece data) {
+    MklPrimitiveParamsReader reader(data);
+    MklDnnMatMulFwdParams params({}, {}, {}, {});
+    int64_t src_format, weight_format, dst_format, const_weight, num_post_ops;
+    if (!reader.ReadInts(&params.src_dims) ||
+        !reader.ReadInts(&params.weight_dims) ||
+        !reader.ReadInts(&params.bias_dims) ||
+        !reader.ReadInts(&params.dst_dims) || !reader.ReadInt(&src_format) ||
+        !reader.ReadInt(&weight_format) || !reader.ReadInt(&dst_format) ||
+        !reader.ReadString(&params.dtypes) || !reader.ReadInt(&const_weight) ||
+        !reader.ReadInt(&num_post_ops) || num_post_ops < 0) {
+      return false;
+    }
+    params.src_format = static_cast<memory::format_tag>(src_format);
+    params.weight_format = static_cast<memory::format_tag>(weight_format);
+    params.dst_format = static_cast<memory::format_tag>(dst_format);
+    params.const_weight = const_weight != 0;
+    for (int64_t i = 0; i < num_post_ops; ++i) {
+      MklDnnMatMulFwdParams::PostOpParam post_op_param;
+      if (!reader.ReadString(&post_op_param.name) ||
+          !reader.ReadFloats(&post_op_param.param)) {
+        return false;
+      }
+      params.post_op_params.push_back(std::move(post_op_param));
+    }
+    if (!reader.done()) return false;
+    Get(params, /*do_not_cache=*/false);
+    return true;
+  }
+
+  static MklPrimitiveKey CreateKey(
+      const MklDnnMatMulFwdParams& mkldnn_matmul_fwd_dims) {
     string prefix = "matmul_fwd_";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -532,7 +595,7 @@ class MklDnnMatMulFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
         key_creator.AddAsKey(post_op_param.name);
         key_creator.AddAsKey(post_op_param.param[0]);
       } else {
-        return string("not_a_key");
+        return MklPrimitiveKey("not_a_key");
       }
     }
     return key_creator.GetKey();
@@ -540,17 +603,23 @@ class MklDnnMatMulFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
 
   MklPrimitive* GetMklDnnMatMulFwd(
       const MklDnnMatMulFwdParams& mkldnn_matmul_fwd_dims) {
-    string key = CreateKey(mkldnn_matmul_fwd_dims);
+    MklPrimitiveKey key = CreateKey(mkldnn_matmul_fwd_dims);
     return this->GetOp(key);
   }
 
   void SetMklDnnMatMulFwd(const MklDnnMatMulFwdParams& mkldnn_matmul_fwd_dims,
                           MklPrimitive* op) {
-    string key = CreateKey(mkldnn_matmul_fwd_dims);
+    MklPrimitiveKey key = CreateKey(mkldnn_matmul_fwd_dims);
     this->SetOp(key, op);
   }
 };
 
+template <typename T, typename Tinput, typename Tweight, typename Tbias,
+          typename Toutput>
+const bool MklDnnMatMulFwdPrimitiveFactory<T, Tinput, Tweight, Tbias,
+                                           Toutput>::snapshot_enabled_ =
+    RegisterMklPrimitiveReplayer(SnapshotName(), &ReplayParams);
+
 template <class Tweight, class Tbias, class Toutput>
 class MklDnnMatMulOpBase : public OpKernel {
  public:
@@ -619,22 +688,40 @@ class MklDnnMatMulOpBase : public OpKernel {
     }
 #endif  // ENABLE_ONEDNN_V3
 
-    // reorder and cache the weight
-    weight.SetUsrMem(weight_md, &weight_tensor);
-    weight.CheckReorderToOpMem(matmul_fwd_pd.get()->weights_desc(), cpu_engine_,
-                               context);
-    weight_data = static_cast<Tweight*>(weight.GetOpMem().get_data_handle());
-
-    size_t weight_size = matmul_fwd_pd.get()->weights_desc().get_size();
-    TensorShape weight_tf_shape;
-    weight_tf_shape.AddDim(weight_size / sizeof(Tweight));
-
-    OP_REQUIRES_OK(context,
-                   context->allocate_temp(DataTypeToEnum<Tweight>::value,
-                                          weight_tf_shape, &weight_oi_));
+    // Share the reordered weight with other kernels that reorder the same
+    // weight to the same format, e.g. in other replicas of the model.
+    ReorderedWeightCache* weight_cache = ReorderedWeightCache::Global();
+    ReorderedWeightCache::Key weight_key;
+    bool is_weight_shared = false;
+    if (weight_cache->enabled()) {
+      weight_key.weights =
+          ReorderedWeightCache::FingerprintWeights(weight_tensor);
+      weight_key.layout =
+          GetReorderLayoutKey(weight_md, matmul_fwd_pd->weights_desc());
+      is_weight_shared = weight_cache->Lookup(weight_key, &weight_oi_);
+    }
 
-    void* weight_oi_t_data = weight.GetTensorBuffer(&weight_oi_);
-    memcpy(weight_oi_t_data, weight_data, weight_size);
+    if (!is_weight_shared) {
+      // reorder and cache the weight
+      weight.SetUsrMem(weight_md, &weight_tensor);
+      weight.CheckReorderToOpMem(matmul_fwd_pd.get()->weights_desc(),
+                                 cpu_engine_, context);
+      weight_data = static_cast<Tweight*>(weight.GetOpMem().get_data_handle());
+
+      size_t weight_size = matmul_fwd_pd.get()->weights_desc().get_size();
+      TensorShape weight_tf_shape;
+      weight_tf_shape.AddDim(weight_size / sizeof(Tweight));
+
+      OP_REQUIRES_OK(context,
+                     context->allocate_temp(DataTypeToEnum<Tweight>::value,
+                                            weight_tf_shape, &weight_oi_));
+
+      void* weight_oi_t_data = weight.GetTensorBuffer(&weight_oi_);
+      memcpy(weight_oi_t_data, weight_data, weight_size);
+      if (weight_cache->enabled()) {
+        weight_cache->Insert(weight_key, &weight_oi_);
+      }
+    }
 
     // cache the memory descriptor
     auto expected_md = matmul_fwd_pd->weights_desc();
@@ -811,42 +898,16 @@ class MklMatMulPrimitive : public MklPrimitive {
   void Execute(const std::shared_ptr<stream>& stream, const Tlhs* a_data,
                const Trhs* b_data, const Toutput* c_data, void* sp_data,
                void* mul_data = nullptr, void* add_data = nullptr) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    context_.a_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tlhs*>(a_data)), *stream);
-    context_.b_mem->set_data_handle(
-        static_cast<void*>(const_cast<Trhs*>(b_data)), *stream);
-    context_.c_mem->set_data_handle(
-        static_cast<void*>(const_cast<Toutput*>(c_data)), *stream);
-    context_.sp_mem->set_data_handle(sp_data, *stream);
-
-    if (mul_data != nullptr)
-      context_.mul_mem->set_data_handle(mul_data, *stream);
-    if (add_data != nullptr)
-      context_.add_mem->set_data_handle(add_data, *stream);
-#else
-    context_.a_mem->set_data_handle(
-        static_cast<void*>(const_cast<Tlhs*>(a_data)));
-    context_.b_mem->set_data_handle(
-        static_cast<void*>(const_cast<Trhs*>(b_data)));
-    context_.c_mem->set_data_handle(
-        static_cast<void*>(const_cast<Toutput*>(c_data)));
-    context_.sp_mem->set_data_handle(sp_data);
-    if (mul_data != nullptr) context_.mul_mem->set_data_handle(mul_data);
-    if (add_data != nullptr) context_.add_mem->set_data_handle(add_data);
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-    execute_primitives(context_.matmul_primitives, stream, context_.net_args);
-
-    // After execution, set data handle back
-    context_.a_mem->set_data_handle(DummyData);
-    context_.b_mem->set_data_handle(DummyData);
-    context_.c_mem->set_data_handle(DummyData);
-    context_.sp_mem->set_data_handle(DummyData);
-    if (mul_data != nullptr) context_.mul_mem->set_data_handle(DummyData);
-    if (add_data != nullptr) context_.add_mem->set_data_handle(DummyData);
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.a_mem, a_data);
+    bindings.Bind(context_.b_mem, b_data);
+    bindings.Bind(context_.c_mem, c_data);
+    bindings.Bind(context_.sp_mem, sp_data);
+    if (mul_data != nullptr) bindings.Bind(context_.mul_mem, mul_data);
+    if (add_data != nullptr) bindings.Bind(context_.add_mem, add_data);
+    execute_primitives(context_.matmul_primitives, stream, context_.net_args,
+                       bindings);
   }
 
   std::shared_ptr<dnnl::matmul::primitive_desc> GetPrimitiveDesc() const {
@@ -1011,9 +1072,8 @@ class MklMatMulPrimitive : public MklPrimitive {
   }
 
   struct MklMatMulContext context_;
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T, typename Tlhs, typename Trhs, typename Toutput>
@@ -1036,6 +1096,10 @@ class MklMatMulPrimitiveFactory : public MklPrimitiveFactory<T> {
         MklMatMulPrimitiveFactory<T, Tlhs, Trhs, Toutput>::GetInstance()
             .SetMklMatMul(params, matmul_prim);
       }
+      if (snapshot_enabled_) {
+        RecordMklPrimitiveUse(matmul_prim, SnapshotName(),
+                              [&] { return SerializeParams(params); });
+      }
     }
 
     return matmul_prim;
@@ -1050,7 +1114,67 @@ class MklMatMulPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const MklMatMulParams& params) {
+  // Whether the parameters of created primitives are recorded in
+  // MklPrimitiveSnapshot, which then replays them through ReplayParams().
+  static const bool snapshot_enabled_;
+
+  static string SnapshotName() {
+    return absl::StrCat("matmul_", typeid(T).name(), "_", typeid(Tlhs).name(),
+                        "_", typeid(Trhs).name(), "_", typeid(Toutput).name());
+  }
+
+  static string SerializeParams(const MklMatMulParams& params) {
+    MklPrimitiveParamsWriter writer;
+    writer.AddString(params.prefix);
+    writer.AddInts(params.a_dims);
+    writer.AddInts(params.b_dims);
+    writer.AddInts(params.c_dims);
+    writer.AddInts(params.a_strides);
+    writer.AddInts(params.b_strides);
+    writer.AddInts(params.c_strides);
+    writer.AddInt(params.post_op_params.size());
+    for (const auto& post_op_param : params.post_op_params) {
+      writer.AddString(post_op_param.name);
+      writer.AddFloats(post_op_param.param);
+      writer.AddInts(post_op_param.dims);
+      writer.AddInt(static_cast<int64_t>(post_op_param.data_type));
+      writer.AddInt(static_cast<int64_t>(post_op_param.format_tag));
+    }
+    return writer.data();
+  }
+
+  static bool ReplayParams(StringPiece data) {
+    MklPrimitiveParamsReader reader(data);
+    MklMatMulParams params("", {}, {}, {}, {}, {}, {});
+    int64_t num_post_ops;
+    if (!reader.ReadString(&params.prefix) ||
+        !reader.ReadInts(&params.a_dims) || !reader.ReadInts(&params.b_dims) ||
+        !reader.ReadInts(&params.c_dims) ||
+        !reader.ReadInts(&params.a_strides) ||
+        !reader.ReadInts(&params.b_strides) ||
+        !reader.ReadInts(&params.c_strides) ||
+        !reader.ReadInt(&num_post_ops) || num_post_ops < 0) {
+      return false;
+    }
+    for (int64_t i = 0; i < num_post_ops; ++i) {
+      MklMatMulParams::PostOpParam post_op_param;
+      int64_t data_type, format_tag;
+      if (!reader.ReadString(&post_op_param.name) ||
+          !reader.ReadFloats(&post_op_param.param) ||
+          !reader.ReadInts(&post_op_param.dims) ||
+          !reader.ReadInt(&data_type) || !reader.ReadInt(&format_tag)) {
+        return false;
+      }
+      post_op_param.data_type = static_cast<memory::data_type>(data_type);
+      post_op_param.format_tag = static_cast<memory::format_tag>(format_tag);
+      params.post_op_params.push_back(std::move(post_op_param));
+    }
+    if (!reader.done()) return false;
+    Get(params, /*do_not_cache=*/false);
+    return true;
+  }
+
+  static MklPrimitiveKey CreateKey(const MklMatMulParams& params) {
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(params.prefix);
     key_creator.AddAsKey(params.a_dims);
@@ -1074,23 +1198,28 @@ class MklMatMulPrimitiveFactory : public MklPrimitiveFactory<T> {
         key_creator.AddAsKey(post_op_param.name);
         key_creator.AddAsKey(post_op_param.dims);
       } else {
-        return string("not_a_key");
+        return MklPrimitiveKey("not_a_key");
       }
     }
     return key_creator.GetKey();
   }
 
   MklPrimitive* GetMklMatMul(const MklMatMulParams& params) {
-    string key = CreateKey(params);
+    MklPrimitiveKey key = CreateKey(params);
     return this->GetOp(key);
   }
 
   void SetMklMatMul(const MklMatMulParams& params, MklPrimitive* op) {
-    string key = CreateKey(params);
+    MklPrimitiveKey key = CreateKey(params);
     this->SetOp(key, op);
   }
 };
 
+template <typename T, typename Tlhs, typename Trhs, typename Toutput>
+const bool
+    MklMatMulPrimitiveFactory<T, Tlhs, Trhs, Toutput>::snapshot_enabled_ =
+        RegisterMklPrimitiveReplayer(SnapshotName(), &ReplayParams);
+
 template <typename T>
 void dnnl_gemm(char transa, char transb, int64_t m, int64_t n, int64_t k,
                float alpha, const T* a, int64_t lda, const T* b, int64_t ldb,
@@ -1120,6 +1249,7 @@ void dnnl_gemm(char transa, char transb, int64_t m, int64_t n, int64_t k,
       EigenThreadPoolFromTfContext(ctx);
   tsl::OneDnnThreadPool eigen_tp(eigen_interface, ThreadPoolUseCallerThread(),
                                  st ? 1 : -1);
+  MklPrimitivePinScope pin_scope;
   MklMatMulPrimitive<T, T, T>* matmul_prim =
       MklMatMulPrimitiveFactory<T, T, T, T>::Get(params, 0);
 
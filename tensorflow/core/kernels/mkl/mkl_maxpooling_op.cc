@@ -48,6 +48,7 @@ class MklMaxPoolingOp : public MklPoolingForwardOpBase<T> {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& input_tensor =
           MklGetInput(context, this->kInputTensorIndexInput);
       MklDnnShape dnn_shape_input;
@@ -254,6 +255,7 @@ class MklMaxPoolingGradOp : public MklPoolingBackwardOpBase<T> {
   }
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& orig_input_tensor =
           MklGetInput(context, kInputTensorIndexOrigInput);
       const Tensor& grad_tensor =
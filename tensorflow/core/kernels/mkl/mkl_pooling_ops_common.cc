@@ -101,41 +101,18 @@ template <typename T>
 void MklPoolingFwdPrimitive<T>::Execute(const T* src_data, T* dst_data,
                                         void* ws_data,
                                         std::shared_ptr<stream> fwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-  context_.src_mem->set_data_handle(
-      static_cast<void*>(const_cast<T*>(src_data)), *fwd_stream);
-  context_.dst_mem->set_data_handle(static_cast<void*>(dst_data), *fwd_stream);
+  MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+  MklMemoryBindings bindings;
+  bindings.Bind(context_.src_mem, src_data);
+  bindings.Bind(context_.dst_mem, dst_data);
   if (context_.alg_kind == dnnl::algorithm::pooling_max &&
       context_.prop_kind ==
           prop_kind::forward_training) {  // Max pooling must have workspace.
     DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(ws_data, *fwd_stream);
-  }
-#else
-  context_.src_mem->set_data_handle(
-      static_cast<void*>(const_cast<T*>(src_data)));
-  context_.dst_mem->set_data_handle(static_cast<void*>(dst_data));
-  if (context_.alg_kind == dnnl::algorithm::pooling_max &&
-      context_.prop_kind ==
-          prop_kind::forward_training) {  // Max pooling must have workspace.
-    DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(ws_data);
-  }
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-  execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args);
-
-  // Set back data handle.
-  context_.src_mem->set_data_handle(DummyData);
-  context_.dst_mem->set_data_handle(DummyData);
-  if (context_.alg_kind == dnnl::algorithm::pooling_max &&
-      context_.prop_kind ==
-          prop_kind::forward_training) {  // Max pooling must have workspace.
-    DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(DummyData);
+    bindings.Bind(context_.ws_mem, ws_data);
   }
+  execute_primitives(context_.fwd_primitives, fwd_stream, context_.net_args,
+                     bindings);
 }
 
 template class MklPoolingFwdPrimitive<float>;
@@ -216,37 +193,16 @@ template <typename T>
 void MklPoolingBwdPrimitive<T>::Execute(const T* diff_dst_data,
                                         T* diff_src_data, const void* ws_data,
                                         std::shared_ptr<stream> bwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-  context_.diff_dst_mem->set_data_handle(
-      static_cast<void*>(const_cast<T*>(diff_dst_data)), *bwd_stream);
-  context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data),
-                                         *bwd_stream);
-  if (context_.alg_kind == dnnl::algorithm::pooling_max) {
-    DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(const_cast<void*>(ws_data), *bwd_stream);
-  }
-#else
-  context_.diff_dst_mem->set_data_handle(
-      static_cast<void*>(const_cast<T*>(diff_dst_data)));
-  context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data));
-  if (context_.alg_kind == dnnl::algorithm::pooling_max) {
-    DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(const_cast<void*>(ws_data));
-  }
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-
-  execute_primitives(context_.bwd_primitives, bwd_stream, context_.net_args);
-
-  // Set back data handle.
-  context_.diff_dst_mem->set_data_handle(DummyData);
-  context_.diff_src_mem->set_data_handle(DummyData);
+  MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+  MklMemoryBindings bindings;
+  bindings.Bind(context_.diff_dst_mem, diff_dst_data);
+  bindings.Bind(context_.diff_src_mem, diff_src_data);
   if (context_.alg_kind == dnnl::algorithm::pooling_max) {
     DCHECK(ws_data != nullptr);
-    context_.ws_mem->set_data_handle(DummyData);
+    bindings.Bind(context_.ws_mem, ws_data);
   }
+  execute_primitives(context_.bwd_primitives, bwd_stream, context_.net_args,
+                     bindings);
 }
 
 template class MklPoolingBwdPrimitive<float>;
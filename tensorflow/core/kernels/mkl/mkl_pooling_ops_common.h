@@ -20,16 +20,16 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "dnnl.hpp"
 #include "tensorflow/core/framework/kernel_shape_util.h"
 #include "tensorflow/core/framework/ops_util.h"
 #include "tensorflow/core/util/mkl_util.h"
 #include "tensorflow/core/util/padding.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 namespace tensorflow {
 
@@ -177,9 +177,8 @@ class MklPoolingFwdPrimitive : public MklPrimitive {
 
   struct PoolingFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -197,6 +196,12 @@ class MklPoolingFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
       MklPoolingFwdPrimitiveFactory<T>::GetInstance().SetPoolingFwd(
           fwdParams, pooling_forward);
     }
+    // Blocked source layouts are opaque, so only primitives on plain layouts
+    // can be replayed.
+    if (snapshot_enabled_ && fwdParams.native_format) {
+      RecordMklPrimitiveUse(pooling_forward, SnapshotName(),
+                            [&] { return SerializeParams(fwdParams); });
+    }
     return pooling_forward;
   }
 
@@ -209,11 +214,69 @@ class MklPoolingFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklPoolingFwdPrimitiveFactory() {}
   ~MklPoolingFwdPrimitiveFactory() {}
 
+  // Whether the parameters of created primitives are recorded in
+  // MklPrimitiveSnapshot, which then replays them through ReplayParams().
+  static const bool snapshot_enabled_;
+
+  static string SnapshotName() {
+    return absl::StrCat("pooling_fwd_", typeid(T).name());
+  }
+
+  static string SerializeParams(const MklPoolingParams& fwdParams) {
+    MklPrimitiveParamsWriter writer;
+    writer.AddInts(fwdParams.src_dims);
+    writer.AddInts(fwdParams.dst_dims);
+    writer.AddInts(fwdParams.filter_dims);
+    writer.AddInts(fwdParams.strides);
+#ifdef ENABLE_ONEDNN_V3
+    writer.AddInts(fwdParams.dilations);
+#endif  // ENABLE_ONEDNN_V3
+    writer.AddInts(fwdParams.padding_left);
+    writer.AddInts(fwdParams.padding_right);
+    writer.AddInt(static_cast<int64_t>(fwdParams.alg_kind));
+    writer.AddInt(static_cast<int64_t>(fwdParams.prop_kind));
+    writer.AddInt(static_cast<int64_t>(fwdParams.src_format));
+    return writer.data();
+  }
+
+  static bool ReplayParams(StringPiece data) {
+    MklPrimitiveParamsReader reader(data);
+    memory::dims src_dims, dst_dims, filter_dims, strides, padding_left,
+        padding_right;
+#ifdef ENABLE_ONEDNN_V3
+    memory::dims dilations;
+#endif  // ENABLE_ONEDNN_V3
+    int64_t alg_kind, prop_kind, src_format;
+    if (!reader.ReadInts(&src_dims) || !reader.ReadInts(&dst_dims) ||
+        !reader.ReadInts(&filter_dims) || !reader.ReadInts(&strides) ||
+#ifdef ENABLE_ONEDNN_V3
+        !reader.ReadInts(&dilations) ||
+#endif  // ENABLE_ONEDNN_V3
+        !reader.ReadInts(&padding_left) || !reader.ReadInts(&padding_right) ||
+        !reader.ReadInt(&alg_kind) || !reader.ReadInt(&prop_kind) ||
+        !reader.ReadInt(&src_format) || !reader.done()) {
+      return false;
+    }
+    const auto format = static_cast<memory::format_tag>(src_format);
+    MklPoolingParams fwdParams(
+#ifndef ENABLE_ONEDNN_V3
+        src_dims, dst_dims, filter_dims, strides,
+#else
+        src_dims, dst_dims, filter_dims, strides, dilations,
+#endif  // !ENABLE_ONEDNN_V3
+        padding_left, padding_right, static_cast<dnnl::algorithm>(alg_kind),
+        static_cast<dnnl::prop_kind>(prop_kind), format,
+        memory::desc(src_dims, MklDnnType<T>(), format),
+        /*native_format=*/true);
+    Get(fwdParams);
+    return true;
+  }
+
   // The key to be created will be used to get/set pooling
   // primitive op from reuse perspective.
   // A pooling key is a string which concates key parameters
   // as well as algorithm kind (max versus avg).
-  static string CreateKey(const MklPoolingParams& fwdParams) {
+  static MklPrimitiveKey CreateKey(const MklPoolingParams& fwdParams) {
     string prefix = "pooling_fwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -232,16 +295,20 @@ class MklPoolingFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetPoolingFwd(const MklPoolingParams& fwdParams) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     return this->GetOp(key);
   }
 
   void SetPoolingFwd(const MklPoolingParams& fwdParams, MklPrimitive* op) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     this->SetOp(key, op);
   }
 };
 
+template <typename T>
+const bool MklPoolingFwdPrimitiveFactory<T>::snapshot_enabled_ =
+    RegisterMklPrimitiveReplayer(SnapshotName(), &ReplayParams);
+
 template <typename T>
 class MklPoolingBwdPrimitive : public MklPrimitive {
  public:
@@ -332,9 +399,8 @@ class MklPoolingBwdPrimitive : public MklPrimitive {
   };
 
   struct PoolingBwdContext context_;
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -369,7 +435,7 @@ class MklPoolingBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   // primitive op from reuse perspective.
   // A pooling key is a string which concates key parameters
   // as well as algorithm kind (max versus avg).
-  static string CreateKey(const MklPoolingParams& bwdParams) {
+  static MklPrimitiveKey CreateKey(const MklPoolingParams& bwdParams) {
     string prefix = "pooling_bwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -387,12 +453,12 @@ class MklPoolingBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetPoolingBwd(const MklPoolingParams& bwdParams) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     return this->GetOp(key);
   }
 
   void SetPoolingBwd(const MklPoolingParams& bwdParams, MklPrimitive* op) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     this->SetOp(key, op);
   }
 };
@@ -177,6 +177,7 @@ class MklDnnQuantizedMatMulOp
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       // Input tensors
       const Tensor& src_tensor = MklGetInput(context, this->kInputIndexSrc);
       const Tensor& weight_tensor =
@@ -25,9 +25,7 @@ limitations under the License.
 #include "tensorflow/core/graph/mkl_graph_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/util/mkl_util.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::primitive_attr;
 using dnnl::prop_kind;
@@ -111,26 +109,15 @@ class MklReorderWithScalePrimitive : public MklPrimitive {
                void* scale_data,
 #endif  // ENABLE_ONEDNN_V3
                std::shared_ptr<stream> reorder_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    context_.src_mem->set_data_handle(src_data, *reorder_stream);
-    context_.dst_mem->set_data_handle(dst_data, *reorder_stream);
-#else
-    context_.src_mem->set_data_handle(src_data);
-    context_.dst_mem->set_data_handle(dst_data);
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-#ifdef ENABLE_ONEDNN_V3
-    context_.scale_mem->set_data_handle(scale_data);
-#endif  // ENABLE_ONEDNN_V3
-    context_.reorder_prim->execute(*reorder_stream, context_.prim_args);
-    // After execution, set data handle back.
-    context_.src_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.dst_mem, dst_data);
 #ifdef ENABLE_ONEDNN_V3
-    context_.scale_mem->set_data_handle(DummyData);
+    bindings.Bind(context_.scale_mem, scale_data);
 #endif  // ENABLE_ONEDNN_V3
+    context_.reorder_prim->execute(*reorder_stream,
+                                   bindings.Apply(context_.prim_args));
   }
 
  private:
@@ -202,9 +189,8 @@ class MklReorderWithScalePrimitive : public MklPrimitive {
 #endif  // ENABLE_ONEDNN_V3
   }
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -234,8 +220,9 @@ class MklReorderWithScalePrimitiveFactory : public MklPrimitiveFactory<T> {
   MklReorderWithScalePrimitiveFactory() {}
   ~MklReorderWithScalePrimitiveFactory() {}
 
-  static string CreateKey(const memory* from, const memory* to,
-                          const MklReorderWithScaleFwdParams& fwdParams) {
+  static MklPrimitiveKey CreateKey(
+      const memory* from, const memory* to,
+      const MklReorderWithScaleFwdParams& fwdParams) {
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(MklReorderPrimitiveFactory<T>::CreateKey(from, to));
     // Generate key for post-op scale
@@ -244,7 +231,7 @@ class MklReorderWithScalePrimitiveFactory : public MklPrimitiveFactory<T> {
       key_creator.AddAsKey(fwdParams.post_op_params.name);
       key_creator.AddAsKey(fwdParams.post_op_params.param[0]);
     } else {
-      return string("not_a_key");
+      return MklPrimitiveKey("not_a_key");
     }
 
     return key_creator.GetKey();
@@ -252,13 +239,13 @@ class MklReorderWithScalePrimitiveFactory : public MklPrimitiveFactory<T> {
 
   MklPrimitive* GetReorder(const memory* from, const memory* to,
                            const MklReorderWithScaleFwdParams& fwdParams) {
-    string key = CreateKey(from, to, fwdParams);
+    MklPrimitiveKey key = CreateKey(from, to, fwdParams);
     return this->GetOp(key);
   }
 
   void SetReorder(const memory* from, const memory* to, MklPrimitive* op,
                   const MklReorderWithScaleFwdParams& fwdParams) {
-    string key = CreateKey(from, to, fwdParams);
+    MklPrimitiveKey key = CreateKey(from, to, fwdParams);
     this->SetOp(key, op);
   }
 };
@@ -372,6 +359,7 @@ class MklQuantizeV2Op : public OpKernel {
   }
 
   void Compute(OpKernelContext* ctx) override {
+    MklPrimitivePinScope pin_scope;
     const unsigned int src_idx = 0;
     const Tensor& input = ctx->input(src_idx);
     const float input_min_range = ctx->input(1).scalar<float>()();
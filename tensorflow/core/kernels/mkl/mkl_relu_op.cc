@@ -29,9 +29,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/util/mkl_util.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 
 using dnnl::algorithm;
 using dnnl::eltwise_forward;
@@ -80,27 +78,14 @@ class MklEltwiseFwdPrimitive : public MklPrimitive {
   //   dst_data:  output data buffer of dst
   void Execute(const T* src_data, T* dst_data,
                std::shared_ptr<stream> fwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#ifndef ENABLE_ONEDNN_OPENMP
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *fwd_stream);
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data),
-                                      *fwd_stream);
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data));
-#endif  // !ENABLE_ONEDNN_OPENMP
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.dst_mem, dst_data);
     DCHECK_EQ(context_.fwd_primitives.size(),
               context_.fwd_primitives_args.size());
     execute_primitives(context_.fwd_primitives, fwd_stream,
-                       context_.fwd_primitives_args);
-
-    // After execution, set data handle back.
-    context_.src_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
+                       context_.fwd_primitives_args, bindings);
   }
 
   std::shared_ptr<EltwiseFwdPd> GetEltwiseFwdPd() { return context_.fwd_pd; }
@@ -163,9 +148,8 @@ class MklEltwiseFwdPrimitive : public MklPrimitive {
 
   struct EltwiseFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -197,7 +181,7 @@ class MklEltwiseFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklEltwiseFwdPrimitiveFactory() {}
   ~MklEltwiseFwdPrimitiveFactory() {}
 
-  static string CreateKey(const MklEltwiseFwdParams<T>& fwdParams) {
+  static MklPrimitiveKey CreateKey(const MklEltwiseFwdParams<T>& fwdParams) {
     string prefix = "eltwise_fwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -209,13 +193,13 @@ class MklEltwiseFwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetEltwiseFwd(const MklEltwiseFwdParams<T>& fwdParams) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     return this->GetOp(key);
   }
 
   void SetEltwiseFwd(const MklEltwiseFwdParams<T>& fwdParams,
                      MklPrimitive* op) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     this->SetOp(key, op);
   }
 };
@@ -262,32 +246,15 @@ class MklEltwiseBwdPrimitive : public MklPrimitive {
   //   diff_src_data:  output data buffer of diff_src
   void Execute(const T* src_data, const T* diff_dst_data, T* diff_src_data,
                std::shared_ptr<stream> bwd_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#ifndef ENABLE_ONEDNN_OPENMP
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *bwd_stream);
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)), *bwd_stream);
-    context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data),
-                                           *bwd_stream);
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.diff_dst_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(diff_dst_data)));
-    context_.diff_src_mem->set_data_handle(static_cast<void*>(diff_src_data));
-#endif  // !ENABLE_ONEDNN_OPENMP
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.diff_dst_mem, diff_dst_data);
+    bindings.Bind(context_.diff_src_mem, diff_src_data);
     DCHECK_EQ(context_.bwd_primitives.size(),
               context_.bwd_primitives_args.size());
     execute_primitives(context_.bwd_primitives, bwd_stream,
-                       context_.bwd_primitives_args);
-
-    // after execution, set data handle back
-    context_.src_mem->set_data_handle(DummyData);
-    context_.diff_dst_mem->set_data_handle(DummyData);
-    context_.diff_src_mem->set_data_handle(DummyData);
+                       context_.bwd_primitives_args, bindings);
   }
 
   std::shared_ptr<EltwiseBwdPd> GetEltwiseBwdPd() { return context_.bwd_pd; }
@@ -371,9 +338,8 @@ class MklEltwiseBwdPrimitive : public MklPrimitive {
 
   struct EltwiseBwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -406,7 +372,7 @@ class MklEltwiseBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
  private:
-  static string CreateKey(const MklEltwiseBwdParams<T>& bwdParams) {
+  static MklPrimitiveKey CreateKey(const MklEltwiseBwdParams<T>& bwdParams) {
     string prefix = "eltwise_bwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -418,13 +384,13 @@ class MklEltwiseBwdPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetEltwiseBwd(const MklEltwiseBwdParams<T>& bwdParams) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     return this->GetOp(key);
   }
 
   void SetEltwiseBwd(const MklEltwiseBwdParams<T>& bwdParams,
                      MklPrimitive* op) {
-    string key = CreateKey(bwdParams);
+    MklPrimitiveKey key = CreateKey(bwdParams);
     this->SetOp(key, op);
   }
 };
@@ -442,6 +408,7 @@ class MklReluOpBase : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const size_t src_index = 0;  // index of src input tensor
       const size_t dst_index = 0;  // index of dst output tensor
       const Tensor& src_tensor = MklGetInput(context, src_index);
@@ -595,6 +562,7 @@ class MklReluGradOpBase : public OpKernel {
 
   void Compute(OpKernelContext* context) {
     try {
+      MklPrimitivePinScope pin_scope;
       MklDnnData<T> src(&cpu_engine);
       MklDnnData<T> diff_dst(&cpu_engine);
 
@@ -0,0 +1,374 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Calibrates the oneDNN rewrite thresholds of mkl_heuristics.h for the host
+// CPU. For every op it times the Eigen and the oneDNN kernel over a sweep of
+// shapes and intra-op thread counts, finds the amount of work (in MFLOPs, as
+// computed by CalculateNodeMFlops) above which oneDNN is faster, and fits
+//
+//   threshold = thread_sync_cost * threads + framework_cost
+//
+// by least squares. The fitted costs are written as a profile which the
+// layout pass picks up through TF_ONEDNN_REWRITE_THRESHOLDS_PROFILE.
+//
+// Usage:
+//   mkl_rewrite_threshold_calibration --output=/path/to/profile.txt \
+//       [--max_threads=N] [--benchmark_min_time=0.2]
+
+#ifdef INTEL_MKL
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/common_runtime/mkl_layout_pass.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/command_line_flags.h"
+#include "tensorflow/core/util/mkl_heuristics.h"
+#include "tensorflow/core/util/util.h"
+#include "tsl/platform/cpu_info.h"
+
+namespace tensorflow {
+namespace {
+
+// An op to calibrate, together with the shapes to sweep. `build` adds the op
+// for sweep point `size` to the graph and records the shapes of its inputs.
+struct Workload {
+  string op;
+  // Ops that map to the same oneDNN primitive and share op's thresholds.
+  std::vector<string> aliases;
+  std::vector<int> sizes;
+  std::function<Node*(Graph*, int, std::vector<TensorShape>*)> build;
+};
+
+Node* RandomInput(Graph* g, const TensorShape& shape,
+                  std::vector<TensorShape>* shapes) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  shapes->push_back(shape);
+  return test::graph::Constant(g, t);
+}
+
+Node* AddConv2D(Graph* g, int size, std::vector<TensorShape>* shapes) {
+  Node* input = RandomInput(g, {1, size, size, 32}, shapes);
+  Node* filter = RandomInput(g, {3, 3, 32, 32}, shapes);
+  Node* ret = nullptr;
+  TF_CHECK_OK(NodeBuilder(g->NewName("conv"), "Conv2D")
+                  .Input(input)
+                  .Input(filter)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("strides", {1, 1, 1, 1})
+                  .Attr("padding", "SAME")
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+Node* AddMatMul(Graph* g, int size, std::vector<TensorShape>* shapes) {
+  Node* a = RandomInput(g, {size, size}, shapes);
+  Node* b = RandomInput(g, {size, size}, shapes);
+  Node* ret = nullptr;
+  TF_CHECK_OK(NodeBuilder(g->NewName("matmul"), "MatMul")
+                  .Input(a)
+                  .Input(b)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("transpose_a", false)
+                  .Attr("transpose_b", false)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+Node* AddBatchMatMulV2(Graph* g, int size, std::vector<TensorShape>* shapes) {
+  Node* x = RandomInput(g, {8, size, size}, shapes);
+  Node* y = RandomInput(g, {8, size, size}, shapes);
+  Node* ret = nullptr;
+  TF_CHECK_OK(NodeBuilder(g->NewName("batch_matmul"), "BatchMatMulV2")
+                  .Input(x)
+                  .Input(y)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("adj_x", false)
+                  .Attr("adj_y", false)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+std::function<Node*(Graph*, int, std::vector<TensorShape>*)> AddPool(
+    const string& op) {
+  return [op](Graph* g, int size, std::vector<TensorShape>* shapes) {
+    Node* input = RandomInput(g, {1, size, size, 32}, shapes);
+    Node* ret = nullptr;
+    TF_CHECK_OK(NodeBuilder(g->NewName("pool"), op)
+                    .Input(input)
+                    .Attr("T", DT_FLOAT)
+                    .Attr("ksize", {1, 3, 3, 1})
+                    .Attr("strides", {1, 2, 2, 1})
+                    .Attr("padding", "SAME")
+                    .Finalize(g, &ret));
+    return ret;
+  };
+}
+
+std::vector<Workload> Workloads() {
+  return {
+      {"Conv2D", {"_FusedConv2D"}, {2, 4, 6, 8, 12, 16, 24, 32, 48, 64},
+       AddConv2D},
+      {"MatMul",
+       {"_FusedMatMul"},
+       {4, 8, 16, 24, 32, 48, 64, 96, 128, 192, 256},
+       AddMatMul},
+      {"BatchMatMulV2",
+       {"BatchMatMul"},
+       {2, 4, 8, 12, 16, 24, 32, 48, 64, 96, 128},
+       AddBatchMatMulV2},
+      {"MaxPool",
+       {},
+       {4, 8, 12, 16, 24, 32, 48, 64, 96, 128},
+       AddPool("MaxPool")},
+      {"AvgPool",
+       {},
+       {4, 8, 12, 16, 24, 32, 48, 64, 96, 128},
+       AddPool("AvgPool")},
+  };
+}
+
+// Builds the graph for one sweep point. With `onednn` set, the layout pass
+// rewrites the op unconditionally because no _input_shapes are attached.
+Graph* BuildGraph(const Workload& workload, int size, bool onednn,
+                  double* mflops) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<TensorShape> shapes;
+  Node* n = workload.build(g, size, &shapes);
+
+  if (mflops != nullptr) {
+    NodeDef def = n->def();
+    AttrValue input_shapes;
+    for (const TensorShape& shape : shapes) {
+      shape.AsProto(input_shapes.mutable_list()->add_shape());
+    }
+    (*def.mutable_attr())["_input_shapes"] = input_shapes;
+    *mflops = CalculateNodeMFlops(AttrSlice(def), workload.op);
+  }
+
+  if (onednn) {
+    std::unique_ptr<Graph> ug(g);
+    RunMklLayoutRewritePass(&ug);
+    g = ug.release();
+  }
+  return g;
+}
+
+string BenchmarkName(const Workload& workload, int size, int threads,
+                     bool onednn) {
+  return absl::StrCat(workload.op, onednn ? "_onednn" : "_eigen", "_t",
+                      threads, "_s", size);
+}
+
+// Records the real time per iteration of every benchmark, keyed by name.
+class TimingReporter : public ::benchmark::ConsoleReporter {
+ public:
+  explicit TimingReporter(std::map<string, double>* times) : times_(times) {}
+
+  void ReportRuns(const std::vector<Run>& runs) override {
+    for (const Run& run : runs) {
+      if (run.error_occurred || run.run_type != Run::RT_Iteration) continue;
+      string name = run.benchmark_name();
+      (*times_)[name.substr(0, name.find('/'))] = run.GetAdjustedRealTime();
+    }
+    ConsoleReporter::ReportRuns(runs);
+  }
+
+ private:
+  std::map<string, double>* times_;  // Not owned.
+};
+
+// Returns the MFLOPs above which oneDNN is consistently faster than Eigen,
+// interpolating log-linearly between the sweep points around the switch.
+double Crossover(const std::vector<double>& mflops,
+                 const std::vector<double>& eigen_time,
+                 const std::vector<double>& onednn_time) {
+  int last_loss = -1;
+  for (int i = 0; i < mflops.size(); ++i) {
+    if (onednn_time[i] > eigen_time[i]) last_loss = i;
+  }
+  if (last_loss < 0) return 0;
+  if (last_loss + 1 == mflops.size()) return mflops.back();
+
+  double r0 = std::log(eigen_time[last_loss] / onednn_time[last_loss]);
+  double r1 = std::log(eigen_time[last_loss + 1] / onednn_time[last_loss + 1]);
+  double t = r1 > r0 ? std::min(1.0, -r0 / (r1 - r0)) : 0.0;
+  return std::exp(std::log(mflops[last_loss]) +
+                  t * (std::log(mflops[last_loss + 1]) -
+                       std::log(mflops[last_loss])));
+}
+
+// Fits y = slope * x + intercept by least squares.
+void FitLine(const std::vector<double>& x, const std::vector<double>& y,
+             double* slope, double* intercept) {
+  const double n = x.size();
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int i = 0; i < x.size(); ++i) {
+    sx += x[i];
+    sy += y[i];
+    sxx += x[i] * x[i];
+    sxy += x[i] * y[i];
+  }
+  const double denom = n * sxx - sx * sx;
+  if (denom == 0) {
+    *slope = 0;
+    *intercept = sy / n;
+    return;
+  }
+  *slope = (n * sxy - sx * sy) / denom;
+  *intercept = (sy - *slope * sx) / n;
+}
+
+int Calibrate(const string& output, int max_threads) {
+  if (!IsMKLEnabled()) {
+    LOG(ERROR) << "oneDNN is disabled; nothing to calibrate.";
+    return 1;
+  }
+
+  std::vector<int> thread_counts;
+  for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+  thread_counts.push_back(max_threads);
+
+  const std::vector<Workload> workloads = Workloads();
+  for (const Workload& workload : workloads) {
+    for (int size : workload.sizes) {
+      for (int threads : thread_counts) {
+        for (bool onednn : {false, true}) {
+          ::benchmark::RegisterBenchmark(
+              BenchmarkName(workload, size, threads, onednn).c_str(),
+              [&workload, size, threads,
+               onednn](::benchmark::State& state) {
+                SessionOptions opts;
+                opts.config.set_inter_op_parallelism_threads(1);
+                opts.config.set_intra_op_parallelism_threads(threads);
+                opts.config.set_use_per_session_threads(true);
+                test::Benchmark("cpu",
+                                BuildGraph(workload, size, onednn, nullptr),
+                                &opts, nullptr, nullptr, "",
+                                /*old_benchmark_api*/ false)
+                    .Run(state);
+              })
+              ->UseRealTime()
+              ->Unit(::benchmark::kMicrosecond);
+        }
+      }
+    }
+  }
+
+  std::map<string, double> times;
+  TimingReporter reporter(&times);
+  ::benchmark::RunSpecifiedBenchmarks(&reporter);
+
+  const int cpu_family = tsl::port::CPUFamily();
+  const int cpu_model_num = tsl::port::CPUModelNum();
+  string profile = absl::StrFormat(
+      "# oneDNN rewrite thresholds calibrated for CPU family 0x%x model 0x%x\n"
+      "# op cpu_family cpu_model_num thread_sync_cost framework_cost\n",
+      cpu_family, cpu_model_num);
+
+  for (const Workload& workload : workloads) {
+    std::vector<double> mflops;
+    for (int size : workload.sizes) {
+      mflops.push_back(0);
+      delete BuildGraph(workload, size, /*onednn=*/false, &mflops.back());
+    }
+
+    std::vector<double> threads, crossovers;
+    for (int t : thread_counts) {
+      std::vector<double> eigen_time, onednn_time;
+      for (int size : workload.sizes) {
+        auto eigen = times.find(BenchmarkName(workload, size, t, false));
+        auto onednn = times.find(BenchmarkName(workload, size, t, true));
+        if (eigen == times.end() || onednn == times.end()) break;
+        eigen_time.push_back(eigen->second);
+        onednn_time.push_back(onednn->second);
+      }
+      if (eigen_time.size() != workload.sizes.size()) {
+        LOG(WARNING) << "Incomplete timings for " << workload.op << " with "
+                     << t << " threads; skipping.";
+        continue;
+      }
+      threads.push_back(t);
+      crossovers.push_back(Crossover(mflops, eigen_time, onednn_time));
+      VLOG(1) << workload.op << " threads=" << t
+              << " crossover_mflops=" << crossovers.back();
+    }
+    if (threads.empty()) continue;
+
+    double thread_sync_cost, framework_cost;
+    FitLine(threads, crossovers, &thread_sync_cost, &framework_cost);
+    std::vector<string> ops = {workload.op};
+    ops.insert(ops.end(), workload.aliases.begin(), workload.aliases.end());
+    for (const string& op : ops) {
+      absl::StrAppendFormat(&profile, "%s 0x%x 0x%x %.6g %.6g\n", op,
+                            cpu_family, cpu_model_num, thread_sync_cost,
+                            framework_cost);
+    }
+  }
+
+  Status s = WriteStringToFile(Env::Default(), output, profile);
+  if (!s.ok()) {
+    LOG(ERROR) << "Failed to write " << output << ": " << s;
+    return 1;
+  }
+  LOG(INFO) << "Wrote oneDNN rewrite threshold profile to " << output;
+  return 0;
+}
+
+}  // namespace
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::string output;
+  tensorflow::int32 max_threads = tsl::port::MaxParallelism();
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("output", &output,
+                       "File to write the rewrite threshold profile to."),
+      tensorflow::Flag("max_threads", &max_threads,
+                       "Largest intra-op thread count to calibrate for."),
+  };
+  bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  if (!parse_result || output.empty() || max_threads < 1) {
+    std::cerr << tensorflow::Flags::Usage(argv[0], flag_list);
+    return -1;
+  }
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  ::benchmark::Initialize(&argc, argv);
+  return tensorflow::Calibrate(output, max_threads);
+}
+
+#else  // INTEL_MKL
+
+#include <iostream>
+
+int main(int argc, char** argv) {
+  std::cerr << "oneDNN support was not compiled in; nothing to calibrate.\n";
+  return -1;
+}
+
+#endif  // INTEL_MKL
@@ -26,9 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/util/mkl_util.h"
 #include "tensorflow/core/util/tensor_format.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
 #include "tensorflow/core/platform/mutex.h"
-#endif
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 
 using dnnl::prop_kind;
@@ -64,27 +62,13 @@ class MklSoftmaxPrimitive : public MklPrimitive {
   //   dst_data:  output data buffer of dst
   void Execute(const T* src_data, T* dst_data,
                std::shared_ptr<stream> fwd_cpu_stream) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(primitive_execution_mu_);
-#endif
-#if !defined(ENABLE_ONEDNN_OPENMP) && !defined(ENABLE_ONEDNN_V3)
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)), *fwd_cpu_stream);
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data),
-                                      *fwd_cpu_stream);
-#else
-    context_.src_mem->set_data_handle(
-        static_cast<void*>(const_cast<T*>(src_data)));
-    context_.dst_mem->set_data_handle(static_cast<void*>(dst_data));
-#endif  // !ENABLE_ONEDNN_OPENMP && !ENABLE_ONEDNN_V3
-
+    MklPrimitiveExecutionLock lock(&primitive_execution_mu_);
+    MklMemoryBindings bindings;
+    bindings.Bind(context_.src_mem, src_data);
+    bindings.Bind(context_.dst_mem, dst_data);
     DCHECK_EQ(context_.fwd_primitives.size(), context_.fwd_net_args.size());
     execute_primitives(context_.fwd_primitives, fwd_cpu_stream,
-                       context_.fwd_net_args);
-
-    // After execution, set data handle back.
-    context_.src_mem->set_data_handle(DummyData);
-    context_.dst_mem->set_data_handle(DummyData);
+                       context_.fwd_net_args, bindings);
   }
 
   std::shared_ptr<dnnl::softmax_forward::primitive_desc> GetSoftmaxFwdPd() {
@@ -160,9 +144,8 @@ class MklSoftmaxPrimitive : public MklPrimitive {
 
   struct SoftmaxFwdContext context_;
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  // Guards Execute() with ACL, whose primitives are not thread safe.
   mutex primitive_execution_mu_;
-#endif
 };
 
 template <typename T>
@@ -191,7 +174,7 @@ class MklSoftmaxPrimitiveFactory : public MklPrimitiveFactory<T> {
   MklSoftmaxPrimitiveFactory() {}
   ~MklSoftmaxPrimitiveFactory() {}
 
-  static string CreateKey(const MklSoftmaxParams& fwdParams) {
+  static MklPrimitiveKey CreateKey(const MklSoftmaxParams& fwdParams) {
     string prefix = "softmax_fwd";
     FactoryKeyCreator key_creator;
     key_creator.AddAsKey(prefix);
@@ -205,12 +188,12 @@ class MklSoftmaxPrimitiveFactory : public MklPrimitiveFactory<T> {
   }
 
   MklPrimitive* GetSoftmaxFwd(const MklSoftmaxParams& fwdParams) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     return this->GetOp(key);
   }
 
   void SetSoftmaxFwd(const MklSoftmaxParams& fwdParams, MklPrimitive* op) {
-    string key = CreateKey(fwdParams);
+    MklPrimitiveKey key = CreateKey(fwdParams);
     this->SetOp(key, op);
   }
 };
@@ -226,6 +209,7 @@ class MklSoftmaxOp : public OpKernel {
 
   void Compute(OpKernelContext* context) override {
     try {
+      MklPrimitivePinScope pin_scope;
       const Tensor& src_tensor = context->input(0);
       auto src_shape = src_tensor.shape();
       const int input_dims = src_shape.dims();
@@ -0,0 +1,283 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// MatMul with weight-only quantized weights, for memory bound inference such
+// as the token by token decoding of language models, where each step streams
+// all of the weights through the cores for a few rows of activations. Keeping
+// the weights in 8 or 4 bits cuts that traffic 4x or 8x compared to float,
+// while the activations and the accumulation stay in float, so unlike the
+// _MklQuantizedMatMul ops no Quantize/Requantize nodes are needed.
+//
+// The weights are never dequantized as a whole. The output is split into
+// [kMBlock, kNBlock] blocks across the intra-op threads, and for each block
+// [kKBlock, kNBlock] tiles of the weights are dequantized into a buffer that
+// stays in the L2 cache of the core and multiplied with the activations right
+// away.
+
+#ifdef INTEL_MKL
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "absl/strings/str_join.h"
+#include "dnnl.hpp"
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/util/mkl_util.h"
+#include "tensorflow/core/util/weight_only_quantization.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using CPUDevice = Eigen::ThreadPoolDevice;
+
+namespace tensorflow {
+
+namespace {
+
+// Output rows and columns of a unit of work, and rows of the weights
+// dequantized at a time. A tile of weights and a block of the output take
+// 128KB each.
+constexpr int64_t kMBlock = 256;
+constexpr int64_t kNBlock = 128;
+constexpr int64_t kKBlock = 256;
+
+enum class Activation { kNone, kRelu, kRelu6, kElu, kTanh, kSigmoid };
+
+bool ParseActivation(const string& name, Activation* activation) {
+  if (name == "Relu") {
+    *activation = Activation::kRelu;
+  } else if (name == "Relu6") {
+    *activation = Activation::kRelu6;
+  } else if (name == "Elu") {
+    *activation = Activation::kElu;
+  } else if (name == "Tanh") {
+    *activation = Activation::kTanh;
+  } else if (name == "Sigmoid") {
+    *activation = Activation::kSigmoid;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Row-major sgemm on the calling thread. The output blocks are already
+// sharded across the intra-op threads.
+void BlockSgemm(int64_t m, int64_t n, int64_t k, const float* a, int64_t lda,
+                const float* b, int64_t ldb, float* c, int64_t ldc) {
+#ifndef ENABLE_ONEDNN_OPENMP
+  dnnl::threadpool_interop::sgemm('N', 'N', m, n, k, 1.0f, a, lda, b, ldb,
+                                  1.0f, c, ldc, nullptr);
+#else
+  dnnl_sgemm('N', 'N', m, n, k, 1.0f, a, lda, b, ldb, 1.0f, c, ldc);
+#endif  // !ENABLE_ONEDNN_OPENMP
+}
+
+void FromFloat(const float* src, float* dst, int64_t size) {
+  std::copy_n(src, size, dst);
+}
+
+void FromFloat(const float* src, bfloat16* dst, int64_t size) {
+  RoundFloatToBFloat16(src, dst, size);
+}
+
+}  // namespace
+
+template <typename Device, typename T>
+class MklWeightOnlyQuantizedMatMulOp : public OpKernel {
+ public:
+  explicit MklWeightOnlyQuantizedMatMulOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("weight_bits", &weight_bits_));
+    OP_REQUIRES(context, weight_bits_ == 8 || weight_bits_ == 4,
+                errors::InvalidArgument("weight_bits must be 8 or 4, got ",
+                                        weight_bits_));
+    OP_REQUIRES_OK(context, context->GetAttr("group_size", &group_size_));
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+
+    for (size_t i = 0; i < fused_ops.size(); ++i) {
+      if (fused_ops[i] == "BiasAdd" && i == 0) {
+        has_bias_ = true;
+      } else if (activation_ != Activation::kNone ||
+                 !ParseActivation(fused_ops[i], &activation_)) {
+        OP_REQUIRES(context, false,
+                    errors::Unimplemented("Unsupported fusion: [",
+                                          absl::StrJoin(fused_ops, ","), "]"));
+      }
+    }
+    OP_REQUIRES(context, num_args == has_bias_,
+                errors::InvalidArgument("Expected ", has_bias_,
+                                        " arguments, got ", num_args));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& a = ctx->input(kAIndex);
+    const Tensor& b = ctx->input(kBIndex);
+    const Tensor& b_scales = ctx->input(kScalesIndex);
+    OP_REQUIRES(ctx, a.dims() == 2,
+                errors::InvalidArgument("a must be 2D: ",
+                                        a.shape().DebugString()));
+    OP_REQUIRES(ctx, b.dims() == 2 && b_scales.dims() == 2,
+                errors::InvalidArgument("b and b_scales must be 2D: ",
+                                        b.shape().DebugString(), " ",
+                                        b_scales.shape().DebugString()));
+
+    const int64_t m = a.dim_size(0);
+    const int64_t k = a.dim_size(1);
+    const int64_t n = b_scales.dim_size(1);
+    const int64_t packed_n = weight_bits_ == 8 ? n : (n + 1) / 2;
+    OP_REQUIRES(ctx, b.dim_size(0) == k && b.dim_size(1) == packed_n,
+                errors::InvalidArgument(
+                    "b must be [", k, ", ", packed_n, "] for ", weight_bits_,
+                    " bit weights, got ", b.shape().DebugString()));
+    const int64_t num_groups = NumWeightQuantizationGroups(k, group_size_);
+    OP_REQUIRES(ctx, b_scales.dim_size(0) == num_groups,
+                errors::InvalidArgument(
+                    "b_scales must have ", num_groups, " rows for ", k,
+                    " rows of weights in groups of ", group_size_, ", got ",
+                    b_scales.shape().DebugString()));
+
+    const T* bias_data = nullptr;
+    if (has_bias_) {
+      const Tensor& bias = ctx->input(kArgsIndex);
+      OP_REQUIRES(ctx, bias.dims() == 1 && bias.dim_size(0) == n,
+                  errors::InvalidArgument("bias must be [", n, "], got ",
+                                          bias.shape().DebugString()));
+      bias_data = bias.flat<T>().data();
+    }
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({m, n}), &output));
+    if (output->NumElements() == 0) return;
+
+    // The activations are small next to the weights, so they are converted to
+    // float once up front.
+    const float* a_data;
+    Tensor a_float;
+    if (std::is_same<T, float>::value) {
+      a_data = reinterpret_cast<const float*>(a.flat<T>().data());
+    } else {
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, a.shape(), &a_float));
+      BFloat16ToFloat(reinterpret_cast<const bfloat16*>(a.flat<T>().data()),
+                      a_float.flat<float>().data(), a.NumElements());
+      a_data = a_float.flat<float>().data();
+    }
+    const int8* b_data = b.flat<int8>().data();
+    const float* scales_data = b_scales.flat<float>().data();
+    T* output_data = output->flat<T>().data();
+
+    const int64_t num_m_blocks = (m + kMBlock - 1) / kMBlock;
+    const int64_t num_n_blocks = (n + kNBlock - 1) / kNBlock;
+    auto compute_blocks = [&](int64_t begin, int64_t end) {
+      std::vector<float> tile(kKBlock * kNBlock);
+      std::vector<float> out(kMBlock * kNBlock);
+
+      for (int64_t unit = begin; unit < end; ++unit) {
+        const int64_t m0 = (unit % num_m_blocks) * kMBlock;
+        const int64_t n0 = (unit / num_m_blocks) * kNBlock;
+        const int64_t bm = std::min(kMBlock, m - m0);
+        const int64_t bn = std::min(kNBlock, n - n0);
+
+        std::fill_n(out.begin(), bm * bn, 0.0f);
+        for (int64_t k0 = 0; k0 < k; k0 += kKBlock) {
+          const int64_t bk = std::min(kKBlock, k - k0);
+          DequantizeWeightBlock(b_data, scales_data, weight_bits_, n,
+                                group_size_, k0, k0 + bk, n0, n0 + bn,
+                                tile.data());
+          BlockSgemm(bm, bn, bk, a_data + m0 * k + k0, k, tile.data(), bn,
+                     out.data(), bn);
+        }
+
+        for (int64_t i = 0; i < bm; ++i) {
+          float* row_data = out.data() + i * bn;
+          if (bias_data != nullptr) {
+            for (int64_t j = 0; j < bn; ++j) {
+              row_data[j] += static_cast<float>(bias_data[n0 + j]);
+            }
+          }
+          ApplyActivation(row_data, bn);
+          FromFloat(row_data, output_data + (m0 + i) * n + n0, bn);
+        }
+      }
+    };
+
+    const int64_t cost_per_unit = 2 * std::min(kMBlock, m) * k * kNBlock;
+#ifndef ENABLE_ONEDNN_OPENMP
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(ctx->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_m_blocks * num_n_blocks, cost_per_unit, compute_blocks);
+#else
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t unit = 0; unit < num_m_blocks * num_n_blocks; ++unit) {
+      compute_blocks(unit, unit + 1);
+    }
+#endif  // !ENABLE_ONEDNN_OPENMP
+  }
+
+ private:
+  void ApplyActivation(float* data, int64_t size) const {
+    Eigen::Map<Eigen::ArrayXf> x(data, size);
+    switch (activation_) {
+      case Activation::kNone:
+        break;
+      case Activation::kRelu:
+        x = x.max(0.0f);
+        break;
+      case Activation::kRelu6:
+        x = x.max(0.0f).min(6.0f);
+        break;
+      case Activation::kElu:
+        x = (x < 0.0f).select(x.exp() - 1.0f, x);
+        break;
+      case Activation::kTanh:
+        x = x.tanh();
+        break;
+      case Activation::kSigmoid:
+        x = (1.0f + (-x).exp()).inverse();
+        break;
+    }
+  }
+
+  int weight_bits_;
+  int64_t group_size_;
+  bool has_bias_ = false;
+  Activation activation_ = Activation::kNone;
+  const int kAIndex = 0;
+  const int kBIndex = 1;
+  const int kScalesIndex = 2;
+  const int kArgsIndex = 3;
+};
+
+#define REGISTER_WEIGHT_ONLY_QUANTIZED_MATMUL_CPU(T)                     \
+  REGISTER_KERNEL_BUILDER(Name("_MklWeightOnlyQuantizedMatMul")          \
+                              .Device(DEVICE_CPU)                        \
+                              .TypeConstraint<T>("T"),                   \
+                          MklWeightOnlyQuantizedMatMulOp<CPUDevice, T>);
+
+TF_CALL_float(REGISTER_WEIGHT_ONLY_QUANTIZED_MATMUL_CPU);
+TF_CALL_bfloat16(REGISTER_WEIGHT_ONLY_QUANTIZED_MATMUL_CPU);
+
+#undef REGISTER_WEIGHT_ONLY_QUANTIZED_MATMUL_CPU
+
+}  // namespace tensorflow
+
+#endif  // INTEL_MKL
@@ -0,0 +1,105 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifdef INTEL_MKL
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/common_runtime/mkl_layout_pass.h"
+#include "tensorflow/core/graph/mkl_graph_util.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/util/mkl_util.h"
+#include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/weight_only_quantization.h"
+
+namespace tensorflow {
+namespace {
+
+// MatMul of [m, k] activations with constant [k, n] weights, run on weights
+// quantized to 'bits' (8 or 4) bits, or on the original weights if 'bits' is
+// 0, as the baseline.
+template <typename T>
+static Graph* WeightOnlyQuantizedMatmul(int m, int k, int n, int bits,
+                                        int group_size, DataType type) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in0(type, TensorShape({m, k}));
+  in0.flat<T>().setRandom();
+  Tensor in1(type, TensorShape({k, n}));
+  in1.flat<T>().setRandom();
+  Node* src0 = test::graph::Constant(g, in0);
+
+  Node* ret = nullptr;
+  if (bits == 0) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("matmul"), "MatMul")
+                    .Input(src0)
+                    .Input(test::graph::Constant(g, in1))
+                    .Finalize(g, &ret));
+    if (IsMKLEnabled()) {
+      std::unique_ptr<Graph>* ug = new std::unique_ptr<Graph>(g);
+      RunMklLayoutRewritePass(ug);
+    }
+    return g;
+  }
+
+  Tensor quantized, scales;
+  TF_CHECK_OK(QuantizeWeightsForMatMul(in1, /*transpose_weights=*/false, bits,
+                                       group_size, &quantized, &scales));
+  TF_CHECK_OK(NodeBuilder(g->NewName("matmul"), "_MklWeightOnlyQuantizedMatMul")
+                  .Input(src0)
+                  .Input(test::graph::Constant(g, quantized))
+                  .Input(test::graph::Constant(g, scales))
+                  .Input(std::vector<NodeBuilder::NodeOut>())
+                  .Attr("weight_bits", bits)
+                  .Attr("group_size", group_size)
+                  .Attr("num_args", 0)
+                  .Attr("fused_ops", std::vector<string>())
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_WoqMatmulDev(M, K, N, BITS, G, T, TFTYPE)                      \
+  static void BM_WoqMatmul##_##M##_##K##_##N##_##BITS##_##G##_##TFTYPE(   \
+      ::testing::benchmark::State& state) {                               \
+    test::Benchmark("cpu", WeightOnlyQuantizedMatmul<T>(M, K, N, BITS, G, \
+                                                        TFTYPE))          \
+        .Run(state);                                                      \
+    state.SetItemsProcessed(state.iterations() * M * K * N * 2);          \
+  }                                                                       \
+  BENCHMARK(BM_WoqMatmul##_##M##_##K##_##N##_##BITS##_##G##_##TFTYPE)     \
+      ->MeasureProcessCPUTime();
+
+// Runs the float baseline and the int8 and int4 kernels, per output channel
+// and in groups of 128 rows.
+#define BM_WoqMatmul(M, K, N)                              \
+  BM_WoqMatmulDev(M, K, N, 0, 0, float, DT_FLOAT);         \
+  BM_WoqMatmulDev(M, K, N, 8, 0, float, DT_FLOAT);         \
+  BM_WoqMatmulDev(M, K, N, 4, 0, float, DT_FLOAT);         \
+  BM_WoqMatmulDev(M, K, N, 4, 128, float, DT_FLOAT);       \
+  BM_WoqMatmulDev(M, K, N, 0, 0, bfloat16, DT_BFLOAT16);   \
+  BM_WoqMatmulDev(M, K, N, 8, 0, bfloat16, DT_BFLOAT16);   \
+  BM_WoqMatmulDev(M, K, N, 4, 128, bfloat16, DT_BFLOAT16);
+
+// Projections of a 7B parameter decoder: token by token decoding with a batch
+// of 1 and 8 sequences, and the prompt processing of 128 tokens.
+BM_WoqMatmul(1, 4096, 4096);
+BM_WoqMatmul(8, 4096, 4096);
+BM_WoqMatmul(128, 4096, 4096);
+BM_WoqMatmul(1, 4096, 11008);
+BM_WoqMatmul(1, 11008, 4096);
+BM_WoqMatmul(8, 11008, 4096);
+
+}  // namespace
+}  // namespace tensorflow
+
+#endif  // INTEL_MKL
@@ -1902,6 +1902,67 @@ REGISTER_OP("_MklFusedBatchMatMulV2")
 expected to create these operators.
 )doc");
 
+REGISTER_OP("_MklFusedAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("args: num_args * T")
+    .Output("output: T")
+    .Attr("T: {bfloat16, float}")
+    .Attr("adj_y: bool = true")
+    .Attr("num_args: int >= 0")
+    .Attr("fused_ops: list(string) = []")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query, value, batch_and_rows, output;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 3, &query));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 3, &value));
+      TF_RETURN_IF_ERROR(c->Subshape(query, 0, -1, &batch_and_rows));
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          batch_and_rows, c->Vector(c->Dim(value, -1)), &output));
+      c->set_output(0, output);
+      return OkStatus();
+    })
+    .Doc(R"doc(
+oneDNN version of scaled dot-product attention,
+Softmax(query * key^T * scale + mask) * value, where key is transposed only if
+adj_y is set. fused_ops is one of [], ["Mul"], ["Add"] and ["Mul", "Add"],
+with the scale and the mask passed in args.
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
+REGISTER_OP("_MklWeightOnlyQuantizedMatMul")
+    .Input("a: T")
+    .Input("b: int8")
+    .Input("b_scales: float")
+    .Input("args: num_args * T")
+    .Output("product: T")
+    .Attr("T: {bfloat16, float}")
+    .Attr("weight_bits: int = 8")
+    .Attr("group_size: int >= 0 = 0")
+    .Attr("num_args: int >= 0")
+    .Attr("fused_ops: list(string) = []")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle a, b_scales;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &a));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &b_scales));
+      c->set_output(0, c->Matrix(c->Dim(a, 0), c->Dim(b_scales, 1)));
+      return OkStatus();
+    })
+    .Doc(R"doc(
+oneDNN version of MatMul with weight-only quantized weights, a * b, where the
+activations a are float or bfloat16 and b holds [K, N] weights quantized to 8
+or 4 bits with one float scale per output channel, or per group of group_size
+rows of an output channel (see util/weight_only_quantization.h for the
+layout). The weights are dequantized block by block inside the GEMM.
+fused_ops is an optional "BiasAdd", with the bias passed in args, followed by
+an optional "Relu", "Relu6", "Elu", "Tanh" or "Sigmoid".
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("_MklSwish")
     .Input("features: T")
     .Output("activations: T")
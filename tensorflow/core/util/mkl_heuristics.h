@@ -20,10 +20,16 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_MKL_HEURISTICS_H_
 #ifdef INTEL_MKL
 
+#include <algorithm>
+#include <sstream>
 #include <vector>
 
+#include "absl/strings/ascii.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/util/onednn_env_vars.h"
 #include "tsl/platform/cpu_info.h"
 
 namespace tensorflow {
@@ -59,6 +65,81 @@ static const RewriteThreshold rewrite_thresholds[] = {
 #endif  // DNNL_AARCH64_USE_ACL
     {"", 0x0, 0x0, {0, 0}}};
 
+// Parses a rewrite threshold profile. Every line that is neither empty nor a
+// '#' comment holds one entry:
+//
+//   <op> <cpu_family> <cpu_model_num> <thread_sync_cost> <framework_cost>
+//
+// CPU family and model accept the same 0x-prefixed form as the table above.
+// Profiles for the host CPU are written by
+// //tensorflow/core/kernels/mkl:mkl_rewrite_threshold_calibration.
+static Status ParseRewriteThresholdProfile(
+    const string& contents, std::vector<RewriteThreshold>* thresholds) {
+  std::istringstream lines(contents);
+  string line;
+  for (int line_num = 1; std::getline(lines, line); ++line_num) {
+    absl::string_view entry = absl::StripAsciiWhitespace(line);
+    if (entry.empty() || entry[0] == '#') continue;
+
+    std::istringstream fields{string(entry)};
+    fields.unsetf(std::ios_base::basefield);
+    RewriteThreshold threshold;
+    string trailing;
+    if (!(fields >> threshold.op >> threshold.cpu_family >>
+          threshold.cpu_model_num >> threshold.params.thread_sync_cost >>
+          threshold.params.framework_cost) ||
+        (fields >> trailing)) {
+      return errors::InvalidArgument("Malformed rewrite threshold on line ",
+                                     line_num, ": ", line);
+    }
+    thresholds->push_back(threshold);
+  }
+  return OkStatus();
+}
+
+// The rewrite threshold profile named by TF_ONEDNN_REWRITE_THRESHOLDS_PROFILE,
+// as loaded by the process.
+struct LoadedRewriteThresholdProfile {
+  string path;
+  // Fingerprint of the profile contents, or 0 if no profile is in effect.
+  uint64 fingerprint = 0;
+  std::vector<RewriteThreshold> thresholds;
+};
+
+// Returns the profile named by TF_ONEDNN_REWRITE_THRESHOLDS_PROFILE. The
+// profile is read once per process; an unreadable or malformed profile is
+// reported and ignored.
+inline const LoadedRewriteThresholdProfile& RewriteThresholdProfile() {
+  static const LoadedRewriteThresholdProfile* loaded = [] {
+    auto* profile = new LoadedRewriteThresholdProfile();
+    profile->path = RewriteThresholdsProfile();
+    if (profile->path.empty()) return profile;
+
+    string contents;
+    Status s = ReadFileToString(Env::Default(), profile->path, &contents);
+    if (s.ok()) {
+      s = ParseRewriteThresholdProfile(contents, &profile->thresholds);
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Ignoring oneDNN rewrite threshold profile "
+                   << profile->path << ": " << s;
+      profile->thresholds.clear();
+    } else {
+      profile->fingerprint = Fingerprint64(contents);
+      VLOG(1) << "Loaded " << profile->thresholds.size()
+              << " oneDNN rewrite thresholds from " << profile->path;
+    }
+    return profile;
+  }();
+  return *loaded;
+}
+
+// Returns the thresholds of the profile named by
+// TF_ONEDNN_REWRITE_THRESHOLDS_PROFILE.
+inline const std::vector<RewriteThreshold>& ProfileRewriteThresholds() {
+  return RewriteThresholdProfile().thresholds;
+}
+
 static double FindRewriteThreshold(const string node_name, int threads) {
   int cpu_family_ = tsl::port::CPUFamily();
   int cpu_model_num_ = tsl::port::CPUModelNum();
@@ -69,6 +150,14 @@ static double FindRewriteThreshold(const string node_name, int threads) {
     return 0;
   }
 
+  // A calibrated profile takes precedence over the built-in table.
+  for (const RewriteThreshold& i : ProfileRewriteThresholds()) {
+    if (node_name == i.op && cpu_family_ == i.cpu_family &&
+        cpu_model_num_ == i.cpu_model_num) {
+      return i.params.thread_sync_cost * threads + i.params.framework_cost;
+    }
+  }
+
   for (const RewriteThreshold* i = rewrite_thresholds;
        i->op != "" && threads > 0; i++) {
     if (node_name == i->op && cpu_family_ == i->cpu_family &&
@@ -116,6 +205,77 @@ static double CalculateNodeMFlops(const AttrSlice& attrs,
     }
     return input_shape.dim_size(0) * input_shape.dim_size(1) *
            input_shape.dim_size(2) * input_shape.dim_size(3) / (double)1e6;
+  } else if ((node_name == "MatMul" || node_name == "_FusedMatMul") &&
+             shape_attrs.size() >= 2) {
+    TensorShape lhs_shape, rhs_shape;
+    if (TensorShape::BuildTensorShape(*shape_attrs[0], &lhs_shape) !=
+            tsl::OkStatus() ||
+        lhs_shape.dims() != 2) {
+      return -1;
+    }
+    if (TensorShape::BuildTensorShape(*shape_attrs[1], &rhs_shape) !=
+            tsl::OkStatus() ||
+        rhs_shape.dims() != 2) {
+      return -1;
+    }
+    bool transpose_a = false, transpose_b = false;
+    TryGetNodeAttr(attrs, "transpose_a", &transpose_a);
+    TryGetNodeAttr(attrs, "transpose_b", &transpose_b);
+
+    // MFLOPS = M * K * N / 1e6.
+    return lhs_shape.dim_size(transpose_a ? 1 : 0) *
+           lhs_shape.dim_size(transpose_a ? 0 : 1) *
+           rhs_shape.dim_size(transpose_b ? 0 : 1) / (double)1e6;
+  } else if ((node_name == "BatchMatMul" || node_name == "BatchMatMulV2") &&
+             shape_attrs.size() == 2) {
+    TensorShape lhs_shape, rhs_shape;
+    if (TensorShape::BuildTensorShape(*shape_attrs[0], &lhs_shape) !=
+            tsl::OkStatus() ||
+        lhs_shape.dims() < 2) {
+      return -1;
+    }
+    if (TensorShape::BuildTensorShape(*shape_attrs[1], &rhs_shape) !=
+            tsl::OkStatus() ||
+        rhs_shape.dims() < 2) {
+      return -1;
+    }
+    bool adj_x = false, adj_y = false;
+    TryGetNodeAttr(attrs, "adj_x", &adj_x);
+    TryGetNodeAttr(attrs, "adj_y", &adj_y);
+
+    // Batch dimensions broadcast against each other.
+    const int lhs_rank = lhs_shape.dims();
+    const int rhs_rank = rhs_shape.dims();
+    double batch = 1;
+    for (int i = 3; i <= std::max(lhs_rank, rhs_rank); ++i) {
+      int64_t lhs_dim = i <= lhs_rank ? lhs_shape.dim_size(lhs_rank - i) : 1;
+      int64_t rhs_dim = i <= rhs_rank ? rhs_shape.dim_size(rhs_rank - i) : 1;
+      batch *= std::max(lhs_dim, rhs_dim);
+    }
+
+    // MFLOPS = B * M * K * N / 1e6.
+    return batch * lhs_shape.dim_size(lhs_rank - (adj_x ? 1 : 2)) *
+           lhs_shape.dim_size(lhs_rank - (adj_x ? 2 : 1)) *
+           rhs_shape.dim_size(rhs_rank - (adj_y ? 2 : 1)) / (double)1e6;
+  } else if ((node_name == "MaxPool" || node_name == "AvgPool") &&
+             shape_attrs.size() >= 1) {
+    TensorShape input_shape;
+    if (TensorShape::BuildTensorShape(*shape_attrs[0], &input_shape) !=
+        tsl::OkStatus()) {
+      return -1;
+    }
+    std::vector<int32> ksize, strides;
+    if (!TryGetNodeAttr(attrs, "ksize", &ksize) ||
+        !TryGetNodeAttr(attrs, "strides", &strides)) {
+      return -1;
+    }
+
+    // Every output element reduces one window, so
+    // MFLOPS = N * H * W * C * prod(ksize) / prod(strides) / 1e6.
+    double window = 1;
+    for (int32 k : ksize) window *= k;
+    for (int32 s : strides) window /= std::max(s, 1);
+    return input_shape.num_elements() * window / (double)1e6;
   }
 
   return -1;
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/util/mkl_heuristics.h"
 
 #include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -76,6 +77,79 @@ TEST(MklHeuristicsTest, MklCalculateMFlops) {
   EXPECT_EQ(sigmoid_calculated_mflops, expected_sigmoid_mflops);
 }
 
+TEST(MklHeuristicsTest, MklCalculateMatMulAndPoolMFlops) {
+  auto add_shape = [](AttrValue* attr, std::initializer_list<int64_t> dims) {
+    TensorShapeProto* proto = attr->mutable_list()->add_shape();
+    for (int64_t dim : dims) proto->add_dim()->set_size(dim);
+  };
+
+  // MatMul with transposed lhs: [K, M] x [K, N].
+  NodeDef matmul;
+  AttrValue matmul_shapes;
+  add_shape(&matmul_shapes, {64, 16});
+  add_shape(&matmul_shapes, {64, 32});
+  (*matmul.mutable_attr())["_input_shapes"] = matmul_shapes;
+  (*matmul.mutable_attr())["transpose_a"].set_b(true);
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(matmul), "MatMul"),
+            16 * 64 * 32 / static_cast<double>(1e6));
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(matmul), "_FusedMatMul"),
+            16 * 64 * 32 / static_cast<double>(1e6));
+
+  // BatchMatMulV2 broadcasts the batch dimensions: [4, 1, M, K] x [3, K, N].
+  NodeDef batch_matmul;
+  AttrValue batch_matmul_shapes;
+  add_shape(&batch_matmul_shapes, {4, 1, 8, 16});
+  add_shape(&batch_matmul_shapes, {3, 16, 24});
+  (*batch_matmul.mutable_attr())["_input_shapes"] = batch_matmul_shapes;
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(batch_matmul), "BatchMatMulV2"),
+            4 * 3 * 8 * 16 * 24 / static_cast<double>(1e6));
+
+  // 3x3 pooling with stride 2 reduces one window per output element.
+  NodeDef pool;
+  AttrValue pool_shapes;
+  add_shape(&pool_shapes, {2, 32, 32, 16});
+  (*pool.mutable_attr())["_input_shapes"] = pool_shapes;
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(pool), "MaxPool"), -1);
+  AttrValue ksize, strides;
+  for (int32 k : {1, 3, 3, 1}) ksize.mutable_list()->add_i(k);
+  for (int32 s : {1, 2, 2, 1}) strides.mutable_list()->add_i(s);
+  (*pool.mutable_attr())["ksize"] = ksize;
+  (*pool.mutable_attr())["strides"] = strides;
+  double expected_pool_mflops =
+      2 * 32 * 32 * 16 * 9 / 4 / static_cast<double>(1e6);
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(pool), "MaxPool"),
+            expected_pool_mflops);
+  EXPECT_EQ(CalculateNodeMFlops(AttrSlice(pool), "AvgPool"),
+            expected_pool_mflops);
+}
+
+TEST(MklHeuristicsTest, MklParseRewriteThresholdProfile) {
+  std::vector<RewriteThreshold> thresholds;
+  TF_EXPECT_OK(ParseRewriteThresholdProfile(
+      "# op cpu_family cpu_model_num thread_sync_cost framework_cost\n"
+      "\n"
+      "Conv2D 0x6 0x55 0.25 12.5\n"
+      "  MatMul 6 85 0 -1.5  \n",
+      &thresholds));
+  ASSERT_EQ(thresholds.size(), 2);
+  EXPECT_EQ(thresholds[0].op, "Conv2D");
+  EXPECT_EQ(thresholds[0].cpu_family, 6);
+  EXPECT_EQ(thresholds[0].cpu_model_num, 0x55);
+  EXPECT_EQ(thresholds[0].params.thread_sync_cost, 0.25);
+  EXPECT_EQ(thresholds[0].params.framework_cost, 12.5);
+  EXPECT_EQ(thresholds[1].op, "MatMul");
+  EXPECT_EQ(thresholds[1].cpu_model_num, 85);
+  EXPECT_EQ(thresholds[1].params.framework_cost, -1.5);
+
+  thresholds.clear();
+  EXPECT_FALSE(
+      ParseRewriteThresholdProfile("Conv2D 0x6 0x55 0.25\n", &thresholds)
+          .ok());
+  EXPECT_FALSE(ParseRewriteThresholdProfile("Conv2D 0x6 0x55 0.25 1 extra\n",
+                                            &thresholds)
+                   .ok());
+}
+
 #ifdef DNNL_AARCH64_USE_ACL
 TEST(MklHeuristicsTest, MklThresholds) {
   int cpu_family = tsl::port::CPUFamily();
@@ -0,0 +1,359 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/mkl_primitive_snapshot.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr char kSnapshotHeader[] = "# oneDNN primitive snapshot v2";
+
+// Whether the calling thread replays records.
+thread_local bool replaying = false;
+
+uint64 DoubleToBits(double value) {
+  uint64 bits;
+  static_assert(sizeof(bits) == sizeof(value), "");
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double BitsToDouble(uint64 bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+bool IsHexString(StringPiece s) {
+  if (s.size() % 2 != 0) return false;
+  for (char c : s) {
+    if (!absl::ascii_isxdigit(c)) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void MklPrimitiveParamsWriter::AddInt(int64_t value) {
+  core::PutVarint64(&data_, static_cast<uint64>(value));
+}
+
+void MklPrimitiveParamsWriter::AddFloat(double value) {
+  core::PutVarint64(&data_, DoubleToBits(value));
+}
+
+void MklPrimitiveParamsWriter::AddString(StringPiece value) {
+  core::PutVarint64(&data_, value.size());
+  data_.append(value.data(), value.size());
+}
+
+void MklPrimitiveParamsWriter::AddInts(const std::vector<int64_t>& values) {
+  core::PutVarint64(&data_, values.size());
+  for (int64_t value : values) AddInt(value);
+}
+
+void MklPrimitiveParamsWriter::AddFloats(const std::vector<float>& values) {
+  core::PutVarint64(&data_, values.size());
+  for (float value : values) AddFloat(value);
+}
+
+bool MklPrimitiveParamsReader::ReadInt(int64_t* value) {
+  uint64 bits;
+  if (!core::GetVarint64(&data_, &bits)) return false;
+  *value = static_cast<int64_t>(bits);
+  return true;
+}
+
+bool MklPrimitiveParamsReader::ReadFloat(double* value) {
+  uint64 bits;
+  if (!core::GetVarint64(&data_, &bits)) return false;
+  *value = BitsToDouble(bits);
+  return true;
+}
+
+bool MklPrimitiveParamsReader::ReadBytes(size_t n, StringPiece* bytes) {
+  if (n > data_.size()) return false;
+  *bytes = data_.substr(0, n);
+  data_.remove_prefix(n);
+  return true;
+}
+
+bool MklPrimitiveParamsReader::ReadString(string* value) {
+  uint64 size;
+  StringPiece bytes;
+  if (!core::GetVarint64(&data_, &size) || !ReadBytes(size, &bytes)) {
+    return false;
+  }
+  value->assign(bytes.data(), bytes.size());
+  return true;
+}
+
+bool MklPrimitiveParamsReader::ReadInts(std::vector<int64_t>* values) {
+  uint64 size;
+  // Each value takes at least one byte, which bounds bogus sizes.
+  if (!core::GetVarint64(&data_, &size) || size > data_.size()) return false;
+  values->resize(size);
+  for (int64_t& value : *values) {
+    if (!ReadInt(&value)) return false;
+  }
+  return true;
+}
+
+bool MklPrimitiveParamsReader::ReadFloats(std::vector<float>* values) {
+  uint64 size;
+  if (!core::GetVarint64(&data_, &size) || size > data_.size()) return false;
+  values->resize(size);
+  for (float& value : *values) {
+    double d;
+    if (!ReadFloat(&d)) return false;
+    value = static_cast<float>(d);
+  }
+  return true;
+}
+
+MklPrimitiveSnapshot::MklPrimitiveSnapshot(const string& path)
+    : path_(path) {}
+
+MklPrimitiveSnapshot::~MklPrimitiveSnapshot() {
+  // Joins the replay thread before the members it uses go away.
+  StopReplay();
+}
+
+/* static */
+MklPrimitiveSnapshot* MklPrimitiveSnapshot::Global() {
+  static MklPrimitiveSnapshot* snapshot = [] {
+    string path;
+    Status status =
+        ReadStringFromEnvVar("TF_ONEDNN_PRIMITIVE_SNAPSHOT", "", &path);
+    if (!status.ok()) {
+      LOG(ERROR) << "MklPrimitiveSnapshot: " << status.message();
+      path.clear();
+    }
+    auto* snapshot = new MklPrimitiveSnapshot(path);
+    if (snapshot->enabled()) {
+      // Replays start with the first user of the snapshot, which is the first
+      // primitive factory that registers, whether in graph or eager mode.
+      snapshot->StartReplay();
+      std::atexit([] {
+        MklPrimitiveSnapshot* snapshot = MklPrimitiveSnapshot::Global();
+        snapshot->StopReplay();
+        Status status = snapshot->Save(snapshot->path());
+        if (!status.ok()) {
+          LOG(WARNING) << "Failed to save the oneDNN primitive snapshot: "
+                       << status;
+        }
+      });
+    }
+    return snapshot;
+  }();
+  return snapshot;
+}
+
+void MklPrimitiveSnapshot::RegisterFactory(const string& factory,
+                                           Replayer replayer) {
+  mutex_lock l(mu_);
+  replayers_[factory] = replayer;
+  auto it = pending_.find(factory);
+  if (it != pending_.end()) {
+    ScheduleReplay(std::move(replayer), std::move(it->second));
+    pending_.erase(it);
+  }
+}
+
+void MklPrimitiveSnapshot::Record(const string& factory,
+                                  const string& params) {
+  mutex_lock l(mu_);
+  RecordState& record = records_[RecordKey(factory, params)];
+  if (!replaying) record.used = true;
+}
+
+/* static */
+bool MklPrimitiveSnapshot::IsReplaying() { return replaying; }
+
+void MklPrimitiveSnapshot::StartReplay() {
+  if (!enabled()) return;
+  {
+    mutex_lock l(mu_);
+    if (replay_started_) return;
+    replay_started_ = true;
+  }
+  Status status = Restore(path_);
+  if (errors::IsNotFound(status)) {
+    VLOG(1) << "No oneDNN primitive snapshot at " << path_ << " yet";
+  } else if (!status.ok()) {
+    LOG(WARNING) << "Failed to restore the oneDNN primitive snapshot: "
+                 << status;
+  }
+}
+
+Status MklPrimitiveSnapshot::Restore(const string& path) {
+  string content;
+  TF_RETURN_IF_ERROR(ReadFileToString(Env::Default(), path, &content));
+
+  // The parameters and unused runs of the records by factory.
+  std::map<string, std::vector<std::pair<string, int>>> restored;
+  int line_number = 0;
+  for (StringPiece line : absl::StrSplit(content, '\n')) {
+    ++line_number;
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line[0] == '#') continue;
+    // Records of v1 snapshots have no unused runs.
+    std::vector<StringPiece> fields = absl::StrSplit(line, '\t');
+    int unused_runs = 0;
+    if ((fields.size() != 2 && fields.size() != 3) || fields[0].empty() ||
+        !IsHexString(fields[1]) ||
+        (fields.size() == 3 &&
+         (!absl::SimpleAtoi(fields[2], &unused_runs) || unused_runs < 0))) {
+      return errors::InvalidArgument("Malformed record at ", path, ":",
+                                     line_number);
+    }
+    restored[string(fields[0])].emplace_back(
+        absl::HexStringToBytes(fields[1]), unused_runs);
+  }
+
+  mutex_lock l(mu_);
+  for (auto& factory_params : restored) {
+    const string& factory = factory_params.first;
+    std::vector<string> params;
+    for (auto& p : factory_params.second) {
+      RecordState state;
+      state.unused_runs = p.second;
+      if (records_.emplace(RecordKey(factory, p.first), state).second) {
+        params.push_back(std::move(p.first));
+      }
+    }
+    if (params.empty()) continue;
+    auto it = replayers_.find(factory);
+    if (it != replayers_.end()) {
+      ScheduleReplay(it->second, std::move(params));
+    } else {
+      std::vector<string>& pending = pending_[factory];
+      pending.insert(pending.end(), std::make_move_iterator(params.begin()),
+                     std::make_move_iterator(params.end()));
+    }
+  }
+  return OkStatus();
+}
+
+Status MklPrimitiveSnapshot::Save(const string& path) const {
+  string content = absl::StrCat(kSnapshotHeader, "\n");
+  {
+    mutex_lock l(mu_);
+    // The records to keep with their unused runs including this one.
+    std::vector<std::pair<int, const RecordKey*>> kept;
+    for (const auto& record : records_) {
+      const int unused_runs =
+          record.second.used ? 0 : record.second.unused_runs + 1;
+      if (unused_runs <= kMaxUnusedRuns) {
+        kept.emplace_back(unused_runs, &record.first);
+      }
+    }
+    if (kept.size() > kMaxRecords) {
+      std::stable_sort(kept.begin(), kept.end(),
+                       [](const std::pair<int, const RecordKey*>& a,
+                          const std::pair<int, const RecordKey*>& b) {
+                         return a.first < b.first;
+                       });
+      kept.resize(kMaxRecords);
+    }
+    for (const auto& record : kept) {
+      absl::StrAppend(&content, record.second->first, "\t",
+                      absl::BytesToHexString(record.second->second), "\t",
+                      record.first, "\n");
+    }
+  }
+  // Writes a uniquely named temporary file first, so that concurrent readers
+  // never see a partially written snapshot, and processes saving the same
+  // snapshot at exit do not write into each other's file.
+  Env* env = Env::Default();
+  string tmp_path = absl::StrCat(path, ".");
+  if (!env->CreateUniqueFileName(&tmp_path, ".tmp")) {
+    return errors::AlreadyExists(
+        "Failed to create a unique temporary file name for ", path);
+  }
+  Status status = WriteStringToFile(env, tmp_path, content);
+  if (status.ok()) {
+    status = env->RenameFile(tmp_path, path);
+  }
+  if (!status.ok()) {
+    env->DeleteFile(tmp_path).IgnoreError();
+  }
+  return status;
+}
+
+void MklPrimitiveSnapshot::ScheduleReplay(Replayer replayer,
+                                          std::vector<string> params) {
+  if (replay_stopped_) return;
+  if (replay_pool_ == nullptr) {
+    replay_pool_.reset(new thread::ThreadPool(
+        Env::Default(), "onednn_primitive_replay", /*num_threads=*/1));
+  }
+  ++outstanding_replays_;
+  replay_pool_->Schedule(
+      [this, replayer = std::move(replayer), params = std::move(params)]() {
+        replaying = true;
+        for (const string& p : params) {
+          if (stop_replay_) break;
+          if (replayer(p)) {
+            ++num_replayed_;
+          } else {
+            ++num_replay_failures_;
+          }
+        }
+        replaying = false;
+        mutex_lock l(mu_);
+        if (--outstanding_replays_ == 0) replay_done_.notify_all();
+      });
+}
+
+void MklPrimitiveSnapshot::StopReplay() {
+  std::unique_ptr<thread::ThreadPool> replay_pool;
+  {
+    mutex_lock l(mu_);
+    replay_stopped_ = true;
+    replay_pool = std::move(replay_pool_);
+  }
+  stop_replay_ = true;
+  // Joins the replay thread, which skips the replays that are left.
+  replay_pool.reset();
+}
+
+void MklPrimitiveSnapshot::WaitForReplay() {
+  mutex_lock l(mu_);
+  while (outstanding_replays_ > 0) replay_done_.wait(l);
+}
+
+size_t MklPrimitiveSnapshot::num_records() const {
+  mutex_lock l(mu_);
+  return records_.size();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,192 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_UTIL_MKL_PRIMITIVE_SNAPSHOT_H_
+#define TENSORFLOW_CORE_UTIL_MKL_PRIMITIVE_SNAPSHOT_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/threadpool.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Serializes the parameters a primitive factory creates a primitive from, for
+// MklPrimitiveSnapshot. Values are appended in a fixed binary encoding and
+// must be read back in the same order with MklPrimitiveParamsReader.
+class MklPrimitiveParamsWriter {
+ public:
+  void AddInt(int64_t value);
+  void AddFloat(double value);
+  void AddString(StringPiece value);
+  void AddInts(const std::vector<int64_t>& values);
+  void AddFloats(const std::vector<float>& values);
+
+  const string& data() const { return data_; }
+
+ private:
+  string data_;
+};
+
+// Reads parameters written by MklPrimitiveParamsWriter. The Read* methods
+// return false if 'data' is truncated or malformed.
+class MklPrimitiveParamsReader {
+ public:
+  explicit MklPrimitiveParamsReader(StringPiece data) : data_(data) {}
+
+  bool ReadInt(int64_t* value);
+  bool ReadFloat(double* value);
+  bool ReadString(string* value);
+  bool ReadInts(std::vector<int64_t>* values);
+  bool ReadFloats(std::vector<float>* values);
+
+  // Returns true once all the data has been read.
+  bool done() const { return data_.empty(); }
+
+ private:
+  bool ReadBytes(size_t n, StringPiece* bytes);
+
+  StringPiece data_;
+};
+
+// Records the parameters of the oneDNN primitives that the primitive factories
+// create during a run, and re-creates those primitives when a later run of the
+// same model starts, so that the first requests after a restart do not pay for
+// primitive creation and JIT compilation.
+//
+// The snapshot is enabled by pointing the environment variable
+// TF_ONEDNN_PRIMITIVE_SNAPSHOT to a file. When the process first uses the
+// snapshot, Global() reads the file, if it exists, and replays its records on
+// a background thread. At exit, the replay is stopped and the records are
+// written back to the file. Records of primitives that no kernel used in the
+// last kMaxUnusedRuns runs are dropped then, and of the others at most
+// kMaxRecords are kept, the most recently used first.
+//
+// Each factory registers a replayer under a name unique to the factory and its
+// template arguments, and records the serialized parameters of every primitive
+// when a kernel first looks it up. Replaying a record calls the replayer with
+// those parameters, which creates and caches the primitive through the
+// factory. Records whose factory has not registered yet, e.g. because its
+// kernels live in a library that is loaded later, are replayed once it does.
+//
+// Note that the primitive caches of the factories are thread local if
+// TF_ONEDNN_SHARED_PRIMITIVE_CACHE is false. Replays then only warm up
+// oneDNN's own process-wide cache of JIT compiled kernels, which is where most
+// of the creation time goes.
+class MklPrimitiveSnapshot {
+ public:
+  // Creates the primitive for the serialized parameters. Returns false if the
+  // parameters cannot be parsed or the primitive cannot be created.
+  using Replayer = std::function<bool(StringPiece params)>;
+
+  // An empty 'path' disables the snapshot.
+  explicit MklPrimitiveSnapshot(const string& path);
+  ~MklPrimitiveSnapshot();
+
+  // Returns the process-wide snapshot, whose file is read from the environment
+  // variable TF_ONEDNN_PRIMITIVE_SNAPSHOT. If it is set, the replay of the
+  // file starts with the first call, and the snapshot is saved to that file
+  // at exit.
+  static MklPrimitiveSnapshot* Global();
+
+  // Records that no kernel used in this many consecutive runs are dropped.
+  static constexpr int kMaxUnusedRuns = 8;
+  // The maximum number of records saved.
+  static constexpr size_t kMaxRecords = 4096;
+
+  bool enabled() const { return !path_.empty(); }
+  const string& path() const { return path_; }
+
+  // Registers the replayer of 'factory' and schedules the replay of the
+  // records already restored for it.
+  void RegisterFactory(const string& factory, Replayer replayer)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  // Records that a kernel used the primitive that 'factory' created from
+  // 'params'. Records made by replays do not count as used by the run.
+  void Record(const string& factory, const string& params)
+      TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns whether the calling thread replays records.
+  static bool IsReplaying();
+
+  // Restores the snapshot from the file once per process, replaying its
+  // records on a background thread. Does nothing if the snapshot is disabled
+  // or the file does not exist yet.
+  void StartReplay();
+
+  // Gives up the replays that have not run yet, and joins the replay thread.
+  void StopReplay() TF_LOCKS_EXCLUDED(mu_);
+
+  // Reads the records of 'path' and schedules their replay.
+  Status Restore(const string& path) TF_LOCKS_EXCLUDED(mu_);
+
+  // Writes the records, restored or recorded, to 'path', dropping the ones
+  // unused for too long.
+  Status Save(const string& path) const TF_LOCKS_EXCLUDED(mu_);
+
+  // Blocks until all scheduled replays are done.
+  void WaitForReplay() TF_LOCKS_EXCLUDED(mu_);
+
+  size_t num_records() const TF_LOCKS_EXCLUDED(mu_);
+  int64_t num_replayed() const { return num_replayed_.load(); }
+  int64_t num_replay_failures() const { return num_replay_failures_.load(); }
+
+ private:
+  using RecordKey = std::pair<string, string>;
+
+  struct RecordState {
+    // The number of consecutive earlier runs in which no kernel used the
+    // primitive.
+    int unused_runs = 0;
+    // Whether a kernel of this run used the primitive.
+    bool used = false;
+  };
+
+  // Replays 'params' with 'replayer' on the background thread.
+  void ScheduleReplay(Replayer replayer, std::vector<string> params)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const string path_;
+
+  mutable mutex mu_;
+  std::map<RecordKey, RecordState> records_ TF_GUARDED_BY(mu_);
+  std::map<string, Replayer> replayers_ TF_GUARDED_BY(mu_);
+  // Restored parameters of factories that have not registered yet.
+  std::map<string, std::vector<string>> pending_ TF_GUARDED_BY(mu_);
+  std::unique_ptr<thread::ThreadPool> replay_pool_ TF_GUARDED_BY(mu_);
+  int64_t outstanding_replays_ TF_GUARDED_BY(mu_) = 0;
+  condition_variable replay_done_;
+  bool replay_started_ TF_GUARDED_BY(mu_) = false;
+  bool replay_stopped_ TF_GUARDED_BY(mu_) = false;
+  std::atomic<bool> stop_replay_{false};
+
+  std::atomic<int64_t> num_replayed_{0};
+  std::atomic<int64_t> num_replay_failures_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MklPrimitiveSnapshot);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_UTIL_MKL_PRIMITIVE_SNAPSHOT_H_
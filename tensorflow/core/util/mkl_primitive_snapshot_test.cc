@@ -0,0 +1,171 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/mkl_primitive_snapshot.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+string SnapshotPath(const string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+TEST(MklPrimitiveSnapshotTest, ParamsRoundTrip) {
+  MklPrimitiveParamsWriter writer;
+  writer.AddInt(-3);
+  writer.AddFloat(0.5);
+  writer.AddString(string("a\0b", 3));
+  writer.AddInts({1, 64, 1LL << 40});
+  writer.AddFloats({1.0f, -2.5f});
+
+  MklPrimitiveParamsReader reader(writer.data());
+  int64_t i;
+  double f;
+  string s;
+  std::vector<int64_t> ints;
+  std::vector<float> floats;
+  ASSERT_TRUE(reader.ReadInt(&i));
+  ASSERT_TRUE(reader.ReadFloat(&f));
+  ASSERT_TRUE(reader.ReadString(&s));
+  ASSERT_TRUE(reader.ReadInts(&ints));
+  ASSERT_TRUE(reader.ReadFloats(&floats));
+  EXPECT_TRUE(reader.done());
+  EXPECT_EQ(i, -3);
+  EXPECT_EQ(f, 0.5);
+  EXPECT_EQ(s, string("a\0b", 3));
+  EXPECT_EQ(ints, std::vector<int64_t>({1, 64, 1LL << 40}));
+  EXPECT_EQ(floats, std::vector<float>({1.0f, -2.5f}));
+
+  // Truncated data fails to parse.
+  MklPrimitiveParamsReader truncated(
+      StringPiece(writer.data()).substr(0, writer.data().size() - 1));
+  ASSERT_TRUE(truncated.ReadInt(&i));
+  ASSERT_TRUE(truncated.ReadFloat(&f));
+  ASSERT_TRUE(truncated.ReadString(&s));
+  ASSERT_TRUE(truncated.ReadInts(&ints));
+  EXPECT_FALSE(truncated.ReadFloats(&floats));
+}
+
+TEST(MklPrimitiveSnapshotTest, SaveAndRestore) {
+  const string path = SnapshotPath("save_and_restore");
+  {
+    MklPrimitiveSnapshot snapshot(path);
+    snapshot.Record("matmul", "params1");
+    snapshot.Record("matmul", "params1");
+    snapshot.Record("matmul", string("\t\n", 2));
+    snapshot.Record("conv", "params2");
+    EXPECT_EQ(snapshot.num_records(), 3);
+    TF_ASSERT_OK(snapshot.Save(path));
+  }
+
+  mutex mu;
+  std::vector<string> matmul_replays;
+  MklPrimitiveSnapshot snapshot(path);
+  // Records of factories registered before the restore are replayed right
+  // away, the others once their factory registers.
+  snapshot.RegisterFactory("matmul", [&](StringPiece params) {
+    mutex_lock l(mu);
+    matmul_replays.emplace_back(params);
+    return true;
+  });
+  TF_ASSERT_OK(snapshot.Restore(path));
+  snapshot.WaitForReplay();
+  EXPECT_EQ(snapshot.num_replayed(), 2);
+  {
+    mutex_lock l(mu);
+    EXPECT_EQ(matmul_replays,
+              std::vector<string>({string("\t\n", 2), "params1"}));
+  }
+
+  snapshot.RegisterFactory("conv", [](StringPiece params) { return false; });
+  snapshot.WaitForReplay();
+  EXPECT_EQ(snapshot.num_replayed(), 2);
+  EXPECT_EQ(snapshot.num_replay_failures(), 1);
+  EXPECT_EQ(snapshot.num_records(), 3);
+}
+
+TEST(MklPrimitiveSnapshotTest, DropsRecordsUnusedForTooLong) {
+  const string path = SnapshotPath("unused_records");
+  const int max_unused_runs = MklPrimitiveSnapshot::kMaxUnusedRuns;
+  // "6f6c64" and "6e6577" are the hex encodings of "old" and "new".
+  TF_ASSERT_OK(WriteStringToFile(
+      Env::Default(), path,
+      absl::StrCat("matmul\t6f6c64\t", max_unused_runs, "\n",
+                   "matmul\t6e6577\t", max_unused_runs, "\n")));
+  {
+    MklPrimitiveSnapshot snapshot(path);
+    // Replays do not count as uses, unlike the record of a kernel.
+    snapshot.RegisterFactory("matmul", [&](StringPiece params) {
+      snapshot.Record("matmul", string(params));
+      return true;
+    });
+    TF_ASSERT_OK(snapshot.Restore(path));
+    snapshot.WaitForReplay();
+    EXPECT_EQ(snapshot.num_replayed(), 2);
+    snapshot.Record("matmul", "new");
+    snapshot.Record("conv", "params");
+    TF_ASSERT_OK(snapshot.Save(path));
+  }
+
+  MklPrimitiveSnapshot snapshot(path);
+  TF_ASSERT_OK(snapshot.Restore(path));
+  EXPECT_EQ(snapshot.num_records(), 2);
+}
+
+TEST(MklPrimitiveSnapshotTest, StopReplay) {
+  const string path = SnapshotPath("stop_replay");
+  {
+    MklPrimitiveSnapshot snapshot(path);
+    snapshot.Record("matmul", "params1");
+    snapshot.Record("matmul", "params2");
+    TF_ASSERT_OK(snapshot.Save(path));
+  }
+
+  MklPrimitiveSnapshot snapshot(path);
+  TF_ASSERT_OK(snapshot.Restore(path));
+  snapshot.StopReplay();
+  // Factories registering after the stop replay nothing, while the records
+  // are still saved.
+  snapshot.RegisterFactory("matmul", [](StringPiece params) { return true; });
+  snapshot.WaitForReplay();
+  EXPECT_EQ(snapshot.num_replayed(), 0);
+  TF_ASSERT_OK(snapshot.Save(path));
+  EXPECT_EQ(snapshot.num_records(), 2);
+}
+
+TEST(MklPrimitiveSnapshotTest, RejectsMalformedSnapshot) {
+  const string path = SnapshotPath("malformed");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, "matmul\tnot_hex\n"));
+  MklPrimitiveSnapshot snapshot(path);
+  EXPECT_FALSE(snapshot.Restore(path).ok());
+  EXPECT_EQ(snapshot.num_records(), 0);
+}
+
+TEST(MklPrimitiveSnapshotTest, DisabledWithoutPath) {
+  MklPrimitiveSnapshot snapshot("");
+  EXPECT_FALSE(snapshot.enabled());
+  snapshot.StartReplay();
+  EXPECT_EQ(snapshot.num_records(), 0);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -17,13 +17,22 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_MKL_UTIL_H_
 #ifdef INTEL_MKL
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <list>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
 #include "dnnl.hpp"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -32,16 +41,19 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/hash.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/mkl_primitive_snapshot.h"
 #include "tensorflow/core/util/onednn_env_vars.h"
 #include "tensorflow/core/util/padding.h"
 #include "tensorflow/core/util/tensor_format.h"
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-#include "tensorflow/core/platform/mutex.h"
-#endif
 #include "tsl/util/onednn_threadpool.h"
 
 using dnnl::engine;
@@ -159,6 +171,54 @@ inline void execute_primitives(
   }
 }
 
+// MklMemoryBindings holds the data of one execution of a cached primitive.
+// Cached primitives are shared by the threads of the process, so an execution
+// does not set its data handles on the memory objects of the primitive.
+// Instead, each memory object bound here is replaced, in the arguments of this
+// execution only, by a memory object with the same descriptor over the data
+// of the execution. The oneDNN primitives themselves hold no data and are
+// executed by several threads at once.
+class MklMemoryBindings {
+ public:
+  MklMemoryBindings() {}
+
+  // Binds 'data' to 'mem' for this execution.
+  void Bind(const std::shared_ptr<memory>& mem, const void* data) {
+    bound_.emplace_back(mem->get(), memory(mem->get_desc(), mem->get_engine(),
+                                           const_cast<void*>(data)));
+  }
+
+  // Returns 'args' with the bound memory objects replaced.
+  MemoryArgsMap Apply(const MemoryArgsMap& args) const {
+    MemoryArgsMap bound_args = args;
+    for (auto& arg : bound_args) {
+      for (auto it = bound_.rbegin(); it != bound_.rend(); ++it) {
+        if (it->first == arg.second.get()) {
+          arg.second = it->second;
+          break;
+        }
+      }
+    }
+    return bound_args;
+  }
+
+ private:
+  gtl::InlinedVector<std::pair<dnnl_memory_t, memory>, 8> bound_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MklMemoryBindings);
+};
+
+inline void execute_primitives(
+    const std::vector<dnnl::primitive>& primitives,
+    std::shared_ptr<stream> stream,
+    const std::vector<std::unordered_map<int, memory>>& net_args,
+    const MklMemoryBindings& bindings) {
+  DCHECK_EQ(primitives.size(), net_args.size());
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    primitives.at(i).execute(*stream, bindings.Apply(net_args.at(i)));
+  }
+}
+
 #ifndef ENABLE_ONEDNN_V3
 #define ARE_MEMORY_DESCS_EQUAL(md1, md2) dnnl_memory_desc_equal(&md1, &md2)
 #define CREATE_MEMORY_DESC_USING_STRIDES dnnl_memory_desc_init_by_strides
@@ -1820,6 +1880,170 @@ class MklDnnData {
   }
 };
 
+/// Batch-size bucketing of primitives for inputs whose batch varies per run.
+///
+/// TF_ONEDNN_BATCH_BUCKETS lists the batch sizes to create primitives for,
+/// either explicitly ("1,8,32,128,256") or as "pow2". Kernels that support
+/// padded execution round their batch up to the next bucket and run the
+/// bucket-sized primitive on zero-padded rows, so a handful of primitives
+/// serves every batch size. Batches above the largest bucket are not rounded.
+///
+/// TF_ONEDNN_WARMUP_BATCH_RANGE ("lo:hi") makes kernels create the primitives
+/// for every batch in [lo, hi] in the background when they first run, so that
+/// batch sizes seen later do not pay primitive creation on the request path.
+/// Warm-up fills the cache shared by all threads, and is skipped if
+/// TF_ONEDNN_SHARED_PRIMITIVE_CACHE is false.
+///
+/// Only _MklFusedMatMul pads its batch. Convolutions may produce blocked
+/// layouts, where padded rows cannot be dropped cheaply, so they warm up each
+/// batch of the range. Plain _MklMatMul calls oneDNN's sgemm for float, which
+/// caches no primitives, and neither pads nor warms up.
+class MklBatchBuckets {
+ public:
+  /// Parses a TF_ONEDNN_BATCH_BUCKETS value into sorted, unique buckets.
+  static Status Parse(const string& setting, std::vector<int64_t>* buckets) {
+    buckets->clear();
+    if (setting.empty()) return OkStatus();
+    if (setting == "pow2") {
+      for (int64_t b = 1; b <= kMaxPow2Bucket; b *= 2) buckets->push_back(b);
+      return OkStatus();
+    }
+    for (absl::string_view field : absl::StrSplit(setting, ',')) {
+      int64_t bucket;
+      if (!absl::SimpleAtoi(field, &bucket) || bucket <= 0) {
+        return errors::InvalidArgument("Invalid batch bucket '", field,
+                                       "' in '", setting, "'");
+      }
+      buckets->push_back(bucket);
+    }
+    std::sort(buckets->begin(), buckets->end());
+    buckets->erase(std::unique(buckets->begin(), buckets->end()),
+                   buckets->end());
+    return OkStatus();
+  }
+
+  /// Returns the configured buckets in increasing order, or an empty list
+  /// when bucketing is disabled.
+  static const std::vector<int64_t>& Buckets() {
+    static const std::vector<int64_t>* buckets = [] {
+      string setting;
+      TF_CHECK_OK(
+          ReadStringFromEnvVar("TF_ONEDNN_BATCH_BUCKETS", "", &setting));
+      auto* parsed = new std::vector<int64_t>();
+      Status s = Parse(setting, parsed);
+      if (!s.ok()) {
+        LOG(WARNING) << "Batch bucketing disabled: " << s;
+        parsed->clear();
+      }
+      return parsed;
+    }();
+    return *buckets;
+  }
+
+  /// Rounds `batch` up to its bucket.
+  static int64_t RoundUp(int64_t batch,
+                         const std::vector<int64_t>& buckets = Buckets()) {
+    auto it = std::lower_bound(buckets.begin(), buckets.end(), batch);
+    return it == buckets.end() ? batch : *it;
+  }
+
+  /// Returns the batch sizes whose primitives serve every batch in [lo, hi],
+  /// i.e. their buckets if the kernel pads, or every batch otherwise.
+  static std::vector<int64_t> Cover(
+      int64_t lo, int64_t hi, bool padded,
+      const std::vector<int64_t>& buckets = Buckets()) {
+    std::vector<int64_t> batches;
+    for (int64_t batch = std::max<int64_t>(lo, 1); batch <= hi; ++batch) {
+      int64_t target = padded ? RoundUp(batch, buckets) : batch;
+      if (batches.empty() || batches.back() != target) {
+        batches.push_back(target);
+      }
+    }
+    return batches;
+  }
+
+  /// Returns true and sets [lo, hi] if TF_ONEDNN_WARMUP_BATCH_RANGE is set.
+  static bool WarmUpRange(int64_t* lo, int64_t* hi) {
+    static const std::pair<int64_t, int64_t> range = [] {
+      string setting;
+      TF_CHECK_OK(
+          ReadStringFromEnvVar("TF_ONEDNN_WARMUP_BATCH_RANGE", "", &setting));
+      std::pair<int64_t, int64_t> parsed(0, -1);
+      if (setting.empty()) return parsed;
+      std::vector<string> fields = absl::StrSplit(setting, ':');
+      if (fields.size() != 2 || !absl::SimpleAtoi(fields[0], &parsed.first) ||
+          !absl::SimpleAtoi(fields[1], &parsed.second) || parsed.first < 1 ||
+          parsed.second < parsed.first) {
+        LOG(WARNING) << "Ignoring invalid TF_ONEDNN_WARMUP_BATCH_RANGE '"
+                     << setting << "'; expected lo:hi.";
+        return std::pair<int64_t, int64_t>(0, -1);
+      }
+      return parsed;
+    }();
+    if (range.second < range.first) return false;
+    *lo = range.first;
+    *hi = range.second;
+    return true;
+  }
+
+ private:
+  static constexpr int64_t kMaxPow2Bucket = 4096;
+};
+
+/// Function to check whether cached primitives are shared by all threads of
+/// the process. A shared primitive is created once per process for each key
+/// and executed by several threads at once, each binding the data of its
+/// execution with MklMemoryBindings. Primitives are shared unless
+/// TF_ONEDNN_SHARED_PRIMITIVE_CACHE is false, in which case each thread
+/// caches its own primitives. Primitives are always shared with ACL and
+/// OpenMP.
+inline bool IsMklPrimitiveCacheShared() {
+#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  return true;
+#else
+  static const bool is_shared = [] {
+    bool value = true;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_ONEDNN_SHARED_PRIMITIVE_CACHE", true,
+                                   &value));
+    return value;
+  }();
+  return is_shared;
+#endif
+}
+
+/// Locks the execution mutex of a primitive with ACL and OpenMP, whose
+/// primitives hold state of their executions, and does nothing otherwise.
+class MklPrimitiveExecutionLock {
+ public:
+#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
+  explicit MklPrimitiveExecutionLock(mutex* mu) : lock_(*mu) {}
+
+ private:
+  mutex_lock lock_;
+#else
+  explicit MklPrimitiveExecutionLock(mutex* mu) {}
+#endif  // DNNL_AARCH64_USE_ACL && ENABLE_ONEDNN_OPENMP
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MklPrimitiveExecutionLock);
+};
+
+/// Counters of the primitive caches of the process.
+struct MklPrimitiveCacheStats {
+  std::atomic<int64_t> hits{0};
+  std::atomic<int64_t> misses{0};
+  // Lookups of a shared primitive that waited for another thread creating it.
+  std::atomic<int64_t> waits{0};
+  // Primitives created on a miss, and the time spent creating them.
+  std::atomic<int64_t> creations{0};
+  std::atomic<int64_t> creation_micros{0};
+  std::atomic<int64_t> evictions{0};
+};
+
+inline MklPrimitiveCacheStats& GetMklPrimitiveCacheStats() {
+  static MklPrimitiveCacheStats* stats = new MklPrimitiveCacheStats;
+  return *stats;
+}
+
 /// Base class for operations with reuse of primitives
 class MklPrimitive {
  public:
@@ -1830,10 +2054,72 @@ class MklPrimitive {
   unsigned char* DummyData = nullptr;
   engine cpu_engine_ = engine(engine::kind::cpu, 0);
   const engine& GetEngine() { return cpu_engine_; }
+  // Bytes of data owned by the primitive, such as cached weights, which count
+  // against the byte capacity of the shared primitive cache.
+  virtual size_t GetMemoryBytes() const { return 0; }
+
+  // Primitives of the shared cache are reference counted, since a primitive
+  // evicted by one thread may still be used by others. A new primitive holds
+  // the reference of its creator, the cache holds one and each thread using
+  // the primitive holds one in its MklPrimitivePinScope.
+  void Ref() const { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void Unref() const {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  // Returns true for the first call only, see RecordMklPrimitiveUse().
+  bool MarkUsedByKernel() {
+    return !used_by_kernel_.load(std::memory_order_relaxed) &&
+           !used_by_kernel_.exchange(true, std::memory_order_relaxed);
+  }
+
+ private:
+  mutable std::atomic<int> refs_{1};
+  std::atomic<bool> used_by_kernel_{false};
 };
 
 const dnnl::memory::dims NONE_DIMS = {};
 
+// MklPrimitiveKey is the binary key of a cached primitive, as built by
+// FactoryKeyCreator. The key bytes are hashed once when the key is built, so
+// that cache lookups compare the precomputed hashes first and never rehash
+// the key. Keys of common primitives fit in the inline buffer.
+class MklPrimitiveKey {
+ public:
+  MklPrimitiveKey() { Rehash(); }
+  explicit MklPrimitiveKey(const char* bytes)
+      : MklPrimitiveKey(StringPiece(bytes)) {}
+  explicit MklPrimitiveKey(const string& bytes)
+      : MklPrimitiveKey(StringPiece(bytes)) {}
+  explicit MklPrimitiveKey(StringPiece bytes)
+      : bytes_(bytes.begin(), bytes.end()) {
+    Rehash();
+  }
+
+  uint64 hash() const { return hash_; }
+  StringPiece bytes() const {
+    return StringPiece(bytes_.data(), bytes_.size());
+  }
+
+  bool operator==(const MklPrimitiveKey& other) const {
+    return hash_ == other.hash_ && bytes_.size() == other.bytes_.size() &&
+           memcmp(bytes_.data(), other.bytes_.data(), bytes_.size()) == 0;
+  }
+
+  struct Hasher {
+    size_t operator()(const MklPrimitiveKey& key) const { return key.hash_; }
+  };
+
+ private:
+  friend class FactoryKeyCreator;
+  static constexpr int kInlineBytes = 384;
+
+  void Rehash() { hash_ = Hash64(bytes_.data(), bytes_.size()); }
+
+  gtl::InlinedVector<char, kInlineBytes> bytes_;
+  uint64 hash_;
+};
+
 //
 // LRUCache is a class which implements LRU (Least Recently Used) cache.
 // The implementation is similar to that of
@@ -1844,7 +2130,8 @@ const dnnl::memory::dims NONE_DIMS = {};
 // The LRU list maintains objects in chronological order based on
 // creation time, with the least recently accessed object at the
 // tail of LRU list, while the most recently accessed object
-// at the head of LRU list.
+// at the head of LRU list. The list is threaded through the cache
+// entries, so a cache hit only relinks the entry and never allocates.
 //
 // This class is used to maintain an upper bound on the total number of
 // cached items. When the cache reaches its capacity, the LRU item will
@@ -1855,183 +2142,467 @@ class LRUCache {
  public:
   explicit LRUCache(size_t capacity) {
     capacity_ = capacity;
-    Clear();
+    head_.prev = &head_;
+    head_.next = &head_;
   }
 
-  T* GetOp(const string& key) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(lru_mu_);
-#endif
+  T* GetOp(const MklPrimitiveKey& key) {
     auto it = cache_.find(key);
     if (it == cache_.end()) {
       return nullptr;
     }
 
     // Move to the front of LRU list as the most recently accessed.
-    lru_list_.erase(it->second.lru_iterator);
-    lru_list_.push_front(it->first);
-    it->second.lru_iterator = lru_list_.begin();
-    return it->second.op;
+    Entry* entry = &it->second;
+    Unlink(entry);
+    LinkFront(entry);
+    return entry->op;
   }
 
-  void SetOp(const string& key, T* op) {
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    mutex_lock lock(lru_mu_);
-#endif
-    if (lru_list_.size() >= capacity_) {
+  void SetOp(const MklPrimitiveKey& key, T* op) {
+    if (cache_.size() >= capacity_) {
       Delete();
     }
 
     // Insert an entry to the front of the LRU list
-    lru_list_.push_front(key);
-    Entry entry(op, lru_list_.begin());
-    cache_.emplace(std::make_pair(key, std::move(entry)));
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-    FinishedAllocation(key);
-#endif
+    auto result = cache_.try_emplace(key);
+    Entry* entry = &result.first->second;
+    if (!result.second) {
+      // Replace the op of an existing entry.
+      delete entry->op;
+      Unlink(entry);
+    }
+    entry->op = op;
+    entry->key = &result.first->first;
+    LinkFront(entry);
   }
 
   void Clear() {
-    if (lru_list_.empty()) return;
+    if (cache_.empty()) return;
 
     // Clean up the cache
     cache_.clear();
-    lru_list_.clear();
-  }
-
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  bool IsAllocating(const string& key) {
-    mutex_lock lock(in_flight_mu_);
-    return in_flight_.find(key) != in_flight_.end();
-  }
-
-  void Allocate(const string& key) {
-    mutex_lock lock(in_flight_mu_);
-    in_flight_.insert(key);
+    head_.prev = &head_;
+    head_.next = &head_;
   }
 
-  void FinishedAllocation(const string& key) {
-    mutex_lock lock(in_flight_mu_);
-    in_flight_.erase(key);
-  }
-#endif
-
  private:
   struct Entry {
-    // The entry's value.
-    T* op;
-
-    // A list iterator pointing to the entry's position in the LRU list.
-    std::list<string>::iterator lru_iterator;
-
-    // Constructor
-    Entry(T* op, std::list<string>::iterator it) {
-      this->op = op;
-      this->lru_iterator = it;
-    }
-
-    // Move constructor
-    Entry(Entry&& source) noexcept
-        : lru_iterator(std::move(source.lru_iterator)) {
-      op = std::move(source.op);
-      source.op = std::forward<T*>(nullptr);
-    }
+    Entry() = default;
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
 
     // Destructor
     ~Entry() {
       if (op != nullptr) delete op;
     }
+
+    // The entry's value.
+    T* op = nullptr;
+
+    // The entry's key, owned by cache_.
+    const MklPrimitiveKey* key = nullptr;
+
+    // The neighbours of the entry in the LRU list.
+    Entry* prev = nullptr;
+    Entry* next = nullptr;
   };
 
+  void Unlink(Entry* entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+  }
+
+  void LinkFront(Entry* entry) {
+    entry->prev = &head_;
+    entry->next = head_.next;
+    head_.next->prev = entry;
+    head_.next = entry;
+  }
+
   // Remove the least recently accessed entry from LRU list, which
-  // is the tail of lru_list_. Update cache_ correspondingly.
+  // is the tail of the list. Update cache_ correspondingly.
   bool Delete() {
-    if (lru_list_.empty()) return false;
-    string key = lru_list_.back();
-    lru_list_.pop_back();
-    cache_.erase(key);
+    Entry* entry = head_.prev;
+    if (entry == &head_) return false;
+    Unlink(entry);
+    cache_.erase(cache_.find(*entry->key));
+    GetMklPrimitiveCacheStats().evictions.fetch_add(1,
+                                                    std::memory_order_relaxed);
     return true;
   }
 
   // Cache capacity
   size_t capacity_;
 
-  // The cache, a map from string key to a LRU entry.
-  std::unordered_map<string, Entry> cache_;
+  // The cache, a map from the key to a LRU entry.
+  std::unordered_map<MklPrimitiveKey, Entry, MklPrimitiveKey::Hasher> cache_;
 
-  // The LRU list of entries.
-  // The front of the list contains the key of the most recently accessed
-  // entry, while the back of the list is the least recently accessed entry.
-  std::list<string> lru_list_;
-
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  // Guards access to the cache and LRU list
-  mutex lru_mu_;
+  // Sentinel of the LRU list of entries.
+  // Its next entry is the most recently accessed entry, while its previous
+  // entry is the least recently accessed entry.
+  Entry head_;
 
-  // The keys that are currently under creation
-  std::set<string> in_flight_;
-  TF_GUARDED_BY(in_flight_mu_)
-  mutex in_flight_mu_;
-#endif
+  TF_DISALLOW_COPY_AND_ASSIGN(LRUCache);
 };
 
+// MklSharedPrimitiveCache is a process-wide primitive cache shared by all
+// threads. Keys are spread over shards, each with its own lock and LRU list,
+// so that lookups of different primitives rarely contend. Each shard holds at
+// most its share of 'capacity' entries and of 'capacity_bytes' bytes, as
+// reported by MklPrimitive::GetMemoryBytes(), where 0 means no byte bound.
+//
+// The cache holds a reference to each of its primitives, see MklPrimitive,
+// and hands out primitives with a reference taken for the caller. An evicted
+// primitive is deleted when the last thread using it releases its reference.
+//
+// Creation is single-flight: the first thread missing a key gets nullptr and
+// creates the primitive, while other threads looking up the key wait until it
+// is inserted by SetOp(). If the creator gives up with AbortOp(), the waiting
+// threads fail with its error, or one of them takes over the creation. A
+// creation that is neither finished nor aborted in time is taken over too.
 template <typename T>
-class MklPrimitiveFactory {
+class MklSharedPrimitiveCache {
  public:
-  MklPrimitiveFactory() {}
+  MklSharedPrimitiveCache(size_t capacity, size_t capacity_bytes)
+      : shard_capacity_(std::max<size_t>(1, capacity / kNumShards)),
+        shard_capacity_bytes_(capacity_bytes / kNumShards) {
+    for (Shard& shard : shards_) {
+      shard.head.prev = &shard.head;
+      shard.head.next = &shard.head;
+    }
+  }
 
-  ~MklPrimitiveFactory() {}
+  ~MklSharedPrimitiveCache() {
+    for (Shard& shard : shards_) {
+      for (auto& entry : shard.cache) entry.second.op->Unref();
+    }
+  }
 
-  MklPrimitive* GetOp(const string& key) {
-#if !defined(DNNL_AARCH64_USE_ACL) || !defined(ENABLE_ONEDNN_OPENMP)
-    auto& lru_cache = MklPrimitiveFactory<T>::GetLRUCache();
-    return lru_cache.GetOp(key);
-#else
+  // Looks up the primitive of 'key'. On a hit, sets '*op' to the primitive,
+  // which the caller releases with Unref(). On a miss, sets '*op' to nullptr
+  // and makes the caller the creator of the primitive, who finishes with
+  // SetOp() or AbortOp(). Fails with the error of the creator if this thread
+  // waited for a creation that failed.
+  Status GetOp(const MklPrimitiveKey& key, T** op) {
+    *op = nullptr;
+    Shard& shard = GetShard(key);
+    mutex_lock lock(shard.mu);
+    // The creation this thread waits for, if any.
+    uint64 waited_creation = 0;
     while (true) {
-      // TODO(milpuz01): Consider if it is possible to narrow scope to be
-      // only around checks for allocations and conditional wait.
-      mutex_lock lock(primitive_creation_mu_);
-      auto& lru_cache = MklPrimitiveFactory<T>::GetLRUCache();
+      if (waited_creation != 0) {
+        auto failure = shard.failures.find(waited_creation);
+        if (failure != shard.failures.end()) {
+          Status error = failure->second.error;
+          if (--failure->second.waiters == 0) shard.failures.erase(failure);
+          return error;
+        }
+      }
+      auto it = shard.cache.find(key);
+      if (it != shard.cache.end()) {
+        // Move to the front of LRU list as the most recently accessed.
+        Entry* entry = &it->second;
+        Unlink(entry);
+        LinkFront(&shard, entry);
+        entry->op->Ref();
+        *op = entry->op;
+        return OkStatus();
+      }
+      const uint64 now_micros = EnvTime::NowMicros();
+      auto in_flight = shard.in_flight.find(key);
+      if (in_flight == shard.in_flight.end()) {
+        // This thread is going to create the primitive.
+        InFlight& creation = shard.in_flight[key];
+        creation.id = ++shard.last_creation;
+        creation.start_micros = now_micros;
+        return OkStatus();
+      }
+      InFlight& creation = in_flight->second;
+      if (creation.id != waited_creation) {
+        waited_creation = creation.id;
+        ++creation.waiters;
+        GetMklPrimitiveCacheStats().waits.fetch_add(1,
+                                                    std::memory_order_relaxed);
+      }
+      const uint64 waited_micros = now_micros - creation.start_micros;
+      if (waited_micros >= kCreationTimeoutMicros) {
+        // The creator went away without finishing the creation, e.g. since
+        // it created the primitive outside of an MklPrimitivePinScope.
+        --creation.waiters;
+        creation.start_micros = now_micros;
+        return OkStatus();
+      }
+      shard.cv.wait_for(lock, std::chrono::microseconds(kCreationTimeoutMicros -
+                                                        waited_micros));
+    }
+  }
 
-      // Check to see whether primitive already exists.
-      MklPrimitive* primitive = lru_cache.GetOp(key);
-      if (primitive != nullptr) {
-        return primitive;
+  // Finishes the creation of 'key' by inserting 'op'. The cache takes its own
+  // reference to 'op', while the creator keeps its reference.
+  void SetOp(const MklPrimitiveKey& key, T* op) {
+    Shard& shard = GetShard(key);
+    gtl::InlinedVector<T*, 4> evicted_ops;
+    {
+      mutex_lock lock(shard.mu);
+      shard.in_flight.erase(key);
+      auto result = shard.cache.try_emplace(key);
+      if (result.second) {
+        Entry* entry = &result.first->second;
+        op->Ref();
+        entry->op = op;
+        entry->bytes = op->GetMemoryBytes();
+        entry->key = &result.first->first;
+        LinkFront(&shard, entry);
+        shard.bytes += entry->bytes;
+        while (shard.cache.size() > 1 &&
+               (shard.cache.size() > shard_capacity_ ||
+                (shard_capacity_bytes_ > 0 &&
+                 shard.bytes > shard_capacity_bytes_))) {
+          Entry* evicted = shard.head.prev;
+          Unlink(evicted);
+          shard.bytes -= evicted->bytes;
+          evicted_ops.push_back(evicted->op);
+          shard.cache.erase(shard.cache.find(*evicted->key));
+          GetMklPrimitiveCacheStats().evictions.fetch_add(
+              1, std::memory_order_relaxed);
+        }
       }
+      // Otherwise the creation was taken over and the primitive already
+      // inserted, so 'op' is deleted when its creator releases it.
+    }
+    // Now we can inform all waiting threads that primitive is created.
+    shard.cv.notify_all();
+    for (T* evicted_op : evicted_ops) evicted_op->Unref();
+  }
 
-      // Now check whether some other thread is creating this primitive.
-      if (!lru_cache.IsAllocating(key)) {
-        // This thread is going to pick it up and create the primitive.
-        lru_cache.Allocate(key);
-        return nullptr;
-        // Now we release lock as primitive creation might take long time.
+  // Ends the creation of 'key' without inserting a primitive. The threads
+  // waiting for it fail with 'error', or if it is OK, one of them takes over.
+  void AbortOp(const MklPrimitiveKey& key, const Status& error) {
+    Shard& shard = GetShard(key);
+    {
+      mutex_lock lock(shard.mu);
+      auto in_flight = shard.in_flight.find(key);
+      if (in_flight == shard.in_flight.end()) return;
+      const InFlight& creation = in_flight->second;
+      if (!error.ok() && creation.waiters > 0) {
+        Failure& failure = shard.failures[creation.id];
+        failure.error = error;
+        failure.waiters = creation.waiters;
       }
+      shard.in_flight.erase(in_flight);
+    }
+    shard.cv.notify_all();
+  }
 
-      // At this point we cannot create primitive as other thread is creating
-      // it. We should wait for primitive to get created.
-      primitive_creation_cv_.wait(lock);
+ private:
+  static constexpr int kNumShards = 16;
+  static constexpr uint64 kCreationTimeoutMicros = 10 * 1000 * 1000;
+
+  struct Entry {
+    T* op = nullptr;
+    size_t bytes = 0;
+    // The entry's key, owned by the shard's cache.
+    const MklPrimitiveKey* key = nullptr;
+    // The neighbours of the entry in the shard's LRU list.
+    Entry* prev = nullptr;
+    Entry* next = nullptr;
+  };
 
-      // The primitive is created and is in the cache so we are going to try
-      // retrieve it again after getting a lock on it as multiple threads might
-      // be waiting for the primitive.
+  // A creation of a primitive in progress.
+  struct InFlight {
+    // Identifies the creation among all creations of the shard.
+    uint64 id = 0;
+    uint64 start_micros = 0;
+    // The number of threads waiting for the primitive.
+    int waiters = 0;
+  };
+
+  // The error of an aborted creation, kept until all of the threads that
+  // waited for it have seen it.
+  struct Failure {
+    Status error;
+    int waiters = 0;
+  };
+
+  struct Shard {
+    mutex mu;
+    condition_variable cv;
+    std::unordered_map<MklPrimitiveKey, Entry, MklPrimitiveKey::Hasher> cache
+        TF_GUARDED_BY(mu);
+    // Sentinel of the LRU list. Its next entry is the most recently accessed
+    // entry, while its previous entry is the least recently accessed entry.
+    Entry head TF_GUARDED_BY(mu);
+    size_t bytes TF_GUARDED_BY(mu) = 0;
+    // The keys that are currently under creation.
+    std::unordered_map<MklPrimitiveKey, InFlight, MklPrimitiveKey::Hasher>
+        in_flight TF_GUARDED_BY(mu);
+    uint64 last_creation TF_GUARDED_BY(mu) = 0;
+    // The failed creations by their id.
+    std::unordered_map<uint64, Failure> failures TF_GUARDED_BY(mu);
+  };
+
+  Shard& GetShard(const MklPrimitiveKey& key) {
+    // The low bits of the hash select the buckets within a shard.
+    return shards_[(key.hash() >> 32) % kNumShards];
+  }
+
+  static void Unlink(Entry* entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+  }
+
+  static void LinkFront(Shard* shard, Entry* entry)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    entry->prev = &shard->head;
+    entry->next = shard->head.next;
+    shard->head.next->prev = entry;
+    shard->head.next = entry;
+  }
+
+  const size_t shard_capacity_;
+  const size_t shard_capacity_bytes_;
+  Shard shards_[kNumShards];
+};
+
+// MklPrimitivePinScope keeps the primitives of the shared cache alive that
+// the calling thread looks up or creates while the scope is active, until the
+// scope ends. Kernels open a scope within the try block of their Compute(),
+// around all uses of cached primitives. Creations that the thread starts in
+// the scope and does not finish are aborted when the scope ends, with an
+// error if an exception, such as a failure to create the primitive, unwinds
+// the scope, so that threads waiting for the primitive do not time out.
+//
+// The shared cache is only used within a scope, see MklPrimitiveFactory.
+class MklPrimitivePinScope {
+ public:
+  MklPrimitivePinScope()
+      : parent_(Current()), uncaught_exceptions_(std::uncaught_exceptions()) {
+    Current() = this;
+  }
+
+  ~MklPrimitivePinScope() {
+    Current() = parent_;
+    if (!creations_.empty()) {
+      const Status error =
+          std::uncaught_exceptions() > uncaught_exceptions_
+              ? errors::Aborted("Creation of the oneDNN primitive failed in "
+                                "another thread")
+              : OkStatus();
+      for (const Creation& creation : creations_) {
+        creation.first->AbortOp(creation.second, error);
+      }
     }
-#endif
+    for (MklPrimitive* op : pinned_) op->Unref();
   }
 
-  void SetOp(const string& key, MklPrimitive* op) {
-#if !defined(DNNL_AARCH64_USE_ACL) || !defined(ENABLE_ONEDNN_OPENMP)
-    auto& lru_cache = MklPrimitiveFactory<T>::GetLRUCache();
-    lru_cache.SetOp(key, op);
-#else
-    {
-      mutex_lock lock(primitive_creation_mu_);
-      auto& lru_cache = MklPrimitiveFactory<T>::GetLRUCache();
-      lru_cache.SetOp(key, op);
+  // Returns whether the calling thread is within a scope.
+  static bool IsActive() { return Current() != nullptr; }
+
+  // Takes over a reference to 'op' from the caller. A primitive looked up
+  // several times in a scope holds one reference for each lookup.
+  static void Pin(MklPrimitive* op) {
+    DCHECK(IsActive());
+    Current()->pinned_.push_back(op);
+  }
+
+  // Records that the calling thread creates the primitive of 'key'.
+  static void StartCreation(MklSharedPrimitiveCache<MklPrimitive>* cache,
+                            const MklPrimitiveKey& key) {
+    DCHECK(IsActive());
+    Current()->creations_.emplace_back(cache, key);
+  }
+
+  static void FinishCreation(const MklPrimitiveKey& key) {
+    for (MklPrimitivePinScope* scope = Current(); scope != nullptr;
+         scope = scope->parent_) {
+      for (auto it = scope->creations_.begin(); it != scope->creations_.end();
+           ++it) {
+        if (it->second == key) {
+          scope->creations_.erase(it);
+          return;
+        }
+      }
     }
+  }
 
-    // Now we can inform all waiting threads that primitive is created.
-    primitive_creation_cv_.notify_all();
-#endif
+ private:
+  using Creation =
+      std::pair<MklSharedPrimitiveCache<MklPrimitive>*, MklPrimitiveKey>;
+
+  static MklPrimitivePinScope*& Current() {
+    static thread_local MklPrimitivePinScope* current = nullptr;
+    return current;
+  }
+
+  MklPrimitivePinScope* const parent_;
+  const int uncaught_exceptions_;
+  gtl::InlinedVector<MklPrimitive*, 8> pinned_;
+  std::vector<Creation> creations_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MklPrimitivePinScope);
+};
+
+template <typename T>
+class MklPrimitiveFactory {
+ public:
+  MklPrimitiveFactory() {}
+
+  ~MklPrimitiveFactory() {}
+
+  // Looks up the primitive of 'key', or returns nullptr if the caller is to
+  // create it and insert it with SetOp(). Shared primitives are pinned in the
+  // MklPrimitivePinScope of the caller, which must be open. Throws the oneDNN
+  // error of a failed creation of the primitive by another thread.
+  MklPrimitive* GetOp(const MklPrimitiveKey& key) {
+    MklPrimitive* primitive = nullptr;
+    if (IsMklPrimitiveCacheShared()) {
+      CHECK(MklPrimitivePinScope::IsActive())
+          << "Shared oneDNN primitives must be looked up in a "
+             "MklPrimitivePinScope";
+      MklSharedPrimitiveCache<MklPrimitive>& cache =
+          MklPrimitiveFactory<T>::GetSharedCache();
+      Status status = cache.GetOp(key, &primitive);
+      if (!status.ok()) {
+        // The message must outlive the error, which the caller handles
+        // before this thread looks up another primitive.
+        static thread_local string message;
+        message = string(status.message());
+        throw dnnl::error(dnnl_runtime_error, message.c_str());
+      }
+      if (primitive != nullptr) {
+        MklPrimitivePinScope::Pin(primitive);
+      } else {
+        MklPrimitivePinScope::StartCreation(&cache, key);
+      }
+    } else {
+      primitive = MklPrimitiveFactory<T>::GetLRUCache().GetOp(key);
+    }
+    MklPrimitiveCacheStats& stats = GetMklPrimitiveCacheStats();
+    if (primitive != nullptr) {
+      stats.hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      stats.misses.fetch_add(1, std::memory_order_relaxed);
+      // The primitive is created by this thread before it calls SetOp().
+      CreationStartMicros() = EnvTime::NowMicros();
+    }
+    return primitive;
+  }
+
+  void SetOp(const MklPrimitiveKey& key, MklPrimitive* op) {
+    MklPrimitiveCacheStats& stats = GetMklPrimitiveCacheStats();
+    stats.creations.fetch_add(1, std::memory_order_relaxed);
+    stats.creation_micros.fetch_add(
+        EnvTime::NowMicros() - CreationStartMicros(),
+        std::memory_order_relaxed);
+    if (IsMklPrimitiveCacheShared()) {
+      MklPrimitivePinScope::FinishCreation(key);
+      MklPrimitiveFactory<T>::GetSharedCache().SetOp(key, op);
+      // The reference of the creator.
+      MklPrimitivePinScope::Pin(op);
+    } else {
+      MklPrimitiveFactory<T>::GetLRUCache().SetOp(key, op);
+    }
   }
 
   /// Function to decide whether HW has AVX512 or AVX2
@@ -2059,6 +2630,46 @@ class MklPrimitiveFactory {
     return is_primitive_mem_opt_enabled;
   }
 
+  // Runs 'create' with each of 'batches' on a background thread, to warm up
+  // the shared cache with the primitives of those batch sizes for the kernel
+  // 'kernel_name'. Warm-up over all kernels of the process creates at most
+  // half of the cache capacity, so that it never evicts the primitives that
+  // the kernels actually run. Does nothing if the cache is not shared, since
+  // the background thread would only fill its own cache.
+  static void WarmUpInBackground(const string& kernel_name,
+                                 std::vector<int64_t> batches,
+                                 std::function<void(int64_t)> create) {
+    if (!IsMklPrimitiveCacheShared()) {
+      LOG_FIRST_N(WARNING, 1)
+          << "TF_ONEDNN_WARMUP_BATCH_RANGE is ignored, since "
+             "TF_ONEDNN_SHARED_PRIMITIVE_CACHE is false.";
+      return;
+    }
+    const size_t reserved = ReserveWarmUpPrimitives(batches.size());
+    if (reserved < batches.size()) {
+      // Each kernel warms up once, so this logs once per truncated kernel.
+      LOG(WARNING) << "oneDNN primitive warm-up of " << kernel_name
+                   << " exceeds half of the primitive cache capacity of "
+                   << kCapacity << "; " << batches.size() - reserved << " of "
+                   << batches.size() << " batch sizes are not warmed up.";
+      batches.resize(reserved);
+    }
+    if (batches.empty()) return;
+    Env::Default()->SchedClosure([batches = std::move(batches),
+                                  create = std::move(create)]() {
+      for (int64_t batch : batches) {
+        try {
+          MklPrimitivePinScope pin_scope;
+          create(batch);
+        } catch (dnnl::error& e) {
+          LOG(WARNING) << "oneDNN primitive warm-up for batch size " << batch
+                       << " failed: " << e.message;
+          return;
+        }
+      }
+    });
+  }
+
 #ifdef DNNL_AARCH64_USE_ACL
   static int IncrementCounter() {
     static std::atomic_int counter{1};
@@ -2067,61 +2678,131 @@ class MklPrimitiveFactory {
 #endif
 
  private:
+  static const int kCapacity = 1024;  // cache capacity
+
+  // Takes up to 'n' primitives from the warm-up budget of the cache.
+  static size_t ReserveWarmUpPrimitives(size_t n) {
+    static std::atomic<int64_t> remaining{kCapacity / 2};
+    int64_t available = remaining.load(std::memory_order_relaxed);
+    int64_t taken;
+    do {
+      taken = std::min<int64_t>(available, n);
+    } while (!remaining.compare_exchange_weak(available, available - taken,
+                                              std::memory_order_relaxed));
+    return taken;
+  }
+
   static inline LRUCache<MklPrimitive>& GetLRUCache() {
-    static const int kCapacity = 1024;  // cache capacity
-#if !defined(DNNL_AARCH64_USE_ACL) || !defined(ENABLE_ONEDNN_OPENMP)
     static thread_local LRUCache<MklPrimitive> lru_cache_(kCapacity);
-#else
-    static LRUCache<MklPrimitive> lru_cache_(kCapacity);
-#endif
     return lru_cache_;
   }
 
-#if defined(DNNL_AARCH64_USE_ACL) && defined(ENABLE_ONEDNN_OPENMP)
-  mutex primitive_creation_mu_;
-  condition_variable primitive_creation_cv_;
-#endif
+  static inline MklSharedPrimitiveCache<MklPrimitive>& GetSharedCache() {
+    static MklSharedPrimitiveCache<MklPrimitive>* shared_cache = [] {
+      int64_t capacity_bytes = 0;
+      TF_CHECK_OK(ReadInt64FromEnvVar("TF_ONEDNN_PRIMITIVE_CACHE_BYTES", 0,
+                                      &capacity_bytes));
+      return new MklSharedPrimitiveCache<MklPrimitive>(
+          kCapacity, static_cast<size_t>(std::max<int64_t>(0, capacity_bytes)));
+    }();
+    return *shared_cache;
+  }
+
+  // Start time of the primitive creation by this thread.
+  static inline uint64& CreationStartMicros() {
+    static thread_local uint64 start_micros = 0;
+    return start_micros;
+  }
 };
 
-// utility class for creating keys of MKL primitive pool.
+// utility class for creating keys of MKL primitive pool. Fields are appended
+// in binary form, with variable length fields prefixed by their length, so
+// that distinct field sequences never produce the same key.
 class FactoryKeyCreator {
  public:
-  FactoryKeyCreator() { key_.reserve(kMaxKeyLength); }
+  FactoryKeyCreator() {}
 
   ~FactoryKeyCreator() {}
 
-  void AddAsKey(const string& str) { Append(str); }
+  void AddAsKey(const string& str) {
+    AddAsKey<uint32>(str.size());
+    Append(str.data(), str.size());
+  }
+
+  void AddAsKey(const MklPrimitiveKey& key) {
+    StringPiece bytes = key.bytes();
+    AddAsKey<uint32>(bytes.size());
+    Append(bytes.data(), bytes.size());
+  }
 
   void AddAsKey(const dnnl::memory::dims& dims) {
+    AddAsKey<uint32>(dims.size());
     for (unsigned int i = 0; i < dims.size(); i++) {
-      AddAsKey<int>(dims[i]);
+      AddAsKey<int64_t>(dims[i]);
     }
   }
 
   template <typename T>
   void AddAsKey(const T data) {
-    auto buffer = reinterpret_cast<const char*>(&data);
-    Append(StringPiece(buffer, sizeof(T)));
+    Append(&data, sizeof(T));
   }
 
   // generalisation to handle pointers
-  void AddAsKey(const void* data) {
-    auto buffer = reinterpret_cast<const char*>(&data);
-    Append(StringPiece(buffer, sizeof(data)));
-  }
+  void AddAsKey(const void* data) { Append(&data, sizeof(data)); }
 
-  string GetKey() { return key_; }
+  // Moves the key out of the creator, which is empty afterwards. Callers
+  // return the result directly, so that the key is built in the object of the
+  // final caller without copies.
+  MklPrimitiveKey GetKey() {
+    MklPrimitiveKey key(std::move(key_));
+    key_.bytes_.clear();
+    key.Rehash();
+    return key;
+  }
 
  private:
-  string key_;
-  const char delimiter = 'x';
-  const int kMaxKeyLength = 256;
-  void Append(StringPiece s) {
-    key_.append(string(s));
-    key_.append(1, delimiter);
+  MklPrimitiveKey key_;
+  void Append(const void* data, size_t size) {
+    auto buffer = static_cast<const char*>(data);
+    key_.bytes_.insert(key_.bytes_.end(), buffer, buffer + size);
   }
 };
 
+// Registers the replayer of a primitive factory with the process-wide
+// MklPrimitiveSnapshot, see there. Replays that fail with a oneDNN error, e.g.
+// because the snapshot was taken on a CPU with other ISA extensions, count as
+// failed. Returns whether the snapshot is enabled, in which case the factory
+// records the parameters of the primitives it creates.
+inline bool RegisterMklPrimitiveReplayer(
+    const string& factory, MklPrimitiveSnapshot::Replayer replayer) {
+  MklPrimitiveSnapshot* snapshot = MklPrimitiveSnapshot::Global();
+  if (!snapshot->enabled()) return false;
+  snapshot->RegisterFactory(factory, [factory, replayer](StringPiece params) {
+    try {
+      MklPrimitivePinScope pin_scope;
+      return replayer(params);
+    } catch (dnnl::error& e) {
+      VLOG(1) << "Failed to replay a " << factory
+              << " primitive: " << e.message;
+      return false;
+    }
+  });
+  return true;
+}
+
+// Records with the snapshot that a kernel uses 'primitive' of 'factory',
+// whose serialized parameters 'params' returns. Only the first lookup of the
+// primitive by a kernel is recorded, whether it created the primitive or
+// found it in the cache, e.g. created by a replay, which does not count.
+template <typename ParamsFn>
+inline void RecordMklPrimitiveUse(MklPrimitive* primitive,
+                                  const string& factory, ParamsFn params) {
+  if (MklPrimitiveSnapshot::IsReplaying() || !primitive->MarkUsedByKernel()) {
+    return;
+  }
+  MklPrimitiveSnapshot::Global()->Record(factory, params());
+}
+
 class MklReorderPrimitive : public MklPrimitive {
  public:
   explicit MklReorderPrimitive(const memory* from, const memory* to)
@@ -2180,7 +2861,7 @@ class MklReorderPrimitiveFactory : public MklPrimitiveFactory<T> {
     return instance_;
   }
 
-  static string CreateKey(const memory* from, const memory* to) {
+  static MklPrimitiveKey CreateKey(const memory* from, const memory* to) {
     string prefix = "reorder";
     FactoryKeyCreator key_creator;
     auto const& from_desc = from->GET_MEMORY_DESC;
@@ -2209,10 +2890,14 @@ class MklReorderPrimitiveFactory : public MklPrimitiveFactory<T> {
 #endif  // !ENABLE_ONEDNN_V3
 
     key_creator.AddAsKey(prefix);
-#ifdef DNNL_AARCH64_USE_ACL
     // The reorder primitives have local memory (calls to SetMemory) so we
     // need to make sure that memory for those primitives is cached per thread.
+#ifdef DNNL_AARCH64_USE_ACL
     key_creator.AddAsKey(std::this_thread::get_id());
+#else
+    if (IsMklPrimitiveCacheShared()) {
+      key_creator.AddAsKey(std::this_thread::get_id());
+    }
 #endif
     // TODO(intel-tf): dnnl_memory_extra_desc_t (from/to_desc.extra) can no
     // longer be queried in oneDNN v3.x. In oneDNN v2.x, this was used to
@@ -2245,12 +2930,12 @@ class MklReorderPrimitiveFactory : public MklPrimitiveFactory<T> {
   ~MklReorderPrimitiveFactory() {}
 
   MklPrimitive* GetReorder(const memory* from, const memory* to) {
-    string key = CreateKey(from, to);
+    MklPrimitiveKey key = CreateKey(from, to);
     return this->GetOp(key);
   }
 
   void SetReorder(const memory* from, const memory* to, MklPrimitive* op) {
-    string key = CreateKey(from, to);
+    MklPrimitiveKey key = CreateKey(from, to);
     this->SetOp(key, op);
   }
 };
@@ -2269,6 +2954,28 @@ inline MklReorderPrimitive* FindOrCreateReorder(const memory* from,
   return reorder_prim;
 }
 
+// Returns a key of the reorder of constant data from 'from_md' to 'to_md',
+// e.g. for the layout of ReorderedWeightCache entries.
+inline string GetReorderLayoutKey(const memory::desc& from_md,
+                                  const memory::desc& to_md) {
+  FactoryKeyCreator key_creator;
+  for (const memory::desc* md : {&from_md, &to_md}) {
+#ifndef ENABLE_ONEDNN_V3
+    key_creator.AddAsKey(string(reinterpret_cast<const char*>(&md->data),
+                                sizeof(md->data)));
+#else
+    key_creator.AddAsKey(static_cast<int>(md->get_format_kind()));
+    key_creator.AddAsKey(static_cast<int>(md->get_data_type()));
+    key_creator.AddAsKey(md->get_dims());
+    key_creator.AddAsKey(md->get_strides());
+    key_creator.AddAsKey(md->get_inner_blks());
+    key_creator.AddAsKey(md->get_inner_idxs());
+    key_creator.AddAsKey(md->get_size());
+#endif  // !ENABLE_ONEDNN_V3
+  }
+  return string(key_creator.GetKey().bytes());
+}
+
 // utility function to determine if it is conv 1x1 and stride != 1
 // for purpose of temporarily disabling primitive reuse
 inline bool IsConv1x1StrideNot1(memory::dims filter_dims,
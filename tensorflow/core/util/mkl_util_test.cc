@@ -17,6 +17,10 @@ limitations under the License.
 
 #include "tensorflow/core/util/mkl_util.h"
 
+#include <thread>  // NOLINT(build/c++11)
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -94,19 +98,19 @@ TEST(MklUtilTest, LRUCacheTest) {
 
   // Test SetOp: be able to set more ops than the capacity
   for (int k = 0; k < num_objects; k++) {
-    lru_cache.SetOp(std::to_string(k), new int(k));
+    lru_cache.SetOp(MklPrimitiveKey(std::to_string(k)), new int(k));
   }
 
   // Test GetOp and capacity:
   // Least recently accessed objects should not be in cache any more.
   for (int k = 0; k < num_objects - capacity; ++k) {
-    EXPECT_EQ(nullptr, lru_cache.GetOp(std::to_string(k)));
+    EXPECT_EQ(nullptr, lru_cache.GetOp(MklPrimitiveKey(std::to_string(k))));
   }
 
   // Test GetOp and capacity:
   // Most recently accessed objects should still be in cache.
   for (int k = num_objects - capacity; k < num_objects; ++k) {
-    int* int_ptr = lru_cache.GetOp(std::to_string(k));
+    int* int_ptr = lru_cache.GetOp(MklPrimitiveKey(std::to_string(k)));
     EXPECT_NE(nullptr, int_ptr);
     EXPECT_EQ(*int_ptr, k);
   }
@@ -116,8 +120,176 @@ TEST(MklUtilTest, LRUCacheTest) {
 
   // After clean up, there should be no cached object.
   for (int k = 0; k < num_objects; ++k) {
-    EXPECT_EQ(nullptr, lru_cache.GetOp(std::to_string(k)));
+    EXPECT_EQ(nullptr, lru_cache.GetOp(MklPrimitiveKey(std::to_string(k))));
+  }
+}
+
+// Primitive that reports a fixed number of owned bytes.
+class TestPrimitive : public MklPrimitive {
+ public:
+  explicit TestPrimitive(size_t bytes, bool* deleted = nullptr)
+      : bytes_(bytes), deleted_(deleted) {}
+  ~TestPrimitive() override {
+    if (deleted_ != nullptr) *deleted_ = true;
+  }
+  size_t GetMemoryBytes() const override { return bytes_; }
+
+ private:
+  size_t bytes_;
+  bool* deleted_;
+};
+
+TestPrimitive* GetOrNull(MklSharedPrimitiveCache<TestPrimitive>* cache,
+                         const MklPrimitiveKey& key) {
+  TestPrimitive* op = nullptr;
+  TF_CHECK_OK(cache->GetOp(key, &op));
+  return op;
+}
+
+TEST(MklUtilTest, SharedPrimitiveCacheSingleFlight) {
+  MklSharedPrimitiveCache<TestPrimitive> cache(/*capacity=*/1024,
+                                               /*capacity_bytes=*/0);
+  const MklPrimitiveKey conv("conv");
+  // The first lookup of a key misses and makes the caller its creator.
+  EXPECT_EQ(nullptr, GetOrNull(&cache, conv));
+
+  // A concurrent lookup of the key waits for the primitive to be inserted.
+  TestPrimitive* looked_up = nullptr;
+  std::thread waiter([&] { looked_up = GetOrNull(&cache, conv); });
+  Env::Default()->SleepForMicroseconds(10000);
+  TestPrimitive* created = new TestPrimitive(0);
+  cache.SetOp(conv, created);
+  waiter.join();
+  EXPECT_EQ(created, looked_up);
+  EXPECT_EQ(created, GetOrNull(&cache, conv));
+  for (int i = 0; i < 3; ++i) created->Unref();
+}
+
+TEST(MklUtilTest, SharedPrimitiveCacheAbortedCreation) {
+  MklSharedPrimitiveCache<TestPrimitive> cache(/*capacity=*/1024,
+                                               /*capacity_bytes=*/0);
+  const MklPrimitiveKey conv("conv");
+  ASSERT_EQ(nullptr, GetOrNull(&cache, conv));
+
+  // A failed creation wakes the waiting thread with the error of the creator.
+  Status waiter_status;
+  std::thread waiter([&] {
+    TestPrimitive* op = nullptr;
+    waiter_status = cache.GetOp(conv, &op);
+  });
+  Env::Default()->SleepForMicroseconds(10000);
+  cache.AbortOp(conv, errors::Internal("unsupported"));
+  waiter.join();
+  EXPECT_EQ(waiter_status, errors::Internal("unsupported"));
+
+  // After an abort without error, the next lookup creates the primitive.
+  ASSERT_EQ(nullptr, GetOrNull(&cache, conv));
+  TestPrimitive* taken_over = nullptr;
+  std::thread creator([&] { taken_over = GetOrNull(&cache, conv); });
+  Env::Default()->SleepForMicroseconds(10000);
+  cache.AbortOp(conv, OkStatus());
+  creator.join();
+  EXPECT_EQ(nullptr, taken_over);
+}
+
+TEST(MklUtilTest, SharedPrimitiveCacheKeepsEvictedPrimitivesInUse) {
+  // Keys spread over 16 shards with a single entry each.
+  MklSharedPrimitiveCache<TestPrimitive> cache(/*capacity=*/16,
+                                               /*capacity_bytes=*/0);
+  bool deleted = false;
+  const MklPrimitiveKey in_use_key("0");
+  ASSERT_EQ(nullptr, GetOrNull(&cache, in_use_key));
+  TestPrimitive* in_use = new TestPrimitive(0, &deleted);
+  cache.SetOp(in_use_key, in_use);
+  for (int k = 1; k < 256; ++k) {
+    const MklPrimitiveKey key(std::to_string(k));
+    if (GetOrNull(&cache, key) == nullptr) {
+      TestPrimitive* op = new TestPrimitive(0);
+      cache.SetOp(key, op);
+      op->Unref();
+    }
+  }
+  // The primitive is evicted, but the reference of its creator keeps it.
+  EXPECT_EQ(nullptr, GetOrNull(&cache, in_use_key));
+  cache.AbortOp(in_use_key, OkStatus());
+  EXPECT_FALSE(deleted);
+  in_use->Unref();
+  EXPECT_TRUE(deleted);
+}
+
+TEST(MklUtilTest, SharedPrimitiveCacheByteCapacity) {
+  // Keys spread over 16 shards with 1024 bytes each.
+  MklSharedPrimitiveCache<TestPrimitive> cache(/*capacity=*/1024,
+                                               /*capacity_bytes=*/16 * 1024);
+  const int64_t evictions = GetMklPrimitiveCacheStats().evictions.load();
+  const int num_objects = 64;
+  for (int k = 0; k < num_objects; ++k) {
+    const MklPrimitiveKey key(std::to_string(k));
+    ASSERT_EQ(nullptr, GetOrNull(&cache, key));
+    TestPrimitive* op = new TestPrimitive(1024);
+    cache.SetOp(key, op);
+    op->Unref();
+  }
+  // Each shard keeps only its most recently inserted primitive.
+  int num_cached = 0;
+  for (int k = 0; k < num_objects; ++k) {
+    const MklPrimitiveKey key(std::to_string(k));
+    TestPrimitive* op = GetOrNull(&cache, key);
+    if (op != nullptr) {
+      ++num_cached;
+    } else {
+      // Insert it again to finish the creation started by the miss.
+      op = new TestPrimitive(0);
+      cache.SetOp(key, op);
+    }
+    op->Unref();
   }
+  EXPECT_LE(num_cached, 16);
+  EXPECT_GE(GetMklPrimitiveCacheStats().evictions.load() - evictions,
+            num_objects - 16);
+}
+
+TEST(MklUtilTest, RecordsFirstKernelUseOfPrimitive) {
+  MklPrimitiveSnapshot* snapshot = MklPrimitiveSnapshot::Global();
+  const size_t num_records = snapshot->num_records();
+  TestPrimitive* op = new TestPrimitive(0);
+  int num_serialized = 0;
+  auto params = [&num_serialized] {
+    ++num_serialized;
+    return string("params");
+  };
+  // A hit after the creation, e.g. by a replay, records the use only once.
+  RecordMklPrimitiveUse(op, "test_factory", params);
+  RecordMklPrimitiveUse(op, "test_factory", params);
+  EXPECT_EQ(num_serialized, 1);
+  EXPECT_EQ(snapshot->num_records(), num_records + 1);
+  op->Unref();
+}
+
+TEST(MklUtilTest, BatchBuckets) {
+  std::vector<int64_t> buckets;
+  TF_EXPECT_OK(MklBatchBuckets::Parse("", &buckets));
+  EXPECT_TRUE(buckets.empty());
+  EXPECT_EQ(MklBatchBuckets::RoundUp(7, buckets), 7);
+
+  TF_EXPECT_OK(MklBatchBuckets::Parse("32,1,8,8", &buckets));
+  EXPECT_EQ(buckets, std::vector<int64_t>({1, 8, 32}));
+  EXPECT_EQ(MklBatchBuckets::RoundUp(1, buckets), 1);
+  EXPECT_EQ(MklBatchBuckets::RoundUp(2, buckets), 8);
+  EXPECT_EQ(MklBatchBuckets::RoundUp(32, buckets), 32);
+  // Batches beyond the largest bucket are not rounded.
+  EXPECT_EQ(MklBatchBuckets::RoundUp(33, buckets), 33);
+
+  EXPECT_EQ(MklBatchBuckets::Cover(1, 34, /*padded=*/true, buckets),
+            std::vector<int64_t>({1, 8, 32, 33, 34}));
+  EXPECT_EQ(MklBatchBuckets::Cover(3, 5, /*padded=*/false, buckets),
+            std::vector<int64_t>({3, 4, 5}));
+
+  TF_EXPECT_OK(MklBatchBuckets::Parse("pow2", &buckets));
+  EXPECT_EQ(MklBatchBuckets::RoundUp(100, buckets), 128);
+
+  EXPECT_FALSE(MklBatchBuckets::Parse("8,x", &buckets).ok());
+  EXPECT_FALSE(MklBatchBuckets::Parse("0,8", &buckets).ok());
 }
 
 }  // namespace
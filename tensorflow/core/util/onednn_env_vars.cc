@@ -63,5 +63,16 @@ std::string FPMathModeSetting() {
 
   return math_mode_setting;
 }
+
+std::string RewriteThresholdsProfile() {
+  static std::string profile = [] {
+    std::string path = "";
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_ONEDNN_REWRITE_THRESHOLDS_PROFILE",
+                                     /*default_value*/ "", &path));
+    return path;
+  }();
+
+  return profile;
+}
 }  // namespace tensorflow
 #endif  // INTEL_MKL
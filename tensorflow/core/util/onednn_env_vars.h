@@ -28,6 +28,10 @@ bool UseSystemAlloc();
 bool ThreadPoolUseCallerThread();
 
 std::string FPMathModeSetting();
+
+// Path of a rewrite threshold profile produced by
+// mkl_rewrite_threshold_calibration, or "" if none was given.
+std::string RewriteThresholdsProfile();
 }  // namespace tensorflow
 #endif  // INTEL_MKL
 #endif  // TENSORFLOW_CORE_UTIL_ONEDNN_ENV_VARS_H_
@@ -0,0 +1,126 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/reordered_weight_cache.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+ReorderedWeightCache::ReorderedWeightCache(size_t capacity_bytes)
+    : capacity_bytes_(capacity_bytes) {}
+
+ReorderedWeightCache::~ReorderedWeightCache() {}
+
+/* static */
+ReorderedWeightCache* ReorderedWeightCache::Global() {
+  static ReorderedWeightCache* cache = [] {
+    int64_t capacity_bytes = 0;
+    Status status = ReadInt64FromEnvVar("TF_REORDERED_WEIGHT_CACHE_BYTES",
+                                        1LL << 30, &capacity_bytes);
+    if (!status.ok()) {
+      LOG(ERROR) << "ReorderedWeightCache: " << status.message();
+      capacity_bytes = 1LL << 30;
+    }
+    return new ReorderedWeightCache(std::max<int64_t>(0, capacity_bytes));
+  }();
+  return cache;
+}
+
+/* static */
+Fprint128 ReorderedWeightCache::FingerprintWeights(const Tensor& weights) {
+  const StringPiece data = weights.tensor_data();
+  Fprint128 fingerprint = Fingerprint128(data);
+  const string meta =
+      absl::StrCat(weights.dtype(), ":", weights.shape().DebugString());
+  const Fprint128 meta_fingerprint = Fingerprint128(meta);
+  fingerprint.low64 =
+      FingerprintCat64(fingerprint.low64, meta_fingerprint.low64);
+  fingerprint.high64 =
+      FingerprintCat64(fingerprint.high64, meta_fingerprint.high64);
+  return fingerprint;
+}
+
+/* static */
+string ReorderedWeightCache::EntryKey(const Key& key) {
+  string entry_key(reinterpret_cast<const char*>(&key.weights),
+                   sizeof(key.weights));
+  entry_key.append(key.layout);
+  return entry_key;
+}
+
+bool ReorderedWeightCache::Lookup(const Key& key, Tensor* weights) {
+  if (!enabled()) return false;
+  const string entry_key = EntryKey(key);
+  mutex_lock l(mu_);
+  auto it = entries_.find(entry_key);
+  const bool found = it != entries_.end();
+  // The caller holds the weights it found before unused entries are evicted.
+  if (found) *weights = it->second;
+  EvictUnused();
+  return found;
+}
+
+void ReorderedWeightCache::Insert(const Key& key, Tensor* weights) {
+  if (!enabled()) return;
+  const string entry_key = EntryKey(key);
+  mutex_lock l(mu_);
+  auto it = entries_.find(entry_key);
+  if (it != entries_.end()) {
+    // Another kernel converted the same weights first; share its copy.
+    *weights = it->second;
+    EvictUnused();
+    return;
+  }
+  EvictUnused();
+  if (bytes_ + weights->TotalBytes() > capacity_bytes_) {
+    VLOG(2) << "ReorderedWeightCache: Not caching " << weights->TotalBytes()
+            << " bytes, " << bytes_ << " of " << capacity_bytes_
+            << " bytes are in use";
+    return;
+  }
+  entries_.emplace(entry_key, *weights);
+  bytes_ += weights->TotalBytes();
+}
+
+void ReorderedWeightCache::EvictUnused() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    // The cache holds the only reference to weights no kernel uses.
+    if (!it->second.RefCountIsOne()) {
+      ++it;
+      continue;
+    }
+    bytes_ -= it->second.TotalBytes();
+    VLOG(2) << "ReorderedWeightCache: Evicting " << it->second.TotalBytes()
+            << " bytes";
+    it = entries_.erase(it);
+  }
+}
+
+size_t ReorderedWeightCache::bytes() const {
+  mutex_lock l(mu_);
+  return bytes_;
+}
+
+size_t ReorderedWeightCache::num_entries() const {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+}  // namespace tensorflow
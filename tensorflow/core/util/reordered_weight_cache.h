@@ -0,0 +1,89 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_UTIL_REORDERED_WEIGHT_CACHE_H_
+#define TENSORFLOW_CORE_UTIL_REORDERED_WEIGHT_CACHE_H_
+
+#include <unordered_map>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A process-wide cache of constant weights converted to a kernel specific
+// layout, such as the blocked formats of oneDNN and ZenDNN. Kernels look up
+// the converted weights by a fingerprint of the original weights and a key of
+// the conversion, so that models or model replicas that share weights also
+// share a single converted copy, across kernels and sessions.
+//
+// Converted weights are cached as Tensors, whose buffers are refcounted.
+// Kernels keep the Tensor they get from the cache. Entries that no kernel
+// holds any more are dropped on the next Lookup() or Insert(), so that the
+// cache never keeps the weights of deleted kernels alive. Weights that do not
+// fit into the capacity next to the weights in use are not cached.
+class ReorderedWeightCache {
+ public:
+  struct Key {
+    // Fingerprint of the original weights, see FingerprintWeights().
+    Fprint128 weights;
+    // Identifies the conversion, e.g. the source and target layouts.
+    string layout;
+  };
+
+  // A capacity of 0 disables the cache.
+  explicit ReorderedWeightCache(size_t capacity_bytes);
+  ~ReorderedWeightCache();
+
+  // Returns the process-wide cache, whose capacity is read from the
+  // environment variable TF_REORDERED_WEIGHT_CACHE_BYTES (1 GiB by default).
+  static ReorderedWeightCache* Global();
+
+  // Returns the fingerprint of the type, shape and contents of 'weights'.
+  static Fprint128 FingerprintWeights(const Tensor& weights);
+
+  bool enabled() const { return capacity_bytes_ > 0; }
+
+  // Returns true and sets '*weights' to the cached weights for 'key', if any.
+  bool Lookup(const Key& key, Tensor* weights) TF_LOCKS_EXCLUDED(mu_);
+
+  // Caches '*weights' for 'key' if they fit into the capacity. If weights
+  // were cached for 'key' in the meantime, sets '*weights' to those instead,
+  // so that all callers share one copy.
+  void Insert(const Key& key, Tensor* weights) TF_LOCKS_EXCLUDED(mu_);
+
+  size_t bytes() const TF_LOCKS_EXCLUDED(mu_);
+  size_t num_entries() const TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  static string EntryKey(const Key& key);
+
+  // Evicts the entries held by no kernel.
+  void EvictUnused() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const size_t capacity_bytes_;
+
+  mutable mutex mu_;
+  std::unordered_map<string, Tensor> entries_ TF_GUARDED_BY(mu_);
+  size_t bytes_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ReorderedWeightCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_UTIL_REORDERED_WEIGHT_CACHE_H_
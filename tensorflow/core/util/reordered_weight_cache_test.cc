@@ -0,0 +1,104 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/reordered_weight_cache.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+Tensor MakeWeights(float value) {
+  return test::AsTensor<float>({value, value, value, value}, {2, 2});
+}
+
+TEST(ReorderedWeightCacheTest, SharesConvertedWeights) {
+  ReorderedWeightCache cache(/*capacity_bytes=*/1 << 20);
+  const ReorderedWeightCache::Key key = {
+      ReorderedWeightCache::FingerprintWeights(MakeWeights(1.0f)), "blocked"};
+
+  Tensor looked_up;
+  EXPECT_FALSE(cache.Lookup(key, &looked_up));
+  Tensor converted = MakeWeights(2.0f);
+  cache.Insert(key, &converted);
+
+  // Equal weights of another kernel find the same buffer.
+  const ReorderedWeightCache::Key other_key = {
+      ReorderedWeightCache::FingerprintWeights(MakeWeights(1.0f)), "blocked"};
+  ASSERT_TRUE(cache.Lookup(other_key, &looked_up));
+  EXPECT_EQ(looked_up.data(), converted.data());
+
+  // A concurrent conversion of the same weights is replaced by the cached one.
+  Tensor converted_again = MakeWeights(2.0f);
+  cache.Insert(other_key, &converted_again);
+  EXPECT_EQ(converted_again.data(), converted.data());
+  EXPECT_EQ(cache.num_entries(), 1);
+
+  // Other weights or layouts are distinct entries.
+  const ReorderedWeightCache::Key other_layout = {key.weights, "plain"};
+  const ReorderedWeightCache::Key other_weights = {
+      ReorderedWeightCache::FingerprintWeights(MakeWeights(3.0f)), "blocked"};
+  EXPECT_FALSE(cache.Lookup(other_layout, &looked_up));
+  EXPECT_FALSE(cache.Lookup(other_weights, &looked_up));
+}
+
+TEST(ReorderedWeightCacheTest, EvictsUnusedWeights) {
+  const size_t weight_bytes = MakeWeights(0.0f).TotalBytes();
+  ReorderedWeightCache cache(/*capacity_bytes=*/1 << 20);
+
+  Tensor used = MakeWeights(1.0f);
+  cache.Insert({Fprint128{1, 1}, "blocked"}, &used);
+  {
+    Tensor unused = MakeWeights(2.0f);
+    cache.Insert({Fprint128{2, 2}, "blocked"}, &unused);
+  }
+  EXPECT_EQ(cache.num_entries(), 2);
+
+  // The next lookup evicts the entry that no kernel holds any more, although
+  // the cache is far from its capacity.
+  Tensor looked_up;
+  EXPECT_TRUE(cache.Lookup({Fprint128{1, 1}, "blocked"}, &looked_up));
+  EXPECT_EQ(cache.num_entries(), 1);
+  EXPECT_EQ(cache.bytes(), weight_bytes);
+  EXPECT_FALSE(cache.Lookup({Fprint128{2, 2}, "blocked"}, &looked_up));
+}
+
+TEST(ReorderedWeightCacheTest, DoesNotCacheBeyondCapacity) {
+  const size_t weight_bytes = MakeWeights(0.0f).TotalBytes();
+  ReorderedWeightCache cache(/*capacity_bytes=*/weight_bytes);
+
+  Tensor first = MakeWeights(1.0f);
+  cache.Insert({Fprint128{1, 1}, "blocked"}, &first);
+  // The first weights are in use, so the second ones do not fit.
+  Tensor second = MakeWeights(2.0f);
+  cache.Insert({Fprint128{2, 2}, "blocked"}, &second);
+  Tensor looked_up;
+  EXPECT_TRUE(cache.Lookup({Fprint128{1, 1}, "blocked"}, &looked_up));
+  EXPECT_FALSE(cache.Lookup({Fprint128{2, 2}, "blocked"}, &looked_up));
+  EXPECT_EQ(cache.bytes(), weight_bytes);
+}
+
+TEST(ReorderedWeightCacheTest, ZeroCapacityDisablesCache) {
+  ReorderedWeightCache cache(/*capacity_bytes=*/0);
+  EXPECT_FALSE(cache.enabled());
+  Tensor weights = MakeWeights(1.0f);
+  cache.Insert({Fprint128{1, 1}, "blocked"}, &weights);
+  Tensor looked_up;
+  EXPECT_FALSE(cache.Lookup({Fprint128{1, 1}, "blocked"}, &looked_up));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,141 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/weight_only_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/platform/errors.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Sign-extends the nibbles of a packed 4 bit byte.
+inline int LowNibble(int8 byte) { return static_cast<int8>(byte << 4) >> 4; }
+inline int HighNibble(int8 byte) { return byte >> 4; }
+
+}  // namespace
+
+Status QuantizeWeightsForMatMul(const Tensor& weights, bool transpose_weights,
+                                int bits, int64_t group_size,
+                                Tensor* quantized, Tensor* scales) {
+  if (bits != 8 && bits != 4) {
+    return errors::InvalidArgument("Weights can be quantized to 8 or 4 bits, ",
+                                   "got ", bits);
+  }
+  if (group_size < 0) {
+    return errors::InvalidArgument("Negative quantization group size ",
+                                   group_size);
+  }
+  if (weights.dims() != 2) {
+    return errors::InvalidArgument("Weights must be 2D: ",
+                                   weights.shape().DebugString());
+  }
+  if (weights.dtype() != DT_FLOAT && weights.dtype() != DT_BFLOAT16) {
+    return errors::InvalidArgument("Weights must be float or bfloat16, got ",
+                                   DataTypeString(weights.dtype()));
+  }
+
+  const int64_t k = weights.dim_size(transpose_weights ? 1 : 0);
+  const int64_t n = weights.dim_size(transpose_weights ? 0 : 1);
+  std::vector<float> values(k * n);
+  for (int64_t row = 0; row < k; ++row) {
+    for (int64_t col = 0; col < n; ++col) {
+      const int64_t index = transpose_weights ? col * k + row : row * n + col;
+      values[row * n + col] =
+          weights.dtype() == DT_FLOAT
+              ? weights.flat<float>()(index)
+              : static_cast<float>(weights.flat<bfloat16>()(index));
+    }
+  }
+
+  const int qmax = bits == 8 ? 127 : 7;
+  const int64_t num_groups = NumWeightQuantizationGroups(k, group_size);
+  const int64_t rows_per_group = group_size == 0 ? k : group_size;
+  *scales = Tensor(DT_FLOAT, TensorShape({num_groups, n}));
+  auto scale_values = scales->matrix<float>();
+  for (int64_t g = 0; g < num_groups; ++g) {
+    const int64_t row_end = std::min(k, (g + 1) * rows_per_group);
+    for (int64_t col = 0; col < n; ++col) {
+      float max_abs = 0.0f;
+      for (int64_t row = g * rows_per_group; row < row_end; ++row) {
+        max_abs = std::max(max_abs, std::abs(values[row * n + col]));
+      }
+      scale_values(g, col) = max_abs / qmax;
+    }
+  }
+
+  const int64_t packed_n = bits == 8 ? n : (n + 1) / 2;
+  *quantized = Tensor(DT_INT8, TensorShape({k, packed_n}));
+  int8* q = quantized->flat<int8>().data();
+  std::fill_n(q, k * packed_n, 0);
+  for (int64_t row = 0; row < k; ++row) {
+    const int64_t g = row / rows_per_group;
+    for (int64_t col = 0; col < n; ++col) {
+      const float scale = scale_values(g, col);
+      int value = 0;
+      if (scale != 0.0f) {
+        value = static_cast<int>(std::round(values[row * n + col] / scale));
+        value = std::max(-qmax, std::min(qmax, value));
+      }
+      if (bits == 8) {
+        q[row * n + col] = static_cast<int8>(value);
+      } else {
+        uint8 byte = static_cast<uint8>(q[row * packed_n + col / 2]);
+        const uint8 nibble = static_cast<uint8>(value) & 0x0F;
+        byte = col % 2 == 0 ? (byte & 0xF0) | nibble
+                            : (byte & 0x0F) | (nibble << 4);
+        q[row * packed_n + col / 2] = static_cast<int8>(byte);
+      }
+    }
+  }
+  return OkStatus();
+}
+
+void DequantizeWeightBlock(const int8* quantized, const float* scales,
+                           int bits, int64_t n, int64_t group_size,
+                           int64_t row_begin, int64_t row_end,
+                           int64_t col_begin, int64_t col_end, float* dst) {
+  const int64_t cols = col_end - col_begin;
+  for (int64_t row = row_begin; row < row_end; ++row) {
+    const float* s =
+        scales + (group_size == 0 ? 0 : row / group_size) * n + col_begin;
+    float* d = dst + (row - row_begin) * cols;
+    if (bits == 8) {
+      const int8* q = quantized + row * n + col_begin;
+      for (int64_t j = 0; j < cols; ++j) d[j] = s[j] * q[j];
+      continue;
+    }
+
+    const int8* q = quantized + row * ((n + 1) / 2);
+    int64_t j = 0;
+    if (col_begin % 2 != 0 && cols > 0) {
+      d[0] = s[0] * HighNibble(q[col_begin / 2]);
+      j = 1;
+    }
+    for (; j + 1 < cols; j += 2) {
+      const int8 byte = q[(col_begin + j) / 2];
+      d[j] = s[j] * LowNibble(byte);
+      d[j + 1] = s[j + 1] * HighNibble(byte);
+    }
+    if (j < cols) d[j] = s[j] * LowNibble(q[(col_begin + j) / 2]);
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,60 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_UTIL_WEIGHT_ONLY_QUANTIZATION_H_
+#define TENSORFLOW_CORE_UTIL_WEIGHT_ONLY_QUANTIZATION_H_
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Weight-only quantization of MatMul weights, as consumed by
+// _MklWeightOnlyQuantizedMatMul.
+//
+// The [K, N] weights are quantized symmetrically, without zero points, to
+// 8 or 4 bit signed integers:
+//   w[k, n] ~= scales[k / group_size, n] * q[k, n].
+// A 'group_size' of 0 uses one scale per output channel n, otherwise each
+// output channel has one scale per group of 'group_size' consecutive rows.
+//
+// 8 bit weights are stored as an int8 [K, N] tensor. 4 bit weights are packed
+// two per byte along N into an int8 [K, (N + 1) / 2] tensor: column 2j is the
+// low and column 2j+1 the high nibble of byte j, both in two's complement.
+// The scales are a float [num_groups, N] tensor.
+
+// Returns the number of scale rows of 'k' rows quantized with 'group_size'.
+inline int64_t NumWeightQuantizationGroups(int64_t k, int64_t group_size) {
+  return group_size == 0 ? 1 : (k + group_size - 1) / group_size;
+}
+
+// Quantizes the float or bfloat16 'weights', [K, N] or [N, K] if
+// 'transpose_weights', into 'quantized' and 'scales' as described above.
+Status QuantizeWeightsForMatMul(const Tensor& weights, bool transpose_weights,
+                                int bits, int64_t group_size,
+                                Tensor* quantized, Tensor* scales);
+
+// Dequantizes rows [row_begin, row_end) and columns [col_begin, col_end) of
+// quantized [k, n] weights into the row-major 'dst', whose leading dimension
+// is col_end - col_begin.
+void DequantizeWeightBlock(const int8* quantized, const float* scales,
+                           int bits, int64_t n, int64_t group_size,
+                           int64_t row_begin, int64_t row_end,
+                           int64_t col_begin, int64_t col_end, float* dst);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_UTIL_WEIGHT_ONLY_QUANTIZATION_H_
@@ -0,0 +1,134 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/weight_only_quantization.h"
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Dequantizes all of the [k, n] weights.
+std::vector<float> Dequantize(const Tensor& quantized, const Tensor& scales,
+                              int bits, int64_t k, int64_t n,
+                              int64_t group_size) {
+  std::vector<float> values(k * n);
+  DequantizeWeightBlock(quantized.flat<int8>().data(),
+                        scales.flat<float>().data(), bits, n, group_size, 0, k,
+                        0, n, values.data());
+  return values;
+}
+
+void ExpectRoundTrip(int bits, int64_t group_size, bool transpose) {
+  const int64_t k = 10, n = 7;
+  Tensor weights(DT_FLOAT, transpose ? TensorShape({n, k})
+                                     : TensorShape({k, n}));
+  auto flat = weights.flat<float>();
+  for (int64_t i = 0; i < flat.size(); ++i) {
+    flat(i) = std::sin(0.37f * i) * (1 + i % 5);
+  }
+
+  Tensor quantized, scales;
+  TF_ASSERT_OK(QuantizeWeightsForMatMul(weights, transpose, bits, group_size,
+                                        &quantized, &scales));
+  EXPECT_EQ(quantized.shape(),
+            TensorShape({k, bits == 8 ? n : (n + 1) / 2}));
+  EXPECT_EQ(scales.shape(),
+            TensorShape({NumWeightQuantizationGroups(k, group_size), n}));
+
+  const std::vector<float> values =
+      Dequantize(quantized, scales, bits, k, n, group_size);
+  for (int64_t row = 0; row < k; ++row) {
+    const int64_t g = group_size == 0 ? 0 : row / group_size;
+    for (int64_t col = 0; col < n; ++col) {
+      const float w = transpose ? flat(col * k + row) : flat(row * n + col);
+      // Rounding to the nearest step is off by at most half a step.
+      EXPECT_NEAR(values[row * n + col], w,
+                  scales.matrix<float>()(g, col) / 2 + 1e-6)
+          << "row " << row << " col " << col;
+    }
+  }
+
+  // Blocks starting at odd columns unpack the same values.
+  std::vector<float> block(3 * 4);
+  DequantizeWeightBlock(quantized.flat<int8>().data(),
+                        scales.flat<float>().data(), bits, n, group_size, 2, 5,
+                        3, 7, block.data());
+  for (int64_t row = 2; row < 5; ++row) {
+    for (int64_t col = 3; col < 7; ++col) {
+      EXPECT_EQ(block[(row - 2) * 4 + col - 3], values[row * n + col]);
+    }
+  }
+}
+
+TEST(WeightOnlyQuantizationTest, Int8PerChannel) {
+  ExpectRoundTrip(/*bits=*/8, /*group_size=*/0, /*transpose=*/false);
+  ExpectRoundTrip(/*bits=*/8, /*group_size=*/0, /*transpose=*/true);
+}
+
+TEST(WeightOnlyQuantizationTest, Int4Grouped) {
+  ExpectRoundTrip(/*bits=*/4, /*group_size=*/4, /*transpose=*/false);
+  ExpectRoundTrip(/*bits=*/4, /*group_size=*/4, /*transpose=*/true);
+  ExpectRoundTrip(/*bits=*/4, /*group_size=*/0, /*transpose=*/false);
+}
+
+TEST(WeightOnlyQuantizationTest, Int4Packing) {
+  Tensor weights = test::AsTensor<float>({7, -8, 1, -7, 3}, {1, 5});
+  Tensor quantized, scales;
+  TF_ASSERT_OK(QuantizeWeightsForMatMul(weights, /*transpose_weights=*/false,
+                                        /*bits=*/4, /*group_size=*/0,
+                                        &quantized, &scales));
+  // The largest magnitude, 8, is 7 steps of 8 / 7: {6, -7, 1, -6, 3}.
+  test::ExpectTensorEqual<int8>(
+      quantized,
+      test::AsTensor<int8>({static_cast<int8>(0x96), static_cast<int8>(0xA1),
+                            0x03},
+                           {1, 3}));
+}
+
+TEST(WeightOnlyQuantizationTest, ZeroWeights) {
+  Tensor weights(DT_FLOAT, TensorShape({4, 2}));
+  weights.flat<float>().setZero();
+  Tensor quantized, scales;
+  TF_ASSERT_OK(QuantizeWeightsForMatMul(weights, /*transpose_weights=*/false,
+                                        /*bits=*/8, /*group_size=*/0,
+                                        &quantized, &scales));
+  for (float value : Dequantize(quantized, scales, 8, 4, 2, 0)) {
+    EXPECT_EQ(value, 0.0f);
+  }
+}
+
+TEST(WeightOnlyQuantizationTest, InvalidArguments) {
+  Tensor weights(DT_FLOAT, TensorShape({4, 2}));
+  weights.flat<float>().setZero();
+  Tensor quantized, scales;
+  EXPECT_FALSE(QuantizeWeightsForMatMul(weights, false, /*bits=*/2, 0,
+                                        &quantized, &scales)
+                   .ok());
+  EXPECT_FALSE(QuantizeWeightsForMatMul(weights, false, 8, /*group_size=*/-1,
+                                        &quantized, &scales)
+                   .ok());
+  EXPECT_FALSE(QuantizeWeightsForMatMul(Tensor(DT_FLOAT, TensorShape({8})),
+                                        false, 8, 0, &quantized, &scales)
+                   .ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
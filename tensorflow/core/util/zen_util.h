@@ -19,7 +19,9 @@ limitations under the License.
 #ifdef AMD_ZENDNN
 
 #include "absl/base/call_once.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/port.h"
 
 namespace tensorflow {
 
@@ -34,16 +36,84 @@ inline int64_t GetMempool() {
   return mempool;
 }
 
-inline bool IsBlockedFormatEnabled() {
+inline int64_t GetConvAlgo() {
   static absl::once_flag once;
-  static bool blocked_format = false;
   static int64_t conv_algo = 1;
   absl::call_once(once, [&] {
     TF_CHECK_OK(ReadInt64FromEnvVar("ZENDNN_CONV_ALGO", conv_algo, &conv_algo));
-    blocked_format = (conv_algo == 3);
-    return blocked_format;
+    return conv_algo;
   });
-  return blocked_format;
+  return conv_algo;
+}
+
+inline bool IsBlockedFormatEnabled() { return GetConvAlgo() == 3; }
+
+// Node attribute that carries the memory pool mode of a session to the Zen
+// kernels, when the session sets it. Kernels use GetMempool() otherwise.
+constexpr char kZenMempoolAttr[] = "_zendnn_mempool";
+
+// Node attribute that carries the convolution algorithm of a session to the
+// Zen kernels, when the session sets it. Kernels use GetConvAlgo() otherwise.
+// The graph is rewritten for the layout of this algorithm, so the kernels must
+// run with it too.
+constexpr char kZenConvAlgoAttr[] = "_zendnn_conv_algo";
+
+// ZenDNN settings that the Zen graph and eager op rewrites run with.
+struct ZenDnnConfig {
+  bool enabled;
+  int64_t conv_algo;
+  // Whether 'conv_algo' selects the blocked format.
+  bool blocked_format;
+  int64_t mempool;
+  // Whether 'conv_algo' is set by the session rather than by the environment.
+  bool session_conv_algo;
+  // Whether 'mempool' is set by the session rather than by the environment.
+  bool session_mempool;
+};
+
+// Returns the ZenDNN settings of the process, read from the environment.
+inline const ZenDnnConfig &GetProcessZenDnnConfig() {
+  static const ZenDnnConfig config = {IsZenDnnEnabled(), GetConvAlgo(),
+                                      IsBlockedFormatEnabled(), GetMempool(),
+                                      /*session_conv_algo=*/false,
+                                      /*session_mempool=*/false};
+  return config;
+}
+
+// Returns the ZenDNN settings of a session. Settings that 'config' does not
+// set fall back to those of the process. 'config' may be null.
+inline ZenDnnConfig GetZenDnnConfig(const ConfigProto *config) {
+  ZenDnnConfig zen_config = GetProcessZenDnnConfig();
+  if (config == nullptr || !config->experimental().has_zendnn_options()) {
+    return zen_config;
+  }
+  const auto &options = config->experimental().zendnn_options();
+  if (options.has_enable_zendnn_opts()) {
+    zen_config.enabled = options.enable_zendnn_opts();
+  }
+  if (options.has_conv_algo()) {
+    zen_config.conv_algo = options.conv_algo();
+    zen_config.blocked_format = (options.conv_algo() == 3);
+    zen_config.session_conv_algo = true;
+  }
+  if (options.has_mempool()) {
+    zen_config.mempool = options.mempool();
+    zen_config.session_mempool = true;
+  }
+  return zen_config;
+}
+
+// Whether eager ops are retargeted to Zen ops in place, instead of being
+// cloned into a new EagerOperation. Enabled by default.
+inline bool IsZenEagerInplaceRewriteEnabled() {
+  static absl::once_flag once;
+  static bool inplace_rewrite = true;
+  absl::call_once(once, [&] {
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_ZEN_EAGER_INPLACE_REWRITE",
+                                   inplace_rewrite, &inplace_rewrite));
+    return inplace_rewrite;
+  });
+  return inplace_rewrite;
 }
 
 }  // namespace tensorflow